@@ -0,0 +1,99 @@
+use std::env;
+use std::fs;
+use std::process;
+
+use wasmtime::{Config, Engine, Result};
+
+struct Options {
+    input: String,
+    output: String,
+    target: Option<String>,
+    memory_reservation: Option<u64>,
+    memory_guard_size: Option<u64>,
+    debug_info: bool,
+}
+
+fn usage() -> ! {
+    eprintln!(
+        "usage: ngx-wasm-compile [--target <triple>] \
+         [--memory-reservation <bytes>] [--memory-guard-size <bytes>] \
+         [--debug-info] <input.wasm> <output.cwasm>"
+    );
+    process::exit(2);
+}
+
+fn parse_size(arg: Option<String>) -> u64 {
+    match arg.as_deref().map(str::parse::<u64>) {
+        Some(Ok(n)) => n,
+        _ => usage(),
+    }
+}
+
+fn parse_args() -> Options {
+    let mut args = env::args().skip(1);
+    let mut files = Vec::new();
+    let mut opts = Options {
+        input: String::new(),
+        output: String::new(),
+        target: None,
+        memory_reservation: None,
+        memory_guard_size: None,
+        debug_info: false,
+    };
+
+    while let Some(arg) = args.next() {
+        match arg.as_str() {
+            "--target" => opts.target = Some(args.next().unwrap_or_else(|| usage())),
+            "--memory-reservation" => opts.memory_reservation = Some(parse_size(args.next())),
+            "--memory-guard-size" => opts.memory_guard_size = Some(parse_size(args.next())),
+            "--debug-info" => opts.debug_info = true,
+            "-h" | "--help" => usage(),
+            _ => files.push(arg),
+        }
+    }
+
+    if files.len() != 2 {
+        usage();
+    }
+
+    opts.output = files.pop().unwrap();
+    opts.input = files.pop().unwrap();
+    opts
+}
+
+fn compile(opts: &Options) -> Result<()> {
+    let mut config = Config::new();
+
+    /* mirror ngx_wasmtime_init_conf() */
+    config.wasm_reference_types(true);
+    config.debug_info(opts.debug_info);
+
+    if let Some(target) = &opts.target {
+        config.target(target)?;
+    }
+
+    if let Some(size) = opts.memory_reservation {
+        config.static_memory_maximum_size(size);
+    }
+
+    if let Some(size) = opts.memory_guard_size {
+        config.static_memory_guard_size(size);
+        config.dynamic_memory_guard_size(size);
+    }
+
+    let engine = Engine::new(&config)?;
+    let bytes = fs::read(&opts.input)?;
+    let artifact = engine.precompile_module(&bytes)?;
+
+    fs::write(&opts.output, artifact)?;
+    Ok(())
+}
+
+fn main() {
+    let opts = parse_args();
+
+    if let Err(e) = compile(&opts) {
+        eprintln!("ngx-wasm-compile: {}: {:?}", opts.input, e);
+        process::exit(1);
+    }
+}
@@ -7,10 +7,14 @@ local wasmx = require "resty.wasmx"
 local C = ffi.C
 local error = error
 local type = type
+local pairs = pairs
+local ipairs = ipairs
 local tonumber = tonumber
 local min = math.min
 local new_tab = table.new
 local insert = table.insert
+local sort = table.sort
+local concat = table.concat
 local str_fmt = string.format
 local ffi_cast = ffi.cast
 local ffi_fill = ffi.fill
@@ -41,6 +45,7 @@ ffi.cdef [[
         NGX_WA_SHM_EVICTION_LRU,
         NGX_WA_SHM_EVICTION_SLRU,
         NGX_WA_SHM_EVICTION_NONE,
+        NGX_WA_SHM_EVICTION_TINYLFU,
     } ngx_wa_shm_eviction_e;
 
     typedef struct {
@@ -50,8 +55,21 @@ ffi.cdef [[
         ngx_log_t                   *log;
         ngx_slab_pool_t             *shpool;
         void                        *data;
+        ngx_uint_t                   nshards;
+        void                        *shards;
+        ngx_uint_t                   optimistic_reads;
+        ngx_uint_t                   hash_index;
+        ngx_uint_t                   lockfree;
+        size_t                       slot_size;
     } ngx_wa_shm_t;
 
+    typedef struct {
+        ngx_uint_t                   hits;
+        ngx_uint_t                   misses;
+        ngx_uint_t                   evictions;
+        ngx_uint_t                   nelts;
+    } ngx_wa_shm_kv_stats_t;
+
     typedef enum {
         NGX_WA_METRIC_COUNTER,
         NGX_WA_METRIC_GAUGE,
@@ -61,6 +79,7 @@ ffi.cdef [[
     typedef enum {
         NGX_WA_HISTOGRAM_LOG2,
         NGX_WA_HISTOGRAM_CUSTOM,
+        NGX_WA_HISTOGRAM_HDR,
     } ngx_wa_histogram_type_e;
 
     typedef struct {
@@ -75,7 +94,8 @@ ffi.cdef [[
 
     typedef struct {
         ngx_wa_histogram_type_e      h_type;
-        uint8_t                      n_bins;
+        uint16_t                     n_bins;
+        uint8_t                      precision;
         uint64_t                     sum;
         ngx_wa_metrics_bin_t         bins[];
     } ngx_wa_metrics_histogram_t;
@@ -105,13 +125,22 @@ ffi.cdef [[
     ngx_uint_t ngx_wa_ffi_shm_kv_nelts(ngx_wa_shm_t *shm);
     ngx_int_t ngx_wa_ffi_shm_kv_get(ngx_wa_shm_t *shm,
                                     ngx_str_t *k,
-                                    ngx_str_t **v,
+                                    ngx_str_t *v,
                                     uint32_t *cas);
     ngx_int_t ngx_wa_ffi_shm_kv_set(ngx_wa_shm_t *shm,
                                     ngx_str_t *k,
                                     ngx_str_t *v,
                                     uint32_t cas,
+                                    ngx_msec_t ttl,
                                     unsigned *written);
+    void ngx_wa_ffi_shm_kv_stats(ngx_wa_shm_t *shm,
+                                 ngx_wa_shm_kv_stats_t *stats);
+    ngx_int_t ngx_wa_ffi_shm_kv_incr(ngx_wa_shm_t *shm,
+                                     ngx_str_t *k,
+                                     int64_t delta,
+                                     int64_t init,
+                                     ngx_msec_t ttl,
+                                     int64_t *value);
 
     ngx_int_t ngx_wa_ffi_shm_metric_define(ngx_str_t *name,
                                            ngx_wa_metric_type_e type,
@@ -126,6 +155,9 @@ ffi.cdef [[
                                         ngx_str_t *name,
                                         u_char *mbuf, size_t mbs,
                                         u_char *hbuf, size_t hbs);
+    ngx_int_t ngx_wa_ffi_shm_metrics_key_name(ngx_str_t *key,
+                                              u_char *buf, size_t len);
+    size_t ngx_wa_ffi_shm_metrics_name_max_len();
 
     void ngx_wa_ffi_shm_lock(ngx_wa_shm_t *shm);
     void ngx_wa_ffi_shm_unlock(ngx_wa_shm_t *shm);
@@ -172,6 +204,9 @@ local _hbs = C.ngx_wa_ffi_shm_metrics_histogram_max_size()
 local _mbuf = ffi_new("u_char[?]", _mbs)
 local _hbuf = ffi_new("u_char[?]", _hbs)
 local _kbuf = ffi_new("ngx_str_t *[?]", DEFAULT_KEYS_PAGE_SIZE)
+local _nbuf, _nbs
+local _vbs = 4096
+local _vbuf = ffi_new("u_char[?]", _vbs)
 
 
 local function shm_lock(zone)
@@ -184,6 +219,25 @@ local function shm_unlock(zone)
 end
 
 
+local function key_str(shm, ckey)
+    if shm.type == _types.ffi_shm.SHM_TYPE_METRICS
+       and ckey.len > 0 and ckey.data[0] == 0
+    then
+        -- series of a labelled metric family, e.g. "name{key=value}"
+        if _nbuf == nil then
+            _nbs = tonumber(C.ngx_wa_ffi_shm_metrics_name_max_len())
+            _nbuf = ffi_new("u_char[?]", _nbs)
+        end
+
+        local n = C.ngx_wa_ffi_shm_metrics_key_name(ckey, _nbuf, _nbs)
+
+        return ffi_str(_nbuf, n)
+    end
+
+    return ffi_str(ckey.data, ckey.len)
+end
+
+
 local function key_iterator(ctx)
     if ctx.i == tonumber(ctx.ccur_index[0]) then
         ngx_sleep(0) -- TODO: support non-yielding phases
@@ -214,8 +268,7 @@ local function key_iterator(ctx)
         ngx_log(DEBUG, "iterate_keys fetched a new page")
     end
 
-    local ckey = ctx.ckeys[ctx.i]
-    local key = ffi_str(ctx.ckeys[ctx.i].data, ctx.ckeys[ctx.i].len)
+    local key = key_str(ctx.shm, ctx.ckeys[ctx.i])
 
     ctx.i = ctx.i + 1
 
@@ -292,7 +345,7 @@ local function shm_get_keys(zone, max_count)
     assert(total == nkeys)
 
     for i = 1, total do
-        keys[i] = ffi_str(ckeys[i - 1].data, ckeys[i - 1].len)
+        keys[i] = key_str(shm, ckeys[i - 1])
     end
 
     return keys
@@ -306,21 +359,51 @@ local function shm_kv_get(zone, key)
 
     local shm = zone[WASM_SHM_KEY]
     local cname = ffi_new("ngx_str_t", { data = key, len = #key })
-    local cvalue = ffi_new("ngx_str_t *[1]")
+    local cvalue = ffi_new("ngx_str_t", { data = _vbuf, len = _vbs })
     local ccas = ffi_new("uint32_t[1]")
 
     local rc = C.ngx_wa_ffi_shm_kv_get(shm, cname, cvalue, ccas)
+
+    while rc == FFI_BUSY do
+        -- value larger than the copy buffer
+        _vbs = tonumber(cvalue.len)
+        _vbuf = ffi_new("u_char[?]", _vbs)
+
+        cvalue.data = _vbuf
+        cvalue.len = _vbs
+
+        rc = C.ngx_wa_ffi_shm_kv_get(shm, cname, cvalue, ccas)
+    end
+
     if rc == FFI_DECLINED then
         return nil
     end
 
     assert_debug(rc == FFI_OK)
 
-    return ffi_str(cvalue[0].data, cvalue[0].len), tonumber(ccas[0])
+    return ffi_str(cvalue.data, cvalue.len), tonumber(ccas[0])
+end
+
+
+local function ttl_msec(ttl)
+    if ttl == nil then
+        return 0
+    end
+
+    if type(ttl) ~= "number" or ttl < 0 then
+        error("ttl must be a number >= 0", 3)
+    end
+
+    if ttl > 0 and ttl < 0.001 then
+        -- round up to 1ms rather than never expire
+        return 1
+    end
+
+    return ttl * 1000
 end
 
 
-local function shm_kv_set(zone, key, value, cas)
+local function shm_kv_set(zone, key, value, cas, ttl)
     if type(key) ~= "string" then
         error("key must be a string", 2)
     end
@@ -336,12 +419,14 @@ local function shm_kv_set(zone, key, value, cas)
         error("cas must be a number", 2)
     end
 
+    local cttl = ttl_msec(ttl)
+
     local shm = zone[WASM_SHM_KEY]
     local cname = ffi_new("ngx_str_t", { data = key, len = #key })
     local cvalue = ffi_new("ngx_str_t", { data = value, len = #value })
     local written = ffi_new("unsigned[1]")
 
-    local rc = C.ngx_wa_ffi_shm_kv_set(shm, cname, cvalue, cas, written)
+    local rc = C.ngx_wa_ffi_shm_kv_set(shm, cname, cvalue, cas, cttl, written)
     if rc == FFI_ERROR then
         return nil, "no memory"
     end
@@ -352,6 +437,92 @@ local function shm_kv_set(zone, key, value, cas)
 end
 
 
+local function shm_kv_incr(zone, key, value, init, init_ttl)
+    if type(key) ~= "string" then
+        error("key must be a string", 2)
+    end
+
+    if type(value) ~= "number" or value % 1 ~= 0 then
+        error("value must be an integer", 2)
+    end
+
+    if init == nil then
+        init = 0
+
+    elseif type(init) ~= "number" or init % 1 ~= 0 then
+        error("init must be an integer", 2)
+    end
+
+    local cttl = ttl_msec(init_ttl)
+
+    local shm = zone[WASM_SHM_KEY]
+    local cname = ffi_new("ngx_str_t", { data = key, len = #key })
+    local cvalue = ffi_new("int64_t[1]")
+
+    local rc = C.ngx_wa_ffi_shm_kv_incr(shm, cname, value, init, cttl,
+                                        cvalue)
+    if rc == FFI_DECLINED then
+        return nil, "not a number"
+    end
+
+    if rc == FFI_ERROR then
+        return nil, "no memory"
+    end
+
+    assert_debug(rc == FFI_OK)
+
+    return tonumber(cvalue[0])
+end
+
+
+local function shm_kv_stats(zone)
+    local cstats = ffi_new("ngx_wa_shm_kv_stats_t")
+
+    C.ngx_wa_ffi_shm_kv_stats(zone[WASM_SHM_KEY], cstats)
+
+    return {
+        hits = tonumber(cstats.hits),
+        misses = tonumber(cstats.misses),
+        evictions = tonumber(cstats.evictions),
+        entries = tonumber(cstats.nelts),
+    }
+end
+
+
+---
+-- Labelled metrics are series of a metric family, named
+-- "name{key1=value1,key2=value2}" with label keys sorted.
+local function labels_suffix(labels)
+    if type(labels) ~= "table" then
+        error("opts.labels must be a table", 3)
+    end
+
+    local keys = {}
+
+    for k, v in pairs(labels) do
+        if type(k) ~= "string" or k == ""
+           or type(v) ~= "string" or v == ""
+        then
+            error("opts.labels must be a table of non-empty strings", 3)
+        end
+
+        insert(keys, k)
+    end
+
+    if #keys == 0 then
+        return ""
+    end
+
+    sort(keys)
+
+    for i, k in ipairs(keys) do
+        keys[i] = k .. "=" .. labels[k]
+    end
+
+    return "{" .. concat(keys, ",") .. "}"
+end
+
+
 local function metrics_define(zone, name, metric_type, opts)
     if type(name) ~= "string" or name == "" then
         error("name must be a non-empty string", 2)
@@ -367,12 +538,17 @@ local function metrics_define(zone, name, metric_type, opts)
 
     local cbins
     local n_bins = 0
+    local labels = ""
 
     if opts ~= nil then
         if type(opts) ~= "table" then
             error("opts must be a table", 2)
         end
 
+        if opts.labels ~= nil then
+            labels = labels_suffix(opts.labels)
+        end
+
         if metric_type == _types.ffi_metric.HISTOGRAM
            and opts.bins ~= nil
         then
@@ -403,7 +579,7 @@ local function metrics_define(zone, name, metric_type, opts)
         end
     end
 
-    name = "lua." .. name
+    name = "lua." .. name .. labels
 
     local cname = ffi_new("ngx_str_t", { data = name, len = #name })
     local m_id = ffi_new("uint32_t[1]")
@@ -418,7 +594,10 @@ local function metrics_define(zone, name, metric_type, opts)
         return nil, "name too long"
     end
 
-    -- FFI_ABORT: unreachable
+    if rc == FFI_ABORT then
+        return nil, "invalid labels"
+    end
+
     assert_debug(rc == FFI_OK)
 
     return tonumber(m_id[0])
@@ -489,14 +668,16 @@ local function parse_cmetric(cmetric)
 
         for i = 0, (ch.n_bins - 1) do
             local cb = ch.bins[i]
-            if cb.upper_bound == 0 then
-                break
-            end
 
             insert(h.value, {
                 ub = cb.upper_bound,
                 count = cb.count,
             })
+
+            -- the last bin has no upper bound; log-linear bins start at 0
+            if cb.upper_bound == 4294967295 then
+                break
+            end
         end
 
         return h
@@ -536,11 +717,16 @@ end
 -- and will by default prefix the given name with `lua.`
 --
 -- This behavior can be disabled by passing `opts.prefix` as false.
+--
+-- A series of a metric family is retrieved by passing its labels in
+-- `opts.labels`.
 local function metrics_get_by_name(zone, name, opts)
     if type(name) ~= "string" or name == "" then
         error("name must be a non-empty string", 2)
     end
 
+    local labels = ""
+
     if opts ~= nil then
         if type(opts) ~= "table" then
             error("opts must be a table", 2)
@@ -549,12 +735,17 @@ local function metrics_get_by_name(zone, name, opts)
         if opts.prefix ~= nil and type(opts.prefix) ~= "boolean" then
             error("opts.prefix must be a boolean", 2)
         end
+
+        if opts.labels ~= nil then
+            labels = labels_suffix(opts.labels)
+        end
     end
 
     ffi_fill(_mbuf, _mbs)
     ffi_fill(_hbuf, _hbs)
 
     name = (opts and opts.prefix == false) and name or "lua." .. name
+    name = name .. labels
 
     local cname = ffi_new("ngx_str_t", { data = name, len = #name })
 
@@ -583,6 +774,8 @@ function(shm)
         _M[zone_name].get_keys = shm_get_keys
         _M[zone_name].get = shm_kv_get
         _M[zone_name].set = shm_kv_set
+        _M[zone_name].incr = shm_kv_incr
+        _M[zone_name].stats = shm_kv_stats
 
     elseif shm.type == _types.ffi_shm.SHM_TYPE_QUEUE then
         -- NYI
@@ -57,6 +57,9 @@ ngx_http_wasm_ffi_plan_new(ngx_wavm_t *vm,
 
     ngx_proxy_wasm_root_init(pwroot, plan->pool);
 
+    pwroot->ipool_min = mcf->pwroot.ipool_min;
+    pwroot->ipool_max = mcf->pwroot.ipool_max;
+
     plan->conf.proxy_wasm.pwroot = pwroot;
     plan->conf.proxy_wasm.worker_pwroot = &mcf->pwroot;
 
@@ -313,11 +316,41 @@ retrieve_keys(ngx_rbtree_node_t *node, ngx_rbtree_node_t *sentinel,
 }
 
 
+static void
+retrieve_slot_keys(ngx_wa_shm_kv_t *kv, ngx_uint_t limit,
+    ngx_uint_t start_idx, ngx_uint_t *cur_idx, ngx_str_t **keys)
+{
+    ngx_uint_t             i;
+    ngx_wa_shm_kv_slot_t  *slot;
+
+    for (i = 0; i < kv->nslots; i++) {
+        if ((*cur_idx - start_idx) == limit) {
+            return;
+        }
+
+        slot = &kv->slots[i];
+
+        if (slot->node == NULL) {
+            continue;
+        }
+
+        if (*cur_idx >= start_idx) {
+            /* append to result */
+            keys[(*cur_idx - start_idx)] = &slot->node->key.str;
+        }
+
+        (*cur_idx)++;
+    }
+}
+
+
 ngx_int_t
 ngx_wa_ffi_shm_iterate_keys(ngx_wa_shm_t *shm, ngx_uint_t page_size,
     ngx_uint_t *clast_idx, ngx_uint_t *cur_idx, ngx_str_t **keys)
 {
+    ngx_uint_t        i, nshards, n, idx;
     ngx_uint_t        last_idx = clast_idx ? *clast_idx : 0;
+    ngx_wa_shm_t     *shard;
     ngx_wa_shm_kv_t  *kv;
 
     ngx_wa_assert(shm->type == NGX_WA_SHM_TYPE_KV
@@ -327,20 +360,44 @@ ngx_wa_ffi_shm_iterate_keys(ngx_wa_shm_t *shm, ngx_uint_t page_size,
         return NGX_ABORT;
     }
 
-    kv = shm->data;
-
-    if (last_idx >= kv->nelts) {
+    if (last_idx >= ngx_wa_ffi_shm_kv_nelts(shm)) {
         /* finished */
         return NGX_DONE;
     }
 
-    /* cannot be empty here (kv->nelts > 0) */
-    ngx_wa_assert(kv->rbtree.root != kv->rbtree.sentinel);
+    /* keys are indexed shard after shard */
 
-    retrieve_keys(kv->rbtree.root, kv->rbtree.sentinel, page_size, last_idx,
-                  cur_idx, keys);
+    idx = last_idx;
+    n = 0;
+    nshards = shm->shards ? shm->nshards : 1;
 
-    *cur_idx -= last_idx;
+    for (i = 0; i < nshards && n < page_size; i++) {
+        shard = shm->shards ? &shm->shards[i] : shm;
+        kv = shard->data;
+
+        if (idx >= kv->nelts) {
+            idx -= kv->nelts;
+            continue;
+        }
+
+        *cur_idx = 0;
+
+        if (shard->hash_index) {
+            retrieve_slot_keys(kv, page_size - n, idx, cur_idx, keys + n);
+
+        } else {
+            /* cannot be empty here (kv->nelts > 0) */
+            ngx_wa_assert(kv->rbtree.root != kv->rbtree.sentinel);
+
+            retrieve_keys(kv->rbtree.root, kv->rbtree.sentinel, page_size - n,
+                          idx, cur_idx, keys + n);
+        }
+
+        n += *cur_idx - idx;
+        idx = 0;
+    }
+
+    *cur_idx = n;
 
     if (clast_idx) {
         *clast_idx += *cur_idx;
@@ -353,60 +410,102 @@ ngx_wa_ffi_shm_iterate_keys(ngx_wa_shm_t *shm, ngx_uint_t page_size,
 ngx_uint_t
 ngx_wa_ffi_shm_kv_nelts(ngx_wa_shm_t *shm)
 {
+    ngx_uint_t        i, nelts;
     ngx_wa_shm_kv_t  *kv;
 
     ngx_wa_assert(shm->type == NGX_WA_SHM_TYPE_KV
                   || shm->type == NGX_WA_SHM_TYPE_METRICS);
 
-    kv = shm->data;
+    if (shm->shards == NULL) {
+        kv = shm->data;
+        return kv->nelts;
+    }
+
+    nelts = 0;
+
+    for (i = 0; i < shm->nshards; i++) {
+        kv = shm->shards[i].data;
+        nelts += kv->nelts;
+    }
 
-    return kv->nelts;
+    return nelts;
 }
 
 
 ngx_int_t
-ngx_wa_ffi_shm_kv_get(ngx_wa_shm_t *shm, ngx_str_t *k, ngx_str_t **v,
+ngx_wa_ffi_shm_kv_get(ngx_wa_shm_t *shm, ngx_str_t *k, ngx_str_t *v,
     uint32_t *cas)
 {
-    ngx_int_t   rc;
-    unsigned    unlock = 0;
+    uint32_t       key_hash;
+    ngx_wa_shm_t  *shard;
 
     ngx_wa_assert(shm->type == NGX_WA_SHM_TYPE_KV);
 
-    if (!ngx_wa_shm_locked(shm)) {
+    key_hash = ngx_crc32_long(k->data, k->len);
+    shard = ngx_wa_shm_kv_shard(shm, key_hash);
+
+    /* copied into v->data, NGX_BUSY if larger than v->len */
+
+    if (ngx_wa_shm_locked(shard)) {
         /* e.g. already locked if in iterate_keys() */
-        ngx_wa_shm_lock(shm);
-        unlock = 1;
+        return ngx_wa_shm_kv_read_locked(shard, k, &key_hash, v, cas);
     }
 
-    rc = ngx_wa_shm_kv_get_locked(shm, k, NULL, v, cas);
+    return ngx_wa_shm_kv_read(shm, k, &key_hash, v, cas);
+}
 
-    if (unlock) {
-        ngx_wa_shm_unlock(shm);
-    }
+
+ngx_int_t
+ngx_wa_ffi_shm_kv_set(ngx_wa_shm_t *shm, ngx_str_t *k, ngx_str_t *v,
+    uint32_t cas, ngx_msec_t ttl, unsigned *written)
+{
+    ngx_int_t      rc;
+    ngx_wa_shm_t  *shard;
+
+    ngx_wa_assert(shm->type == NGX_WA_SHM_TYPE_KV);
+
+    shard = ngx_wa_shm_kv_shard(shm, ngx_crc32_long(k->data, k->len));
+
+    ngx_wa_shm_lock(shard);
+
+    rc = ngx_wa_shm_kv_set_locked(shard, k, v, cas, ttl, written);
+
+    ngx_wa_shm_unlock(shard);
 
     return rc;
 }
 
 
 ngx_int_t
-ngx_wa_ffi_shm_kv_set(ngx_wa_shm_t *shm, ngx_str_t *k, ngx_str_t *v,
-    uint32_t cas, unsigned *written)
+ngx_wa_ffi_shm_kv_incr(ngx_wa_shm_t *shm, ngx_str_t *k, int64_t delta,
+    int64_t init, ngx_msec_t ttl, int64_t *value)
 {
-    ngx_int_t  rc;
+    ngx_int_t      rc;
+    ngx_wa_shm_t  *shard;
 
     ngx_wa_assert(shm->type == NGX_WA_SHM_TYPE_KV);
 
-    ngx_wa_shm_lock(shm);
+    shard = ngx_wa_shm_kv_shard(shm, ngx_crc32_long(k->data, k->len));
+
+    ngx_wa_shm_lock(shard);
 
-    rc = ngx_wa_shm_kv_set_locked(shm, k, v, cas, written);
+    rc = ngx_wa_shm_kv_incr_locked(shard, k, delta, init, ttl, value);
 
-    ngx_wa_shm_unlock(shm);
+    ngx_wa_shm_unlock(shard);
 
     return rc;
 }
 
 
+void
+ngx_wa_ffi_shm_kv_stats(ngx_wa_shm_t *shm, ngx_wa_shm_kv_stats_t *stats)
+{
+    ngx_wa_assert(shm->type == NGX_WA_SHM_TYPE_KV);
+
+    ngx_wa_shm_kv_stats(shm, stats);
+}
+
+
 ngx_int_t
 ngx_wa_ffi_shm_metric_define(ngx_str_t *name, ngx_wa_metric_type_e type,
     uint32_t *bins, uint16_t n_bins, uint32_t *metric_id)
@@ -455,6 +554,32 @@ ngx_wa_ffi_shm_metric_get(uint32_t metric_id, ngx_str_t *name, u_char *m_buf,
         return ngx_wa_metrics_get(metrics, metric_id, m);
     }
 
-    return ngx_wa_metrics_get(metrics,
-                              ngx_crc32_long(name->data, name->len), m);
+    if (ngx_wa_metrics_lookup(metrics, name, &metric_id) != NGX_OK) {
+        return NGX_DECLINED;
+    }
+
+    return ngx_wa_metrics_get(metrics, metric_id, m);
+}
+
+
+ngx_int_t
+ngx_wa_ffi_shm_metrics_key_name(ngx_str_t *key, u_char *buf, size_t len)
+{
+    ngx_wa_metrics_t  *metrics = ngx_wasmx_metrics((ngx_cycle_t *) ngx_cycle);
+
+    if (!ngx_wa_metrics_is_series(key)) {
+        return ngx_cpymem(buf, key->data, ngx_min(key->len, len)) - buf;
+    }
+
+    return ngx_wa_metrics_series_name(metrics, key, buf, buf + len) - buf;
+}
+
+
+size_t
+ngx_wa_ffi_shm_metrics_name_max_len()
+{
+    ngx_wa_metrics_t  *metrics = ngx_wasmx_metrics((ngx_cycle_t *) ngx_cycle);
+
+    return metrics->config.max_metric_name_length
+           + NGX_WA_METRICS_LABELS_MAX_LEN;
 }
@@ -53,9 +53,13 @@ ngx_int_t ngx_wa_ffi_shm_iterate_keys(ngx_wa_shm_t *shm, ngx_uint_t page_size,
 
 ngx_uint_t ngx_wa_ffi_shm_kv_nelts(ngx_wa_shm_t *shm);
 ngx_int_t ngx_wa_ffi_shm_kv_get(ngx_wa_shm_t *shm, ngx_str_t *k,
-    ngx_str_t **v, uint32_t *cas);
+    ngx_str_t *v, uint32_t *cas);
 ngx_int_t ngx_wa_ffi_shm_kv_set(ngx_wa_shm_t *shm, ngx_str_t *k,
-    ngx_str_t *v, uint32_t cas, unsigned *written);
+    ngx_str_t *v, uint32_t cas, ngx_msec_t ttl, unsigned *written);
+void ngx_wa_ffi_shm_kv_stats(ngx_wa_shm_t *shm,
+    ngx_wa_shm_kv_stats_t *stats);
+ngx_int_t ngx_wa_ffi_shm_kv_incr(ngx_wa_shm_t *shm, ngx_str_t *k,
+    int64_t delta, int64_t init, ngx_msec_t ttl, int64_t *value);
 
 ngx_int_t ngx_wa_ffi_shm_metric_define(ngx_str_t *name,
     ngx_wa_metric_type_e type, uint32_t *bins, uint16_t n_bins,
@@ -64,6 +68,9 @@ ngx_int_t ngx_wa_ffi_shm_metric_increment(uint32_t metric_id, ngx_uint_t value);
 ngx_int_t ngx_wa_ffi_shm_metric_record(uint32_t metric_id, ngx_uint_t value);
 ngx_int_t ngx_wa_ffi_shm_metric_get(uint32_t metric_id, ngx_str_t *name,
     u_char *m_buf, size_t mbs, u_char *h_buf, size_t hbs);
+ngx_int_t ngx_wa_ffi_shm_metrics_key_name(ngx_str_t *key, u_char *buf,
+    size_t len);
+size_t ngx_wa_ffi_shm_metrics_name_max_len();
 
 
 void
@@ -26,6 +26,62 @@ bin_log2_upper_bound(ngx_uint_t n)
 }
 
 
+static ngx_uint_t
+bin_msb(uint32_t n)
+{
+#if (defined __GNUC__ || defined __clang__)
+    return 31 - __builtin_clz(n);
+#else
+    ngx_uint_t  s, r = 0;
+
+    for (s = 16; s; s >>= 1) {
+        if (n >> s) {
+            n >>= s;
+            r += s;
+        }
+    }
+
+    return r;
+#endif
+}
+
+
+/*
+ * Log-linear (HDR) bins: values below 2^p each have their own bin, then
+ * every [2^e, 2^(e+1)) range is split in 2^p bins of equal width, hence
+ * a relative error bounded by 2^-p.
+ */
+static ngx_uint_t
+bin_hdr_index(ngx_uint_t p, ngx_uint_t n)
+{
+    ngx_uint_t  e;
+
+    n = ngx_min(n, NGX_MAX_UINT32_VALUE);
+
+    if (n < ((ngx_uint_t) 1 << p)) {
+        return n;
+    }
+
+    e = bin_msb((uint32_t) n);
+
+    return ((e - p + 1) << p) + ((n >> (e - p)) & (((ngx_uint_t) 1 << p) - 1));
+}
+
+
+static uint32_t
+bin_hdr_upper_bound(ngx_uint_t p, ngx_uint_t i)
+{
+    ngx_uint_t  g = i >> p;
+    uint64_t    m = ((uint64_t) 1 << p) + (i & (((ngx_uint_t) 1 << p) - 1));
+
+    if (g == 0) {
+        return (uint32_t) i;
+    }
+
+    return (uint32_t) (((m + 1) << (g - 1)) - 1);
+}
+
+
 static ngx_int_t
 histogram_grow(ngx_wa_metrics_t *metrics, ngx_wa_metrics_histogram_t *h,
     ngx_wa_metrics_histogram_t **out)
@@ -141,12 +197,54 @@ histogram_log2_bin(ngx_wa_metrics_t *metrics, ngx_wa_metrics_histogram_t *h,
 }
 
 
+static void
+histogram_hdr_get(ngx_wa_metrics_t *metrics, ngx_wa_metric_t *m,
+    ngx_uint_t slots, ngx_wa_metrics_histogram_t *out)
+{
+    size_t                       i, j, k = 0;
+    uint32_t                     count;
+    ngx_wa_metrics_bin_t        *out_b;
+    ngx_wa_metrics_histogram_t  *h;
+
+    h = ngx_wa_metrics_slot(metrics, m, 0)->histogram;
+
+    /* all slots share the same layout; only non-empty bins are output */
+    for (j = 0; j < h->n_bins; j++) {
+        count = 0;
+
+        for (i = 0; i < slots; i++) {
+            count += ngx_wa_metrics_slot(metrics, m, i)->histogram
+                     ->bins[j].count;
+        }
+
+        if (count == 0 && j < (size_t) h->n_bins - 1) {
+            continue;
+        }
+
+        out_b = &out->bins[k];
+
+        if (k < (size_t) out->n_bins - 1) {
+            /* otherwise folded into the last bin */
+            out_b->count = 0;
+            k++;
+        }
+
+        out_b->upper_bound = h->bins[j].upper_bound;
+        out_b->count += count;
+    }
+
+    for (i = 0; i < slots; i++) {
+        out->sum += ngx_wa_metrics_slot(metrics, m, i)->histogram->sum;
+    }
+}
+
+
 #if (NGX_DEBUG)
 static void
 histogram_log(ngx_wa_metrics_t *metrics, ngx_wa_metric_t *m)
 {
     size_t                       i;
-    u_char                      *p;
+    u_char                      *p, *last;
     ngx_wa_metrics_bin_t        *b;
     ngx_wa_metrics_histogram_t  *h;
     u_char                       h_buf[NGX_WA_METRICS_HISTOGRAM_MAX_SIZE];
@@ -155,22 +253,24 @@ histogram_log(ngx_wa_metrics_t *metrics, ngx_wa_metric_t *m)
     ngx_memzero(h_buf, sizeof(h_buf));
 
     p = s_buf;
+    last = s_buf + sizeof(s_buf);
     h = (ngx_wa_metrics_histogram_t *) h_buf;
-    h->n_bins = NGX_WA_METRICS_HISTOGRAM_BINS_MAX;
+    h->n_bins = (sizeof(h_buf) - sizeof(ngx_wa_metrics_histogram_t))
+                / sizeof(ngx_wa_metrics_bin_t);
     h->bins[0].upper_bound = NGX_MAX_UINT32_VALUE;
 
     ngx_wa_metrics_histogram_get(metrics, m, metrics->workers, h);
 
     for (i = 0; i < h->n_bins; i++) {
         b = &h->bins[i];
-        p = ngx_sprintf(p, " %uD: %uD;", b->upper_bound, b->count);
+        p = ngx_slprintf(p, last, " %uD: %uD;", b->upper_bound, b->count);
 
         if (b->upper_bound == NGX_MAX_UINT32_VALUE) {
             break;
         }
     }
 
-    p = ngx_sprintf(p, " SUM: %uD;", h->sum);
+    p = ngx_slprintf(p, last, " SUM: %uD;", h->sum);
 
     ngx_log_debug2(NGX_LOG_DEBUG_WASM, metrics->shm->log, 0,
                    "histogram: %*s",
@@ -185,9 +285,12 @@ ngx_wa_metrics_histogram_add_locked(ngx_wa_metrics_t *metrics, uint32_t *bins,
 {
     size_t                        i, j = 0;
     uint16_t                      n_bins = NGX_WA_METRICS_HISTOGRAM_BINS_INIT;
+    ngx_uint_t                    precision;
     ngx_wa_histogram_type_e       h_type = NGX_WA_HISTOGRAM_LOG2;
     ngx_wa_metrics_histogram_t  **h;
 
+    precision = metrics->config.histogram_precision;
+
     if (bins) {
         if (cn_bins >= NGX_WA_METRICS_HISTOGRAM_BINS_MAX) {
             return NGX_ABORT;
@@ -196,12 +299,18 @@ ngx_wa_metrics_histogram_add_locked(ngx_wa_metrics_t *metrics, uint32_t *bins,
         /* user-defined set of bins + a bin with NGX_MAX_UINT32_VALUE upper-bound */
         n_bins = cn_bins + 1;
         h_type = NGX_WA_HISTOGRAM_CUSTOM;
+
+    } else if (precision) {
+        /* fixed layout, never grown */
+        n_bins = NGX_WA_METRICS_HISTOGRAM_HDR_BINS(precision);
+        h_type = NGX_WA_HISTOGRAM_HDR;
     }
 
-    ngx_wa_assert(n_bins <= NGX_WA_METRICS_HISTOGRAM_BINS_MAX);
+    ngx_wa_assert(n_bins <= NGX_WA_METRICS_HISTOGRAM_BINS_MAX
+                  || h_type == NGX_WA_HISTOGRAM_HDR);
 
     for (i = 0; i < metrics->workers; i++) {
-        h = &m->slots[i].histogram;
+        h = &ngx_wa_metrics_slot(metrics, m, i)->histogram;
         *h = ngx_slab_calloc_locked(metrics->shm->shpool,
                                     sizeof(ngx_wa_metrics_histogram_t)
                                     + sizeof(ngx_wa_metrics_bin_t) * n_bins);
@@ -212,7 +321,14 @@ ngx_wa_metrics_histogram_add_locked(ngx_wa_metrics_t *metrics, uint32_t *bins,
         (*h)->n_bins = n_bins;
         (*h)->h_type = h_type;
 
-        if (bins) {
+        if (h_type == NGX_WA_HISTOGRAM_HDR) {
+            (*h)->precision = precision;
+
+            for (j = 0; j < (size_t) n_bins - 1; j++) {
+                (*h)->bins[j].upper_bound = bin_hdr_upper_bound(precision, j);
+            }
+
+        } else if (bins) {
             /* user-defined set of bins */
             for (j = 0; j < (size_t) n_bins - 1; j++) {
                 (*h)->bins[j].upper_bound = bins[j];
@@ -230,30 +346,86 @@ error:
                        "cannot allocate histogram");
 
     for (/* void */ ; i > 0; i--) {
-        ngx_slab_free_locked(metrics->shm->shpool, m->slots[i - 1].histogram);
+        ngx_slab_free_locked(metrics->shm->shpool,
+                             ngx_wa_metrics_slot(metrics, m, i - 1)
+                             ->histogram);
     }
 
     return NGX_ERROR;
 }
 
 
+/**
+ * Add the bins of an aggregated histogram (e.g. from a previous cycle)
+ * to a slot, whatever its layout.
+ */
+ngx_int_t
+ngx_wa_metrics_histogram_merge(ngx_wa_metrics_t *metrics, ngx_wa_metric_t *m,
+    ngx_uint_t slot, ngx_wa_metrics_histogram_t *src)
+{
+    size_t                       i;
+    ngx_wa_metric_val_t         *val;
+    ngx_wa_metrics_bin_t        *sb, *b;
+    ngx_wa_metrics_histogram_t  *h;
+
+    val = ngx_wa_metrics_slot(metrics, m, slot);
+
+    for (i = 0; i < src->n_bins; i++) {
+        sb = &src->bins[i];
+        h = val->histogram;
+
+        if (sb->count) {
+            switch (h->h_type) {
+            case NGX_WA_HISTOGRAM_LOG2:
+                b = histogram_log2_bin(metrics, h, sb->upper_bound,
+                                       &val->histogram);
+                break;
+            case NGX_WA_HISTOGRAM_CUSTOM:
+                b = histogram_custom_bin(h, sb->upper_bound);
+                break;
+            case NGX_WA_HISTOGRAM_HDR:
+                b = &h->bins[bin_hdr_index(h->precision, sb->upper_bound)];
+                break;
+            default:
+                return NGX_ERROR;
+            }
+
+            b->count += sb->count;
+        }
+
+        if (sb->upper_bound == NGX_MAX_UINT32_VALUE) {
+            break;
+        }
+    }
+
+    val->histogram->sum += src->sum;
+
+    return NGX_OK;
+}
+
+
 ngx_int_t
 ngx_wa_metrics_histogram_record(ngx_wa_metrics_t *metrics, ngx_wa_metric_t *m,
     ngx_uint_t slot, ngx_uint_t n)
 {
+    ngx_wa_metric_val_t         *val;
     ngx_wa_metrics_bin_t        *b;
     ngx_wa_metrics_histogram_t  *h;
 
-    h = m->slots[slot].histogram;
+    val = ngx_wa_metrics_slot(metrics, m, slot);
+    h = val->histogram;
     h->sum += n;
 
     switch (h->h_type) {
     case NGX_WA_HISTOGRAM_LOG2:
-        b = histogram_log2_bin(metrics, h, n, &m->slots[slot].histogram);
+        b = histogram_log2_bin(metrics, h, n, &val->histogram);
         break;
     case NGX_WA_HISTOGRAM_CUSTOM:
         b = histogram_custom_bin(h, n);
         break;
+    case NGX_WA_HISTOGRAM_HDR:
+        b = &h->bins[bin_hdr_index(h->precision, n)];
+        break;
     default:
         return NGX_ERROR;
     }
@@ -278,8 +450,15 @@ ngx_wa_metrics_histogram_get(ngx_wa_metrics_t *metrics, ngx_wa_metric_t *m,
     ngx_wa_metrics_bin_t        *b, *out_b;
     ngx_wa_metrics_histogram_t  *h;
 
+    h = ngx_wa_metrics_slot(metrics, m, 0)->histogram;
+
+    if (h->h_type == NGX_WA_HISTOGRAM_HDR) {
+        histogram_hdr_get(metrics, m, slots, out);
+        return;
+    }
+
     for (i = 0; i < slots; i++) {
-        h = m->slots[i].histogram;
+        h = ngx_wa_metrics_slot(metrics, m, i)->histogram;
 
         for (j = 0; j < h->n_bins; j++) {
             b = &h->bins[j];
@@ -32,12 +32,12 @@ ngx_wa_metric_type_name(ngx_wa_metric_type_e type)
 
 
 static ngx_uint_t
-get_counter(ngx_wa_metric_t *m, ngx_uint_t slots)
+get_counter(ngx_wa_metrics_t *metrics, ngx_wa_metric_t *m)
 {
     ngx_uint_t  i, val = 0;
 
-    for (i = 0; i < slots; i++) {
-        val += m->slots[i].counter;
+    for (i = 0; i < metrics->workers; i++) {
+        val += ngx_wa_metrics_slot(metrics, m, i)->counter;
     }
 
     return val;
@@ -45,18 +45,22 @@ get_counter(ngx_wa_metric_t *m, ngx_uint_t slots)
 
 
 static ngx_uint_t
-get_gauge(ngx_wa_metric_t *m, ngx_uint_t slots)
+get_gauge(ngx_wa_metrics_t *metrics, ngx_wa_metric_t *m)
 {
-    ngx_msec_t  l;
-    ngx_uint_t  i, val = 0;
+    ngx_msec_t               l;
+    ngx_uint_t               i, val = 0;
+    ngx_wa_metrics_gauge_t  *g;
+
+    g = &ngx_wa_metrics_slot(metrics, m, 0)->gauge;
+    val = g->value;
+    l = g->last_update;
 
-    val = m->slots[0].gauge.value;
-    l = m->slots[0].gauge.last_update;
+    for (i = 1; i < metrics->workers; i++) {
+        g = &ngx_wa_metrics_slot(metrics, m, i)->gauge;
 
-    for (i = 1; i < slots; i++) {
-        if (m->slots[i].gauge.last_update > l) {
-            val = m->slots[i].gauge.value;
-            l = m->slots[i].gauge.last_update;
+        if (g->last_update > l) {
+            val = g->value;
+            l = g->last_update;
         }
     }
 
@@ -64,14 +68,53 @@ get_gauge(ngx_wa_metric_t *m, ngx_uint_t slots)
 }
 
 
+/**
+ * Metrics are never removed from their zone: once resolved, a metric's
+ * address is cached for the lifetime of the cycle (and its zone), and
+ * updates skip the zone lookup.
+ */
+static ngx_int_t
+resolve_metric(ngx_wa_metrics_t *metrics, uint32_t mid, ngx_wa_metric_t **out)
+{
+    uint32_t                       cas;
+    ngx_int_t                      rc;
+    ngx_str_t                     *val;
+    ngx_wa_metrics_cache_entry_t  *e;
+
+    e = &metrics->cache[mid & (NGX_WA_METRICS_CACHE_SIZE - 1)];
+
+    if (e->m && e->mid == mid) {
+        *out = e->m;
+        return NGX_OK;
+    }
+
+    rc = ngx_wa_shm_kv_get_locked(metrics->shm, NULL, &mid, &val, &cas);
+    if (rc != NGX_OK) {
+        return rc;
+    }
+
+    ngx_log_debug1(NGX_LOG_DEBUG_WASM, metrics->shm->log, 0,
+                   "wasm caching metric \"%uD\" handle", mid);
+
+    e->mid = mid;
+    e->m = (ngx_wa_metric_t *) val->data;
+
+    *out = e->m;
+
+    return NGX_OK;
+}
+
+
 static ngx_int_t
 realloc_histogram(ngx_wa_metrics_t *metrics, ngx_wa_metric_t *old_m,
     uint32_t mid)
 {
-    uint32_t          cas, slots = metrics->old_metrics->workers;
-    ngx_int_t         rc;
-    ngx_str_t        *val;
-    ngx_wa_metric_t  *m;
+    uint32_t                     cas, slots = metrics->old_metrics->workers;
+    ngx_int_t                    rc;
+    ngx_str_t                   *val;
+    ngx_wa_metric_t             *m;
+    ngx_wa_metrics_histogram_t  *h;
+    u_char                       h_buf[NGX_WA_METRICS_HISTOGRAM_MAX_SIZE];
 
     rc = ngx_wa_shm_kv_get_locked(metrics->shm, NULL, &mid, &val, &cas);
     if (rc != NGX_OK) {
@@ -80,9 +123,18 @@ realloc_histogram(ngx_wa_metrics_t *metrics, ngx_wa_metric_t *old_m,
 
     m = (ngx_wa_metric_t *) val->data;
 
-    ngx_wa_metrics_histogram_get(metrics, old_m, slots, m->slots[0].histogram);
+    ngx_memzero(h_buf, sizeof(h_buf));
 
-    return NGX_OK;
+    h = (ngx_wa_metrics_histogram_t *) h_buf;
+    h->n_bins = (sizeof(h_buf) - sizeof(ngx_wa_metrics_histogram_t))
+                / sizeof(ngx_wa_metrics_bin_t);
+    h->bins[0].upper_bound = NGX_MAX_UINT32_VALUE;
+
+    /* old values laid out as per the old configuration */
+    ngx_wa_metrics_histogram_get(metrics->old_metrics, old_m, slots, h);
+
+    /* the new layout may differ (e.g. histogram_precision changed) */
+    return ngx_wa_metrics_histogram_merge(metrics, m, 0, h);
 }
 
 
@@ -92,34 +144,48 @@ realloc_metrics(ngx_wa_metrics_t *metrics, ngx_rbtree_node_t *node,
 {
     uint32_t               mid;
     ngx_int_t              rc;
+    ngx_str_t              name;
     ngx_uint_t             val;
     ngx_wa_shm_kv_node_t  *n = (ngx_wa_shm_kv_node_t *) node;
     ngx_wa_metric_t       *m = (ngx_wa_metric_t *) n->value.data;
+    u_char                 buf[metrics->old_metrics->config
+                               .max_metric_name_length
+                               + NGX_WA_METRICS_LABELS_MAX_LEN];
 
     if (node == sentinel) {
         return NGX_OK;
     }
 
+    name = n->key.str;
+
+    if (ngx_wa_metrics_is_series(&name)) {
+        /* series are redefined from their labels in the new zone */
+        name.data = buf;
+        name.len = ngx_wa_metrics_series_name(metrics->old_metrics,
+                                              &n->key.str, buf,
+                                              buf + sizeof(buf))
+                   - buf;
+    }
+
     ngx_log_debug1(NGX_LOG_DEBUG_WASM, metrics->shm->log, 0,
-                   "reallocating metric \"%V\"", &n->key.str);
+                   "reallocating metric \"%V\"", &name);
 
-    if (ngx_wa_metrics_define(metrics, &n->key.str, m->type, NULL, 0, &mid)
+    if (ngx_wa_metrics_define(metrics, &name, m->type, NULL, 0, &mid)
         != NGX_OK)
     {
         ngx_wasm_log_error(NGX_LOG_ERR, metrics->shm->log, 0,
-                           "failed redefining metric \"%V\"",
-                           &n->key.str);
+                           "failed redefining metric \"%V\"", &name);
         return NGX_ERROR;
     }
 
     switch (m->type) {
     case NGX_WA_METRIC_COUNTER:
-        val = get_counter(m, metrics->old_metrics->workers);
+        val = get_counter(metrics->old_metrics, m);
         rc = ngx_wa_metrics_increment(metrics, mid, val);
         break;
 
     case NGX_WA_METRIC_GAUGE:
-        val = get_gauge(m, metrics->old_metrics->workers);
+        val = get_gauge(metrics->old_metrics, m);
         rc = ngx_wa_metrics_record(metrics, mid, val);
         break;
 
@@ -134,7 +200,7 @@ realloc_metrics(ngx_wa_metrics_t *metrics, ngx_rbtree_node_t *node,
 
     if (rc != NGX_OK) {
         ngx_wasm_log_error(NGX_LOG_ERR, metrics->shm->log, 0,
-                           "failed updating metric \"%V\"", &n->key.str);
+                           "failed updating metric \"%V\"", &name);
         return NGX_ERROR;
     }
 
@@ -168,6 +234,9 @@ ngx_wa_metrics_alloc(ngx_cycle_t *cycle)
     metrics->old_metrics = ngx_wasmx_metrics(cycle->old_cycle);
     metrics->config.slab_size = NGX_CONF_UNSET_SIZE;
     metrics->config.max_metric_name_length = NGX_CONF_UNSET_SIZE;
+    metrics->config.max_metric_series = NGX_CONF_UNSET_UINT;
+    metrics->config.histogram_precision = NGX_CONF_UNSET_UINT;
+    metrics->config.slot_layout = NGX_CONF_UNSET_UINT;
 
     metrics->shm = ngx_pcalloc(cycle->pool, sizeof(ngx_wa_shm_t));
     if (metrics->shm == NULL) {
@@ -175,6 +244,14 @@ ngx_wa_metrics_alloc(ngx_cycle_t *cycle)
         return NULL;
     }
 
+    /* copied in each worker, dropped with the cycle */
+    metrics->cache = ngx_pcalloc(cycle->pool,
+                                 sizeof(ngx_wa_metrics_cache_entry_t)
+                                 * NGX_WA_METRICS_CACHE_SIZE);
+    if (metrics->cache == NULL) {
+        return NULL;
+    }
+
     metrics->shm->log = &cycle->new_log;
     metrics->shm->name = shm_name;
     metrics->shm->type = NGX_WA_SHM_TYPE_METRICS;
@@ -205,9 +282,29 @@ ngx_wa_metrics_init_conf(ngx_conf_t *cf)
             NGX_WA_METRICS_DEFAULT_MAX_NAME_LEN;
     }
 
+    if (metrics->config.max_metric_series == NGX_CONF_UNSET_UINT) {
+        metrics->config.max_metric_series = NGX_WA_METRICS_DEFAULT_MAX_SERIES;
+    }
+
+    if (metrics->config.histogram_precision == NGX_CONF_UNSET_UINT) {
+        /* log2 bins */
+        metrics->config.histogram_precision = 0;
+    }
+
     /* TODO: if eviction is enabled, metrics->workers must be set to 1 */
     metrics->workers = ccf->worker_processes;
 
+    if (metrics->config.slot_layout == NGX_CONF_UNSET_UINT) {
+        metrics->config.slot_layout = NGX_WA_METRICS_SLOTS_PACKED;
+    }
+
+    metrics->slot_stride = sizeof(ngx_wa_metric_val_t);
+
+    if (metrics->config.slot_layout == NGX_WA_METRICS_SLOTS_PADDED) {
+        metrics->slot_stride = ngx_align(sizeof(ngx_wa_metric_val_t),
+                                         NGX_CPU_CACHE_LINE);
+    }
+
     metrics->mapping = ngx_array_push(shms);
     if (metrics->mapping == NULL) {
         return NULL;
@@ -227,7 +324,13 @@ ngx_wa_metrics_init_conf(ngx_conf_t *cf)
 
     if (old_metrics
         && (metrics->workers != old_metrics->workers
-            || metrics->config.slab_size != old_metrics->config.slab_size))
+            || metrics->config.slab_size != old_metrics->config.slab_size
+            || metrics->config.slot_layout
+               != old_metrics->config.slot_layout
+            || metrics->config.max_metric_series
+               != old_metrics->config.max_metric_series
+            || metrics->config.histogram_precision
+               != old_metrics->config.histogram_precision))
     {
         metrics->mapping->zone->noreuse = 1;
     }
@@ -254,6 +357,11 @@ ngx_wa_metrics_shm_init(ngx_cycle_t *cycle)
         return rc;
     }
 
+    rc = ngx_wa_metrics_families_init(metrics);
+    if (rc != NGX_OK) {
+        return rc;
+    }
+
     if (metrics->old_metrics && metrics->mapping->zone->noreuse) {
         /* mark the old kv store for cleanup during SIGHUP old_cycle free */
         metrics->old_metrics->mapping->zone->noreuse = 1;
@@ -271,6 +379,9 @@ ngx_wa_metrics_shm_init(ngx_cycle_t *cycle)
 
 
 /**
+ * Labelled names ("name{key=value,...}") define a series of the "name"
+ * family, see ngx_wa_metrics_series_define_locked.
+ *
  * NGX_OK: success
  * NGX_BUSY: name too long
  * NGX_ABORT: bad usage
@@ -280,14 +391,8 @@ ngx_int_t
 ngx_wa_metrics_define(ngx_wa_metrics_t *metrics, ngx_str_t *name,
     ngx_wa_metric_type_e type, uint32_t *bins, uint16_t n_bins, uint32_t *out)
 {
-    ssize_t           size = sizeof(ngx_wa_metric_t)
-                             + sizeof(ngx_wa_metric_val_t) * metrics->workers;
-    uint32_t          cas, mid;
-    unsigned          written;
-    ngx_int_t         rc;
-    ngx_str_t        *p, val;
-    ngx_wa_metric_t  *m;
-    u_char            buf[size];
+    ngx_int_t                rc;
+    ngx_wa_metrics_labels_t  labels;
 
     if (type != NGX_WA_METRIC_COUNTER
         && type != NGX_WA_METRIC_GAUGE
@@ -296,14 +401,74 @@ ngx_wa_metrics_define(ngx_wa_metrics_t *metrics, ngx_str_t *name,
         return NGX_ABORT;
     }
 
-    if (name->len > metrics->config.max_metric_name_length) {
-        return NGX_BUSY;
-    }
+    rc = ngx_wa_metrics_labels_parse(metrics, name, &labels);
+    if (rc == NGX_DECLINED) {
+        if (name->len > metrics->config.max_metric_name_length) {
+            return NGX_BUSY;
+        }
+
+        if (ngx_wa_metrics_is_series(name)) {
+            /* reserved for series keys */
+            return NGX_ABORT;
+        }
 
-    mid = ngx_crc32_long(name->data, name->len);
+    } else if (rc != NGX_OK) {
+        return rc;
+    }
 
     ngx_wa_shm_lock(metrics->shm);
 
+    if (rc == NGX_OK) {
+        rc = ngx_wa_metrics_series_define_locked(metrics, &labels, type,
+                                                 bins, n_bins, out);
+
+    } else {
+        rc = ngx_wa_metrics_define_locked(metrics, name, type, bins, n_bins,
+                                          out);
+    }
+
+    ngx_wa_shm_unlock(metrics->shm);
+
+    if (rc == NGX_OK) {
+        ngx_log_debug3(NGX_LOG_DEBUG_WASM, metrics->shm->log, 0,
+                       "defined %V \"%V\" with id %uD",
+                       ngx_wa_metric_type_name(type), name, *out);
+    }
+
+    ngx_wa_assert(rc == NGX_OK
+                  || rc == NGX_ERROR
+                  || rc == NGX_ABORT);
+
+    return rc;
+}
+
+
+/**
+ * Define a metric under key, or return the existing one.
+ *
+ * NGX_OK: success
+ * NGX_ABORT: bad usage
+ * NGX_ERROR: no memory
+ */
+ngx_int_t
+ngx_wa_metrics_define_locked(ngx_wa_metrics_t *metrics, ngx_str_t *key,
+    ngx_wa_metric_type_e type, uint32_t *bins, uint16_t n_bins, uint32_t *out)
+{
+    ssize_t           size = sizeof(ngx_wa_metric_t)
+                             + metrics->slot_stride * metrics->workers
+                             + (metrics->config.slot_layout
+                                == NGX_WA_METRICS_SLOTS_PADDED
+                                ? NGX_CPU_CACHE_LINE : 0);
+    uint32_t          cas, mid;
+    unsigned          written;
+    ngx_int_t         rc;
+    ngx_uint_t        i;
+    ngx_str_t        *p, val;
+    ngx_wa_metric_t  *m, *stored;
+    u_char            buf[size];
+
+    mid = ngx_crc32_long(key->data, key->len);
+
     rc = ngx_wa_shm_kv_get_locked(metrics->shm, NULL, &mid, &p, &cas);
     if (rc == NGX_OK) {
         ngx_log_debug1(NGX_LOG_DEBUG_WASM, metrics->shm->log, 0,
@@ -320,35 +485,71 @@ ngx_wa_metrics_define(ngx_wa_metrics_t *metrics, ngx_str_t *name,
     if (type == NGX_WA_METRIC_HISTOGRAM) {
         rc = ngx_wa_metrics_histogram_add_locked(metrics, bins, n_bins, m);
         if (rc != NGX_OK) {
-            goto error;
+            return rc;
         }
     }
 
     val.len = size;
     val.data = buf;
 
-    rc = ngx_wa_shm_kv_set_locked(metrics->shm, name, &val, 0, &written);
+    rc = ngx_wa_shm_kv_set_locked(metrics->shm, key, &val, 0, 0, &written);
     if (rc != NGX_OK) {
-        goto error;
+        return NGX_ERROR;
+    }
+
+    if (type == NGX_WA_METRIC_HISTOGRAM
+        && metrics->config.slot_layout == NGX_WA_METRICS_SLOTS_PADDED)
+    {
+        /* padded slots are aligned from the stored copy's address */
+        rc = ngx_wa_shm_kv_get_locked(metrics->shm, NULL, &mid, &p, &cas);
+        if (rc != NGX_OK) {
+            return NGX_ERROR;
+        }
+
+        stored = (ngx_wa_metric_t *) p->data;
+
+        for (i = 0; i < metrics->workers; i++) {
+            ngx_wa_metrics_slot(metrics, stored, i)->histogram =
+                ngx_wa_metrics_slot(metrics, m, i)->histogram;
+        }
     }
 
 done:
 
     *out = mid;
 
-error:
+    return NGX_OK;
+}
 
-    ngx_wa_shm_unlock(metrics->shm);
 
-    if (rc == NGX_OK) {
-        ngx_log_debug3(NGX_LOG_DEBUG_WASM, metrics->shm->log, 0,
-                       "defined %V \"%V\" with id %uD",
-                       ngx_wa_metric_type_name(type), name, mid);
+/**
+ * Resolve the id of a (possibly labelled) metric name.
+ *
+ * NGX_OK: success
+ * NGX_DECLINED: not found
+ */
+ngx_int_t
+ngx_wa_metrics_lookup(ngx_wa_metrics_t *metrics, ngx_str_t *name,
+    uint32_t *out)
+{
+    ngx_int_t                rc;
+    ngx_wa_metrics_labels_t  labels;
+
+    rc = ngx_wa_metrics_labels_parse(metrics, name, &labels);
+    if (rc == NGX_DECLINED) {
+        *out = ngx_crc32_long(name->data, name->len);
+        return NGX_OK;
     }
 
-    ngx_wa_assert(rc == NGX_OK
-                  || rc == NGX_ERROR
-                  || rc == NGX_ABORT);
+    if (rc != NGX_OK) {
+        return NGX_DECLINED;
+    }
+
+    ngx_wa_shm_lock(metrics->shm);
+
+    rc = ngx_wa_metrics_series_lookup_locked(metrics, &labels, out);
+
+    ngx_wa_shm_unlock(metrics->shm);
 
     return rc;
 }
@@ -362,10 +563,8 @@ error:
 ngx_int_t
 ngx_wa_metrics_increment(ngx_wa_metrics_t *metrics, uint32_t mid, ngx_int_t n)
 {
-    uint32_t          cas;
     ngx_uint_t        slot;
     ngx_int_t         rc;
-    ngx_str_t        *val;
     ngx_wa_metric_t  *m;
 
     slot = (ngx_process == NGX_PROCESS_WORKER) ? ngx_worker : 0;
@@ -377,13 +576,11 @@ ngx_wa_metrics_increment(ngx_wa_metrics_t *metrics, uint32_t mid, ngx_int_t n)
     }
 #endif
 
-    rc = ngx_wa_shm_kv_get_locked(metrics->shm, NULL, &mid, &val, &cas);
+    rc = resolve_metric(metrics, mid, &m);
     if (rc != NGX_OK) {
         goto error;
     }
 
-    m = (ngx_wa_metric_t *) val->data;
-
     switch (m->type) {
     case NGX_WA_METRIC_COUNTER:
         break;
@@ -396,7 +593,7 @@ ngx_wa_metrics_increment(ngx_wa_metrics_t *metrics, uint32_t mid, ngx_int_t n)
     ngx_log_debug2(NGX_LOG_DEBUG_WASM, metrics->shm->log, 0,
                    "wasm updating metric \"%uD\" with %d", mid, n);
 
-    m->slots[slot].counter += n;
+    ngx_wa_metrics_slot(metrics, m, slot)->counter += n;
 
 error:
 
@@ -422,11 +619,10 @@ error:
 ngx_int_t
 ngx_wa_metrics_record(ngx_wa_metrics_t *metrics, uint32_t mid, ngx_int_t n)
 {
-    uint32_t          cas;
-    ngx_int_t         rc;
-    ngx_str_t        *val;
-    ngx_uint_t        slot;
-    ngx_wa_metric_t  *m;
+    ngx_int_t                rc;
+    ngx_uint_t               slot;
+    ngx_wa_metric_t         *m;
+    ngx_wa_metrics_gauge_t  *g;
 
     slot = (ngx_process == NGX_PROCESS_WORKER) ? ngx_worker : 0;
 
@@ -437,7 +633,7 @@ ngx_wa_metrics_record(ngx_wa_metrics_t *metrics, uint32_t mid, ngx_int_t n)
     }
 #endif
 
-    rc = ngx_wa_shm_kv_get_locked(metrics->shm, NULL, &mid, &val, &cas);
+    rc = resolve_metric(metrics, mid, &m);
     if (rc != NGX_OK) {
         goto error;
     }
@@ -445,12 +641,11 @@ ngx_wa_metrics_record(ngx_wa_metrics_t *metrics, uint32_t mid, ngx_int_t n)
     ngx_log_debug2(NGX_LOG_DEBUG_WASM, metrics->shm->log, 0,
                    "wasm updating metric \"%uD\" with %d", mid, n);
 
-    m = (ngx_wa_metric_t *) val->data;
-
     switch (m->type) {
     case NGX_WA_METRIC_GAUGE:
-        m->slots[slot].gauge.value = n;
-        m->slots[slot].gauge.last_update = ngx_current_msec;
+        g = &ngx_wa_metrics_slot(metrics, m, slot)->gauge;
+        g->value = n;
+        g->last_update = ngx_current_msec;
         break;
 
     case NGX_WA_METRIC_HISTOGRAM:
@@ -486,26 +681,45 @@ ngx_int_t
 ngx_wa_metrics_get(ngx_wa_metrics_t *metrics, uint32_t mid,
     ngx_wa_metric_t *out)
 {
-    uint32_t          cas;
     ngx_int_t         rc;
-    ngx_str_t        *n;
     ngx_wa_metric_t  *m;
 
-    rc = ngx_wa_shm_kv_get_locked(metrics->shm, NULL, &mid, &n, &cas);
+    rc = resolve_metric(metrics, mid, &m);
     if (rc != NGX_OK) {
         goto done;
     }
 
-    m = (ngx_wa_metric_t *) n->data;
+    rc = ngx_wa_metrics_collect(metrics, m, out);
+
+done:
+
+    ngx_wa_assert(rc == NGX_OK
+                  || rc == NGX_ERROR
+                  || rc == NGX_DECLINED);
+
+    return rc;
+}
+
+
+/**
+ * Consolidate the workers' segments of a metric into out.
+ *
+ * NGX_OK: success
+ * NGX_ERROR: unknown metric type
+ */
+ngx_int_t
+ngx_wa_metrics_collect(ngx_wa_metrics_t *metrics, ngx_wa_metric_t *m,
+    ngx_wa_metric_t *out)
+{
     out->type = m->type;
 
     switch (m->type) {
     case NGX_WA_METRIC_COUNTER:
-        out->slots[0].counter = get_counter(m, metrics->workers);
+        out->slots[0].counter = get_counter(metrics, m);
         break;
 
     case NGX_WA_METRIC_GAUGE:
-        out->slots[0].gauge.value = get_gauge(m, metrics->workers);
+        out->slots[0].gauge.value = get_gauge(metrics, m);
         break;
 
     case NGX_WA_METRIC_HISTOGRAM:
@@ -515,15 +729,68 @@ ngx_wa_metrics_get(ngx_wa_metrics_t *metrics, uint32_t mid,
 
     default:
         ngx_wa_assert(0);
-        rc = NGX_ERROR;
-        break;
+        return NGX_ERROR;
     }
 
-done:
+    return NGX_OK;
+}
 
-    ngx_wa_assert(rc == NGX_OK
-                  || rc == NGX_ERROR
-                  || rc == NGX_DECLINED);
 
-    return rc;
+/**
+ * Retrieve the next page of metrics after *cursor (NULL: first page).
+ * The zone is only locked for the duration of a page lookup: metrics are
+ * never removed, so returned entries remain valid once unlocked.
+ * Series of labelled families are skipped, see
+ * ngx_wa_metrics_families_iterate.
+ *
+ * NGX_OK: *n entries returned
+ * NGX_DONE: no more metrics
+ */
+ngx_int_t
+ngx_wa_metrics_iterate(ngx_wa_metrics_t *metrics, ngx_rbtree_node_t **cursor,
+    ngx_wa_metrics_entry_t *entries, ngx_uint_t max, ngx_uint_t *n)
+{
+    ngx_uint_t             i = 0;
+    ngx_rbtree_t          *tree;
+    ngx_rbtree_node_t     *node;
+    ngx_wa_shm_kv_t       *kv = ngx_wa_shm_get_kv(metrics->shm);
+    ngx_wa_shm_kv_node_t  *kn;
+
+    /* the metrics zone is never hash-indexed */
+    ngx_wa_assert(!metrics->shm->hash_index);
+
+    tree = &kv->rbtree;
+
+    ngx_wa_shm_lock(metrics->shm);
+
+    if (*cursor) {
+        node = ngx_rbtree_next(tree, *cursor);
+
+    } else if (tree->root != tree->sentinel) {
+        node = ngx_rbtree_min(tree->root, tree->sentinel);
+
+    } else {
+        node = NULL;
+    }
+
+    for (/* void */; node && i < max; node = ngx_rbtree_next(tree, node)) {
+        kn = (ngx_wa_shm_kv_node_t *) node;
+        *cursor = node;
+
+        if (ngx_wa_metrics_is_series(&kn->key.str)) {
+            continue;
+        }
+
+        entries[i].name = &kn->key.str;
+        entries[i].id = (uint32_t) node->key;
+        entries[i].m = (ngx_wa_metric_t *) kn->value.data;
+
+        i++;
+    }
+
+    ngx_wa_shm_unlock(metrics->shm);
+
+    *n = i;
+
+    return i ? NGX_OK : NGX_DONE;
 }
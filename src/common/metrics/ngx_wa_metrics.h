@@ -12,10 +12,22 @@
 #define NGX_WA_METRICS_HISTOGRAM_BINS_INIT             5
 #define NGX_WA_METRICS_HISTOGRAM_BINS_MAX              18
 #define NGX_WA_METRICS_HISTOGRAM_BINS_INCREMENT        4
+#define NGX_WA_METRICS_HISTOGRAM_PRECISION_MAX         5
+/* 2^p linear bins, then 2^p bins per power of two up to 2^32 */
+#define NGX_WA_METRICS_HISTOGRAM_HDR_BINS(p)           ((33 - (p)) << (p))
 #define NGX_WA_METRICS_HISTOGRAM_MAX_SIZE                                    \
     sizeof(ngx_wa_metrics_histogram_t)                                       \
     + sizeof(ngx_wa_metrics_bin_t)                                           \
-    * NGX_WA_METRICS_HISTOGRAM_BINS_MAX
+    * NGX_WA_METRICS_HISTOGRAM_HDR_BINS(NGX_WA_METRICS_HISTOGRAM_PRECISION_MAX)
+
+#define NGX_WA_METRICS_CACHE_SIZE                      256
+
+#define NGX_WA_METRICS_LABELS_MAX                      8
+#define NGX_WA_METRICS_LABEL_MAX_LEN                   128
+/* "{k=v,...}" beyond a family name */
+#define NGX_WA_METRICS_LABELS_MAX_LEN                                        \
+    (2 + NGX_WA_METRICS_LABELS_MAX * (2 * NGX_WA_METRICS_LABEL_MAX_LEN + 2))
+#define NGX_WA_METRICS_OVERFLOW_LABEL                  "__overflow__"
 
 #define NGX_WA_METRICS_ONE_SLOT_SIZE                                         \
     sizeof(ngx_wa_metric_t)                                                  \
@@ -31,9 +43,16 @@ typedef enum {
 } ngx_wa_metric_type_e;
 
 
+typedef enum {
+    NGX_WA_METRICS_SLOTS_PACKED,
+    NGX_WA_METRICS_SLOTS_PADDED,
+} ngx_wa_metrics_slots_e;
+
+
 typedef enum {
     NGX_WA_HISTOGRAM_LOG2,
     NGX_WA_HISTOGRAM_CUSTOM,
+    NGX_WA_HISTOGRAM_HDR,
 } ngx_wa_histogram_type_e;
 
 
@@ -51,7 +70,8 @@ typedef struct {
 
 typedef struct {
     ngx_wa_histogram_type_e      h_type;
-    uint8_t                      n_bins;
+    uint16_t                     n_bins;
+    uint8_t                      precision;  /* HDR sub-bin bits */
     uint64_t                     sum;
     ngx_wa_metrics_bin_t         bins[];
 } ngx_wa_metrics_histogram_t;
@@ -70,19 +90,71 @@ typedef struct {
 } ngx_wa_metric_t;
 
 
+typedef struct {
+    uint32_t                     mid;
+    ngx_wa_metric_t             *m;  /* NULL if empty */
+} ngx_wa_metrics_cache_entry_t;
+
+
+typedef struct {
+    ngx_str_t                   *name;
+    uint32_t                     id;
+    ngx_wa_metric_t             *m;
+} ngx_wa_metrics_entry_t;
+
+
+typedef struct {
+    ngx_str_node_t               sn;  /* interned string */
+    u_char                       data[1];
+} ngx_wa_metrics_label_t;
+
+
+typedef struct {
+    ngx_str_node_t               sn;  /* family name */
+    ngx_wa_metric_type_e         type;
+    ngx_uint_t                   nlabels;
+    ngx_str_t                    keys[NGX_WA_METRICS_LABELS_MAX];
+    ngx_uint_t                   nseries;
+    ngx_uint_t                   max_series;
+    ngx_wa_shm_kv_node_t        *overflow;
+    ngx_wa_shm_kv_node_t       **series;  /* max_series nodes */
+} ngx_wa_metrics_family_t;
+
+
+typedef struct {
+    ngx_rbtree_t                 families;
+    ngx_rbtree_node_t            families_sentinel;
+    ngx_rbtree_t                 labels;
+    ngx_rbtree_node_t            labels_sentinel;
+} ngx_wa_metrics_families_t;
+
+
+typedef struct {
+    ngx_str_t                    name;  /* family name */
+    ngx_uint_t                   n;
+    ngx_str_t                    keys[NGX_WA_METRICS_LABELS_MAX];
+    ngx_str_t                    values[NGX_WA_METRICS_LABELS_MAX];
+} ngx_wa_metrics_labels_t;
+
+
 typedef struct {
     size_t                       slab_size;
     size_t                       max_metric_name_length;
+    ngx_uint_t                   max_metric_series;
+    ngx_uint_t                   histogram_precision;  /* 0: log2 */
+    ngx_uint_t                   slot_layout;
     unsigned                     initialized:1;
 } ngx_wa_metrics_conf_t;
 
 
 struct ngx_wa_metrics_s {
-    ngx_uint_t                   workers;
-    ngx_wa_shm_t                *shm;
-    ngx_wa_metrics_t            *old_metrics;
-    ngx_wa_metrics_conf_t        config;
-    ngx_wa_shm_mapping_t        *mapping;
+    ngx_uint_t                     workers;
+    ngx_wa_shm_t                  *shm;
+    ngx_wa_metrics_t              *old_metrics;
+    ngx_wa_metrics_conf_t          config;
+    size_t                         slot_stride;  /* per worker value */
+    ngx_wa_shm_mapping_t          *mapping;
+    ngx_wa_metrics_cache_entry_t  *cache;  /* resolved metrics (worker) */
 };
 
 
@@ -94,21 +166,79 @@ ngx_int_t ngx_wa_metrics_shm_init(ngx_cycle_t *cycle);
 
 ngx_int_t ngx_wa_metrics_define(ngx_wa_metrics_t *metrics, ngx_str_t *name,
     ngx_wa_metric_type_e type, uint32_t *bins, uint16_t n_bins, uint32_t *out);
+ngx_int_t ngx_wa_metrics_define_locked(ngx_wa_metrics_t *metrics,
+    ngx_str_t *key, ngx_wa_metric_type_e type, uint32_t *bins, uint16_t n_bins,
+    uint32_t *out);
+ngx_int_t ngx_wa_metrics_lookup(ngx_wa_metrics_t *metrics, ngx_str_t *name,
+    uint32_t *out);
 ngx_int_t ngx_wa_metrics_increment(ngx_wa_metrics_t *metrics,
     uint32_t metric_id, ngx_int_t val);
 ngx_int_t ngx_wa_metrics_record(ngx_wa_metrics_t *metrics, uint32_t metric_id,
     ngx_int_t val);
 ngx_int_t ngx_wa_metrics_get(ngx_wa_metrics_t *metrics, uint32_t metric_id,
     ngx_wa_metric_t *o);
+ngx_int_t ngx_wa_metrics_collect(ngx_wa_metrics_t *metrics, ngx_wa_metric_t *m,
+    ngx_wa_metric_t *o);
+ngx_int_t ngx_wa_metrics_iterate(ngx_wa_metrics_t *metrics,
+    ngx_rbtree_node_t **cursor, ngx_wa_metrics_entry_t *entries,
+    ngx_uint_t max, ngx_uint_t *n);
+
+ngx_int_t ngx_wa_metrics_families_init(ngx_wa_metrics_t *metrics);
+ngx_int_t ngx_wa_metrics_labels_parse(ngx_wa_metrics_t *metrics,
+    ngx_str_t *name, ngx_wa_metrics_labels_t *out);
+ngx_int_t ngx_wa_metrics_series_define_locked(ngx_wa_metrics_t *metrics,
+    ngx_wa_metrics_labels_t *labels, ngx_wa_metric_type_e type,
+    uint32_t *bins, uint16_t n_bins, uint32_t *out);
+ngx_int_t ngx_wa_metrics_series_lookup_locked(ngx_wa_metrics_t *metrics,
+    ngx_wa_metrics_labels_t *labels, uint32_t *out);
+u_char *ngx_wa_metrics_series_name(ngx_wa_metrics_t *metrics, ngx_str_t *key,
+    u_char *buf, u_char *last);
+ngx_wa_metrics_family_t *ngx_wa_metrics_series_labels(
+    ngx_wa_metrics_t *metrics, ngx_str_t *key, ngx_str_t *values);
+ngx_int_t ngx_wa_metrics_families_iterate(ngx_wa_metrics_t *metrics,
+    ngx_rbtree_node_t **cursor, ngx_wa_metrics_family_t **families,
+    ngx_uint_t max, ngx_uint_t *n);
 
 ngx_int_t ngx_wa_metrics_histogram_add_locked(ngx_wa_metrics_t *metrics,
     uint32_t *bins, uint16_t n_bins, ngx_wa_metric_t *m);
+ngx_int_t ngx_wa_metrics_histogram_merge(ngx_wa_metrics_t *metrics,
+    ngx_wa_metric_t *m, ngx_uint_t slot, ngx_wa_metrics_histogram_t *src);
 ngx_int_t ngx_wa_metrics_histogram_record(ngx_wa_metrics_t *metrics,
     ngx_wa_metric_t *m, ngx_uint_t slot, ngx_uint_t n);
 void ngx_wa_metrics_histogram_get(ngx_wa_metrics_t *metrics, ngx_wa_metric_t *m,
     ngx_uint_t slots, ngx_wa_metrics_histogram_t *out);
 
 
+static ngx_inline ngx_wa_metric_val_t *
+ngx_wa_metrics_slot(ngx_wa_metrics_t *metrics, ngx_wa_metric_t *m,
+    ngx_uint_t slot)
+{
+    u_char  *p = (u_char *) m->slots;
+
+    if (metrics->config.slot_layout == NGX_WA_METRICS_SLOTS_PADDED) {
+        /* each worker's slot in its own cache line */
+        p = ngx_align_ptr(p, NGX_CPU_CACHE_LINE);
+    }
+
+    return (ngx_wa_metric_val_t *) (p + slot * metrics->slot_stride);
+}
+
+
+/* series keys: '\0', family offset, label value offsets (zone-relative) */
+static ngx_inline ngx_uint_t
+ngx_wa_metrics_is_series(ngx_str_t *key)
+{
+    return key->len && key->data[0] == '\0';
+}
+
+
+static ngx_inline ngx_wa_metrics_families_t *
+ngx_wa_metrics_families(ngx_wa_metrics_t *metrics)
+{
+    return ngx_wa_shm_get_kv(metrics->shm)->data;
+}
+
+
 static ngx_inline ngx_wa_metrics_histogram_t *
 ngx_wa_metrics_histogram_set_buffer(ngx_wa_metric_t *m, u_char *b, size_t s)
 {
@@ -0,0 +1,572 @@
+#ifndef DDEBUG
+#define DDEBUG 0
+#endif
+#include "ddebug.h"
+
+#include <ngx_wasm.h>
+#include <ngx_wa_metrics.h>
+
+
+/* '\0', family offset, label value offsets */
+#define NGX_WA_METRICS_SERIES_KEY_LEN                                        \
+    (1 + sizeof(uint32_t) * (1 + NGX_WA_METRICS_LABELS_MAX))
+
+#define ngx_wa_metrics_offset(metrics, p)                                    \
+    (uint32_t) ((u_char *) (p) - (u_char *) (metrics)->shm->shpool)
+#define ngx_wa_metrics_pointer(metrics, off)                                 \
+    ((u_char *) (metrics)->shm->shpool + (off))
+
+
+static ngx_wa_metrics_label_t *
+label_intern_locked(ngx_wa_metrics_t *metrics, ngx_str_t *s, unsigned create)
+{
+    uint32_t                    hash;
+    ngx_wa_metrics_label_t     *l;
+    ngx_wa_metrics_families_t  *families = ngx_wa_metrics_families(metrics);
+
+    hash = ngx_crc32_long(s->data, s->len);
+
+    l = (ngx_wa_metrics_label_t *) ngx_str_rbtree_lookup(&families->labels,
+                                                         s, hash);
+    if (l || !create) {
+        return l;
+    }
+
+    l = ngx_slab_alloc_locked(metrics->shm->shpool,
+                              sizeof(ngx_wa_metrics_label_t) + s->len);
+    if (l == NULL) {
+        return NULL;
+    }
+
+    ngx_memcpy(l->data, s->data, s->len);
+
+    l->sn.str.data = l->data;
+    l->sn.str.len = s->len;
+    l->sn.node.key = hash;
+
+    ngx_rbtree_insert(&families->labels, &l->sn.node);
+
+    return l;
+}
+
+
+static void
+series_key(ngx_wa_metrics_t *metrics, ngx_wa_metrics_family_t *f,
+    uint32_t *values, u_char *buf, ngx_str_t *key)
+{
+    u_char    *p = buf;
+    uint32_t   off;
+
+    off = ngx_wa_metrics_offset(metrics, f);
+
+    *p++ = '\0';
+    p = ngx_cpymem(p, &off, sizeof(uint32_t));
+    p = ngx_cpymem(p, values, sizeof(uint32_t) * f->nlabels);
+
+    key->data = buf;
+    key->len = p - buf;
+}
+
+
+static ngx_wa_shm_kv_node_t *
+series_node_locked(ngx_wa_metrics_t *metrics, uint32_t mid)
+{
+    uint32_t    cas;
+    ngx_str_t  *val;
+
+    if (ngx_wa_shm_kv_get_locked(metrics->shm, NULL, &mid, &val, &cas)
+        != NGX_OK)
+    {
+        return NULL;
+    }
+
+    return (ngx_wa_shm_kv_node_t *) ((u_char *) val
+                                     - offsetof(ngx_wa_shm_kv_node_t, value));
+}
+
+
+static ngx_wa_metrics_family_t *
+family_lookup_locked(ngx_wa_metrics_t *metrics, ngx_str_t *name)
+{
+    ngx_wa_metrics_families_t  *families = ngx_wa_metrics_families(metrics);
+
+    return (ngx_wa_metrics_family_t *)
+               ngx_str_rbtree_lookup(&families->families, name,
+                                     ngx_crc32_long(name->data, name->len));
+}
+
+
+static ngx_uint_t
+family_match(ngx_wa_metrics_family_t *f, ngx_wa_metrics_labels_t *labels)
+{
+    ngx_uint_t  i;
+
+    if (f->nlabels != labels->n) {
+        return 0;
+    }
+
+    for (i = 0; i < f->nlabels; i++) {
+        if (f->keys[i].len != labels->keys[i].len
+            || ngx_strncmp(f->keys[i].data, labels->keys[i].data,
+                           f->keys[i].len) != 0)
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+
+static ngx_wa_metrics_family_t *
+family_create_locked(ngx_wa_metrics_t *metrics,
+    ngx_wa_metrics_labels_t *labels, ngx_wa_metric_type_e type,
+    uint32_t *bins, uint16_t n_bins)
+{
+    uint32_t                    mid;
+    ngx_str_t                   key;
+    ngx_uint_t                  i;
+    ngx_slab_pool_t            *shpool = metrics->shm->shpool;
+    ngx_wa_metrics_label_t     *l;
+    ngx_wa_metrics_family_t    *f;
+    ngx_wa_metrics_families_t  *families = ngx_wa_metrics_families(metrics);
+    uint32_t                    values[NGX_WA_METRICS_LABELS_MAX];
+    u_char                      buf[NGX_WA_METRICS_SERIES_KEY_LEN];
+
+    f = ngx_slab_calloc_locked(shpool, sizeof(ngx_wa_metrics_family_t)
+                                       + labels->name.len);
+    if (f == NULL) {
+        return NULL;
+    }
+
+    f->series = ngx_slab_calloc_locked(shpool,
+                                       sizeof(ngx_wa_shm_kv_node_t *)
+                                       * metrics->config.max_metric_series);
+    if (f->series == NULL) {
+        goto failed;
+    }
+
+    f->sn.str.data = (u_char *) (f + 1);
+    f->sn.str.len = labels->name.len;
+    f->sn.node.key = ngx_crc32_long(labels->name.data, labels->name.len);
+    ngx_memcpy(f->sn.str.data, labels->name.data, labels->name.len);
+
+    f->type = type;
+    f->nlabels = labels->n;
+    f->max_series = metrics->config.max_metric_series;
+
+    for (i = 0; i < labels->n; i++) {
+        l = label_intern_locked(metrics, &labels->keys[i], 1);
+        if (l == NULL) {
+            goto failed;
+        }
+
+        f->keys[i] = l->sn.str;
+    }
+
+    /* the overflow series has no label values */
+    ngx_memzero(values, sizeof(values));
+    series_key(metrics, f, values, buf, &key);
+
+    if (ngx_wa_metrics_define_locked(metrics, &key, type, bins, n_bins, &mid)
+        != NGX_OK)
+    {
+        goto failed;
+    }
+
+    f->overflow = series_node_locked(metrics, mid);
+
+    ngx_rbtree_insert(&families->families, &f->sn.node);
+
+    ngx_log_debug2(NGX_LOG_DEBUG_WASM, metrics->shm->log, 0,
+                   "wasm defined metric family \"%V\" with %ui labels",
+                   &f->sn.str, f->nlabels);
+
+    return f;
+
+failed:
+
+    if (f->series) {
+        ngx_slab_free_locked(shpool, f->series);
+    }
+
+    ngx_slab_free_locked(shpool, f);
+
+    return NULL;
+}
+
+
+static ngx_uint_t
+labels_overflow(ngx_wa_metrics_labels_t *labels)
+{
+    ngx_uint_t  i;
+
+    for (i = 0; i < labels->n; i++) {
+        if (!ngx_str_eq(labels->values[i].data, labels->values[i].len,
+                        NGX_WA_METRICS_OVERFLOW_LABEL, -1))
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+
+/**
+ * NGX_OK: success
+ * NGX_DECLINED: not found (!create)
+ * NGX_ERROR: no memory
+ */
+static ngx_int_t
+series_resolve_locked(ngx_wa_metrics_t *metrics, ngx_wa_metrics_family_t *f,
+    ngx_wa_metrics_labels_t *labels, uint32_t *bins, uint16_t n_bins,
+    unsigned create, uint32_t *out)
+{
+    uint32_t                 mid;
+    unsigned                 missing = 0;
+    ngx_int_t                rc;
+    ngx_str_t                key;
+    ngx_uint_t               i;
+    ngx_wa_metrics_label_t  *l;
+    uint32_t                 values[NGX_WA_METRICS_LABELS_MAX];
+    u_char                   buf[NGX_WA_METRICS_SERIES_KEY_LEN];
+
+    if (labels_overflow(labels)) {
+        *out = f->overflow->key.node.key;
+        return NGX_OK;
+    }
+
+    /* label values are only interned for new series */
+
+    for (i = 0; i < labels->n; i++) {
+        l = label_intern_locked(metrics, &labels->values[i], 0);
+        if (l == NULL) {
+            missing = 1;
+            break;
+        }
+
+        values[i] = ngx_wa_metrics_offset(metrics, l);
+    }
+
+    if (!missing) {
+        series_key(metrics, f, values, buf, &key);
+
+        mid = ngx_crc32_long(key.data, key.len);
+
+        rc = ngx_wa_shm_kv_get_locked(metrics->shm, NULL, &mid, NULL, NULL);
+        if (rc == NGX_OK) {
+            *out = mid;
+            return NGX_OK;
+        }
+    }
+
+    if (!create) {
+        return NGX_DECLINED;
+    }
+
+    if (f->nseries == f->max_series) {
+        ngx_log_debug2(NGX_LOG_DEBUG_WASM, metrics->shm->log, 0,
+                       "wasm metric family \"%V\" reached %ui series, "
+                       "using overflow series", &f->sn.str, f->max_series);
+
+        *out = f->overflow->key.node.key;
+        return NGX_OK;
+    }
+
+    for (i = 0; i < labels->n; i++) {
+        l = label_intern_locked(metrics, &labels->values[i], 1);
+        if (l == NULL) {
+            return NGX_ERROR;
+        }
+
+        values[i] = ngx_wa_metrics_offset(metrics, l);
+    }
+
+    series_key(metrics, f, values, buf, &key);
+
+    rc = ngx_wa_metrics_define_locked(metrics, &key, f->type, bins, n_bins,
+                                      &mid);
+    if (rc != NGX_OK) {
+        return rc;
+    }
+
+    f->series[f->nseries] = series_node_locked(metrics, mid);
+
+    /* lock-free readers (exporter) iterate up to nseries */
+    ngx_memory_barrier();
+
+    f->nseries++;
+
+    *out = mid;
+
+    return NGX_OK;
+}
+
+
+ngx_int_t
+ngx_wa_metrics_families_init(ngx_wa_metrics_t *metrics)
+{
+    ngx_wa_shm_kv_t            *kv = ngx_wa_shm_get_kv(metrics->shm);
+    ngx_wa_metrics_families_t  *families;
+
+    families = ngx_slab_calloc(metrics->shm->shpool,
+                               sizeof(ngx_wa_metrics_families_t));
+    if (families == NULL) {
+        return NGX_ERROR;
+    }
+
+    ngx_rbtree_init(&families->families, &families->families_sentinel,
+                    ngx_str_rbtree_insert_value);
+    ngx_rbtree_init(&families->labels, &families->labels_sentinel,
+                    ngx_str_rbtree_insert_value);
+
+    kv->data = families;
+
+    return NGX_OK;
+}
+
+
+/**
+ * Parse a labelled metric name: "name{key1=value1,key2=value2}".
+ *
+ * NGX_OK: success
+ * NGX_DECLINED: not a labelled name
+ * NGX_BUSY: name, key or value too long
+ * NGX_ABORT: malformed labels
+ */
+ngx_int_t
+ngx_wa_metrics_labels_parse(ngx_wa_metrics_t *metrics, ngx_str_t *name,
+    ngx_wa_metrics_labels_t *out)
+{
+    u_char      *p, *last, *eq;
+    ngx_uint_t   i;
+    ngx_str_t   *key, *value;
+
+    if (name->len == 0 || name->data[name->len - 1] != '}') {
+        return NGX_DECLINED;
+    }
+
+    last = name->data + name->len - 1;
+
+    p = ngx_strlchr(name->data, last, '{');
+    if (p == NULL) {
+        return NGX_DECLINED;
+    }
+
+    out->name.data = name->data;
+    out->name.len = p - name->data;
+    out->n = 0;
+
+    if (out->name.len == 0) {
+        return NGX_ABORT;
+    }
+
+    if (out->name.len > metrics->config.max_metric_name_length) {
+        return NGX_BUSY;
+    }
+
+    for (p++; p < last; p++) {
+        if (out->n == NGX_WA_METRICS_LABELS_MAX) {
+            return NGX_ABORT;
+        }
+
+        key = &out->keys[out->n];
+        value = &out->values[out->n];
+
+        eq = ngx_strlchr(p, last, '=');
+        if (eq == NULL) {
+            return NGX_ABORT;
+        }
+
+        key->data = p;
+        key->len = eq - p;
+
+        p = ngx_strlchr(eq + 1, last, ',');
+        if (p == NULL) {
+            p = last;
+        }
+
+        value->data = eq + 1;
+        value->len = p - value->data;
+
+        if (key->len == 0 || value->len == 0) {
+            return NGX_ABORT;
+        }
+
+        if (key->len > NGX_WA_METRICS_LABEL_MAX_LEN
+            || value->len > NGX_WA_METRICS_LABEL_MAX_LEN)
+        {
+            return NGX_BUSY;
+        }
+
+        for (i = 0; i < out->n; i++) {
+            if (out->keys[i].len == key->len
+                && ngx_strncmp(out->keys[i].data, key->data, key->len) == 0)
+            {
+                return NGX_ABORT;
+            }
+        }
+
+        out->n++;
+    }
+
+    return out->n ? NGX_OK : NGX_ABORT;
+}
+
+
+/**
+ * Series of a family are stored under compact keys made of interned
+ * label values, up to the family's max_series; further label values
+ * combinations resolve to the family's overflow series.
+ *
+ * NGX_OK: success
+ * NGX_ABORT: type or label keys differ from the family's
+ * NGX_ERROR: no memory
+ */
+ngx_int_t
+ngx_wa_metrics_series_define_locked(ngx_wa_metrics_t *metrics,
+    ngx_wa_metrics_labels_t *labels, ngx_wa_metric_type_e type,
+    uint32_t *bins, uint16_t n_bins, uint32_t *out)
+{
+    ngx_wa_metrics_family_t  *f;
+
+    f = family_lookup_locked(metrics, &labels->name);
+    if (f == NULL) {
+        f = family_create_locked(metrics, labels, type, bins, n_bins);
+        if (f == NULL) {
+            return NGX_ERROR;
+        }
+
+    } else if (f->type != type || !family_match(f, labels)) {
+        return NGX_ABORT;
+    }
+
+    return series_resolve_locked(metrics, f, labels, bins, n_bins, 1, out);
+}
+
+
+/**
+ * NGX_OK: success
+ * NGX_DECLINED: not found
+ */
+ngx_int_t
+ngx_wa_metrics_series_lookup_locked(ngx_wa_metrics_t *metrics,
+    ngx_wa_metrics_labels_t *labels, uint32_t *out)
+{
+    ngx_wa_metrics_family_t  *f;
+
+    f = family_lookup_locked(metrics, &labels->name);
+    if (f == NULL || !family_match(f, labels)) {
+        return NGX_DECLINED;
+    }
+
+    return series_resolve_locked(metrics, f, labels, NULL, 0, 0, out);
+}
+
+
+/**
+ * Decode a series key into its family and label values ("__overflow__"
+ * for the overflow series).
+ */
+ngx_wa_metrics_family_t *
+ngx_wa_metrics_series_labels(ngx_wa_metrics_t *metrics, ngx_str_t *key,
+    ngx_str_t *values)
+{
+    uint32_t                  off;
+    ngx_uint_t                i;
+    ngx_wa_metrics_label_t   *l;
+    ngx_wa_metrics_family_t  *f;
+    static ngx_str_t          overflow =
+                                  ngx_string(NGX_WA_METRICS_OVERFLOW_LABEL);
+
+    ngx_wa_assert(ngx_wa_metrics_is_series(key));
+
+    ngx_memcpy(&off, key->data + 1, sizeof(uint32_t));
+
+    f = (ngx_wa_metrics_family_t *) ngx_wa_metrics_pointer(metrics, off);
+
+    for (i = 0; i < f->nlabels; i++) {
+        ngx_memcpy(&off, key->data + 1 + sizeof(uint32_t) * (i + 1),
+                   sizeof(uint32_t));
+
+        if (off == 0) {
+            values[i] = overflow;
+            continue;
+        }
+
+        l = (ngx_wa_metrics_label_t *) ngx_wa_metrics_pointer(metrics, off);
+        values[i] = l->sn.str;
+    }
+
+    return f;
+}
+
+
+/**
+ * Render a series key as its labelled name, e.g. "name{key=value}".
+ */
+u_char *
+ngx_wa_metrics_series_name(ngx_wa_metrics_t *metrics, ngx_str_t *key,
+    u_char *buf, u_char *last)
+{
+    u_char                   *p = buf;
+    ngx_uint_t                i;
+    ngx_wa_metrics_family_t  *f;
+    ngx_str_t                 values[NGX_WA_METRICS_LABELS_MAX];
+
+    f = ngx_wa_metrics_series_labels(metrics, key, values);
+
+    p = ngx_slprintf(p, last, "%V{", &f->sn.str);
+
+    for (i = 0; i < f->nlabels; i++) {
+        p = ngx_slprintf(p, last, "%s%V=%V", i ? "," : "",
+                         &f->keys[i], &values[i]);
+    }
+
+    return ngx_slprintf(p, last, "}");
+}
+
+
+/**
+ * Retrieve the next page of metric families after *cursor (NULL: first
+ * page); families are never removed, see ngx_wa_metrics_iterate.
+ *
+ * NGX_OK: *n families returned
+ * NGX_DONE: no more families
+ */
+ngx_int_t
+ngx_wa_metrics_families_iterate(ngx_wa_metrics_t *metrics,
+    ngx_rbtree_node_t **cursor, ngx_wa_metrics_family_t **out,
+    ngx_uint_t max, ngx_uint_t *n)
+{
+    ngx_uint_t                  i = 0;
+    ngx_rbtree_t               *tree;
+    ngx_rbtree_node_t          *node;
+    ngx_wa_metrics_families_t  *families = ngx_wa_metrics_families(metrics);
+
+    tree = &families->families;
+
+    ngx_wa_shm_lock(metrics->shm);
+
+    if (*cursor) {
+        node = ngx_rbtree_next(tree, *cursor);
+
+    } else if (tree->root != tree->sentinel) {
+        node = ngx_rbtree_min(tree->root, tree->sentinel);
+
+    } else {
+        node = NULL;
+    }
+
+    for (/* void */; node && i < max; node = ngx_rbtree_next(tree, node)) {
+        out[i++] = (ngx_wa_metrics_family_t *) node;
+        *cursor = node;
+    }
+
+    ngx_wa_shm_unlock(metrics->shm);
+
+    *n = i;
+
+    return i ? NGX_OK : NGX_DONE;
+}
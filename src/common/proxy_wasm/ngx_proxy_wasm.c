@@ -5,6 +5,8 @@
 
 #include <ngx_proxy_wasm.h>
 #include <ngx_proxy_wasm_properties.h>
+#include <ngx_wa_metrics.h>
+#include <ngx_wa_shm_queue.h>
 #ifdef NGX_WASM_HTTP
 #include <ngx_http_proxy_wasm.h>
 #endif
@@ -13,7 +15,6 @@
 #define ngx_proxy_wasm_store_init(s, p)                                      \
     (s)->pool = (p);                                                         \
     ngx_queue_init(&(s)->sweep);                                             \
-    ngx_queue_init(&(s)->free);                                              \
     ngx_queue_init(&(s)->busy)
 
 
@@ -23,6 +24,7 @@ static ngx_proxy_wasm_err_e ngx_proxy_wasm_create_context(
 static void ngx_proxy_wasm_on_log(ngx_proxy_wasm_exec_t *pwexec);
 static void ngx_proxy_wasm_on_done(ngx_proxy_wasm_exec_t *pwexec);
 static ngx_int_t ngx_proxy_wasm_on_tick(ngx_proxy_wasm_exec_t *pwexec);
+static ngx_int_t ngx_proxy_wasm_on_queue_ready(ngx_proxy_wasm_exec_t *pwexec);
 static ngx_proxy_wasm_filter_t *ngx_proxy_wasm_lookup_filter(
     ngx_proxy_wasm_filters_root_t *pwroot, ngx_uint_t id);
 static ngx_proxy_wasm_exec_t *ngx_proxy_wasm_lookup_root_ctx(
@@ -32,12 +34,26 @@ static ngx_proxy_wasm_exec_t *ngx_proxy_wasm_lookup_ctx(
 static ngx_int_t ngx_proxy_wasm_filter_init_abi(
     ngx_proxy_wasm_filter_t *filter);
 static ngx_int_t ngx_proxy_wasm_filter_start(ngx_proxy_wasm_filter_t *filter);
+static ngx_proxy_wasm_instance_t *ngx_proxy_wasm_instance_create(
+    ngx_wavm_module_t *module, ngx_proxy_wasm_snapshot_t *snapshot,
+    ngx_pool_t *pool, ngx_log_t *log);
 static void ngx_proxy_wasm_instance_update(
     ngx_proxy_wasm_instance_t *ictx, ngx_proxy_wasm_exec_t *pwexec);
 static void ngx_proxy_wasm_instance_invalidate(ngx_proxy_wasm_instance_t *ictx);
 static void ngx_proxy_wasm_instance_destroy(ngx_proxy_wasm_instance_t *ictx);
 static void ngx_proxy_wasm_store_destroy(ngx_proxy_wasm_store_t *store);
 static void ngx_proxy_wasm_store_sweep(ngx_proxy_wasm_store_t *store);
+static ngx_proxy_wasm_ipool_t *ngx_proxy_wasm_ipool_get(
+    ngx_proxy_wasm_filters_root_t *pwroot, ngx_wavm_module_t *module,
+    ngx_log_t *log);
+static ngx_int_t ngx_proxy_wasm_ipool_warm(ngx_proxy_wasm_ipool_t *ipool);
+static ngx_proxy_wasm_instance_t *ngx_proxy_wasm_ipool_take(
+    ngx_proxy_wasm_ipool_t *ipool);
+static void ngx_proxy_wasm_ipool_destroy(ngx_proxy_wasm_ipool_t *ipool);
+static ngx_int_t ngx_proxy_wasm_snapshots_create(
+    ngx_proxy_wasm_filters_root_t *pwroot);
+static unsigned ngx_proxy_wasm_snapshot_has_root(
+    ngx_proxy_wasm_snapshot_t *snapshot, ngx_uint_t id);
 #if 0
 static void ngx_proxy_wasm_store_schedule_sweep_handler(ngx_event_t *ev);
 static void ngx_proxy_wasm_store_schedule_sweep(ngx_proxy_wasm_store_t *store);
@@ -84,6 +100,9 @@ ngx_proxy_wasm_root_init(ngx_proxy_wasm_filters_root_t *pwroot,
     ngx_rbtree_init(&pwroot->tree, &pwroot->sentinel,
                     ngx_rbtree_insert_value);
 
+    ngx_queue_init(&pwroot->ipools);
+    ngx_queue_init(&pwroot->snapshots);
+
     ngx_proxy_wasm_store_init(&pwroot->store, pool);
 }
 
@@ -91,8 +110,11 @@ ngx_proxy_wasm_root_init(ngx_proxy_wasm_filters_root_t *pwroot,
 void
 ngx_proxy_wasm_root_destroy(ngx_proxy_wasm_filters_root_t *pwroot)
 {
+    ngx_queue_t               *q;
     ngx_rbtree_node_t        **root, **sentinel, *node;
     ngx_proxy_wasm_filter_t   *filter;
+    ngx_proxy_wasm_ipool_t    *ipool;
+    ngx_proxy_wasm_snapshot_t *snapshot;
 
     root = &pwroot->tree.root;
     sentinel = &pwroot->tree.sentinel;
@@ -108,6 +130,25 @@ ngx_proxy_wasm_root_destroy(ngx_proxy_wasm_filters_root_t *pwroot)
 
     ngx_proxy_wasm_store_destroy(&pwroot->store);
 
+    while (!ngx_queue_empty(&pwroot->ipools)) {
+        q = ngx_queue_head(&pwroot->ipools);
+        ipool = ngx_queue_data(q, ngx_proxy_wasm_ipool_t, q);
+
+        ngx_queue_remove(&ipool->q);
+        ngx_proxy_wasm_ipool_destroy(ipool);
+        ngx_pfree(pwroot->store.pool, ipool);
+    }
+
+    while (!ngx_queue_empty(&pwroot->snapshots)) {
+        q = ngx_queue_head(&pwroot->snapshots);
+        snapshot = ngx_queue_data(q, ngx_proxy_wasm_snapshot_t, q);
+
+        ngx_queue_remove(&snapshot->q);
+        ngx_wavm_snapshot_destroy(snapshot->wsnapshot);
+        ngx_array_destroy(&snapshot->root_ids);
+        ngx_pfree(pwroot->store.pool, snapshot);
+    }
+
     ngx_array_destroy(&pwroot->filter_ids);
 }
 
@@ -163,6 +204,13 @@ ngx_proxy_wasm_load(ngx_proxy_wasm_filters_root_t *pwroot,
         return NGX_ERROR;
     }
 
+    if (pwroot->ipool_max && filter->ipool == NULL) {
+        filter->ipool = ngx_proxy_wasm_ipool_get(pwroot, filter->module, log);
+        if (filter->ipool == NULL) {
+            return NGX_ERROR;
+        }
+    }
+
     filter->loaded = 1;
 
     dd("exit");
@@ -175,8 +223,10 @@ ngx_int_t
 ngx_proxy_wasm_start(ngx_proxy_wasm_filters_root_t *pwroot)
 {
     ngx_int_t                 rc;
+    ngx_queue_t              *q;
     ngx_rbtree_node_t        *root, *sentinel, *node;
     ngx_proxy_wasm_filter_t  *filter;
+    ngx_proxy_wasm_ipool_t   *ipool;
 
     dd("enter (pwroot: %p)", pwroot);
 
@@ -203,6 +253,23 @@ ngx_proxy_wasm_start(ngx_proxy_wasm_filters_root_t *pwroot)
         }
     }
 
+    if (pwroot->snapshot == 1
+        && ngx_proxy_wasm_snapshots_create(pwroot) != NGX_OK)
+    {
+        return NGX_ERROR;
+    }
+
+    for (q = ngx_queue_head(&pwroot->ipools);
+         q != ngx_queue_sentinel(&pwroot->ipools);
+         q = ngx_queue_next(q))
+    {
+        ipool = ngx_queue_data(q, ngx_proxy_wasm_ipool_t, q);
+
+        if (ngx_proxy_wasm_ipool_warm(ipool) != NGX_OK) {
+            return NGX_ERROR;
+        }
+    }
+
 done:
 
     return NGX_OK;
@@ -844,6 +911,9 @@ ngx_proxy_wasm_run_step(ngx_proxy_wasm_exec_t *pwexec,
         rc = ngx_proxy_wasm_on_tick(pwexec);
         pwexec->in_tick = 0;
         break;
+    case NGX_PROXY_WASM_STEP_QUEUE_READY:
+        rc = ngx_proxy_wasm_on_queue_ready(pwexec);
+        break;
     default:
         ngx_proxy_wasm_log_error(NGX_LOG_WASM_NYI, pwctx->log, 0,
                                  "NYI - proxy_wasm step: %d", step);
@@ -993,48 +1063,34 @@ get_instance(ngx_proxy_wasm_filter_t *filter,
         }
     }
 
-#if 0
-    for (q = ngx_queue_head(&store->free);
-         q != ngx_queue_sentinel(&store->free);
-         q = ngx_queue_next(q))
-    {
-        ictx = ngx_queue_data(q, ngx_proxy_wasm_instance_t, q);
+    if (filter->ipool) {
+        ictx = ngx_proxy_wasm_ipool_take(filter->ipool);
+        if (ictx) {
+            ictx->log = log;
+            ictx->store = store;
 
-        ngx_wa_assert(!ictx->instance->trapped);
+            ngx_proxy_wasm_log_error(NGX_LOG_DEBUG, log, 0,
+                                     "\"%V\" filter pooled instance "
+                                     "(ictx: %p, store: %p)",
+                                     filter->name, ictx, store);
 
-        if (ictx->module == module) {
-            dd("reuse free instance, going to busy");
-            ngx_queue_remove(&ictx->q);
             ngx_queue_insert_tail(&store->busy, &ictx->q);
-            goto reuse;
+
+            goto done;
         }
     }
-#endif
 
     dd("create instance in store: %p", store);
 
-    ictx = ngx_pcalloc(store->pool, sizeof(ngx_proxy_wasm_instance_t));
+    ictx = ngx_proxy_wasm_instance_create(module,
+                                          store == filter->store
+                                          ? NULL : filter->snapshot,
+                                          store->pool, log);
     if (ictx == NULL) {
         goto error;
     }
 
-    ictx->pool = store->pool;
-    ictx->log = log;
     ictx->store = store;
-    ictx->module = module;
-
-    ngx_rbtree_init(&ictx->root_ctxs, &ictx->sentinel_root_ctxs,
-                    ngx_rbtree_insert_value);
-
-    ngx_rbtree_init(&ictx->tree_ctxs, &ictx->sentinel_ctxs,
-                    ngx_rbtree_insert_value);
-
-    ictx->instance = ngx_wavm_instance_create(ictx->module, ictx->pool,
-                                              ictx->log, ictx);
-    if (ictx->instance == NULL) {
-        ngx_pfree(store->pool, ictx);
-        goto error;
-    }
 
     ngx_proxy_wasm_log_error(NGX_LOG_DEBUG, log, 0,
                              "\"%V\" filter new instance (ictx: %p, store: %p)",
@@ -1194,6 +1250,21 @@ ngx_proxy_wasm_create_context(ngx_proxy_wasm_filter_t *filter,
 
     /* start root context */
 
+    if (!rexec->started
+        && ictx->snapshot
+        && ngx_proxy_wasm_snapshot_has_root(ictx->snapshot, rexec->id))
+    {
+        dd("restored root exec ctx (rexec: %p, id: %ld, ictx: %p)",
+           rexec, rexec->id, ictx);
+
+        /* configured before the snapshot was taken */
+
+        rexec->node.key = rexec->id;
+        ngx_rbtree_insert(&ictx->root_ctxs, &rexec->node);
+
+        rexec->started = 1;
+    }
+
     if (!rexec->started) {
         dd("start root exec ctx (rexec: %p, root_id: %ld, id: %ld, ictx: %p)",
            rexec, rexec->root_id, rexec->id, ictx);
@@ -1430,6 +1501,29 @@ ngx_proxy_wasm_on_tick(ngx_proxy_wasm_exec_t *pwexec)
 }
 
 
+static ngx_int_t
+ngx_proxy_wasm_on_queue_ready(ngx_proxy_wasm_exec_t *pwexec)
+{
+    ngx_int_t                 rc;
+    wasm_val_vec_t            args;
+    ngx_proxy_wasm_filter_t  *filter = pwexec->filter;
+
+    ngx_wa_assert(pwexec->root_id == NGX_PROXY_WASM_ROOT_CTX_ID);
+
+    wasm_val_vec_new_uninitialized(&args, 2);
+    ngx_wasm_vec_set_i32(&args, 0, pwexec->id);
+    ngx_wasm_vec_set_i32(&args, 1, pwexec->ready_queue);
+
+    rc = ngx_wavm_instance_call_funcref_vec(pwexec->ictx->instance,
+                                            filter->proxy_on_queue_ready,
+                                            NULL, &args);
+
+    wasm_val_vec_delete(&args);
+
+    return rc;
+}
+
+
 /* utils */
 
 
@@ -1800,6 +1894,45 @@ ngx_proxy_wasm_filter_start(ngx_proxy_wasm_filter_t *filter)
 }
 
 
+static ngx_proxy_wasm_instance_t *
+ngx_proxy_wasm_instance_create(ngx_wavm_module_t *module,
+    ngx_proxy_wasm_snapshot_t *snapshot, ngx_pool_t *pool, ngx_log_t *log)
+{
+    ngx_proxy_wasm_instance_t  *ictx;
+
+    ictx = ngx_pcalloc(pool, sizeof(ngx_proxy_wasm_instance_t));
+    if (ictx == NULL) {
+        return NULL;
+    }
+
+    ictx->pool = pool;
+    ictx->log = log;
+    ictx->module = module;
+
+    ngx_rbtree_init(&ictx->root_ctxs, &ictx->sentinel_root_ctxs,
+                    ngx_rbtree_insert_value);
+
+    ngx_rbtree_init(&ictx->tree_ctxs, &ictx->sentinel_ctxs,
+                    ngx_rbtree_insert_value);
+
+    if (snapshot) {
+        ictx->snapshot = snapshot;
+        ictx->instance = ngx_wavm_instance_restore(snapshot->wsnapshot, pool,
+                                                   log, ictx);
+
+    } else {
+        ictx->instance = ngx_wavm_instance_create(module, pool, log, ictx);
+    }
+
+    if (ictx->instance == NULL) {
+        ngx_pfree(pool, ictx);
+        return NULL;
+    }
+
+    return ictx;
+}
+
+
 static void
 ngx_proxy_wasm_instance_update(ngx_proxy_wasm_instance_t *ictx,
     ngx_proxy_wasm_exec_t *pwexec)
@@ -1837,6 +1970,9 @@ ngx_proxy_wasm_instance_invalidate(ngx_proxy_wasm_instance_t *ictx)
 
         dd("unlink instance of root ctx #%ld (rexec: %p)", pwexec->id, pwexec);
 
+        /* resubscribed by the next instance if it registers the queue */
+        ngx_wa_shm_queue_unsubscribe(pwexec);
+
         pwexec->ictx = NULL;
         ngx_rbtree_delete(&ictx->root_ctxs, n);
     }
@@ -1888,6 +2024,8 @@ ngx_proxy_wasm_instance_destroy(ngx_proxy_wasm_instance_t *ictx)
         dd("unlink+destroy instance of root ctx #%ld (rexec: %p)",
            pwexec->id, pwexec);
 
+        ngx_wa_shm_queue_unsubscribe(pwexec);
+
         pwexec->ictx = NULL;
         ngx_rbtree_delete(&ictx->root_ctxs, n);
     }
@@ -1912,7 +2050,13 @@ ngx_proxy_wasm_instance_destroy(ngx_proxy_wasm_instance_t *ictx)
 
     ngx_wavm_instance_destroy(ictx->instance);
 
-    ngx_pfree(ictx->pool, ictx);
+    if (ictx->pooled) {
+        /* pool created for this instance by its ipool */
+        ngx_destroy_pool(ictx->pool);
+
+    } else {
+        ngx_pfree(ictx->pool, ictx);
+    }
 
     dd("exit");
 }
@@ -1931,15 +2075,6 @@ ngx_proxy_wasm_store_destroy(ngx_proxy_wasm_store_t *store)
         q = ngx_queue_head(&store->busy);
         ictx = ngx_queue_data(q, ngx_proxy_wasm_instance_t, q);
 
-        ngx_queue_remove(&ictx->q);
-        ngx_queue_insert_tail(&store->free, &ictx->q);
-    }
-
-    while (!ngx_queue_empty(&store->free)) {
-        dd("remove free");
-        q = ngx_queue_head(&store->free);
-        ictx = ngx_queue_data(q, ngx_proxy_wasm_instance_t, q);
-
         ngx_queue_remove(&ictx->q);
         ngx_queue_insert_tail(&store->sweep, &ictx->q);
     }
@@ -1968,6 +2103,351 @@ ngx_proxy_wasm_store_sweep(ngx_proxy_wasm_store_t *store)
 }
 
 
+/* instance pools */
+
+
+static ngx_int_t
+ngx_proxy_wasm_ipool_add(ngx_proxy_wasm_ipool_t *ipool)
+{
+    ngx_pool_t                 *pool;
+    ngx_proxy_wasm_instance_t  *ictx;
+
+    /* each pooled instance owns its pool so it can be freed from any store */
+
+    pool = ngx_create_pool(512, ipool->log);
+    if (pool == NULL) {
+        return NGX_ERROR;
+    }
+
+    ictx = ngx_proxy_wasm_instance_create(ipool->module, ipool->snapshot,
+                                          pool, ipool->log);
+    if (ictx == NULL) {
+        ngx_destroy_pool(pool);
+        return NGX_ERROR;
+    }
+
+    ictx->pooled = 1;
+
+    ngx_queue_insert_tail(&ipool->free, &ictx->q);
+    ipool->nfree++;
+
+    ngx_log_debug3(NGX_LOG_DEBUG_WASM, ipool->log, 0,
+                   "proxy_wasm \"%V\" instance pool filled "
+                   "(nfree: %ui, max: %ui)",
+                   &ipool->module->name, ipool->nfree, ipool->max);
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_proxy_wasm_ipool_refill_handler(ngx_event_t *ev)
+{
+    ngx_proxy_wasm_ipool_t  *ipool = ev->data;
+
+    if (ngx_exiting || ngx_quit || ngx_terminate) {
+        return;
+    }
+
+    if (ipool->nfree >= ipool->max) {
+        return;
+    }
+
+    if (ngx_proxy_wasm_ipool_add(ipool) != NGX_OK) {
+        /* logged; retried on next take */
+        return;
+    }
+
+    if (ipool->nfree < ipool->max) {
+        /* one instantiation per event loop iteration */
+        ngx_post_event(ev, &ngx_posted_events);
+    }
+}
+
+
+static ngx_proxy_wasm_ipool_t *
+ngx_proxy_wasm_ipool_get(ngx_proxy_wasm_filters_root_t *pwroot,
+    ngx_wavm_module_t *module, ngx_log_t *log)
+{
+    ngx_int_t                rc;
+    ngx_str_t                name;
+    ngx_queue_t             *q;
+    ngx_wa_metrics_t        *metrics;
+    ngx_proxy_wasm_ipool_t  *ipool;
+    u_char                   buf[NGX_WA_METRICS_DEFAULT_MAX_NAME_LEN];
+
+    for (q = ngx_queue_head(&pwroot->ipools);
+         q != ngx_queue_sentinel(&pwroot->ipools);
+         q = ngx_queue_next(q))
+    {
+        ipool = ngx_queue_data(q, ngx_proxy_wasm_ipool_t, q);
+
+        if (ipool->module == module) {
+            return ipool;
+        }
+    }
+
+    ipool = ngx_pcalloc(pwroot->store.pool, sizeof(ngx_proxy_wasm_ipool_t));
+    if (ipool == NULL) {
+        return NULL;
+    }
+
+    ipool->module = module;
+    ipool->log = log;
+    ipool->min = pwroot->ipool_min;
+    ipool->max = pwroot->ipool_max;
+
+    ngx_queue_init(&ipool->free);
+
+    ipool->refill_ev.handler = ngx_proxy_wasm_ipool_refill_handler;
+    ipool->refill_ev.data = ipool;
+    ipool->refill_ev.log = log;
+
+    /* hits/misses counters */
+
+    metrics = ngx_wasmx_metrics((ngx_cycle_t *) ngx_cycle);
+    if (metrics) {
+        name.data = buf;
+        name.len = ngx_snprintf(buf, sizeof(buf), "wa.instance_pool.%V.hits",
+                                &module->name)
+                   - buf;
+
+        rc = ngx_wa_metrics_define(metrics, &name, NGX_WA_METRIC_COUNTER,
+                                   NULL, 0, &ipool->hits_mid);
+        if (rc == NGX_OK) {
+            name.len = ngx_snprintf(buf, sizeof(buf),
+                                    "wa.instance_pool.%V.misses",
+                                    &module->name)
+                       - buf;
+
+            rc = ngx_wa_metrics_define(metrics, &name, NGX_WA_METRIC_COUNTER,
+                                       NULL, 0, &ipool->misses_mid);
+        }
+
+        if (rc == NGX_OK) {
+            ipool->metrics = 1;
+
+        } else {
+            ngx_wasm_log_error(NGX_LOG_WARN, log, 0,
+                               "failed defining \"%V\" instance pool "
+                               "metrics", &module->name);
+        }
+    }
+
+    ngx_queue_insert_tail(&pwroot->ipools, &ipool->q);
+
+    ngx_log_debug3(NGX_LOG_DEBUG_WASM, log, 0,
+                   "proxy_wasm \"%V\" instance pool created "
+                   "(min: %ui, max: %ui)",
+                   &module->name, ipool->min, ipool->max);
+
+    return ipool;
+}
+
+
+static ngx_int_t
+ngx_proxy_wasm_ipool_warm(ngx_proxy_wasm_ipool_t *ipool)
+{
+    while (ipool->nfree < ipool->min) {
+        if (ngx_proxy_wasm_ipool_add(ipool) != NGX_OK) {
+            return NGX_ERROR;
+        }
+    }
+
+    if (ipool->nfree < ipool->max) {
+        ngx_post_event(&ipool->refill_ev, &ngx_posted_events);
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_proxy_wasm_instance_t *
+ngx_proxy_wasm_ipool_take(ngx_proxy_wasm_ipool_t *ipool)
+{
+    ngx_queue_t                *q;
+    ngx_wa_metrics_t           *metrics;
+    ngx_proxy_wasm_instance_t  *ictx = NULL;
+
+    if (!ngx_queue_empty(&ipool->free)) {
+        q = ngx_queue_head(&ipool->free);
+        ictx = ngx_queue_data(q, ngx_proxy_wasm_instance_t, q);
+
+        ngx_queue_remove(&ictx->q);
+        ipool->nfree--;
+        ipool->hits++;
+
+    } else {
+        ipool->misses++;
+    }
+
+    ngx_log_debug4(NGX_LOG_DEBUG_WASM, ipool->log, 0,
+                   "proxy_wasm \"%V\" instance pool %s "
+                   "(hits: %ui, misses: %ui)",
+                   &ipool->module->name, ictx ? "hit" : "miss",
+                   ipool->hits, ipool->misses);
+
+    if (ipool->metrics) {
+        metrics = ngx_wasmx_metrics((ngx_cycle_t *) ngx_cycle);
+
+        (void) ngx_wa_metrics_increment(metrics, ictx ? ipool->hits_mid
+                                                      : ipool->misses_mid, 1);
+    }
+
+    if (ipool->nfree < ipool->max && !ngx_exiting) {
+        ngx_post_event(&ipool->refill_ev, &ngx_posted_events);
+    }
+
+    return ictx;
+}
+
+
+static void
+ngx_proxy_wasm_ipool_destroy(ngx_proxy_wasm_ipool_t *ipool)
+{
+    ngx_queue_t                *q;
+    ngx_proxy_wasm_instance_t  *ictx;
+
+    if (ipool->refill_ev.posted) {
+        ngx_delete_posted_event(&ipool->refill_ev);
+    }
+
+    while (!ngx_queue_empty(&ipool->free)) {
+        q = ngx_queue_head(&ipool->free);
+        ictx = ngx_queue_data(q, ngx_proxy_wasm_instance_t, q);
+
+        ngx_queue_remove(&ictx->q);
+        ngx_proxy_wasm_instance_destroy(ictx);
+    }
+
+    ipool->nfree = 0;
+}
+
+
+/* instance snapshots */
+
+
+static ngx_int_t
+ngx_proxy_wasm_snapshots_create(ngx_proxy_wasm_filters_root_t *pwroot)
+{
+    ngx_uint_t                 *id;
+    ngx_queue_t                *q;
+    ngx_rbtree_node_t          *node, *rnode, *sentinel;
+    ngx_proxy_wasm_exec_t      *rexec;
+    ngx_proxy_wasm_filter_t    *filter;
+    ngx_proxy_wasm_instance_t  *ictx;
+    ngx_proxy_wasm_snapshot_t  *snapshot;
+
+    for (node = ngx_rbtree_min(pwroot->tree.root, pwroot->tree.sentinel);
+         node;
+         node = ngx_rbtree_next(&pwroot->tree, node))
+    {
+        filter = ngx_rbtree_data(node, ngx_proxy_wasm_filter_t, node);
+
+        for (q = ngx_queue_head(&pwroot->snapshots);
+             q != ngx_queue_sentinel(&pwroot->snapshots);
+             q = ngx_queue_next(q))
+        {
+            snapshot = ngx_queue_data(q, ngx_proxy_wasm_snapshot_t, q);
+
+            if (snapshot->wsnapshot->module == filter->module) {
+                goto found;
+            }
+        }
+
+        /* root instance: all root contexts of this module are configured */
+
+        ictx = NULL;
+
+        for (q = ngx_queue_head(&filter->store->busy);
+             q != ngx_queue_sentinel(&filter->store->busy);
+             q = ngx_queue_next(q))
+        {
+            ictx = ngx_queue_data(q, ngx_proxy_wasm_instance_t, q);
+
+            if (ictx->module == filter->module && !ictx->instance->trapped) {
+                break;
+            }
+
+            ictx = NULL;
+        }
+
+        if (ictx == NULL) {
+            continue;
+        }
+
+        snapshot = ngx_pcalloc(pwroot->store.pool,
+                               sizeof(ngx_proxy_wasm_snapshot_t));
+        if (snapshot == NULL) {
+            return NGX_ERROR;
+        }
+
+        if (ngx_array_init(&snapshot->root_ids, pwroot->store.pool, 4,
+                           sizeof(ngx_uint_t))
+            != NGX_OK)
+        {
+            return NGX_ERROR;
+        }
+
+        sentinel = ictx->root_ctxs.sentinel;
+
+        for (rnode = ictx->root_ctxs.root != sentinel
+                     ? ngx_rbtree_min(ictx->root_ctxs.root, sentinel)
+                     : NULL;
+             rnode;
+             rnode = ngx_rbtree_next(&ictx->root_ctxs, rnode))
+        {
+            rexec = ngx_rbtree_data(rnode, ngx_proxy_wasm_exec_t, node);
+
+            id = ngx_array_push(&snapshot->root_ids);
+            if (id == NULL) {
+                return NGX_ERROR;
+            }
+
+            *id = rexec->id;
+        }
+
+        snapshot->wsnapshot = ngx_wavm_snapshot_create(ictx->instance,
+                                                       filter->log);
+        if (snapshot->wsnapshot == NULL) {
+            ngx_array_destroy(&snapshot->root_ids);
+            ngx_pfree(pwroot->store.pool, snapshot);
+            return NGX_ERROR;
+        }
+
+        ngx_queue_insert_tail(&pwroot->snapshots, &snapshot->q);
+
+    found:
+
+        filter->snapshot = snapshot;
+
+        if (filter->ipool) {
+            filter->ipool->snapshot = snapshot;
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+static unsigned
+ngx_proxy_wasm_snapshot_has_root(ngx_proxy_wasm_snapshot_t *snapshot,
+    ngx_uint_t id)
+{
+    ngx_uint_t   i, *ids;
+
+    ids = snapshot->root_ids.elts;
+
+    for (i = 0; i < snapshot->root_ids.nelts; i++) {
+        if (ids[i] == id) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+
 #if 0
 static void
 ngx_proxy_wasm_store_schedule_sweep_handler(ngx_event_t *ev)
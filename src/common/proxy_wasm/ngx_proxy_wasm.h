@@ -78,6 +78,7 @@ typedef enum {
     NGX_PROXY_WASM_STEP_DONE,
     NGX_PROXY_WASM_STEP_TICK,
     NGX_PROXY_WASM_STEP_DISPATCH_RESPONSE,
+    NGX_PROXY_WASM_STEP_QUEUE_READY,
 } ngx_proxy_wasm_step_e;
 
 
@@ -159,7 +160,6 @@ typedef ngx_str_t  ngx_proxy_wasm_marshalled_map_t;
 
 typedef struct {
     ngx_queue_t                        busy;
-    ngx_queue_t                        free;
     ngx_queue_t                        sweep;
     ngx_pool_t                        *pool;
 } ngx_proxy_wasm_store_t;
@@ -177,6 +177,7 @@ struct ngx_proxy_wasm_exec_s {
     ngx_uint_t                         id;
     ngx_uint_t                         index;
     ngx_uint_t                         tick_period;
+    ngx_uint_t                         ready_queue;  /* on_queue_ready token */
     ngx_rbtree_node_t                  node;
     ngx_proxy_wasm_err_e               ecode;
     ngx_pool_t                        *pool;
@@ -206,6 +207,17 @@ typedef ngx_int_t (*ngx_proxy_wasm_properties_ffi_handler_pt)(void *data,
 #endif
 
 
+typedef struct {
+    ngx_str_t                   data;       /* marshalled map */
+    size_t                      size;       /* data capacity */
+    ngx_uint_t                  max_pairs;
+    ngx_uint_t                  truncated;
+    ngx_proxy_wasm_step_e       step;
+    ngx_uint_t                  gen;        /* headers generation */
+    unsigned                    valid:1;
+} ngx_proxy_wasm_map_cache_t;
+
+
 struct ngx_proxy_wasm_ctx_s {
     ngx_uint_t                                    id;      /* r->connection->number */
     ngx_uint_t                                    nfilters;
@@ -245,6 +257,8 @@ struct ngx_proxy_wasm_ctx_s {
 #endif
     ngx_uint_t                                    call_code;
     ngx_uint_t                                    response_code;
+    ngx_proxy_wasm_map_cache_t                    req_headers_cache;
+    ngx_proxy_wasm_map_cache_t                    resp_headers_cache;
 
     /* host properties */
 
@@ -265,8 +279,15 @@ struct ngx_proxy_wasm_ctx_s {
 };
 
 
+typedef struct {
+    ngx_queue_t                        q;         /* pwroot->snapshots */
+    ngx_wavm_snapshot_t               *wsnapshot;
+    ngx_array_t                        root_ids;  /* started root ctxs */
+} ngx_proxy_wasm_snapshot_t;
+
+
 struct ngx_proxy_wasm_instance_s {
-    ngx_queue_t                        q;                 /* store busy/free/sweep */
+    ngx_queue_t                        q;                 /* store busy/sweep */
     ngx_rbtree_t                       tree_ctxs;
     ngx_rbtree_t                       root_ctxs;
     ngx_rbtree_node_t                  sentinel_ctxs;
@@ -276,13 +297,39 @@ struct ngx_proxy_wasm_instance_s {
     ngx_proxy_wasm_store_t            *store;
     ngx_pool_t                        *pool;
     ngx_log_t                         *log;
+    ngx_proxy_wasm_snapshot_t         *snapshot;          /* restored from */
 
     /* swap */
 
     ngx_proxy_wasm_exec_t             *pwexec;            /* current pwexec */
+
+    /* flags */
+
+    unsigned                           pooled:1;          /* owns its pool */
 };
 
 
+typedef struct {
+    ngx_queue_t                        q;                 /* pwroot->ipools */
+    ngx_queue_t                        free;              /* warm instances */
+    ngx_uint_t                         nfree;
+    ngx_uint_t                         min;
+    ngx_uint_t                         max;
+    ngx_uint_t                         hits;
+    ngx_uint_t                         misses;
+    uint32_t                           hits_mid;
+    uint32_t                           misses_mid;
+    ngx_wavm_module_t                 *module;
+    ngx_proxy_wasm_snapshot_t         *snapshot;
+    ngx_log_t                         *log;
+    ngx_event_t                        refill_ev;
+
+    /* flags */
+
+    unsigned                           metrics:1;
+} ngx_proxy_wasm_ipool_t;
+
+
 typedef struct {
     ngx_proxy_wasm_ctx_t              *(*get_context)(void *data);
     ngx_int_t                          (*resume)(ngx_proxy_wasm_exec_t *pwexec,
@@ -302,6 +349,9 @@ struct ngx_proxy_wasm_filter_s {
     ngx_wavm_module_t             *module;
     ngx_proxy_wasm_subsystem_t    *subsystem;
     ngx_proxy_wasm_store_t        *store;   /* mcf->pwroot.store */
+    ngx_proxy_wasm_ipool_t        *ipool;   /* warm instances (optional) */
+    ngx_proxy_wasm_snapshot_t     *snapshot;  /* post-configure (optional) */
+    ngx_array_t                   *properties;  /* resolved property handles */
     ngx_proxy_wasm_err_e           ecode;
 
     /* dyn config */
@@ -389,6 +439,11 @@ typedef struct {
     ngx_rbtree_t                   tree;
     ngx_rbtree_node_t              sentinel;
     ngx_proxy_wasm_store_t         store;
+    ngx_queue_t                    ipools;
+    ngx_uint_t                     ipool_min;
+    ngx_uint_t                     ipool_max;
+    ngx_queue_t                    snapshots;
+    ngx_flag_t                     snapshot;
     unsigned                       init:1;
 } ngx_proxy_wasm_filters_root_t;
 
@@ -429,11 +484,19 @@ u_char *ngx_proxy_wasm_log_error_handler(ngx_log_t *log, u_char *buf,
 void ngx_proxy_wasm_log_error(ngx_uint_t level, ngx_log_t *log,
     ngx_proxy_wasm_err_e err, const char *fmt, ...);
 void ngx_proxy_wasm_filter_tick_handler(ngx_event_t *ev);
+void ngx_proxy_wasm_filter_queue_ready(uint32_t token, void *data);
 ngx_int_t ngx_proxy_wasm_pairs_unmarshal(ngx_proxy_wasm_exec_t *pwexec,
     ngx_array_t *dst, ngx_proxy_wasm_marshalled_map_t *map);
+ngx_int_t ngx_proxy_wasm_keys_unmarshal(ngx_proxy_wasm_exec_t *pwexec,
+    ngx_array_t *dst, ngx_proxy_wasm_marshalled_map_t *map);
 unsigned ngx_proxy_wasm_marshal(ngx_proxy_wasm_exec_t *pwexec,
     ngx_list_t *list, ngx_array_t *extras, ngx_wavm_ptr_t *out,
     uint32_t *out_size, ngx_uint_t *truncated);
+ngx_int_t ngx_proxy_wasm_marshal_cache(ngx_proxy_wasm_exec_t *pwexec,
+    ngx_proxy_wasm_map_cache_t *cache, ngx_list_t *list, ngx_array_t *extras);
+unsigned ngx_proxy_wasm_marshal_cached(ngx_proxy_wasm_exec_t *pwexec,
+    ngx_proxy_wasm_map_cache_t *cache, ngx_wavm_ptr_t *out,
+    uint32_t *out_size);
 
 
 static ngx_inline void
@@ -422,6 +422,188 @@ ngx_proxy_wasm_hfuncs_get_buffer(ngx_wavm_instance_t *instance,
 }
 
 
+static ngx_chain_t *
+ngx_proxy_wasm_get_buffer_chain(ngx_wavm_instance_t *instance,
+    ngx_proxy_wasm_buffer_type_e buf_type, ngx_chain_t *tmp,
+    wasm_val_t rets[], ngx_int_t *rc)
+{
+    unsigned                none = 0;
+    char                   *trapmsg = NULL;
+    ngx_str_t              *config;
+    ngx_chain_t            *cl;
+    ngx_proxy_wasm_exec_t  *pwexec;
+
+    /**
+     * Resolve buf_type to a chain of in-memory buffers; configuration
+     * strings are wrapped in the caller-provided tmp link. On failure,
+     * rets is set and *rc holds the host function return value.
+     */
+
+    pwexec = ngx_proxy_wasm_instance2pwexec(instance);
+
+    switch (buf_type) {
+    case NGX_PROXY_WASM_BUFFER_PLUGIN_CONFIGURATION:
+        config = &pwexec->filter->config;
+        break;
+
+    case NGX_PROXY_WASM_BUFFER_VM_CONFIGURATION:
+        config = &pwexec->filter->module->config;
+        break;
+
+    default:
+        cl = ngx_proxy_wasm_get_buffer_helper(instance, buf_type, &none,
+                                              &trapmsg);
+        if (cl == NULL) {
+            if (trapmsg) {
+                *rc = ngx_proxy_wasm_result_trap(pwexec, trapmsg, rets,
+                                                 NGX_WAVM_BAD_USAGE);
+
+            } else if (none) {
+                *rc = ngx_proxy_wasm_result_notfound(rets);
+
+            } else {
+                *rc = ngx_proxy_wasm_result_badarg(rets);
+            }
+        }
+
+        return cl;
+    }
+
+    tmp->buf->pos = config->data;
+    tmp->buf->last = config->data + config->len;
+    tmp->buf->last_buf = 1;
+    tmp->next = NULL;
+
+    return tmp;
+}
+
+
+static ngx_int_t
+ngx_proxy_wasm_hfuncs_get_buffer_into(ngx_wavm_instance_t *instance,
+    wasm_val_t args[], wasm_val_t rets[])
+{
+    size_t                         offset, max_len, len, chunk_len;
+    u_char                        *dst;
+    uint32_t                      *rlen;
+    ngx_int_t                      rc;
+    ngx_buf_t                      b, *buf;
+    ngx_chain_t                    tmp, *cl;
+    ngx_proxy_wasm_buffer_type_e   buf_type;
+
+    /**
+     * Copy up to max_len bytes of a buffer starting at offset into a
+     * guest-provided region, without proxy_on_memory_allocate.
+     */
+
+    buf_type = args[0].of.i32;
+    offset = args[1].of.i32;
+    max_len = args[2].of.i32;
+    dst = NGX_WAVM_HOST_LIFT_SLICE(instance, args[3].of.i32, max_len);
+    rlen = NGX_WAVM_HOST_LIFT(instance, args[4].of.i32, uint32_t);
+
+    ngx_memzero(&b, sizeof(ngx_buf_t));
+    tmp.buf = &b;
+
+    cl = ngx_proxy_wasm_get_buffer_chain(instance, buf_type, &tmp, rets, &rc);
+    if (cl == NULL) {
+        return rc;
+    }
+
+    len = 0;
+
+    for (/* void */; cl && len < max_len; cl = cl->next) {
+        buf = cl->buf;
+        chunk_len = buf->last - buf->pos;
+
+        if (offset >= chunk_len) {
+            offset -= chunk_len;
+
+        } else {
+            chunk_len = ngx_min(chunk_len - offset, max_len - len);
+            ngx_memcpy(dst + len, buf->pos + offset, chunk_len);
+
+            len += chunk_len;
+            offset = 0;
+        }
+
+        if (buf->last_buf || buf->last_in_chain) {
+            break;
+        }
+    }
+
+    *rlen = (uint32_t) len;
+
+    return ngx_proxy_wasm_result_ok(rets);
+}
+
+
+static ngx_int_t
+ngx_proxy_wasm_hfuncs_get_buffer_windows(ngx_wavm_instance_t *instance,
+    wasm_val_t args[], wasm_val_t rets[])
+{
+    size_t                         offset, pos, chunk_len;
+    uint32_t                       max_windows, n, *rcount, window[2];
+    u_char                        *windows;
+    ngx_int_t                      rc;
+    ngx_buf_t                      b, *buf;
+    ngx_chain_t                    tmp, *cl;
+    ngx_proxy_wasm_buffer_type_e   buf_type;
+
+    /**
+     * Describe the buffer as up to max_windows (offset, length) pairs of
+     * u32, one per contiguous host buffer, starting at offset; the guest
+     * reads the windows it needs with proxy_get_buffer_into.
+     */
+
+    buf_type = args[0].of.i32;
+    offset = args[1].of.i32;
+    max_windows = args[3].of.i32;
+
+    if (max_windows > NGX_MAX_UINT32_VALUE / sizeof(window)) {
+        return ngx_proxy_wasm_result_badarg(rets);
+    }
+
+    windows = NGX_WAVM_HOST_LIFT_SLICE(instance, args[2].of.i32,
+                                       (size_t) max_windows
+                                       * sizeof(window));
+    rcount = NGX_WAVM_HOST_LIFT(instance, args[4].of.i32, uint32_t);
+
+    ngx_memzero(&b, sizeof(ngx_buf_t));
+    tmp.buf = &b;
+
+    cl = ngx_proxy_wasm_get_buffer_chain(instance, buf_type, &tmp, rets, &rc);
+    if (cl == NULL) {
+        return rc;
+    }
+
+    n = 0;
+    pos = 0;
+
+    for (/* void */; cl && n < max_windows; cl = cl->next) {
+        buf = cl->buf;
+        chunk_len = buf->last - buf->pos;
+
+        if (chunk_len && pos + chunk_len > offset) {
+            window[0] = (uint32_t) ngx_max(pos, offset);
+            window[1] = (uint32_t) (pos + chunk_len - window[0]);
+
+            ngx_memcpy(windows + n * sizeof(window), window, sizeof(window));
+            n++;
+        }
+
+        pos += chunk_len;
+
+        if (buf->last_buf || buf->last_in_chain) {
+            break;
+        }
+    }
+
+    *rcount = n;
+
+    return ngx_proxy_wasm_result_ok(rets);
+}
+
+
 static ngx_int_t
 ngx_proxy_wasm_hfuncs_set_buffer(ngx_wavm_instance_t *instance,
     wasm_val_t args[], wasm_val_t rets[])
@@ -543,13 +725,14 @@ static ngx_int_t
 ngx_proxy_wasm_hfuncs_get_header_map_pairs(ngx_wavm_instance_t *instance,
     wasm_val_t args[], wasm_val_t rets[])
 {
-    uint32_t                   *rlen;
-    ngx_uint_t                  truncated = 0;
-    ngx_list_t                 *list;
-    ngx_array_t                 extras;
-    ngx_wavm_ptr_t             *rbuf;
-    ngx_proxy_wasm_exec_t      *pwexec;
-    ngx_proxy_wasm_map_type_e   map_type;
+    uint32_t                    *rlen;
+    ngx_uint_t                   truncated = 0;
+    ngx_list_t                  *list;
+    ngx_array_t                  extras;
+    ngx_wavm_ptr_t              *rbuf;
+    ngx_proxy_wasm_exec_t       *pwexec;
+    ngx_proxy_wasm_map_type_e    map_type;
+    ngx_proxy_wasm_map_cache_t  *cache;
 
     pwexec = ngx_proxy_wasm_instance2pwexec(instance);
 
@@ -557,6 +740,21 @@ ngx_proxy_wasm_hfuncs_get_header_map_pairs(ngx_wavm_instance_t *instance,
     rbuf = NGX_WAVM_HOST_LIFT(instance, args[1].of.i32, ngx_wavm_ptr_t);
     rlen = NGX_WAVM_HOST_LIFT(instance, args[2].of.i32, uint32_t);
 
+    cache = ngx_proxy_wasm_maps_cache(instance, map_type);
+
+    if (cache
+        && cache->valid
+        && cache->step == pwexec->parent->step
+        && cache->max_pairs == pwexec->filter->max_pairs)
+    {
+        ngx_log_debug1(NGX_LOG_DEBUG_WASM, pwexec->log, 0,
+                       "proxy_wasm reusing marshalled map "
+                       "(map_type: %d)", map_type);
+
+        truncated = cache->truncated;
+        goto marshal;
+    }
+
     ngx_array_init(&extras, pwexec->pool, 8, sizeof(ngx_table_elt_t));
 
     list = ngx_proxy_wasm_maps_get_all(instance, map_type, &extras);
@@ -564,12 +762,33 @@ ngx_proxy_wasm_hfuncs_get_header_map_pairs(ngx_wavm_instance_t *instance,
         return ngx_proxy_wasm_result_badarg(rets);
     }
 
+    if (cache) {
+        if (ngx_proxy_wasm_marshal_cache(pwexec, cache, list, &extras)
+            != NGX_OK)
+        {
+            return ngx_proxy_wasm_result_err(rets);
+        }
+
+        truncated = cache->truncated;
+        goto marshal;
+    }
+
     if (!ngx_proxy_wasm_marshal(pwexec, list, &extras, rbuf, rlen,
                                 &truncated))
     {
         return ngx_proxy_wasm_result_invalid_mem(rets);
     }
 
+    goto done;
+
+marshal:
+
+    if (!ngx_proxy_wasm_marshal_cached(pwexec, cache, rbuf, rlen)) {
+        return ngx_proxy_wasm_result_invalid_mem(rets);
+    }
+
+done:
+
     if (truncated) {
         ngx_proxy_wasm_log_error(NGX_LOG_WARN, pwexec->log, 0,
                                  "marshalled map truncated to %ui elements",
@@ -639,6 +858,10 @@ ngx_proxy_wasm_hfuncs_set_header_check(ngx_wavm_instance_t *instance,
     pwctx = pwexec->parent;
 #endif
 
+    /* the map is about to change: drop its marshalled copy */
+
+    ngx_proxy_wasm_maps_cache_invalidate(instance, map_type);
+
     switch (map_type) {
 #ifdef NGX_WASM_HTTP
     case NGX_PROXY_WASM_MAP_HTTP_REQUEST_HEADERS:
@@ -865,6 +1088,147 @@ ngx_proxy_wasm_hfuncs_remove_header_map_value(ngx_wavm_instance_t *instance,
 }
 
 
+static ngx_int_t
+ngx_proxy_wasm_hfuncs_get_map_values(ngx_wavm_instance_t *instance,
+    wasm_val_t args[], wasm_val_t rets[])
+{
+    uint32_t                         *rlen;
+    ngx_int_t                         rc;
+    ngx_uint_t                        truncated = 0;
+    ngx_list_t                        empty;
+    ngx_array_t                       keys, values;
+    ngx_wavm_ptr_t                   *rbuf;
+    ngx_proxy_wasm_exec_t            *pwexec;
+    ngx_proxy_wasm_map_type_e         map_type;
+    ngx_proxy_wasm_marshalled_map_t   map;
+    wasm_val_t                        pairs_args[3];
+
+    pwexec = ngx_proxy_wasm_instance2pwexec(instance);
+
+    map_type = args[0].of.i32;
+    map.len = args[2].of.i32;
+    map.data = NGX_WAVM_HOST_LIFT_SLICE(instance, args[1].of.i32, map.len);
+    rbuf = NGX_WAVM_HOST_LIFT(instance, args[3].of.i32, ngx_wavm_ptr_t);
+    rlen = NGX_WAVM_HOST_LIFT(instance, args[4].of.i32, uint32_t);
+
+    if (ngx_proxy_wasm_keys_unmarshal(pwexec, &keys, &map) != NGX_OK) {
+        return ngx_proxy_wasm_result_badarg(rets);
+    }
+
+    if (keys.nelts == 0) {
+        /* no keys: all pairs */
+        pairs_args[0] = args[0];
+        pairs_args[1] = args[3];
+        pairs_args[2] = args[4];
+
+        return ngx_proxy_wasm_hfuncs_get_header_map_pairs(instance,
+                                                          pairs_args, rets);
+    }
+
+    if (ngx_array_init(&values, pwexec->pool, keys.nelts,
+                       sizeof(ngx_table_elt_t))
+        != NGX_OK
+        || ngx_list_init(&empty, pwexec->pool, 1, sizeof(ngx_table_elt_t))
+           != NGX_OK)
+    {
+        return ngx_proxy_wasm_result_err(rets);
+    }
+
+    /* keys point to guest memory: lookup before any guest allocation */
+
+    rc = ngx_proxy_wasm_maps_get_values(instance, map_type, &keys, &values);
+    if (rc == NGX_DECLINED) {
+        return ngx_proxy_wasm_result_badarg(rets);
+    }
+
+    if (rc != NGX_OK) {
+        return ngx_proxy_wasm_result_err(rets);
+    }
+
+    if (values.nelts == 0) {
+        return ngx_proxy_wasm_result_notfound(rets);
+    }
+
+    if (!ngx_proxy_wasm_marshal(pwexec, &empty, &values, rbuf, rlen,
+                                &truncated))
+    {
+        return ngx_proxy_wasm_result_invalid_mem(rets);
+    }
+
+    if (truncated) {
+        ngx_proxy_wasm_log_error(NGX_LOG_WARN, pwexec->log, 0,
+                                 "marshalled map truncated to %ui elements",
+                                 truncated);
+    }
+
+    return ngx_proxy_wasm_result_ok(rets);
+}
+
+
+static ngx_int_t
+ngx_proxy_wasm_hfuncs_set_map_values(ngx_wavm_instance_t *instance,
+    wasm_val_t args[], wasm_val_t rets[])
+{
+    size_t                            i;
+    ngx_int_t                         rc;
+    ngx_str_t                        *key;
+    ngx_array_t                       keys, pairs;
+    ngx_table_elt_t                  *elt;
+    ngx_proxy_wasm_exec_t            *pwexec;
+    ngx_proxy_wasm_map_type_e         map_type;
+    ngx_proxy_wasm_marshalled_map_t   remove_map, map;
+
+    pwexec = ngx_proxy_wasm_instance2pwexec(instance);
+
+    map_type = args[0].of.i32;
+    remove_map.len = args[2].of.i32;
+    remove_map.data = NGX_WAVM_HOST_LIFT_SLICE(instance, args[1].of.i32,
+                                               remove_map.len);
+    map.len = args[4].of.i32;
+    map.data = NGX_WAVM_HOST_LIFT_SLICE(instance, args[3].of.i32, map.len);
+
+    rc = ngx_proxy_wasm_hfuncs_set_header_check(instance, map_type, rets);
+    if (rc != NGX_OK) {
+        return rc;
+    }
+
+    if (ngx_proxy_wasm_keys_unmarshal(pwexec, &keys, &remove_map) != NGX_OK
+        || ngx_proxy_wasm_pairs_unmarshal(pwexec, &pairs, &map) != NGX_OK)
+    {
+        return ngx_proxy_wasm_result_badarg(rets);
+    }
+
+    key = keys.elts;
+
+    for (i = 0; i < keys.nelts; i++) {
+        rc = ngx_proxy_wasm_maps_set(instance, map_type, &key[i], NULL,
+                                     NGX_PROXY_WASM_MAP_REMOVE);
+        if (rc == NGX_ERROR) {
+            return ngx_proxy_wasm_result_err(rets);
+        }
+    }
+
+    elt = pairs.elts;
+
+    for (i = 0; i < pairs.nelts; i++) {
+        rc = ngx_proxy_wasm_maps_set(instance, map_type,
+                                     &elt[i].key, &elt[i].value,
+                                     NGX_PROXY_WASM_MAP_ADD);
+        if (rc == NGX_ERROR) {
+            return ngx_proxy_wasm_result_err(rets);
+        }
+    }
+
+    /*
+     * NGX_ABORT: read-only
+     */
+
+    ngx_wa_assert(rc == NGX_OK || rc == NGX_ABORT);
+
+    return ngx_proxy_wasm_result_ok(rets);
+}
+
+
 /* properties */
 
 
@@ -933,53 +1297,151 @@ ngx_proxy_wasm_hfuncs_get_property(ngx_wavm_instance_t *instance,
 
 
 static ngx_int_t
-ngx_proxy_wasm_hfuncs_set_property(ngx_wavm_instance_t *instance,
+ngx_proxy_wasm_hfuncs_resolve_property(ngx_wavm_instance_t *instance,
     wasm_val_t args[], wasm_val_t rets[])
 {
-    char                    trapmsg[NGX_MAX_ERROR_STR];
-    ngx_int_t               rc;
-    ngx_str_t               path, value;
-    ngx_str_t               err = { 0, NULL };
-    u_char                 *dotted_path, *last;
+    ngx_str_t               path;
+    ngx_uint_t              handle;
+    uint32_t               *ret_handle;
     ngx_proxy_wasm_exec_t  *pwexec;
 
     path.len = args[1].of.i32;
     path.data = NGX_WAVM_HOST_LIFT_SLICE(instance, args[0].of.i32, path.len);
-    value.len = args[3].of.i32;
-    value.data = NGX_WAVM_HOST_LIFT_SLICE(instance, args[2].of.i32, value.len);
-
-    pwexec = ngx_proxy_wasm_instance2pwexec(instance);
-
-    rc = ngx_proxy_wasm_properties_set(pwexec->parent, &path, &value, &err);
 
-    switch (rc) {
-    case NGX_DECLINED:
-        return ngx_proxy_wasm_result_notfound(rets);
-    case NGX_ERROR:
-        if (err.len) {
-            ngx_proxy_wasm_properties_unmarsh_path(&path, &dotted_path);
+    ret_handle = NGX_WAVM_HOST_LIFT(instance, args[2].of.i32, uint32_t);
 
-            last = ngx_slprintf((u_char *) &trapmsg,
-                                (u_char *) trapmsg + NGX_MAX_ERROR_STR - 1,
-                                "could not set \"%s\": %V",
-                                dotted_path,
-                                &err);
-            *last++ = '\0';
+    pwexec = ngx_proxy_wasm_instance2pwexec(instance);
 
-            return ngx_proxy_wasm_result_trap(pwexec, trapmsg, rets,
-                                              NGX_WAVM_ERROR);
-        }
+    if (path.len == 0) {
+        return ngx_proxy_wasm_result_badarg(rets);
+    }
 
+    if (ngx_proxy_wasm_properties_resolve(pwexec->filter, &path, &handle)
+        != NGX_OK)
+    {
         return ngx_proxy_wasm_result_err(rets);
-    default:
-        ngx_wa_assert(rc == NGX_OK);
     }
 
+    *ret_handle = (uint32_t) handle;
+
     return ngx_proxy_wasm_result_ok(rets);
 }
 
 
-/* stream */
+static ngx_int_t
+ngx_proxy_wasm_hfuncs_get_property_by_handle(ngx_wavm_instance_t *instance,
+    wasm_val_t args[], wasm_val_t rets[])
+{
+    char                    trapmsg[NGX_MAX_ERROR_STR];
+    ngx_int_t               rc;
+    ngx_uint_t              handle;
+    ngx_str_t               value;
+    ngx_str_t               err = { 0, NULL };
+    int32_t                *ret_size;
+    u_char                 *last;
+    ngx_proxy_wasm_exec_t  *pwexec;
+    ngx_wavm_ptr_t         *ret_data, p = 0;
+
+    handle = (uint32_t) args[0].of.i32;
+
+    ret_data = NGX_WAVM_HOST_LIFT(instance, args[1].of.i32, ngx_wavm_ptr_t);
+    ret_size = NGX_WAVM_HOST_LIFT(instance, args[2].of.i32, int32_t);
+
+    pwexec = ngx_proxy_wasm_instance2pwexec(instance);
+
+    rc = ngx_proxy_wasm_properties_get_by_handle(pwexec->parent,
+                                                 pwexec->filter, handle,
+                                                 &value, &err);
+
+    switch (rc) {
+    case NGX_ABORT:
+        /* unknown handle */
+        return ngx_proxy_wasm_result_badarg(rets);
+    case NGX_DECLINED:
+        return ngx_proxy_wasm_result_notfound(rets);
+    case NGX_ERROR:
+        if (err.len) {
+            last = ngx_slprintf((u_char *) &trapmsg,
+                                (u_char *) trapmsg + NGX_MAX_ERROR_STR - 1,
+                                "could not get property handle %ui: %V",
+                                handle, &err);
+            *last++ = '\0';
+
+            return ngx_proxy_wasm_result_trap(pwexec, trapmsg, rets,
+                                              NGX_WAVM_ERROR);
+        }
+
+        return ngx_proxy_wasm_result_err(rets);
+    default:
+        ngx_wa_assert(rc == NGX_OK);
+    }
+
+    p = ngx_proxy_wasm_alloc(pwexec, value.len);
+    if (p == 0) {
+        return ngx_proxy_wasm_result_err(rets);
+    }
+
+    if (!ngx_wavm_memory_memcpy(instance->memory, p,
+                                value.data, value.len))
+    {
+        return ngx_proxy_wasm_result_invalid_mem(rets);
+    }
+
+    *ret_data = p;
+    *ret_size = value.len;
+
+    return ngx_proxy_wasm_result_ok(rets);
+}
+
+
+static ngx_int_t
+ngx_proxy_wasm_hfuncs_set_property(ngx_wavm_instance_t *instance,
+    wasm_val_t args[], wasm_val_t rets[])
+{
+    char                    trapmsg[NGX_MAX_ERROR_STR];
+    ngx_int_t               rc;
+    ngx_str_t               path, value;
+    ngx_str_t               err = { 0, NULL };
+    u_char                 *dotted_path, *last;
+    ngx_proxy_wasm_exec_t  *pwexec;
+
+    path.len = args[1].of.i32;
+    path.data = NGX_WAVM_HOST_LIFT_SLICE(instance, args[0].of.i32, path.len);
+    value.len = args[3].of.i32;
+    value.data = NGX_WAVM_HOST_LIFT_SLICE(instance, args[2].of.i32, value.len);
+
+    pwexec = ngx_proxy_wasm_instance2pwexec(instance);
+
+    rc = ngx_proxy_wasm_properties_set(pwexec->parent, &path, &value, &err);
+
+    switch (rc) {
+    case NGX_DECLINED:
+        return ngx_proxy_wasm_result_notfound(rets);
+    case NGX_ERROR:
+        if (err.len) {
+            ngx_proxy_wasm_properties_unmarsh_path(&path, &dotted_path);
+
+            last = ngx_slprintf((u_char *) &trapmsg,
+                                (u_char *) trapmsg + NGX_MAX_ERROR_STR - 1,
+                                "could not set \"%s\": %V",
+                                dotted_path,
+                                &err);
+            *last++ = '\0';
+
+            return ngx_proxy_wasm_result_trap(pwexec, trapmsg, rets,
+                                              NGX_WAVM_ERROR);
+        }
+
+        return ngx_proxy_wasm_result_err(rets);
+    default:
+        ngx_wa_assert(rc == NGX_OK);
+    }
+
+    return ngx_proxy_wasm_result_ok(rets);
+}
+
+
+/* stream */
 
 
 static ngx_int_t
@@ -1243,13 +1705,14 @@ static ngx_int_t
 ngx_proxy_wasm_hfuncs_get_shared_data(ngx_wavm_instance_t *instance,
     wasm_val_t args[], wasm_val_t rets[])
 {
+    u_char                 *p = NULL;
     ngx_int_t               rc;
-    ngx_str_t               key;
-    ngx_str_t              *value;
+    ngx_str_t               key, value;
     uint32_t               *value_data, *value_size, *cas;
     uint32_t                wbuf_ptr;
     ngx_wa_shm_kv_key_t     resolved;
     ngx_proxy_wasm_exec_t  *pwexec = ngx_proxy_wasm_instance2pwexec(instance);
+    u_char                  buf[NGX_WA_SHM_KV_READ_BUF_SIZE];
 
     key.len = args[1].of.i32;
     key.data = NGX_WAVM_HOST_LIFT_SLICE(instance, args[0].of.i32, key.len);
@@ -1276,101 +1739,533 @@ ngx_proxy_wasm_hfuncs_get_shared_data(ngx_wavm_instance_t *instance,
                                           NGX_WAVM_BAD_USAGE);
     }
 
-    ngx_wa_assert(rc == NGX_OK);
+    ngx_wa_assert(rc == NGX_OK);
+
+    /* get */
+
+    value.data = buf;
+    value.len = sizeof(buf);
+
+    for ( ;; ) {
+        rc = ngx_wa_shm_kv_read(resolved.shm, &key, NULL, &value, cas);
+        if (rc != NGX_BUSY) {
+            break;
+        }
+
+        /* larger values are copied in a temporary buffer */
+
+        if (p) {
+            ngx_free(p);
+        }
+
+        p = ngx_alloc(value.len, pwexec->log);
+        if (p == NULL) {
+            goto nomem;
+        }
+
+        value.data = p;
+    }
+
+    if (rc == NGX_DECLINED) {
+        rc = ngx_proxy_wasm_result_notfound(rets);
+        goto done;
+    }
+
+    ngx_wa_assert(rc == NGX_OK);
+
+    /* return value */
+
+    wbuf_ptr = ngx_proxy_wasm_alloc(pwexec, value.len);
+    if (wbuf_ptr == 0) {
+        goto nomem;
+    }
+
+    ngx_memcpy(NGX_WAVM_HOST_LIFT_SLICE(instance, wbuf_ptr, value.len),
+               value.data, value.len);
+
+    *value_data = wbuf_ptr;
+    *value_size = value.len;
+
+    rc = ngx_proxy_wasm_result_ok(rets);
+
+done:
+
+    if (p) {
+        ngx_free(p);
+    }
+
+    return rc;
+
+nomem:
+
+    if (p) {
+        ngx_free(p);
+    }
+
+    /* TODO: format with key */
+    return ngx_proxy_wasm_result_trap(pwexec, "failed getting value "
+                                      "from shm (no memory)", rets,
+                                      NGX_WAVM_ERROR);
+}
+
+
+static ngx_int_t
+ngx_proxy_wasm_set_shared_data(ngx_wavm_instance_t *instance,
+    wasm_val_t args[], ngx_msec_t ttl, wasm_val_t rets[])
+{
+    uint32_t                cas;
+    unsigned                written;
+    ngx_int_t               rc;
+    ngx_str_t               key, value;
+    ngx_wa_shm_t           *shard;
+    ngx_wa_shm_kv_key_t     resolved;
+    ngx_proxy_wasm_exec_t  *pwexec = ngx_proxy_wasm_instance2pwexec(instance);
+
+    key.len = args[1].of.i32;
+    key.data = NGX_WAVM_HOST_LIFT_SLICE(instance, args[0].of.i32, key.len);
+    value.len = args[3].of.i32;
+    value.data = NGX_WAVM_HOST_LIFT_SLICE(instance, args[2].of.i32, value.len);
+    cas = args[4].of.i32;
+
+    dd("setting \"%.*s\" -> \"%.*s\"",
+       (int) key.len, key.data,
+       (int) value.len, value.data);
+
+    /* resolve key namespace */
+
+    rc = ngx_wa_shm_kv_resolve_key(&key, &resolved);
+    if (rc == NGX_ABORT) {
+        /* TODO: format with key */
+        return ngx_proxy_wasm_result_trap(pwexec, "attempt to set "
+                                          "key/value in a queue", rets,
+                                          NGX_WAVM_BAD_USAGE);
+    }
+
+    if (rc == NGX_DECLINED) {
+        /* TODO: format with key */
+        return ngx_proxy_wasm_result_trap(pwexec, "failed setting value "
+                                          "to shm (could not resolve "
+                                          "namespace)", rets,
+                                          NGX_WAVM_BAD_USAGE);
+    }
+
+    ngx_wa_assert(rc == NGX_OK);
+
+    /* set */
+
+    shard = ngx_wa_shm_kv_shard(resolved.shm,
+                                ngx_crc32_long(key.data, key.len));
+
+    ngx_wa_shm_lock(shard);
+
+    /*
+     * If the filter passes a NULL value pointer, treat it as a delete request.
+     * It is still possible to distinguish between:
+     * - Setting an empty value (ptr != NULL, len == 0)
+     * - Deleting a k/v pair (ptr == NULL, len == 0)
+     */
+    rc = ngx_wa_shm_kv_set_locked(shard, &key, value.data ? &value : NULL,
+                                  cas, ttl, &written);
+
+    ngx_wa_shm_unlock(shard);
+
+    if (rc == NGX_ERROR) {
+        /* TODO: format with key */
+        return ngx_proxy_wasm_result_trap(pwexec, "failed setting value "
+                                          "to shm (could not write to slab)",
+                                          rets,
+                                          NGX_WAVM_ERROR);
+    }
+
+    ngx_wa_assert(rc == NGX_OK);
+
+    if (!written) {
+        return ngx_proxy_wasm_result_cas_mismatch(rets);
+    }
+
+    return ngx_proxy_wasm_result_ok(rets);
+}
+
+
+static ngx_int_t
+ngx_proxy_wasm_hfuncs_set_shared_data(ngx_wavm_instance_t *instance,
+    wasm_val_t args[], wasm_val_t rets[])
+{
+    return ngx_proxy_wasm_set_shared_data(instance, args, 0, rets);
+}
+
+
+static ngx_int_t
+ngx_proxy_wasm_hfuncs_set_shared_data_with_ttl(ngx_wavm_instance_t *instance,
+    wasm_val_t args[], wasm_val_t rets[])
+{
+    return ngx_proxy_wasm_set_shared_data(instance, args,
+                                          (ngx_msec_t) args[5].of.i32, rets);
+}
+
+
+static ngx_int_t
+ngx_proxy_wasm_hfuncs_increment_shared_data(ngx_wavm_instance_t *instance,
+    wasm_val_t args[], wasm_val_t rets[])
+{
+    int64_t                 delta, init, *value;
+    ngx_int_t               rc;
+    ngx_msec_t              ttl;
+    ngx_str_t               key;
+    ngx_wa_shm_t           *shard;
+    ngx_wa_shm_kv_key_t     resolved;
+    ngx_proxy_wasm_exec_t  *pwexec = ngx_proxy_wasm_instance2pwexec(instance);
+
+    key.len = args[1].of.i32;
+    key.data = NGX_WAVM_HOST_LIFT_SLICE(instance, args[0].of.i32, key.len);
+    delta = args[2].of.i64;
+    init = args[3].of.i64;
+    ttl = (ngx_msec_t) args[4].of.i32;
+    value = NGX_WAVM_HOST_LIFT(instance, args[5].of.i32, int64_t);
+
+    dd("incrementing \"%.*s\" by %ld", (int) key.len, key.data,
+       (long) delta);
+
+    /* resolve key namespace */
+
+    rc = ngx_wa_shm_kv_resolve_key(&key, &resolved);
+    if (rc == NGX_ABORT) {
+        return ngx_proxy_wasm_result_trap(pwexec, "attempt to increment "
+                                          "key/value in a queue", rets,
+                                          NGX_WAVM_BAD_USAGE);
+    }
+
+    if (rc == NGX_DECLINED) {
+        return ngx_proxy_wasm_result_trap(pwexec, "failed incrementing "
+                                          "value in shm (could not resolve "
+                                          "namespace)", rets,
+                                          NGX_WAVM_BAD_USAGE);
+    }
+
+    ngx_wa_assert(rc == NGX_OK);
+
+    /* increment */
+
+    shard = ngx_wa_shm_kv_shard(resolved.shm,
+                                ngx_crc32_long(key.data, key.len));
+
+    ngx_wa_shm_lock(shard);
+
+    rc = ngx_wa_shm_kv_incr_locked(shard, &key, delta, init, ttl, value);
+
+    ngx_wa_shm_unlock(shard);
+
+    if (rc == NGX_DECLINED) {
+        /* existing value is not an 8 bytes integer */
+        return ngx_proxy_wasm_result_badarg(rets);
+    }
+
+    if (rc == NGX_ERROR) {
+        return ngx_proxy_wasm_result_trap(pwexec, "failed incrementing "
+                                          "value in shm (could not write "
+                                          "to slab)", rets, NGX_WAVM_ERROR);
+    }
+
+    ngx_wa_assert(rc == NGX_OK);
+
+    return ngx_proxy_wasm_result_ok(rets);
+}
+
+
+static ngx_int_t
+ngx_proxy_wasm_kvstore_key(ngx_proxy_wasm_exec_t *pwexec, ngx_wa_shm_t *shm,
+    ngx_str_t *key, ngx_str_t *out)
+{
+    u_char  *p;
+
+    /* stored keys carry their namespace, except in the default one */
+
+    if (shm->name.len == 1 && shm->name.data[0] == '*') {
+        out->len = key->len;
+
+    } else {
+        out->len = shm->name.len + 1 + key->len;
+    }
+
+    out->data = ngx_pnalloc(pwexec->pool, out->len);
+    if (out->data == NULL) {
+        return NGX_ERROR;
+    }
+
+    p = out->data;
+
+    if (out->len != key->len) {
+        p = ngx_cpymem(p, shm->name.data, shm->name.len);
+        *p++ = '/';
+    }
+
+    ngx_memcpy(p, key->data, key->len);
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_proxy_wasm_hfuncs_open_shared_kvstore(ngx_wavm_instance_t *instance,
+    wasm_val_t args[], wasm_val_t rets[])
+{
+    uint32_t               *id;
+    ngx_int_t               zone_idx;
+    ngx_str_t               name;
+    ngx_wa_shm_t           *shm;
+    ngx_proxy_wasm_exec_t  *pwexec = ngx_proxy_wasm_instance2pwexec(instance);
+
+    name.len = args[1].of.i32;
+    name.data = NGX_WAVM_HOST_LIFT_SLICE(instance, args[0].of.i32, name.len);
+    id = NGX_WAVM_HOST_LIFT(instance, args[3].of.i32, uint32_t);
+
+    /* args[2] (can_create): zones are only declared in nginx.conf */
+
+    zone_idx = ngx_wa_shm_lookup_index(&name);
+    if (zone_idx == NGX_WA_SHM_INDEX_NOTFOUND) {
+        return ngx_proxy_wasm_result_notfound(rets);
+    }
+
+    if (ngx_wa_shm_kv_resolve((uint32_t) zone_idx, &shm) != NGX_OK) {
+        /* TODO: format with shm name */
+        return ngx_proxy_wasm_result_trap(pwexec, "attempt to use "
+                                          "a queue as a key/value shm store",
+                                          rets, NGX_WAVM_BAD_USAGE);
+    }
+
+    *id = (uint32_t) zone_idx;
+
+    return ngx_proxy_wasm_result_ok(rets);
+}
+
+
+static ngx_int_t
+ngx_proxy_wasm_hfuncs_get_shared_kvstore_key_values(
+    ngx_wavm_instance_t *instance, wasm_val_t args[], wasm_val_t rets[])
+{
+    size_t                            i;
+    uint32_t                         *rlen, *cas, *rcas, hash;
+    ngx_int_t                         rc;
+    ngx_str_t                        *keys, *value, key;
+    ngx_uint_t                        truncated = 0;
+    ngx_list_t                        empty;
+    ngx_array_t                       names, values;
+    ngx_wa_shm_t                     *shm, *shard;
+    ngx_wavm_ptr_t                   *rbuf, rcas_ptr;
+    ngx_table_elt_t                  *elt;
+    ngx_proxy_wasm_exec_t            *pwexec;
+    ngx_proxy_wasm_marshalled_map_t   map;
+
+    pwexec = ngx_proxy_wasm_instance2pwexec(instance);
+
+    map.len = args[2].of.i32;
+    map.data = NGX_WAVM_HOST_LIFT_SLICE(instance, args[1].of.i32, map.len);
+    rbuf = NGX_WAVM_HOST_LIFT(instance, args[3].of.i32, ngx_wavm_ptr_t);
+    rlen = NGX_WAVM_HOST_LIFT(instance, args[4].of.i32, uint32_t);
+    rcas_ptr = args[5].of.i32;
+
+    rc = ngx_wa_shm_kv_resolve(args[0].of.i32, &shm);
+    if (rc == NGX_DECLINED) {
+        /* TODO: format with kvstore id */
+        return ngx_proxy_wasm_result_trap(pwexec, "could not find kvstore",
+                                          rets, NGX_WAVM_BAD_USAGE);
+    }
+
+    if (rc == NGX_ABORT) {
+        return ngx_proxy_wasm_result_trap(pwexec, "attempt to use "
+                                          "a queue as a key/value shm store",
+                                          rets, NGX_WAVM_BAD_USAGE);
+    }
+
+    if (ngx_proxy_wasm_keys_unmarshal(pwexec, &names, &map) != NGX_OK
+        || names.nelts == 0)
+    {
+        return ngx_proxy_wasm_result_badarg(rets);
+    }
+
+    /* keys point to guest memory: copy before any guest allocation */
+
+    keys = ngx_pnalloc(pwexec->pool, names.nelts * sizeof(ngx_str_t));
+    cas = ngx_pcalloc(pwexec->pool, names.nelts * sizeof(uint32_t));
+    if (keys == NULL
+        || cas == NULL
+        || ngx_array_init(&values, pwexec->pool, names.nelts,
+                          sizeof(ngx_table_elt_t))
+           != NGX_OK
+        || ngx_list_init(&empty, pwexec->pool, 1, sizeof(ngx_table_elt_t))
+           != NGX_OK)
+    {
+        return ngx_proxy_wasm_result_err(rets);
+    }
+
+    for (i = 0; i < names.nelts; i++) {
+        if (ngx_proxy_wasm_kvstore_key(pwexec, shm,
+                                       &((ngx_str_t *) names.elts)[i],
+                                       &keys[i])
+            != NGX_OK)
+        {
+            return ngx_proxy_wasm_result_err(rets);
+        }
+    }
+
+    /* get: single zone lock for the whole batch */
+
+    rc = NGX_OK;
+
+    ngx_wa_shm_lock(shm);
+
+    for (i = 0; i < names.nelts; i++) {
+        hash = ngx_crc32_long(keys[i].data, keys[i].len);
+        shard = ngx_wa_shm_kv_shard(shm, hash);
+
+        if (ngx_wa_shm_kv_get_locked(shard, &keys[i], &hash, &value, &cas[i])
+            != NGX_OK)
+        {
+            continue;
+        }
+
+        elt = ngx_array_push(&values);
+        if (elt == NULL) {
+            rc = NGX_ERROR;
+            break;
+        }
+
+        /* returned keys are the requested ones, without namespace */
 
-    /* get */
+        key = ((ngx_str_t *) names.elts)[i];
 
-    ngx_wa_shm_lock(resolved.shm);
+        elt->hash = 1;
+        elt->key.len = key.len;
+        elt->key.data = keys[i].data + keys[i].len - key.len;
+        elt->value.len = value->len;
+        elt->value.data = ngx_pnalloc(pwexec->pool, value->len);
+        if (elt->value.data == NULL) {
+            rc = NGX_ERROR;
+            break;
+        }
+
+        ngx_memcpy(elt->value.data, value->data, value->len);
+    }
 
-    rc = ngx_wa_shm_kv_get_locked(resolved.shm, &key, NULL, &value, cas);
+    ngx_wa_shm_unlock(shm);
 
-    ngx_wa_shm_unlock(resolved.shm);
+    if (rc != NGX_OK) {
+        return ngx_proxy_wasm_result_err(rets);
+    }
 
-    if (rc == NGX_DECLINED) {
+    if (values.nelts == 0) {
         return ngx_proxy_wasm_result_notfound(rets);
     }
 
-    ngx_wa_assert(rc == NGX_OK);
-
-    /* return value */
+    /* return values: single marshalled map */
 
-    wbuf_ptr = ngx_proxy_wasm_alloc(pwexec, value->len);
-    if (wbuf_ptr == 0) {
-        /* TODO: format with key */
-        return ngx_proxy_wasm_result_trap(pwexec, "failed getting value "
-                                          "from shm (no memory)", rets,
-                                          NGX_WAVM_ERROR);
+    if (!ngx_proxy_wasm_marshal(pwexec, &empty, &values, rbuf, rlen,
+                                &truncated))
+    {
+        return ngx_proxy_wasm_result_invalid_mem(rets);
     }
 
-    ngx_memcpy(NGX_WAVM_HOST_LIFT_SLICE(instance, wbuf_ptr, value->len),
-               value->data, value->len);
+    if (truncated) {
+        ngx_proxy_wasm_log_error(NGX_LOG_WARN, pwexec->log, 0,
+                                 "marshalled map truncated to %ui elements",
+                                 truncated);
+    }
 
-    *value_data = wbuf_ptr;
-    *value_size = value->len;
+    if (rcas_ptr) {
+        /* one cas per requested key, 0 when not found */
+        rcas = (uint32_t *) NGX_WAVM_HOST_LIFT_SLICE(instance, rcas_ptr,
+                                                    names.nelts
+                                                    * sizeof(uint32_t));
+        ngx_memcpy(rcas, cas, names.nelts * sizeof(uint32_t));
+    }
 
     return ngx_proxy_wasm_result_ok(rets);
 }
 
 
 static ngx_int_t
-ngx_proxy_wasm_hfuncs_set_shared_data(ngx_wavm_instance_t *instance,
-    wasm_val_t args[], wasm_val_t rets[])
+ngx_proxy_wasm_hfuncs_set_shared_kvstore_key_values(
+    ngx_wavm_instance_t *instance, wasm_val_t args[], wasm_val_t rets[])
 {
-    uint32_t                cas;
-    unsigned                written;
-    ngx_int_t               rc;
-    ngx_str_t               key, value;
-    ngx_wa_shm_kv_key_t     resolved;
-    ngx_proxy_wasm_exec_t  *pwexec = ngx_proxy_wasm_instance2pwexec(instance);
+    size_t                            i;
+    uint32_t                         *cas, *nwritten;
+    unsigned                          written;
+    ngx_int_t                         rc;
+    ngx_str_t                         key;
+    ngx_array_t                       pairs;
+    ngx_wa_shm_t                     *shm, *shard;
+    ngx_table_elt_t                  *elt;
+    ngx_proxy_wasm_exec_t            *pwexec;
+    ngx_proxy_wasm_marshalled_map_t   map;
 
-    key.len = args[1].of.i32;
-    key.data = NGX_WAVM_HOST_LIFT_SLICE(instance, args[0].of.i32, key.len);
-    value.len = args[3].of.i32;
-    value.data = NGX_WAVM_HOST_LIFT_SLICE(instance, args[2].of.i32, value.len);
-    cas = args[4].of.i32;
+    pwexec = ngx_proxy_wasm_instance2pwexec(instance);
 
-    dd("setting \"%.*s\" -> \"%.*s\"",
-       (int) key.len, key.data,
-       (int) value.len, value.data);
+    map.len = args[2].of.i32;
+    map.data = NGX_WAVM_HOST_LIFT_SLICE(instance, args[1].of.i32, map.len);
+    cas = args[3].of.i32
+          ? (uint32_t *) NGX_WAVM_HOST_LIFT_SLICE(instance, args[3].of.i32,
+                                                  args[4].of.i32)
+          : NULL;
+    nwritten = NGX_WAVM_HOST_LIFT(instance, args[5].of.i32, uint32_t);
 
-    /* resolve key namespace */
+    rc = ngx_wa_shm_kv_resolve(args[0].of.i32, &shm);
+    if (rc == NGX_DECLINED) {
+        /* TODO: format with kvstore id */
+        return ngx_proxy_wasm_result_trap(pwexec, "could not find kvstore",
+                                          rets, NGX_WAVM_BAD_USAGE);
+    }
 
-    rc = ngx_wa_shm_kv_resolve_key(&key, &resolved);
     if (rc == NGX_ABORT) {
-        /* TODO: format with key */
-        return ngx_proxy_wasm_result_trap(pwexec, "attempt to set "
-                                          "key/value in a queue", rets,
-                                          NGX_WAVM_BAD_USAGE);
+        return ngx_proxy_wasm_result_trap(pwexec, "attempt to use "
+                                          "a queue as a key/value shm store",
+                                          rets, NGX_WAVM_BAD_USAGE);
     }
 
-    if (rc == NGX_DECLINED) {
-        /* TODO: format with key */
-        return ngx_proxy_wasm_result_trap(pwexec, "failed setting value "
-                                          "to shm (could not resolve "
-                                          "namespace)", rets,
-                                          NGX_WAVM_BAD_USAGE);
+    if (ngx_proxy_wasm_pairs_unmarshal(pwexec, &pairs, &map) != NGX_OK) {
+        return ngx_proxy_wasm_result_err(rets);
     }
 
-    ngx_wa_assert(rc == NGX_OK);
+    if (cas && (size_t) args[4].of.i32 != pairs.nelts * sizeof(uint32_t)) {
+        /* one cas per pair */
+        return ngx_proxy_wasm_result_badarg(rets);
+    }
 
-    /* set */
+    elt = pairs.elts;
 
-    ngx_wa_shm_lock(resolved.shm);
+    for (i = 0; i < pairs.nelts; i++) {
+        if (ngx_proxy_wasm_kvstore_key(pwexec, shm, &elt[i].key, &key)
+            != NGX_OK)
+        {
+            return ngx_proxy_wasm_result_err(rets);
+        }
 
-    /*
-     * If the filter passes a NULL value pointer, treat it as a delete request.
-     * It is still possible to distinguish between:
-     * - Setting an empty value (ptr != NULL, len == 0)
-     * - Deleting a k/v pair (ptr == NULL, len == 0)
-     */
-    rc = ngx_wa_shm_kv_set_locked(resolved.shm,
-                                  &key, value.data ? &value : NULL,
-                                  cas, &written);
+        elt[i].key = key;
+    }
+
+    /* set: single zone lock for the whole batch */
+
+    *nwritten = 0;
+
+    ngx_wa_shm_lock(shm);
+
+    for (i = 0; i < pairs.nelts; i++) {
+        shard = ngx_wa_shm_kv_shard(shm, ngx_crc32_long(elt[i].key.data,
+                                                        elt[i].key.len));
+
+        rc = ngx_wa_shm_kv_set_locked(shard, &elt[i].key, &elt[i].value,
+                                      cas ? cas[i] : 0, 0, &written);
+        if (rc != NGX_OK) {
+            break;
+        }
+
+        if (written) {
+            (*nwritten)++;
+        }
+    }
 
-    ngx_wa_shm_unlock(resolved.shm);
+    ngx_wa_shm_unlock(shm);
 
     if (rc == NGX_ERROR) {
-        /* TODO: format with key */
         return ngx_proxy_wasm_result_trap(pwexec, "failed setting value "
                                           "to shm (could not write to slab)",
                                           rets,
@@ -1379,7 +2274,7 @@ ngx_proxy_wasm_hfuncs_set_shared_data(ngx_wavm_instance_t *instance,
 
     ngx_wa_assert(rc == NGX_OK);
 
-    if (!written) {
+    if (*nwritten < pairs.nelts) {
         return ngx_proxy_wasm_result_cas_mismatch(rets);
     }
 
@@ -1395,7 +2290,7 @@ ngx_proxy_wasm_hfuncs_register_shared_queue(ngx_wavm_instance_t *instance,
     wasm_val_t args[], wasm_val_t rets[])
 {
     uint32_t               *token;
-    ngx_int_t               zone_idx;
+    ngx_int_t               rc, zone_idx;
     ngx_str_t               queue_name;
     ngx_wa_shm_t           *shm;
     ngx_shm_zone_t         *zone;
@@ -1426,6 +2321,18 @@ ngx_proxy_wasm_hfuncs_register_shared_queue(ngx_wavm_instance_t *instance,
                                           NGX_WAVM_BAD_USAGE);
     }
 
+    if (pwexec->root_id == NGX_PROXY_WASM_ROOT_CTX_ID
+        && pwexec->filter->proxy_on_queue_ready)
+    {
+        /* wake up the registering root context when items are enqueued */
+        rc = ngx_wa_shm_queue_subscribe((uint32_t) zone_idx,
+                                        ngx_proxy_wasm_filter_queue_ready,
+                                        pwexec);
+        if (rc == NGX_ERROR) {
+            return ngx_proxy_wasm_result_err(rets);
+        }
+    }
+
     *token = (uint32_t) zone_idx;
 
     return ngx_proxy_wasm_result_ok(rets);
@@ -1469,9 +2376,13 @@ ngx_proxy_wasm_hfuncs_enqueue_shared_queue(ngx_wavm_instance_t *instance,
 
     /* push */
 
-    ngx_wa_shm_lock(shm);
-    rc = ngx_wa_shm_queue_push_locked(shm, &data);
-    ngx_wa_shm_unlock(shm);
+    rc = ngx_wa_shm_queue_push(shm, &data);
+
+    if (rc == NGX_DECLINED) {
+        return ngx_proxy_wasm_result_trap(pwexec, "could not enqueue "
+                                          "(item exceeds queue slot_size)",
+                                          rets, NGX_WAVM_ERROR);
+    }
 
     if (rc == NGX_ABORT) {
         /* TODO: format with queue name */
@@ -1543,9 +2454,7 @@ ngx_proxy_wasm_hfuncs_dequeue_shared_queue(ngx_wavm_instance_t *instance,
 
     /* pop */
 
-    ngx_wa_shm_lock(shm);
-    rc = ngx_wa_shm_queue_pop_locked(shm, &data, shared_queue_alloc, instance);
-    ngx_wa_shm_unlock(shm);
+    rc = ngx_wa_shm_queue_pop(shm, &data, shared_queue_alloc, instance);
 
     if (rc == NGX_ERROR) {
         return ngx_proxy_wasm_result_err(rets);
@@ -1573,6 +2482,134 @@ ngx_proxy_wasm_hfuncs_dequeue_shared_queue(ngx_wavm_instance_t *instance,
 }
 
 
+static ngx_int_t
+ngx_proxy_wasm_hfuncs_enqueue_shared_queue_items(ngx_wavm_instance_t *instance,
+    wasm_val_t args[], wasm_val_t rets[])
+{
+    ngx_int_t               rc;
+    ngx_uint_t              token, n;
+    ngx_str_t               items;
+    ngx_shm_zone_t         *zone;
+    ngx_wa_shm_t           *shm;
+    ngx_proxy_wasm_exec_t  *pwexec = ngx_proxy_wasm_instance2pwexec(instance);
+
+    token = args[0].of.i32;
+    items.len = args[2].of.i32;
+    items.data = NGX_WAVM_HOST_LIFT_SLICE(instance, args[1].of.i32,
+                                          items.len);
+
+    /* resolve queue */
+
+    rc = ngx_wa_shm_queue_resolve(instance->log, token, &zone);
+    if (rc == NGX_DECLINED) {
+        /* TODO: format with token */
+        return ngx_proxy_wasm_result_trap(pwexec, "could not find queue", rets,
+                                          NGX_WAVM_BAD_USAGE);
+    }
+
+    if (rc == NGX_ABORT) {
+        return ngx_proxy_wasm_result_trap(pwexec, "attempt to use "
+                                          "a key/value shm store as a queue",
+                                          rets,
+                                          NGX_WAVM_BAD_USAGE);
+    }
+
+    ngx_wa_assert(rc == NGX_OK);
+
+    shm = zone->data;
+
+    /* push */
+
+    rc = ngx_wa_shm_queue_push_batch(shm, &items, &n);
+
+    if (rc == NGX_DECLINED) {
+        /* malformed framing or item exceeding slot_size */
+        return ngx_proxy_wasm_result_badarg(rets);
+    }
+
+    if (rc == NGX_ABORT) {
+        /* TODO: format with queue name */
+        return ngx_proxy_wasm_result_trap(pwexec, "could not enqueue "
+                                          "(queue is full)", rets,
+                                          NGX_WAVM_ERROR);
+    }
+
+    ngx_wa_assert(rc == NGX_OK);
+
+    dd("enqueued %lu items", n);
+
+    return ngx_proxy_wasm_result_ok(rets);
+}
+
+
+static ngx_int_t
+ngx_proxy_wasm_hfuncs_dequeue_shared_queue_items(ngx_wavm_instance_t *instance,
+    wasm_val_t args[], wasm_val_t rets[])
+{
+    size_t                  max_size;
+    ngx_int_t               rc;
+    ngx_uint_t              token, max_items, n;
+    ngx_str_t               data;
+    ngx_shm_zone_t         *zone;
+    ngx_wa_shm_t           *shm;
+    uint32_t               *wasm_data_ptr;
+    uint32_t               *wasm_data_size;
+    uint32_t               *wasm_count;
+    ngx_proxy_wasm_exec_t  *pwexec = ngx_proxy_wasm_instance2pwexec(instance);
+
+    token = args[0].of.i32;
+    max_items = args[1].of.i32;
+    max_size = args[2].of.i32;
+    wasm_data_ptr = NGX_WAVM_HOST_LIFT(instance, args[3].of.i32, uint32_t);
+    wasm_data_size = NGX_WAVM_HOST_LIFT(instance, args[4].of.i32, uint32_t);
+    wasm_count = NGX_WAVM_HOST_LIFT(instance, args[5].of.i32, uint32_t);
+
+    /* resolve queue */
+
+    rc = ngx_wa_shm_queue_resolve(instance->log, token, &zone);
+    if (rc == NGX_DECLINED) {
+        /* TODO: format with token */
+        return ngx_proxy_wasm_result_trap(pwexec, "could not find queue", rets,
+                                          NGX_WAVM_BAD_USAGE);
+    }
+
+    if (rc == NGX_ABORT) {
+        return ngx_proxy_wasm_result_trap(pwexec, "attempt to use "
+                                          "a key/value shm store as a queue",
+                                          rets,
+                                          NGX_WAVM_BAD_USAGE);
+    }
+
+    ngx_wa_assert(rc == NGX_OK);
+
+    shm = zone->data;
+
+    /* pop: single guest allocation */
+
+    rc = ngx_wa_shm_queue_pop_batch(shm, max_items, max_size, &data, &n,
+                                    shared_queue_alloc, instance);
+
+    if (rc == NGX_ERROR) {
+        return ngx_proxy_wasm_result_err(rets);
+    }
+
+    if (rc == NGX_AGAIN) {
+        return ngx_proxy_wasm_result_empty(rets);
+    }
+
+    ngx_wa_assert(rc == NGX_OK);
+
+    /* return value */
+
+    *wasm_data_ptr = (uint32_t) ((char *) data.data -
+                                 ngx_wavm_memory_base(instance->memory));
+    *wasm_data_size = data.len;
+    *wasm_count = n;
+
+    return ngx_proxy_wasm_result_ok(rets);
+}
+
+
 /* metrics */
 
 
@@ -1589,7 +2626,8 @@ ngx_proxy_wasm_hfuncs_define_metric(ngx_wavm_instance_t *instance,
     ngx_wa_metric_type_e           type;
     ngx_proxy_wasm_exec_t         *pwexec;
     ngx_proxy_wasm_metric_type_e   pw_type;
-    u_char                         buf[metrics->config.max_metric_name_length];
+    u_char                         buf[metrics->config.max_metric_name_length
+                                       + NGX_WA_METRICS_LABELS_MAX_LEN];
     u_char                         trapmsg[NGX_MAX_ERROR_STR];
 
     pwexec = ngx_proxy_wasm_instance2pwexec(instance);
@@ -1626,12 +2664,11 @@ ngx_proxy_wasm_hfuncs_define_metric(ngx_wavm_instance_t *instance,
 
     filter_name = pwexec->filter->name;
 
-    if (4 + filter_name->len + name.len > max_len) {
-        ngx_sprintf(trapmsg, "could not define metric: name \"%*s\" too long",
-                    name.len, name.data);
-
-        return ngx_proxy_wasm_result_trap(pwexec, (char *) trapmsg,
-                                          rets, NGX_WAVM_ERROR);
+    /* labels ("name{key=value}") are checked separately */
+    if (4 + filter_name->len + name.len
+        > max_len + NGX_WA_METRICS_LABELS_MAX_LEN)
+    {
+        goto too_long;
     }
 
     prefixed_name.data = buf;
@@ -1640,6 +2677,16 @@ ngx_proxy_wasm_hfuncs_define_metric(ngx_wavm_instance_t *instance,
 
     rc = ngx_wa_metrics_define(metrics, &prefixed_name, type, NULL, 0, id);
     switch (rc) {
+    case NGX_BUSY:
+        goto too_long;
+
+    case NGX_ABORT:
+        ngx_sprintf(trapmsg, "could not define metric \"%*s\": "
+                    "invalid labels", name.len, name.data);
+
+        return ngx_proxy_wasm_result_trap(pwexec, (char *) trapmsg,
+                                          rets, NGX_WAVM_ERROR);
+
     case NGX_ERROR:
         ngx_sprintf(trapmsg, "could not define metric \"%*s\": "
                     "no memory (increase \"slab_size\" directive)",
@@ -1656,6 +2703,14 @@ ngx_proxy_wasm_hfuncs_define_metric(ngx_wavm_instance_t *instance,
     }
 
     return ngx_proxy_wasm_result_ok(rets);
+
+too_long:
+
+    ngx_sprintf(trapmsg, "could not define metric: name \"%*s\" too long",
+                name.len, name.data);
+
+    return ngx_proxy_wasm_result_trap(pwexec, (char *) trapmsg,
+                                      rets, NGX_WAVM_ERROR);
 }
 
 
@@ -1924,6 +2979,14 @@ static ngx_wavm_host_func_def_t  ngx_proxy_wasm_hfuncs[] = {
       &ngx_proxy_wasm_hfuncs_get_buffer,
       ngx_wavm_arity_i32x5,
       ngx_wavm_arity_i32 },
+    { ngx_string("proxy_get_buffer_into"),               /* ngx_wasm */
+      &ngx_proxy_wasm_hfuncs_get_buffer_into,
+      ngx_wavm_arity_i32x5,
+      ngx_wavm_arity_i32 },
+    { ngx_string("proxy_get_buffer_windows"),            /* ngx_wasm */
+      &ngx_proxy_wasm_hfuncs_get_buffer_windows,
+      ngx_wavm_arity_i32x5,
+      ngx_wavm_arity_i32 },
     { ngx_string("proxy_set_buffer"),                    /* vNEXT */
       &ngx_proxy_wasm_hfuncs_set_buffer,
       ngx_wavm_arity_i32x5,
@@ -1936,7 +2999,7 @@ static ngx_wavm_host_func_def_t  ngx_proxy_wasm_hfuncs[] = {
     /* maps */
 
     { ngx_string("proxy_get_map_values"),                /* vNEXT */
-      &ngx_proxy_wasm_hfuncs_nop,                        /* NYI */
+      &ngx_proxy_wasm_hfuncs_get_map_values,
       ngx_wavm_arity_i32x5,
       ngx_wavm_arity_i32 },
     { ngx_string("proxy_get_header_map_pairs"),          /* <= 0.2.1 */
@@ -1948,7 +3011,7 @@ static ngx_wavm_host_func_def_t  ngx_proxy_wasm_hfuncs[] = {
       ngx_wavm_arity_i32x5,
       ngx_wavm_arity_i32 },
     { ngx_string("proxy_set_map_values"),                /* vNEXT */
-      &ngx_proxy_wasm_hfuncs_nop,                        /* NYI */
+      &ngx_proxy_wasm_hfuncs_set_map_values,
       ngx_wavm_arity_i32x5,
       ngx_wavm_arity_i32 },
     { ngx_string("proxy_set_header_map_pairs"),          /* <= 0.2.1 */
@@ -1982,6 +3045,14 @@ static ngx_wavm_host_func_def_t  ngx_proxy_wasm_hfuncs[] = {
       &ngx_proxy_wasm_hfuncs_set_property,
       ngx_wavm_arity_i32x4,
       ngx_wavm_arity_i32 },
+    { ngx_string("proxy_resolve_property"),              /* ngx_wasm */
+      &ngx_proxy_wasm_hfuncs_resolve_property,
+      ngx_wavm_arity_i32x3,
+      ngx_wavm_arity_i32 },
+    { ngx_string("proxy_get_property_by_handle"),        /* ngx_wasm */
+      &ngx_proxy_wasm_hfuncs_get_property_by_handle,
+      ngx_wavm_arity_i32x3,
+      ngx_wavm_arity_i32 },
 
     /* stream */
 
@@ -2111,11 +3182,11 @@ static ngx_wavm_host_func_def_t  ngx_proxy_wasm_hfuncs[] = {
     /* shared k/v store */
 
     { ngx_string("proxy_open_shared_kvstore"),           /* vNEXT */
-      &ngx_proxy_wasm_hfuncs_nop,                        /* NYI */
+      &ngx_proxy_wasm_hfuncs_open_shared_kvstore,
       ngx_wavm_arity_i32x4,
       ngx_wavm_arity_i32 },
     { ngx_string("proxy_get_shared_kvstore_key_values"), /* vNEXT */
-      &ngx_proxy_wasm_hfuncs_nop,                        /* NYI */
+      &ngx_proxy_wasm_hfuncs_get_shared_kvstore_key_values,
       ngx_wavm_arity_i32x6,
       ngx_wavm_arity_i32 },
     { ngx_string("proxy_get_shared_data"),               /* <= 0.2.1 */
@@ -2123,13 +3194,21 @@ static ngx_wavm_host_func_def_t  ngx_proxy_wasm_hfuncs[] = {
       ngx_wavm_arity_i32x5,
       ngx_wavm_arity_i32 },
     { ngx_string("proxy_set_shared_kvstore_key_values"), /* vNEXT */
-      &ngx_proxy_wasm_hfuncs_nop,                        /* NYI */
+      &ngx_proxy_wasm_hfuncs_set_shared_kvstore_key_values,
       ngx_wavm_arity_i32x6,
       ngx_wavm_arity_i32 },
     { ngx_string("proxy_set_shared_data"),               /* <= 0.2.1 */
       &ngx_proxy_wasm_hfuncs_set_shared_data,
       ngx_wavm_arity_i32x5,
       ngx_wavm_arity_i32 },
+    { ngx_string("proxy_set_shared_data_with_ttl"),      /* ngx_wasm */
+      &ngx_proxy_wasm_hfuncs_set_shared_data_with_ttl,
+      ngx_wavm_arity_i32x6,
+      ngx_wavm_arity_i32 },
+    { ngx_string("proxy_increment_shared_data"),         /* ngx_wasm */
+      &ngx_proxy_wasm_hfuncs_increment_shared_data,
+      ngx_wavm_arity_i32x2_i64x2_i32x2,
+      ngx_wavm_arity_i32 },
     { ngx_string("proxy_add_shared_kvstore_key_values"), /* vNEXT */
       &ngx_proxy_wasm_hfuncs_nop,                        /* NYI */
       ngx_wavm_arity_i32x6,
@@ -2169,6 +3248,14 @@ static ngx_wavm_host_func_def_t  ngx_proxy_wasm_hfuncs[] = {
       &ngx_proxy_wasm_hfuncs_enqueue_shared_queue,
       ngx_wavm_arity_i32x3,
       ngx_wavm_arity_i32 },
+    { ngx_string("proxy_enqueue_shared_queue_items"),    /* ngx_wasm */
+      &ngx_proxy_wasm_hfuncs_enqueue_shared_queue_items,
+      ngx_wavm_arity_i32x3,
+      ngx_wavm_arity_i32 },
+    { ngx_string("proxy_dequeue_shared_queue_items"),    /* ngx_wasm */
+      &ngx_proxy_wasm_hfuncs_dequeue_shared_queue_items,
+      ngx_wavm_arity_i32x6,
+      ngx_wavm_arity_i32 },
     { ngx_string("proxy_delete_shared_queue"),           /* vNEXT */
       &ngx_proxy_wasm_hfuncs_nop,                        /* NYI */
       ngx_wavm_arity_i32x4,
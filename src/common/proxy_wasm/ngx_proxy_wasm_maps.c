@@ -131,6 +131,67 @@ ngx_proxy_wasm_maps_get_map(ngx_wavm_instance_t *instance,
 }
 
 
+ngx_proxy_wasm_map_cache_t *
+ngx_proxy_wasm_maps_cache(ngx_wavm_instance_t *instance,
+    ngx_proxy_wasm_map_type_e map_type)
+{
+#ifdef NGX_WASM_HTTP
+    ngx_uint_t                   gen;
+    ngx_proxy_wasm_exec_t       *pwexec;
+    ngx_proxy_wasm_ctx_t        *pwctx;
+    ngx_http_wasm_req_ctx_t     *rctx;
+    ngx_proxy_wasm_map_cache_t  *cache;
+
+    pwexec = ngx_proxy_wasm_instance2pwexec(instance);
+    pwctx = pwexec->parent;
+    if (pwctx == NULL) {
+        return NULL;
+    }
+
+    rctx = ngx_http_proxy_wasm_get_rctx(instance);
+    if (rctx == NULL) {
+        return NULL;
+    }
+
+    switch (map_type) {
+    case NGX_PROXY_WASM_MAP_HTTP_REQUEST_HEADERS:
+        cache = &pwctx->req_headers_cache;
+        gen = rctx->req_headers_gen;
+        break;
+    case NGX_PROXY_WASM_MAP_HTTP_RESPONSE_HEADERS:
+        cache = &pwctx->resp_headers_cache;
+        gen = rctx->resp_headers_gen;
+        break;
+    default:
+        return NULL;
+    }
+
+    if (cache->gen != gen) {
+        /* headers changed since marshalled, by any caller */
+        cache->gen = gen;
+        cache->valid = 0;
+    }
+
+    return cache;
+#else
+    return NULL;
+#endif
+}
+
+
+void
+ngx_proxy_wasm_maps_cache_invalidate(ngx_wavm_instance_t *instance,
+    ngx_proxy_wasm_map_type_e map_type)
+{
+    ngx_proxy_wasm_map_cache_t  *cache;
+
+    cache = ngx_proxy_wasm_maps_cache(instance, map_type);
+    if (cache) {
+        cache->valid = 0;
+    }
+}
+
+
 ngx_list_t *
 ngx_proxy_wasm_maps_get_all(ngx_wavm_instance_t *instance,
     ngx_proxy_wasm_map_type_e map_type, ngx_array_t *extras)
@@ -220,6 +281,101 @@ ngx_proxy_wasm_maps_get_all(ngx_wavm_instance_t *instance,
 }
 
 
+static ngx_int_t
+ngx_proxy_wasm_maps_push_if_key(ngx_array_t *values, ngx_array_t *keys,
+    ngx_table_elt_t *elt)
+{
+    size_t            i;
+    ngx_str_t        *key;
+    ngx_table_elt_t  *value;
+
+    key = keys->elts;
+
+    for (i = 0; i < keys->nelts; i++) {
+        if (key[i].len == elt->key.len
+            && ngx_strncasecmp(key[i].data, elt->key.data, key[i].len) == 0)
+        {
+            value = ngx_array_push(values);
+            if (value == NULL) {
+                return NGX_ERROR;
+            }
+
+            *value = *elt;
+            value->hash = 0;
+            value->lowcase_key = NULL;
+            break;
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+ngx_int_t
+ngx_proxy_wasm_maps_get_values(ngx_wavm_instance_t *instance,
+    ngx_proxy_wasm_map_type_e map_type, ngx_array_t *keys,
+    ngx_array_t *values)
+{
+    size_t                  i;
+    ngx_list_t             *list;
+    ngx_list_part_t        *part;
+    ngx_array_t             extras;
+    ngx_table_elt_t        *elt;
+    ngx_proxy_wasm_exec_t  *pwexec = ngx_proxy_wasm_instance2pwexec(instance);
+
+    /* single pass over the map for all keys, repeated keys included */
+
+    if (ngx_array_init(&extras, pwexec->pool, 8, sizeof(ngx_table_elt_t))
+        != NGX_OK)
+    {
+        return NGX_ERROR;
+    }
+
+    list = ngx_proxy_wasm_maps_get_all(instance, map_type, &extras);
+    if (list == NULL) {
+        return NGX_DECLINED;
+    }
+
+    elt = extras.elts;
+
+    for (i = 0; i < extras.nelts; i++) {
+        if (ngx_proxy_wasm_maps_push_if_key(values, keys, &elt[i])
+            != NGX_OK)
+        {
+            return NGX_ERROR;
+        }
+    }
+
+    part = &list->part;
+    elt = part->elts;
+
+    for (i = 0; /* void */; i++) {
+
+        if (i >= part->nelts) {
+            if (part->next == NULL) {
+                break;
+            }
+
+            part = part->next;
+            elt = part->elts;
+            i = 0;
+        }
+
+        if (elt[i].hash == 0) {
+            continue;
+        }
+
+        if (ngx_proxy_wasm_maps_push_if_key(values, keys, &elt[i])
+            != NGX_OK)
+        {
+            return NGX_ERROR;
+        }
+    }
+
+    return NGX_OK;
+}
+
+
 ngx_int_t
 ngx_proxy_wasm_maps_set_all(ngx_wavm_instance_t *instance,
     ngx_proxy_wasm_map_type_e map_type, ngx_array_t *pairs)
@@ -247,10 +403,13 @@ ngx_str_t *
 ngx_proxy_wasm_maps_get(ngx_wavm_instance_t *instance,
     ngx_proxy_wasm_map_type_e map_type, ngx_str_t *key)
 {
-    ngx_str_t                *value;
-    ngx_list_t               *list;
+    ngx_str_t                      *value;
+    ngx_list_t                     *list;
 #ifdef NGX_WASM_HTTP
-    ngx_http_wasm_req_ctx_t  *rctx;
+    ngx_uint_t                      hash;
+    ngx_http_wasm_req_ctx_t        *rctx;
+    ngx_http_wasm_header_ref_t     *ref;
+    ngx_http_wasm_headers_index_t  *index;
 
     rctx = ngx_http_proxy_wasm_get_rctx(instance);
 #endif
@@ -269,12 +428,32 @@ ngx_proxy_wasm_maps_get(ngx_wavm_instance_t *instance,
 
     /* key lookup */
 
+#ifdef NGX_WASM_HTTP
+    if (map_type == NGX_PROXY_WASM_MAP_HTTP_REQUEST_HEADERS
+        || map_type == NGX_PROXY_WASM_MAP_HTTP_RESPONSE_HEADERS)
+    {
+        index = ngx_http_wasm_headers_index(rctx->r, list);
+        if (index) {
+            hash = ngx_hash_key_lc(key->data, key->len);
+            ref = ngx_http_wasm_headers_index_find(index, key, hash, NULL);
+            if (ref) {
+                value = &ref->h->value;
+                goto found;
+            }
+
+            goto shims;
+        }
+    }
+#endif
+
     value = ngx_wasm_get_list_elem(list, key->data, key->len);
     if (value) {
         goto found;
     }
 
 #ifdef NGX_WASM_HTTP
+shims:
+
     if (map_type == NGX_PROXY_WASM_MAP_HTTP_RESPONSE_HEADERS) {
         /* shim header lookup */
 
@@ -33,11 +33,18 @@ ngx_list_t *ngx_proxy_wasm_maps_get_all(ngx_wavm_instance_t *instance,
     ngx_proxy_wasm_map_type_e map_type, ngx_array_t *extras);
 ngx_int_t ngx_proxy_wasm_maps_set_all(ngx_wavm_instance_t *instance,
     ngx_proxy_wasm_map_type_e map_type, ngx_array_t *pairs);
+ngx_int_t ngx_proxy_wasm_maps_get_values(ngx_wavm_instance_t *instance,
+    ngx_proxy_wasm_map_type_e map_type, ngx_array_t *keys,
+    ngx_array_t *values);
 ngx_str_t *ngx_proxy_wasm_maps_get(ngx_wavm_instance_t *instance,
     ngx_proxy_wasm_map_type_e map_type, ngx_str_t *key);
 ngx_int_t ngx_proxy_wasm_maps_set(ngx_wavm_instance_t *instance,
     ngx_proxy_wasm_map_type_e map_type, ngx_str_t *key, ngx_str_t *value,
     ngx_uint_t map_op);
+ngx_proxy_wasm_map_cache_t *ngx_proxy_wasm_maps_cache(
+    ngx_wavm_instance_t *instance, ngx_proxy_wasm_map_type_e map_type);
+void ngx_proxy_wasm_maps_cache_invalidate(ngx_wavm_instance_t *instance,
+    ngx_proxy_wasm_map_type_e map_type);
 
 
 #endif /* _NGX_PROXY_WASM_MAPS_H_INCLUDED_ */
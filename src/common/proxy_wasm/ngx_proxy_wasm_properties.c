@@ -50,6 +50,22 @@ static const char  *host_prefix = NGX_WASM_HOST_PROPERTY_NAMESPACE_STR ".";
 static size_t       host_prefix_len;
 
 
+typedef enum {
+    NGX_PROXY_WASM_PROPERTY_GETTER = 0,
+    NGX_PROXY_WASM_PROPERTY_VARIABLE,
+    NGX_PROXY_WASM_PROPERTY_PATH,
+} ngx_proxy_wasm_property_kind_e;
+
+
+typedef struct {
+    ngx_str_t                          path;      /* dotted */
+    ngx_str_t                          name;      /* nginx variable name */
+    ngx_uint_t                         hash;      /* nginx variable hash */
+    pwm2ngx_mapping_t                 *m;
+    ngx_proxy_wasm_property_kind_e     kind;
+} ngx_proxy_wasm_property_handle_t;
+
+
 typedef struct {
     ngx_str_node_t   sn;
     ngx_str_t        value;
@@ -766,21 +782,14 @@ ngx_proxy_wasm_properties_unmarsh_path(ngx_str_t *from, u_char **to)
 }
 
 
+#ifdef NGX_WASM_HTTP
 static ngx_int_t
-ngx_proxy_wasm_properties_get_ngx(ngx_proxy_wasm_ctx_t *pwctx,
-    ngx_str_t *path, ngx_str_t *value)
+get_ngx_variable(ngx_proxy_wasm_ctx_t *pwctx, ngx_str_t *name,
+    ngx_uint_t hash, ngx_str_t *value)
 {
-#ifdef NGX_WASM_HTTP
-    ngx_uint_t                  hash;
-    ngx_str_t                   name;
     ngx_http_variable_value_t  *vv;
     ngx_http_wasm_req_ctx_t    *rctx;
 
-    name.data = (u_char *) (path->data + ngx_prefix_len);
-    name.len = path->len - ngx_prefix_len;
-
-    hash = hash_str(name.data, name.len);
-
     rctx = (ngx_http_wasm_req_ctx_t *) pwctx->data;
     if (rctx == NULL || rctx->fake_request) {
         ngx_wavm_log_error(NGX_LOG_ERR, pwctx->log, NULL,
@@ -788,16 +797,34 @@ ngx_proxy_wasm_properties_get_ngx(ngx_proxy_wasm_ctx_t *pwctx,
         return NGX_ERROR;
     }
 
-    vv = ngx_http_get_variable(rctx->r, &name, hash);
+    vv = ngx_http_get_variable(rctx->r, name, hash);
     if (vv && !vv->not_found) {
         value->data = vv->data;
         value->len = vv->len;
 
         return NGX_OK;
     }
+
+    return NGX_DECLINED;
+}
 #endif
 
+
+static ngx_int_t
+ngx_proxy_wasm_properties_get_ngx(ngx_proxy_wasm_ctx_t *pwctx,
+    ngx_str_t *path, ngx_str_t *value)
+{
+#ifdef NGX_WASM_HTTP
+    ngx_str_t  name;
+
+    name.data = (u_char *) (path->data + ngx_prefix_len);
+    name.len = path->len - ngx_prefix_len;
+
+    return get_ngx_variable(pwctx, &name, hash_str(name.data, name.len),
+                            value);
+#else
     return NGX_DECLINED;
+#endif
 }
 
 
@@ -1138,6 +1165,125 @@ ngx_proxy_wasm_properties_get(ngx_proxy_wasm_ctx_t *pwctx,
 }
 
 
+ngx_int_t
+ngx_proxy_wasm_properties_resolve(ngx_proxy_wasm_filter_t *filter,
+    ngx_str_t *path, ngx_uint_t *handle)
+{
+    u_char                             dotted_path_buf[path->len];
+    ngx_uint_t                         i, key;
+    ngx_str_t                          p = { path->len, NULL };
+    pwm2ngx_mapping_t                 *m;
+    ngx_proxy_wasm_property_handle_t  *h;
+
+    if (filter->properties == NULL) {
+        filter->properties = ngx_array_create(filter->pool, 4,
+                                     sizeof(ngx_proxy_wasm_property_handle_t));
+        if (filter->properties == NULL) {
+            return NGX_ERROR;
+        }
+    }
+
+    p.data = replace_nulls_by_dots(path, dotted_path_buf);
+
+    /* all instances of a filter resolve a path to the same handle */
+
+    h = filter->properties->elts;
+
+    for (i = 0; i < filter->properties->nelts; i++) {
+        if (h[i].path.len == p.len
+            && ngx_memcmp(h[i].path.data, p.data, p.len) == 0)
+        {
+            *handle = i;
+            return NGX_OK;
+        }
+    }
+
+    h = ngx_array_push(filter->properties);
+    if (h == NULL) {
+        return NGX_ERROR;
+    }
+
+    ngx_memzero(h, sizeof(ngx_proxy_wasm_property_handle_t));
+
+    h->path.len = p.len;
+    h->path.data = ngx_pnalloc(filter->pool, p.len);
+    if (h->path.data == NULL) {
+        filter->properties->nelts--;
+        return NGX_ERROR;
+    }
+
+    ngx_memcpy(h->path.data, p.data, p.len);
+    p.data = h->path.data;
+    h->kind = NGX_PROXY_WASM_PROPERTY_PATH;
+
+    key = ngx_hash_key(p.data, p.len);
+
+    m = ngx_hash_find_combined(&pwm2ngx_hash, key, p.data, p.len);
+    if (m && m->getter) {
+        h->kind = NGX_PROXY_WASM_PROPERTY_GETTER;
+        h->m = m;
+
+#ifdef NGX_WASM_HTTP
+    } else if (m) {
+        /* attribute mapped to an nginx variable */
+        h->kind = NGX_PROXY_WASM_PROPERTY_VARIABLE;
+        h->name.data = m->ngx_key.data + ngx_prefix_len;
+        h->name.len = m->ngx_key.len - ngx_prefix_len;
+
+    } else if (p.len > ngx_prefix_len
+               && ngx_memcmp(p.data, ngx_prefix, ngx_prefix_len) == 0)
+    {
+        /* nginx variable (ngx.*) */
+        h->kind = NGX_PROXY_WASM_PROPERTY_VARIABLE;
+        h->name.data = p.data + ngx_prefix_len;
+        h->name.len = p.len - ngx_prefix_len;
+#endif
+    }
+
+#ifdef NGX_WASM_HTTP
+    if (h->kind == NGX_PROXY_WASM_PROPERTY_VARIABLE) {
+        h->hash = hash_str(h->name.data, h->name.len);
+    }
+#endif
+
+    ngx_log_debug3(NGX_LOG_DEBUG_WASM, filter->log, 0,
+                   "wasm properties resolved \"%V\" to handle %ui "
+                   "(kind: %d)", &p, filter->properties->nelts - 1, h->kind);
+
+    *handle = filter->properties->nelts - 1;
+
+    return NGX_OK;
+}
+
+
+ngx_int_t
+ngx_proxy_wasm_properties_get_by_handle(ngx_proxy_wasm_ctx_t *pwctx,
+    ngx_proxy_wasm_filter_t *filter, ngx_uint_t handle, ngx_str_t *value,
+    ngx_str_t *err)
+{
+    ngx_proxy_wasm_property_handle_t  *h;
+
+    if (filter->properties == NULL || handle >= filter->properties->nelts) {
+        return NGX_ABORT;
+    }
+
+    h = filter->properties->elts;
+    h = &h[handle];
+
+    switch (h->kind) {
+    case NGX_PROXY_WASM_PROPERTY_GETTER:
+        return h->m->getter(pwctx, &h->path, value);
+#ifdef NGX_WASM_HTTP
+    case NGX_PROXY_WASM_PROPERTY_VARIABLE:
+        return get_ngx_variable(pwctx, &h->name, h->hash, value);
+#endif
+    default:
+        /* host properties and unknown paths */
+        return ngx_proxy_wasm_properties_get(pwctx, &h->path, value, err);
+    }
+}
+
+
 ngx_int_t
 ngx_proxy_wasm_properties_set(ngx_proxy_wasm_ctx_t *pwctx,
     ngx_str_t *path, ngx_str_t *value, ngx_str_t *err)
@@ -8,6 +8,11 @@ void ngx_proxy_wasm_properties_init(ngx_conf_t *cf);
 void ngx_proxy_wasm_properties_unmarsh_path(ngx_str_t *from, u_char **to);
 ngx_int_t ngx_proxy_wasm_properties_get(ngx_proxy_wasm_ctx_t *pwctx,
     ngx_str_t *path, ngx_str_t *value, ngx_str_t *err);
+ngx_int_t ngx_proxy_wasm_properties_resolve(ngx_proxy_wasm_filter_t *filter,
+    ngx_str_t *path, ngx_uint_t *handle);
+ngx_int_t ngx_proxy_wasm_properties_get_by_handle(ngx_proxy_wasm_ctx_t *pwctx,
+    ngx_proxy_wasm_filter_t *filter, ngx_uint_t handle, ngx_str_t *value,
+    ngx_str_t *err);
 ngx_int_t ngx_proxy_wasm_properties_set(ngx_proxy_wasm_ctx_t *pwctx,
     ngx_str_t *path, ngx_str_t *value, ngx_str_t *err);
 ngx_int_t ngx_proxy_wasm_properties_set_host(ngx_proxy_wasm_ctx_t *pwctx,
@@ -41,7 +41,8 @@ static ngx_str_t  ngx_proxy_wasm_steplist[] = {
     ngx_string("on_log"),
     ngx_string("on_done"),
     ngx_string("on_tick"),
-    ngx_string("on_dispatch_response")
+    ngx_string("on_dispatch_response"),
+    ngx_string("on_queue_ready")
 };
 
 
@@ -62,7 +63,7 @@ ngx_proxy_wasm_step_name(ngx_proxy_wasm_step_e step)
     ngx_str_t  *name;
 
     ngx_wa_assert(step);
-    ngx_wa_assert(step <= NGX_PROXY_WASM_STEP_DISPATCH_RESPONSE);
+    ngx_wa_assert(step <= NGX_PROXY_WASM_STEP_QUEUE_READY);
 
     name = &ngx_proxy_wasm_steplist[step];
 
@@ -248,6 +249,32 @@ nomem:
 }
 
 
+void
+ngx_proxy_wasm_filter_queue_ready(uint32_t token, void *data)
+{
+    ngx_proxy_wasm_exec_t    *rexec = data;
+    ngx_proxy_wasm_filter_t  *filter = rexec->filter;
+#ifdef NGX_WASM_HTTP
+    ngx_proxy_wasm_ctx_t     *pwctx = rexec->parent;
+#endif
+
+    ngx_wa_assert(rexec->root_id == NGX_PROXY_WASM_ROOT_CTX_ID);
+
+    if (ngx_exiting || !filter->proxy_on_queue_ready) {
+        return;
+    }
+
+#ifdef NGX_WASM_HTTP
+    pwctx->phase = ngx_wasm_phase_lookup(&ngx_http_wasm_subsystem,
+                                         NGX_WASM_BACKGROUND_PHASE);
+#endif
+
+    rexec->ready_queue = token;
+
+    (void) ngx_proxy_wasm_run_step(rexec, NGX_PROXY_WASM_STEP_QUEUE_READY);
+}
+
+
 static ngx_uint_t
 ngx_proxy_wasm_pairs_count(ngx_list_t *list)
 {
@@ -533,6 +560,75 @@ failed:
 }
 
 
+ngx_int_t
+ngx_proxy_wasm_keys_unmarshal(ngx_proxy_wasm_exec_t *pwexec,
+    ngx_array_t *dst, ngx_proxy_wasm_marshalled_map_t *map)
+{
+    size_t      i, len;
+    uint32_t    count = 0, *lens;
+    u_char     *buf, *last;
+    ngx_str_t  *key;
+
+    /**
+     * Keys list: count, then each key length, then each key
+     * NUL-terminated (i.e. a pairs map without values).
+     * Keys are not copied and point to the guest memory.
+     */
+
+    buf = map->data;
+    last = map->data + map->len;
+
+    if (map->len) {
+        if (map->len < NGX_PROXY_WASM_PTR_SIZE) {
+            return NGX_ERROR;
+        }
+
+        count = *((uint32_t *) buf);
+        buf += NGX_PROXY_WASM_PTR_SIZE;
+    }
+
+    if ((size_t) (last - buf) / NGX_PROXY_WASM_PTR_SIZE < count) {
+        return NGX_ERROR;
+    }
+
+    if (ngx_array_init(dst, pwexec->pool, ngx_max(count, 1),
+                       sizeof(ngx_str_t))
+        != NGX_OK)
+    {
+        return NGX_ERROR;
+    }
+
+    lens = (uint32_t *) buf;
+    buf += count * NGX_PROXY_WASM_PTR_SIZE;
+
+    for (i = 0; i < count; i++) {
+        len = lens[i];
+
+        if (len >= (size_t) (last - buf)) {
+            goto failed;
+        }
+
+        key = ngx_array_push(dst);
+        if (key == NULL) {
+            goto failed;
+        }
+
+        key->len = len;
+        key->data = buf;
+
+        buf += len + 1;
+    }
+
+    return NGX_OK;
+
+failed:
+
+    ngx_array_destroy(dst);
+
+    return NGX_ERROR;
+}
+
+
 unsigned
 ngx_proxy_wasm_marshal(ngx_proxy_wasm_exec_t *pwexec, ngx_list_t *list,
     ngx_array_t *shims, ngx_wavm_ptr_t *out, uint32_t *out_size,
@@ -563,3 +659,69 @@ ngx_proxy_wasm_marshal(ngx_proxy_wasm_exec_t *pwexec, ngx_list_t *list,
 
     return 1;
 }
+
+
+ngx_int_t
+ngx_proxy_wasm_marshal_cache(ngx_proxy_wasm_exec_t *pwexec,
+    ngx_proxy_wasm_map_cache_t *cache, ngx_list_t *list, ngx_array_t *extras)
+{
+    size_t                 size;
+    ngx_uint_t             truncated = 0;
+    ngx_proxy_wasm_ctx_t  *pwctx = pwexec->parent;
+
+    /* marshal in host memory, reused by the next filters of the chain */
+
+    size = ngx_proxy_wasm_pairs_size(list, extras, pwexec->filter->max_pairs);
+
+    if (size > cache->size) {
+        if (cache->data.data) {
+            ngx_pfree(pwctx->pool, cache->data.data);
+        }
+
+        cache->data.data = ngx_palloc(pwctx->pool, size);
+        if (cache->data.data == NULL) {
+            cache->size = 0;
+            cache->valid = 0;
+            return NGX_ERROR;
+        }
+
+        cache->size = size;
+    }
+
+    ngx_proxy_wasm_pairs_marshal(list, extras, cache->data.data,
+                                 pwexec->filter->max_pairs, &truncated);
+
+    cache->data.len = size;
+    cache->max_pairs = pwexec->filter->max_pairs;
+    cache->truncated = truncated;
+    cache->step = pwctx->step;
+    cache->valid = 1;
+
+    return NGX_OK;
+}
+
+
+unsigned
+ngx_proxy_wasm_marshal_cached(ngx_proxy_wasm_exec_t *pwexec,
+    ngx_proxy_wasm_map_cache_t *cache, ngx_wavm_ptr_t *out,
+    uint32_t *out_size)
+{
+    ngx_wavm_ptr_t         p;
+    ngx_wavm_instance_t   *instance = ngx_proxy_wasm_pwexec2instance(pwexec);
+
+    p = ngx_proxy_wasm_alloc(pwexec, cache->data.len);
+    if (!p) {
+        return 0;
+    }
+
+    if (!ngx_wavm_memory_memcpy(instance->memory, p, cache->data.data,
+                                cache->data.len))
+    {
+        return 0;
+    }
+
+    *out = p;
+    *out_size = (uint32_t) cache->data.len;
+
+    return 1;
+}
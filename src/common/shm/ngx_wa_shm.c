@@ -4,10 +4,16 @@
 #include "ddebug.h"
 
 #include <ngx_wasm.h>
+#include <ngx_channel.h>
 #include <ngx_wa_shm_kv.h>
 #include <ngx_wa_shm_queue.h>
 
 
+static ngx_int_t ngx_wa_shm_init_notify(ngx_cycle_t *cycle);
+static void ngx_wa_shm_cleanup_notify(void *data);
+static void ngx_wa_shm_notify_handler(ngx_event_t *ev);
+
+
 ngx_int_t
 ngx_wa_shm_init_zone(ngx_shm_zone_t *shm_zone, void *data)
 {
@@ -26,6 +32,7 @@ ngx_wa_shm_init(ngx_cycle_t *cycle)
 {
     size_t                 i;
     ngx_int_t              rc;
+    ngx_uint_t             nqueues = 0;
     ngx_array_t           *shms = ngx_wasmx_shms(cycle);
     ngx_wa_shm_mapping_t  *mappings = shms->elts;
     ngx_wa_shm_t          *shm;
@@ -44,6 +51,7 @@ ngx_wa_shm_init(ngx_cycle_t *cycle)
             break;
         case NGX_WA_SHM_TYPE_QUEUE:
             rc = ngx_wa_shm_queue_init(shm);
+            nqueues++;
             break;
         case NGX_WA_SHM_TYPE_METRICS:
             rc = ngx_wa_metrics_shm_init(cycle);
@@ -58,18 +66,145 @@ ngx_wa_shm_init(ngx_cycle_t *cycle)
         }
     }
 
+    if (nqueues && !ngx_test_config) {
+        /* queue consumers are woken up by producers */
+        return ngx_wa_shm_init_notify(cycle);
+    }
+
     return NGX_OK;
 }
 
 
+static ngx_int_t
+ngx_wa_shm_init_notify(ngx_cycle_t *cycle)
+{
+    ngx_uint_t            i, n;
+    ngx_socket_t         *s;
+    ngx_core_conf_t      *ccf;
+    ngx_pool_cleanup_t   *cln;
+    ngx_wa_shm_notify_t  *notify;
+    ngx_wa_conf_t        *wacf = ngx_wa_cycle_get_conf(cycle);
+
+    notify = &wacf->notify;
+
+    ccf = (ngx_core_conf_t *) ngx_get_conf(cycle->conf_ctx, ngx_core_module);
+
+    n = ngx_min((ngx_uint_t) ccf->worker_processes, NGX_WA_SHM_MAX_NOTIFY);
+
+    notify->channels = ngx_palloc(cycle->pool, n * 2 * sizeof(ngx_socket_t));
+    if (notify->channels == NULL) {
+        return NGX_ERROR;
+    }
+
+    cln = ngx_pool_cleanup_add(cycle->pool, 0);
+    if (cln == NULL) {
+        return NGX_ERROR;
+    }
+
+    cln->handler = ngx_wa_shm_cleanup_notify;
+    cln->data = notify;
+
+    /* created before forking: inherited by all workers */
+
+    for (i = 0; i < n; i++) {
+        s = &notify->channels[i * 2];
+
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, s) == -1) {
+            ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_socket_errno,
+                          "socketpair() failed while creating "
+                          "wasm shm notification channel");
+            return NGX_ERROR;
+        }
+
+        notify->nchannels++;
+
+        if (ngx_nonblocking(s[0]) == -1 || ngx_nonblocking(s[1]) == -1) {
+            ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_socket_errno,
+                          ngx_nonblocking_n " failed on "
+                          "wasm shm notification channel");
+            return NGX_ERROR;
+        }
+    }
+
+    ngx_log_debug1(NGX_LOG_DEBUG_WASM, cycle->log, 0,
+                   "wasm shm: %ui notification channels initialized",
+                   notify->nchannels);
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_wa_shm_cleanup_notify(void *data)
+{
+    ngx_wa_shm_notify_t  *notify = data;
+    ngx_uint_t            i;
+
+    for (i = 0; i < notify->nchannels * 2; i++) {
+        if (notify->channels[i] != NGX_WA_BAD_FD) {
+            (void) ngx_close_socket(notify->channels[i]);
+            notify->channels[i] = NGX_WA_BAD_FD;
+        }
+    }
+}
+
+
+static void
+ngx_wa_shm_notify_handler(ngx_event_t *ev)
+{
+    u_char             buf[64];
+    ssize_t            n;
+    ngx_connection_t  *c = ev->data;
+
+    /* drain pending wake-ups: they are coalesced */
+
+    do {
+        n = recv(c->fd, buf, sizeof(buf), 0);
+    } while (n == sizeof(buf));
+
+    if (n == -1 && ngx_socket_errno != NGX_EAGAIN) {
+        ngx_log_error(NGX_LOG_ALERT, ev->log, ngx_socket_errno,
+                      "recv() failed on wasm shm notification channel");
+        return;
+    }
+
+    if (ngx_exiting) {
+        return;
+    }
+
+    ngx_wa_shm_queue_notify_ready((ngx_cycle_t *) ngx_cycle);
+}
+
+
+void
+ngx_wa_shm_notify(uint64_t workers)
+{
+    u_char                c = 0;
+    ngx_uint_t            i;
+    ngx_wa_conf_t        *wacf;
+    ngx_wa_shm_notify_t  *notify;
+
+    wacf = ngx_wa_cycle_get_conf((ngx_cycle_t *) ngx_cycle);
+    notify = &wacf->notify;
+
+    for (i = 0; i < notify->nchannels; i++) {
+        if (workers & ((uint64_t) 1 << i)) {
+            /* EAGAIN: a wake-up is already pending */
+            (void) send(notify->channels[i * 2 + 1], &c, 1, 0);
+        }
+    }
+}
+
+
 ngx_int_t
 ngx_wa_shm_init_process(ngx_cycle_t *cycle)
 {
-#if (NGX_DEBUG)
     size_t                 i;
     ngx_array_t           *shms = ngx_wasmx_shms(cycle);
     ngx_wa_shm_mapping_t  *mappings = shms->elts;
     ngx_wa_shm_t          *shm;
+    ngx_wa_conf_t         *wacf = ngx_wa_cycle_get_conf(cycle);
+    ngx_wa_shm_notify_t   *notify = &wacf->notify;
 
     for (i = 0; i < shms->nelts; i++ ) {
         shm = mappings[i].zone->data;
@@ -77,15 +212,53 @@ ngx_wa_shm_init_process(ngx_cycle_t *cycle)
         ngx_log_debug2(NGX_LOG_DEBUG_WASM, shm->log, 0,
                        "wasm \"%V\" shm: process initialization (zone: %p)",
                        &shm->name, mappings[i].zone->shm.addr);
+
+        if (shm->type == NGX_WA_SHM_TYPE_KV
+            && (ngx_process == NGX_PROCESS_SINGLE
+                || (ngx_process == NGX_PROCESS_WORKER && ngx_worker == 0)))
+        {
+            /* expired entries are swept by the first worker only */
+            if (ngx_wa_shm_kv_init_sweep(shm, cycle) != NGX_OK) {
+                return NGX_ERROR;
+            }
+        }
     }
-#endif
 
-    /* TODO: initialize inter-process notifications */
+    /* inter-process notifications */
+
+    if ((ngx_process != NGX_PROCESS_WORKER
+         && ngx_process != NGX_PROCESS_SINGLE)
+        || ngx_worker >= notify->nchannels)
+    {
+        return NGX_OK;
+    }
+
+    for (i = 0; i < notify->nchannels; i++) {
+        if (i != ngx_worker) {
+            /* other workers' receiving ends */
+            (void) ngx_close_socket(notify->channels[i * 2]);
+            notify->channels[i * 2] = NGX_WA_BAD_FD;
+        }
+    }
+
+    if (ngx_add_channel_event(cycle, notify->channels[ngx_worker * 2],
+                              NGX_READ_EVENT, ngx_wa_shm_notify_handler)
+        != NGX_OK)
+    {
+        return NGX_ERROR;
+    }
 
     return NGX_OK;
 }
 
 
+void
+ngx_wa_shm_exit_process(ngx_cycle_t *cycle)
+{
+    ngx_wa_shm_queue_exit_process(cycle);
+}
+
+
 ngx_int_t
 ngx_wa_shm_lookup_index(ngx_str_t *name)
 {
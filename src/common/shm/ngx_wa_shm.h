@@ -5,8 +5,11 @@
 #include <ngx_core.h>
 
 
-#define NGX_WA_SHM_MIN_SIZE       (3 * ngx_pagesize)
-#define NGX_WA_SHM_INDEX_NOTFOUND -1
+#define NGX_WA_SHM_MIN_SIZE         (3 * ngx_pagesize)
+#define NGX_WA_SHM_INDEX_NOTFOUND   -1
+#define NGX_WA_SHM_MAX_SHARDS       64
+#define NGX_WA_SHM_MAX_NOTIFY       64  /* workers woken up by queues */
+#define NGX_WA_SHM_QUEUE_SLOT_SIZE  1024  /* lockfree queues item size */
 
 
 typedef enum {
@@ -20,17 +23,26 @@ typedef enum {
     NGX_WA_SHM_EVICTION_LRU,
     NGX_WA_SHM_EVICTION_SLRU,
     NGX_WA_SHM_EVICTION_NONE,
+    NGX_WA_SHM_EVICTION_TINYLFU,
 } ngx_wa_shm_eviction_e;
 
 
-typedef struct {
+typedef struct ngx_wa_shm_s  ngx_wa_shm_t;
+
+struct ngx_wa_shm_s {
     ngx_wa_shm_type_e       type;
     ngx_wa_shm_eviction_e   eviction;
     ngx_str_t               name;
     ngx_log_t              *log;
     ngx_slab_pool_t        *shpool;
     void                   *data;
-} ngx_wa_shm_t;
+    ngx_uint_t              nshards;
+    ngx_wa_shm_t           *shards;  /* independently locked slab pools */
+    ngx_uint_t              optimistic_reads;  /* seqlock reads (kv) */
+    ngx_uint_t              hash_index;  /* open addressing index (kv) */
+    ngx_uint_t              lockfree;  /* MPMC slots ring (queue) */
+    size_t                  slot_size;  /* max item size (lockfree queue) */
+};
 
 
 typedef struct {
@@ -39,15 +51,35 @@ typedef struct {
 } ngx_wa_shm_mapping_t;
 
 
+typedef struct {
+    ngx_socket_t           *channels;  /* socketpair per worker */
+    ngx_uint_t              nchannels;
+    ngx_array_t             subscribers;  /* queue consumers (worker) */
+} ngx_wa_shm_notify_t;
+
+
 ngx_int_t ngx_wa_shm_init(ngx_cycle_t *cycle);
 ngx_int_t ngx_wa_shm_init_zone(ngx_shm_zone_t *shm_zone, void *data);
 ngx_int_t ngx_wa_shm_init_process(ngx_cycle_t *cycle);
+void ngx_wa_shm_exit_process(ngx_cycle_t *cycle);
 ngx_int_t ngx_wa_shm_lookup_index(ngx_str_t *name);
+void ngx_wa_shm_notify(uint64_t workers);
 
 
 static ngx_inline void
 ngx_wa_shm_lock(ngx_wa_shm_t *shm)
 {
+    ngx_uint_t  i;
+
+    if (shm->shards) {
+        /* whole zone: always locked in the same order */
+        for (i = 0; i < shm->nshards; i++) {
+            ngx_shmtx_lock(&shm->shards[i].shpool->mutex);
+        }
+
+        return;
+    }
+
     ngx_shmtx_lock(&shm->shpool->mutex);
 }
 
@@ -55,13 +87,40 @@ ngx_wa_shm_lock(ngx_wa_shm_t *shm)
 static ngx_inline void
 ngx_wa_shm_unlock(ngx_wa_shm_t *shm)
 {
+    ngx_uint_t  i;
+
+    if (shm->shards) {
+        for (i = shm->nshards; i > 0; i--) {
+            ngx_shmtx_unlock(&shm->shards[i - 1].shpool->mutex);
+        }
+
+        return;
+    }
+
     ngx_shmtx_unlock(&shm->shpool->mutex);
 }
 
 
+/**
+ * Whether this process holds the lock of shm: of every shard for a
+ * sharded zone, as taken by ngx_wa_shm_lock(). Pass a shard to check
+ * that a single key's lock is held.
+ */
 static ngx_inline unsigned
 ngx_wa_shm_locked(ngx_wa_shm_t *shm)
 {
+    ngx_uint_t  i;
+
+    if (shm->shards) {
+        for (i = 0; i < shm->nshards; i++) {
+            if ((ngx_pid_t) *shm->shards[i].shpool->mutex.lock != ngx_pid) {
+                return 0;
+            }
+        }
+
+        return 1;
+    }
+
     return (ngx_pid_t) *shm->shpool->mutex.lock == ngx_pid;
 }
 
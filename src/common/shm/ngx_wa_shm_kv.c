@@ -14,6 +14,27 @@
 /* one extra queue for larger items */
 #define NGX_WASM_SLRU_NQUEUES(pool)  (NGX_WASM_SLAB_SLOTS(pool) + 1)
 
+/* optimistic reads */
+#define NGX_WA_SHM_KV_READ_TRIES     64
+#define NGX_WA_SHM_KV_MAX_DEPTH      64
+
+/* hash index */
+#define NGX_WA_SHM_KV_MIN_SLOTS      64
+
+/* tinylfu */
+#define NGX_WA_SHM_KV_SKETCH_DEPTH         4
+#define NGX_WA_SHM_KV_SKETCH_MAX           15
+#define NGX_WA_SHM_KV_MIN_SKETCH_WIDTH     64
+
+#define NGX_WA_SHM_KV_SEGMENT_WINDOW       0
+#define NGX_WA_SHM_KV_SEGMENT_PROBATION    1
+#define NGX_WA_SHM_KV_SEGMENT_PROTECTED    2
+
+/* expiry */
+#define NGX_WA_SHM_KV_SWEEP_INTERVAL       1000
+#define NGX_WA_SHM_KV_SWEEP_BUSY_INTERVAL  10
+#define NGX_WA_SHM_KV_SWEEP_BATCH          100
+
 
 ngx_wa_shm_kv_t *
 ngx_wa_shm_get_kv(ngx_wa_shm_t *shm)
@@ -24,12 +45,94 @@ ngx_wa_shm_get_kv(ngx_wa_shm_t *shm)
 }
 
 
+static ngx_slab_pool_t *
+ngx_wa_shm_kv_shard_pool(u_char *addr, size_t size)
+{
+    ngx_slab_pool_t  *sp = (ngx_slab_pool_t *) addr;
+
+    /* as in ngx_init_zone_pool() */
+
+    sp->end = addr + size;
+    sp->min_shift = 3;
+    sp->addr = addr;
+
+    if (ngx_shmtx_create(&sp->mutex, &sp->lock, NULL) != NGX_OK) {
+        return NULL;
+    }
+
+    ngx_slab_init(sp);
+
+    return sp;
+}
+
+
+static ngx_int_t
+ngx_wa_shm_kv_init_shards(ngx_wa_shm_t *shm)
+{
+    size_t         size;
+    u_char        *addr;
+    ngx_int_t      rc;
+    ngx_uint_t     i;
+    ngx_wa_shm_t  *shard;
+
+    /* split the zone's free pages between one slab pool per shard */
+
+    size = (shm->shpool->pfree / shm->nshards) << ngx_pagesize_shift;
+
+    if (size < NGX_WA_SHM_MIN_SIZE) {
+        ngx_wasm_log_error(NGX_LOG_EMERG, shm->log, 0,
+                           "\"%V\" shm store: too small for %ui shards",
+                           &shm->name, shm->nshards);
+        return NGX_ERROR;
+    }
+
+    for (i = 0; i < shm->nshards; i++) {
+        shard = &shm->shards[i];
+
+        addr = ngx_slab_alloc(shm->shpool, size);
+        if (addr == NULL) {
+            return NGX_ERROR;
+        }
+
+        shard->type = shm->type;
+        shard->eviction = shm->eviction;
+        shard->name = shm->name;
+        shard->log = shm->log;
+        shard->optimistic_reads = shm->optimistic_reads;
+        shard->hash_index = shm->hash_index;
+        shard->nshards = 1;
+        shard->shards = NULL;
+
+        shard->shpool = ngx_wa_shm_kv_shard_pool(addr, size);
+        if (shard->shpool == NULL) {
+            return NGX_ERROR;
+        }
+
+        rc = ngx_wa_shm_kv_init(shard);
+        if (rc != NGX_OK) {
+            return rc;
+        }
+    }
+
+    ngx_log_debug3(NGX_LOG_DEBUG_WASM, shm->log, 0,
+                   "wasm \"%V\" shm store: %ui shards of %uz bytes",
+                   &shm->name, shm->nshards, size);
+
+    return NGX_OK;
+}
+
+
 ngx_int_t
 ngx_wa_shm_kv_init(ngx_wa_shm_t *shm)
 {
-    size_t            size, i;
-    ngx_uint_t        n;
-    ngx_wa_shm_kv_t  *kv;
+    size_t                    size, i;
+    ngx_uint_t                n;
+    ngx_wa_shm_kv_t          *kv;
+    ngx_wa_shm_kv_tinylfu_t  *tl;
+
+    if (shm->shards) {
+        return ngx_wa_shm_kv_init_shards(shm);
+    }
 
     n = 0;
     size = sizeof(ngx_wa_shm_kv_t);
@@ -45,9 +148,27 @@ ngx_wa_shm_kv_init(ngx_wa_shm_t *shm)
     }
 
     ngx_rbtree_init(&kv->rbtree, &kv->sentinel, ngx_str_rbtree_insert_value);
+    ngx_rbtree_init(&kv->expiries, &kv->expiries_sentinel,
+                    ngx_rbtree_insert_timer_value);
     shm->data = kv;
     shm->shpool->log_nomem = 0;
 
+    if (shm->hash_index) {
+        /* one slot per 512 bytes of zone, grown when 3/4 full */
+        size = (shm->shpool->end - (u_char *) shm->shpool) / 512;
+
+        for (kv->nslots = NGX_WA_SHM_KV_MIN_SLOTS;
+             kv->nslots < size;
+             kv->nslots <<= 1)
+        { /* void */ }
+
+        kv->slots = ngx_slab_calloc(shm->shpool,
+                                    kv->nslots * sizeof(ngx_wa_shm_kv_slot_t));
+        if (kv->slots == NULL) {
+            return NGX_ERROR;
+        }
+    }
+
     kv->nelts = 0;
 
     if (shm->eviction == NGX_WA_SHM_EVICTION_LRU) {
@@ -57,6 +178,27 @@ ngx_wa_shm_kv_init(ngx_wa_shm_t *shm)
         for (i = 0; i < n; i++) {
             ngx_queue_init(&kv->eviction.slru_queues[i]);
         }
+
+    } else if (shm->eviction == NGX_WA_SHM_EVICTION_TINYLFU) {
+        tl = &kv->eviction.tinylfu;
+
+        ngx_queue_init(&tl->window);
+        ngx_queue_init(&tl->probation);
+        ngx_queue_init(&tl->protected);
+
+        /* about one counter per 256 bytes of zone in each row */
+        size = (shm->shpool->end - (u_char *) shm->shpool) / 256;
+
+        for (tl->sketch_width = NGX_WA_SHM_KV_MIN_SKETCH_WIDTH;
+             tl->sketch_width < size;
+             tl->sketch_width <<= 1)
+        { /* void */ }
+
+        tl->sketch = ngx_slab_calloc(shm->shpool, NGX_WA_SHM_KV_SKETCH_DEPTH
+                                                  * tl->sketch_width);
+        if (tl->sketch == NULL) {
+            return NGX_ERROR;
+        }
     }
 
     ngx_log_debug1(NGX_LOG_DEBUG_WASM, shm->log, 0,
@@ -143,270 +285,1191 @@ ngx_wa_shm_rbtree_lookup(ngx_rbtree_t *rbtree, uint32_t key_hash)
 }
 
 
-ngx_int_t
-ngx_wa_shm_kv_get_locked(ngx_wa_shm_t *shm, ngx_str_t *key,
-    uint32_t *key_hash, ngx_str_t **value_out, uint32_t *cas)
+static ngx_wa_shm_kv_slot_t *
+hash_lookup(ngx_wa_shm_kv_t *kv, uint32_t key_hash)
 {
-    ngx_wa_shm_kv_t       *kv = ngx_wa_shm_get_kv(shm);
-    ngx_wa_shm_kv_node_t  *n;
-
-    if (key_hash) {
-        n = ngx_wa_shm_rbtree_lookup(&kv->rbtree, *key_hash);
+    ngx_uint_t             i, d, mask = kv->nslots - 1;
+    ngx_wa_shm_kv_slot_t  *slot;
 
-    } else {
-        n = ngx_wa_shm_rbtree_lookup(&kv->rbtree,
-                                     ngx_crc32_long(key->data, key->len));
-    }
+    i = key_hash & mask;
 
-    if (n == NULL) {
-        return NGX_DECLINED;
-    }
+    for (d = 0; d < kv->nslots; d++) {
+        slot = &kv->slots[i];
 
-    if (shm->eviction == NGX_WA_SHM_EVICTION_LRU
-        || shm->eviction == NGX_WA_SHM_EVICTION_SLRU)
-    {
-        ngx_queue_remove(&n->queue);
-        ngx_queue_insert_head(queue_for_node(shm, n), &n->queue);
-    }
+        if (slot->node == NULL || slot->dist < d) {
+            /* an entry this far from home would have taken this slot */
+            return NULL;
+        }
 
-    if (value_out) {
-        *value_out = &n->value;
-    }
+        if (slot->hash == key_hash) {
+            return slot;
+        }
 
-    if (cas) {
-        *cas = n->cas;
+        i = (i + 1) & mask;
     }
 
-    return NGX_OK;
+    return NULL;
 }
 
 
-static ngx_int_t
-queue_expire(ngx_wa_shm_t *shm, ngx_queue_t *queue, ngx_queue_t *q)
+static void
+hash_place(ngx_wa_shm_kv_slot_t *slots, ngx_uint_t mask,
+    ngx_wa_shm_kv_node_t *n, uint32_t key_hash)
 {
-    ngx_wa_shm_kv_node_t  *node;
-    ngx_wa_shm_kv_t       *kv = ngx_wa_shm_get_kv(shm);
+    ngx_uint_t             i;
+    ngx_wa_shm_kv_slot_t   e, tmp;
 
-    node = ngx_queue_data(q, ngx_wa_shm_kv_node_t, queue);
-
-    ngx_queue_remove(q);
+    e.node = n;
+    e.hash = key_hash;
+    e.dist = 0;
 
-    ngx_rbtree_delete(&kv->rbtree, &node->key.node);
+    i = key_hash & mask;
 
-    ngx_slab_free_locked(shm->shpool, node);
+    for ( ;; ) {
+        if (slots[i].node == NULL) {
+            slots[i] = e;
+            return;
+        }
 
-    kv->nelts--;
+        if (slots[i].dist < e.dist) {
+            /* Robin Hood: the poorer entry takes the slot */
+            tmp = slots[i];
+            slots[i] = e;
+            e = tmp;
+        }
 
-    return NGX_OK;
+        i = (i + 1) & mask;
+        e.dist++;
+    }
 }
 
 
-static ngx_int_t
-slru_expire(ngx_wa_shm_t *shm, size_t size)
+static void
+hash_grow(ngx_wa_shm_t *shm, ngx_wa_shm_kv_t *kv)
 {
-    ngx_int_t         i;
-    ngx_uint_t        n, start;
-    ngx_queue_t      *q, *queue;
-    ngx_wa_shm_kv_t  *kv = ngx_wa_shm_get_kv(shm);
+    ngx_uint_t             i, nslots;
+    ngx_wa_shm_kv_slot_t  *slots;
 
-    n = NGX_WASM_SLRU_NQUEUES(shm->shpool);
-    start = slru_index_for_size(shm, size);
+    nslots = kv->nslots << 1;
 
-    /* find a non-empty queue to expire something,
-       starting from the correct one, then into larger slots */
-    for (i = start; i < (ngx_int_t) n; i++) {
-        queue = &kv->eviction.slru_queues[i];
+    slots = ngx_slab_calloc_locked(shm->shpool,
+                                   nslots * sizeof(ngx_wa_shm_kv_slot_t));
+    if (slots == NULL) {
+        /* keep filling the current table */
+        return;
+    }
 
-        q = ngx_queue_last(queue);
-        if (q != ngx_queue_sentinel(queue)) {
-            return queue_expire(shm, queue, q);
+    for (i = 0; i < kv->nslots; i++) {
+        if (kv->slots[i].node) {
+            hash_place(slots, nslots - 1, kv->slots[i].node,
+                       kv->slots[i].hash);
         }
     }
 
-    /* fallback into freeing smaller slots */
-    for (i = start - 1; i >= 0; i--) {
-        queue = &kv->eviction.slru_queues[i];
+    ngx_slab_free_locked(shm->shpool, kv->slots);
 
-        q = ngx_queue_last(queue);
-        if (q != ngx_queue_sentinel(queue)) {
-            return queue_expire(shm, queue, q);
-        }
-    }
+    kv->slots = slots;
+    kv->nslots = nslots;
 
-    /* no luck */
-    return NGX_ABORT;
+    ngx_log_debug2(NGX_LOG_DEBUG_WASM, shm->log, 0,
+                   "wasm \"%V\" shm store: index grown to %ui slots",
+                   &shm->name, nslots);
 }
 
 
-static ngx_int_t
-lru_expire(ngx_wa_shm_t *shm)
+static ngx_wa_shm_kv_node_t *
+index_lookup(ngx_wa_shm_t *shm, ngx_wa_shm_kv_t *kv, uint32_t key_hash)
 {
-    ngx_wa_shm_kv_t  *kv = ngx_wa_shm_get_kv(shm);
-    ngx_queue_t      *q, *lru_queue = &kv->eviction.lru_queue;
+    ngx_wa_shm_kv_slot_t  *slot;
 
-    q = ngx_queue_last(lru_queue);
-    if (q == ngx_queue_sentinel(lru_queue)) {
-        return NGX_ABORT;
+    if (shm->hash_index) {
+        slot = hash_lookup(kv, key_hash);
+        return slot ? slot->node : NULL;
     }
 
-    return queue_expire(shm, lru_queue, q);
+    return ngx_wa_shm_rbtree_lookup(&kv->rbtree, key_hash);
 }
 
 
-static ngx_inline void
-node_queue_remove(ngx_wa_shm_t *shm, ngx_wa_shm_kv_node_t *n)
+static ngx_int_t
+index_insert(ngx_wa_shm_t *shm, ngx_wa_shm_kv_t *kv, ngx_wa_shm_kv_node_t *n)
 {
-    if (shm->eviction == NGX_WA_SHM_EVICTION_LRU
-        || shm->eviction == NGX_WA_SHM_EVICTION_SLRU)
-    {
-        ngx_queue_remove(&n->queue);
+    if (!shm->hash_index) {
+        ngx_rbtree_insert(&kv->rbtree, &n->key.node);
+        return NGX_OK;
+    }
+
+    if ((kv->nelts + 1) * 4 > kv->nslots * 3) {
+        hash_grow(shm, kv);
+    }
+
+    if (kv->nelts == kv->nslots) {
+        return NGX_ERROR;
     }
+
+    hash_place(kv->slots, kv->nslots - 1, n, n->key.node.key);
+
+    return NGX_OK;
 }
 
 
-ngx_int_t
-ngx_wa_shm_kv_set_locked(ngx_wa_shm_t *shm, ngx_str_t *key,
-    ngx_str_t *value, uint32_t cas, unsigned *written)
+static void
+index_delete(ngx_wa_shm_t *shm, ngx_wa_shm_kv_t *kv, ngx_wa_shm_kv_node_t *n)
 {
-    size_t                 size;
-    uint32_t               key_hash = ngx_crc32_long(key->data, key->len);
-    ngx_wa_shm_kv_t       *kv = ngx_wa_shm_get_kv(shm);
-    ngx_wa_shm_kv_node_t  *n, *old;
-
-    old = NULL;
-    n = ngx_wa_shm_rbtree_lookup(&kv->rbtree, key_hash);
+    ngx_uint_t             i, j, mask;
+    ngx_wa_shm_kv_slot_t  *slot;
 
-    if (cas != (n == NULL ? 0 : n->cas)) {
-        *written = 0;
-        return NGX_OK;
+    if (!shm->hash_index) {
+        ngx_rbtree_delete(&kv->rbtree, &n->key.node);
+        return;
     }
 
-    if (value == NULL) {
+    slot = hash_lookup(kv, n->key.node.key);
+    if (slot == NULL) {
+        ngx_wa_assert(0);
+        return;
+    }
 
-        /* delete */
+    /* backward shift deletion */
 
-        if (n) {
-            node_queue_remove(shm, n);
+    mask = kv->nslots - 1;
+    i = slot - kv->slots;
 
-            ngx_rbtree_delete(&kv->rbtree, &n->key.node);
-            ngx_slab_free_locked(shm->shpool, n);
-            *written = 1;
-            kv->nelts--;
+    for ( ;; ) {
+        j = (i + 1) & mask;
 
-        } else {
-            *written = 0;
+        if (kv->slots[j].node == NULL || kv->slots[j].dist == 0) {
+            ngx_memzero(&kv->slots[i], sizeof(ngx_wa_shm_kv_slot_t));
+            return;
         }
 
-        return NGX_OK;
+        kv->slots[i] = kv->slots[j];
+        kv->slots[i].dist--;
+        i = j;
     }
+}
 
-    /* set */
 
-    if (n && value->len > n->value.len) {
-        old = n;
-        n = NULL;
-    }
+static ngx_inline ngx_uint_t
+sketch_index(ngx_wa_shm_kv_tinylfu_t *tl, uint32_t key_hash, ngx_uint_t row)
+{
+    uint32_t                 h;
+    static const uint32_t    seeds[NGX_WA_SHM_KV_SKETCH_DEPTH] = {
+        0x9e3779b1, 0x85ebca77, 0xc2b2ae3d, 0x27d4eb2f
+    };
 
-    if (n == NULL) {
-        size = sizeof(ngx_wa_shm_kv_node_t) + key->len + value->len;
+    h = (key_hash ^ (key_hash >> 16)) * seeds[row];
+    h ^= h >> 15;
 
-        for ( ;; ) {
-            n = ngx_slab_calloc_locked(shm->shpool, size);
-            if (n) {
-                break;
-            }
+    return row * tl->sketch_width + (h & (tl->sketch_width - 1));
+}
 
-            if ((shm->eviction == NGX_WA_SHM_EVICTION_LRU
-                 && lru_expire(shm) == NGX_OK) ||
-                (shm->eviction == NGX_WA_SHM_EVICTION_SLRU
-                 && slru_expire(shm, size) == NGX_OK))
-            {
-                ngx_log_debug1(NGX_LOG_DEBUG_WASM, shm->log, 0,
-                               "wasm \"%V\" shm store: expired LRU entry",
-                               &shm->name);
 
-                continue;
-            }
+static void
+sketch_increment(ngx_wa_shm_kv_tinylfu_t *tl, uint32_t key_hash,
+    unsigned locked)
+{
+    ngx_uint_t   i;
+    u_char      *c;
 
-            ngx_wasm_log_error(NGX_LOG_CRIT, shm->log, 0,
-                               "\"%V\" shm store: "
-                               "no memory; cannot allocate pair with "
-                               "key size %d and value size %d",
-                               &shm->name, key->len, value->len);
-            return NGX_ERROR;
+    for (i = 0; i < NGX_WA_SHM_KV_SKETCH_DEPTH; i++) {
+        c = &tl->sketch[sketch_index(tl, key_hash, i)];
+
+        if (*c < NGX_WA_SHM_KV_SKETCH_MAX) {
+            (*c)++;
         }
+    }
 
-        n->key.str.data = (u_char *) n + sizeof(ngx_wa_shm_kv_node_t);
-        n->key.str.len = key->len;
-        n->key.node.key = ngx_crc32_long(key->data, key->len);
-        n->value.data = n->key.str.data + key->len;
-        n->value.len = value->len;
+    if (!locked) {
+        /* approximate: lost updates from concurrent readers are fine */
+        return;
+    }
 
-        if (old) {
-            node_queue_remove(shm, old);
+    if (++tl->sketch_additions < tl->sketch_width * 10) {
+        return;
+    }
 
-            n->cas = old->cas;
-            ngx_rbtree_delete(&kv->rbtree, &old->key.node);
-            ngx_slab_free_locked(shm->shpool, old);
+    /* aging: halve all counters so that old popularity fades */
 
-        } else {
-            kv->nelts++;
-        }
+    for (i = 0; i < tl->sketch_width * NGX_WA_SHM_KV_SKETCH_DEPTH; i++) {
+        tl->sketch[i] >>= 1;
+    }
 
-        ngx_memcpy(n->key.str.data, key->data, key->len);
-        n->key.str.len = key->len;
+    tl->sketch_additions /= 2;
+}
 
-        ngx_rbtree_insert(&kv->rbtree, &n->key.node);
 
-        if (shm->eviction == NGX_WA_SHM_EVICTION_LRU
-            || shm->eviction == NGX_WA_SHM_EVICTION_SLRU)
-        {
-            ngx_queue_insert_head(queue_for_node(shm, n), &n->queue);
-        }
+static ngx_uint_t
+sketch_estimate(ngx_wa_shm_kv_tinylfu_t *tl, uint32_t key_hash)
+{
+    ngx_uint_t  i, c, min = NGX_WA_SHM_KV_SKETCH_MAX;
 
-    } else {
-        n->value.len = value->len;
+    for (i = 0; i < NGX_WA_SHM_KV_SKETCH_DEPTH; i++) {
+        c = tl->sketch[sketch_index(tl, key_hash, i)];
 
-        if (shm->eviction == NGX_WA_SHM_EVICTION_LRU
-            || shm->eviction == NGX_WA_SHM_EVICTION_SLRU)
-        {
-            ngx_queue_remove(&n->queue);
-            ngx_queue_insert_head(queue_for_node(shm, n), &n->queue);
+        if (c < min) {
+            min = c;
         }
     }
 
-    /* no failure after this point */
+    return min;
+}
 
-    n->cas += 1;
 
-    ngx_memcpy(n->value.data, value->data, value->len);
+static ngx_inline void
+tinylfu_segment_insert(ngx_wa_shm_kv_tinylfu_t *tl, ngx_wa_shm_kv_node_t *n,
+    ngx_uint_t segment)
+{
+    n->segment = segment;
+
+    switch (segment) {
+    case NGX_WA_SHM_KV_SEGMENT_WINDOW:
+        tl->nwindow++;
+        ngx_queue_insert_head(&tl->window, &n->queue);
+        break;
+    case NGX_WA_SHM_KV_SEGMENT_PROTECTED:
+        tl->nprotected++;
+        ngx_queue_insert_head(&tl->protected, &n->queue);
+        break;
+    default:
+        ngx_queue_insert_head(&tl->probation, &n->queue);
+        break;
+    }
+}
 
-    *written = 1;
 
-    return NGX_OK;
+static ngx_inline void
+tinylfu_segment_remove(ngx_wa_shm_kv_tinylfu_t *tl, ngx_wa_shm_kv_node_t *n)
+{
+    if (n->segment == NGX_WA_SHM_KV_SEGMENT_WINDOW) {
+        tl->nwindow--;
+
+    } else if (n->segment == NGX_WA_SHM_KV_SEGMENT_PROTECTED) {
+        tl->nprotected--;
+    }
+
+    ngx_queue_remove(&n->queue);
 }
 
 
-ngx_int_t
-ngx_wa_shm_kv_resolve_key(ngx_str_t *key, ngx_wa_shm_kv_key_t *out)
+static ngx_inline ngx_wa_shm_kv_node_t *
+tinylfu_last(ngx_queue_t *queue)
 {
-    size_t                   i;
-    ngx_int_t                zone_idx = NGX_WA_SHM_INDEX_NOTFOUND;
-    ngx_shm_zone_t          *zone;
-    ngx_array_t             *zone_array;
-    ngx_cycle_t             *cycle = (ngx_cycle_t *) ngx_cycle;
-    static const ngx_str_t   default_namespace = ngx_string("*");
+    if (ngx_queue_empty(queue)) {
+        return NULL;
+    }
 
-    ngx_memzero(out, sizeof(ngx_wa_shm_kv_key_t));
+    return ngx_queue_data(ngx_queue_last(queue), ngx_wa_shm_kv_node_t, queue);
+}
 
-    zone_array = ngx_wasmx_shms(cycle);
-    if (zone_array == NULL) {
-        return NGX_DECLINED;
+
+static void
+tinylfu_balance(ngx_wa_shm_kv_t *kv)
+{
+    ngx_wa_shm_kv_node_t     *n;
+    ngx_wa_shm_kv_tinylfu_t  *tl = &kv->eviction.tinylfu;
+
+    /* the window holds ~1% of entries, protected ~80% of the main space */
+
+    while (tl->nwindow > 1 && tl->nwindow > kv->nelts / 100) {
+        n = tinylfu_last(&tl->window);
+        tinylfu_segment_remove(tl, n);
+        tinylfu_segment_insert(tl, n, NGX_WA_SHM_KV_SEGMENT_PROBATION);
     }
 
-    for (i = 0; i < key->len; i++) {
-        if (key->data[i] == '/') {
-            out->namespace.data = key->data;
+    while (tl->nprotected > 1
+           && tl->nprotected > (kv->nelts - tl->nwindow) * 4 / 5)
+    {
+        n = tinylfu_last(&tl->protected);
+        tinylfu_segment_remove(tl, n);
+        tinylfu_segment_insert(tl, n, NGX_WA_SHM_KV_SEGMENT_PROBATION);
+    }
+}
+
+
+static ngx_inline void
+node_queue_remove(ngx_wa_shm_t *shm, ngx_wa_shm_kv_node_t *n)
+{
+    ngx_wa_shm_kv_t  *kv;
+
+    if (shm->eviction == NGX_WA_SHM_EVICTION_LRU
+        || shm->eviction == NGX_WA_SHM_EVICTION_SLRU)
+    {
+        ngx_queue_remove(&n->queue);
+
+    } else if (shm->eviction == NGX_WA_SHM_EVICTION_TINYLFU) {
+        kv = ngx_wa_shm_get_kv(shm);
+        tinylfu_segment_remove(&kv->eviction.tinylfu, n);
+    }
+}
+
+
+static void
+node_queue_insert(ngx_wa_shm_t *shm, ngx_wa_shm_kv_node_t *n)
+{
+    ngx_wa_shm_kv_t          *kv;
+    ngx_wa_shm_kv_tinylfu_t  *tl;
+
+    if (shm->eviction == NGX_WA_SHM_EVICTION_LRU
+        || shm->eviction == NGX_WA_SHM_EVICTION_SLRU)
+    {
+        ngx_queue_insert_head(queue_for_node(shm, n), &n->queue);
+
+    } else if (shm->eviction == NGX_WA_SHM_EVICTION_TINYLFU) {
+        kv = ngx_wa_shm_get_kv(shm);
+        tl = &kv->eviction.tinylfu;
+
+        /* new entries always enter the window */
+        sketch_increment(tl, n->key.node.key, 1);
+        tinylfu_segment_insert(tl, n, NGX_WA_SHM_KV_SEGMENT_WINDOW);
+        tinylfu_balance(kv);
+    }
+}
+
+
+static void
+node_queue_touch(ngx_wa_shm_t *shm, ngx_wa_shm_kv_node_t *n)
+{
+    ngx_wa_shm_kv_t          *kv;
+    ngx_wa_shm_kv_tinylfu_t  *tl;
+
+    if (shm->eviction == NGX_WA_SHM_EVICTION_LRU
+        || shm->eviction == NGX_WA_SHM_EVICTION_SLRU)
+    {
+        ngx_queue_remove(&n->queue);
+        ngx_queue_insert_head(queue_for_node(shm, n), &n->queue);
+
+    } else if (shm->eviction == NGX_WA_SHM_EVICTION_TINYLFU) {
+        kv = ngx_wa_shm_get_kv(shm);
+        tl = &kv->eviction.tinylfu;
+
+        sketch_increment(tl, n->key.node.key, 1);
+        tinylfu_segment_remove(tl, n);
+
+        /* a hit in probation promotes to protected */
+        tinylfu_segment_insert(tl, n,
+                               n->segment == NGX_WA_SHM_KV_SEGMENT_WINDOW
+                               ? NGX_WA_SHM_KV_SEGMENT_WINDOW
+                               : NGX_WA_SHM_KV_SEGMENT_PROTECTED);
+        tinylfu_balance(kv);
+    }
+}
+
+
+static ngx_inline unsigned
+node_expired(ngx_wa_shm_kv_node_t *n)
+{
+    return n->expiry.key
+           && (ngx_msec_int_t) (n->expiry.key - ngx_current_msec) <= 0;
+}
+
+
+static void
+node_set_ttl(ngx_wa_shm_kv_t *kv, ngx_wa_shm_kv_node_t *n, ngx_msec_t ttl)
+{
+    if (n->expiry.key) {
+        ngx_rbtree_delete(&kv->expiries, &n->expiry);
+        n->expiry.key = 0;
+    }
+
+    if (ttl) {
+        n->expiry.key = ngx_current_msec + ttl;
+
+        if (n->expiry.key == 0) {
+            /* 0 means no expiry */
+            n->expiry.key = 1;
+        }
+
+        ngx_rbtree_insert(&kv->expiries, &n->expiry);
+    }
+}
+
+
+static void
+node_free(ngx_wa_shm_t *shm, ngx_wa_shm_kv_t *kv, ngx_wa_shm_kv_node_t *n)
+{
+    index_delete(shm, kv, n);
+
+    if (n->expiry.key) {
+        ngx_rbtree_delete(&kv->expiries, &n->expiry);
+    }
+
+    ngx_slab_free_locked(shm->shpool, n);
+
+    kv->nelts--;
+}
+
+
+static void
+node_delete(ngx_wa_shm_t *shm, ngx_wa_shm_kv_t *kv, ngx_wa_shm_kv_node_t *n)
+{
+    node_queue_remove(shm, n);
+    node_free(shm, kv, n);
+}
+
+
+ngx_int_t
+ngx_wa_shm_kv_get_locked(ngx_wa_shm_t *shm, ngx_str_t *key,
+    uint32_t *key_hash, ngx_str_t **value_out, uint32_t *cas)
+{
+    uint32_t               hash;
+    ngx_wa_shm_kv_t       *kv = ngx_wa_shm_get_kv(shm);
+    ngx_wa_shm_kv_node_t  *n;
+
+    hash = key_hash ? *key_hash : ngx_crc32_long(key->data, key->len);
+
+    n = index_lookup(shm, kv, hash);
+
+    if (n == NULL || node_expired(n)) {
+        /* expired entries are reclaimed by writes or the sweeper */
+        (void) ngx_atomic_fetch_add(&kv->misses, 1);
+
+        if (shm->eviction == NGX_WA_SHM_EVICTION_TINYLFU) {
+            /* misses count towards admission too */
+            sketch_increment(&kv->eviction.tinylfu, hash, 1);
+        }
+
+        return NGX_DECLINED;
+    }
+
+    (void) ngx_atomic_fetch_add(&kv->hits, 1);
+
+    node_queue_touch(shm, n);
+
+    if (value_out) {
+        *value_out = &n->value;
+    }
+
+    if (cas) {
+        *cas = n->cas;
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+queue_expire(ngx_wa_shm_t *shm, ngx_queue_t *queue, ngx_queue_t *q)
+{
+    ngx_wa_shm_kv_node_t  *node;
+    ngx_wa_shm_kv_t       *kv = ngx_wa_shm_get_kv(shm);
+
+    node = ngx_queue_data(q, ngx_wa_shm_kv_node_t, queue);
+
+    node_delete(shm, kv, node);
+
+    (void) ngx_atomic_fetch_add(&kv->evictions, 1);
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+slru_expire(ngx_wa_shm_t *shm, size_t size)
+{
+    ngx_int_t         i;
+    ngx_uint_t        n, start;
+    ngx_queue_t      *q, *queue;
+    ngx_wa_shm_kv_t  *kv = ngx_wa_shm_get_kv(shm);
+
+    n = NGX_WASM_SLRU_NQUEUES(shm->shpool);
+    start = slru_index_for_size(shm, size);
+
+    /* find a non-empty queue to expire something,
+       starting from the correct one, then into larger slots */
+    for (i = start; i < (ngx_int_t) n; i++) {
+        queue = &kv->eviction.slru_queues[i];
+
+        q = ngx_queue_last(queue);
+        if (q != ngx_queue_sentinel(queue)) {
+            return queue_expire(shm, queue, q);
+        }
+    }
+
+    /* fallback into freeing smaller slots */
+    for (i = start - 1; i >= 0; i--) {
+        queue = &kv->eviction.slru_queues[i];
+
+        q = ngx_queue_last(queue);
+        if (q != ngx_queue_sentinel(queue)) {
+            return queue_expire(shm, queue, q);
+        }
+    }
+
+    /* no luck */
+    return NGX_ABORT;
+}
+
+
+static ngx_int_t
+lru_expire(ngx_wa_shm_t *shm)
+{
+    ngx_wa_shm_kv_t  *kv = ngx_wa_shm_get_kv(shm);
+    ngx_queue_t      *q, *lru_queue = &kv->eviction.lru_queue;
+
+    q = ngx_queue_last(lru_queue);
+    if (q == ngx_queue_sentinel(lru_queue)) {
+        return NGX_ABORT;
+    }
+
+    return queue_expire(shm, lru_queue, q);
+}
+
+
+static ngx_int_t
+tinylfu_expire(ngx_wa_shm_t *shm)
+{
+    ngx_wa_shm_kv_t          *kv = ngx_wa_shm_get_kv(shm);
+    ngx_wa_shm_kv_node_t     *candidate, *victim;
+    ngx_wa_shm_kv_tinylfu_t  *tl = &kv->eviction.tinylfu;
+
+    candidate = tinylfu_last(&tl->window);
+    victim = tinylfu_last(&tl->probation);
+
+    if (victim == NULL) {
+        victim = tinylfu_last(&tl->protected);
+    }
+
+    if (candidate == NULL && victim == NULL) {
+        return NGX_ABORT;
+    }
+
+    if (candidate && victim
+        && sketch_estimate(tl, candidate->key.node.key)
+           > sketch_estimate(tl, victim->key.node.key))
+    {
+        /* admitted: the window's oldest entry replaces the main's victim */
+        tinylfu_segment_remove(tl, candidate);
+        tinylfu_segment_insert(tl, candidate, NGX_WA_SHM_KV_SEGMENT_PROBATION);
+        candidate = NULL;
+    }
+
+    if (candidate == NULL) {
+        return queue_expire(shm, &tl->probation, &victim->queue);
+    }
+
+    return queue_expire(shm, &tl->window, &candidate->queue);
+}
+
+
+static ngx_int_t
+ngx_wa_shm_kv_write_locked(ngx_wa_shm_t *shm, ngx_str_t *key,
+    ngx_str_t *value, uint32_t cas, ngx_msec_t ttl, unsigned *written)
+{
+    size_t                 size;
+    uint32_t               key_hash = ngx_crc32_long(key->data, key->len);
+    ngx_wa_shm_kv_t       *kv = ngx_wa_shm_get_kv(shm);
+    ngx_wa_shm_kv_node_t  *n, *old;
+
+    old = NULL;
+    n = index_lookup(shm, kv, key_hash);
+
+    if (n && node_expired(n)) {
+        node_delete(shm, kv, n);
+        n = NULL;
+    }
+
+    if (cas != (n == NULL ? 0 : n->cas)) {
+        *written = 0;
+        return NGX_OK;
+    }
+
+    if (value == NULL) {
+
+        /* delete */
+
+        if (n) {
+            node_delete(shm, kv, n);
+            *written = 1;
+
+        } else {
+            *written = 0;
+        }
+
+        return NGX_OK;
+    }
+
+    /* set */
+
+    if (n && value->len > n->value.len) {
+        old = n;
+        n = NULL;
+    }
+
+    if (n == NULL) {
+        size = sizeof(ngx_wa_shm_kv_node_t) + key->len + value->len;
+
+        if (old) {
+            /* the node being replaced must not be evicted */
+            node_queue_remove(shm, old);
+        }
+
+        for ( ;; ) {
+            n = ngx_slab_calloc_locked(shm->shpool, size);
+            if (n) {
+                break;
+            }
+
+            if ((shm->eviction == NGX_WA_SHM_EVICTION_LRU
+                 && lru_expire(shm) == NGX_OK) ||
+                (shm->eviction == NGX_WA_SHM_EVICTION_SLRU
+                 && slru_expire(shm, size) == NGX_OK) ||
+                (shm->eviction == NGX_WA_SHM_EVICTION_TINYLFU
+                 && tinylfu_expire(shm) == NGX_OK))
+            {
+                ngx_log_debug1(NGX_LOG_DEBUG_WASM, shm->log, 0,
+                               "wasm \"%V\" shm store: expired LRU entry",
+                               &shm->name);
+
+                continue;
+            }
+
+            ngx_wasm_log_error(NGX_LOG_CRIT, shm->log, 0,
+                               "\"%V\" shm store: "
+                               "no memory; cannot allocate pair with "
+                               "key size %d and value size %d",
+                               &shm->name, key->len, value->len);
+
+            if (old) {
+                node_queue_insert(shm, old);
+            }
+
+            return NGX_ERROR;
+        }
+
+        n->key.str.data = (u_char *) n + sizeof(ngx_wa_shm_kv_node_t);
+        n->key.str.len = key->len;
+        n->key.node.key = ngx_crc32_long(key->data, key->len);
+        n->value.data = n->key.str.data + key->len;
+        n->value.len = value->len;
+
+        if (old) {
+            n->cas = old->cas;
+            node_free(shm, kv, old);
+        }
+
+        ngx_memcpy(n->key.str.data, key->data, key->len);
+        n->key.str.len = key->len;
+
+        if (index_insert(shm, kv, n) != NGX_OK) {
+            /* cannot happen when replacing: a slot was just freed */
+            ngx_slab_free_locked(shm->shpool, n);
+
+            ngx_wasm_log_error(NGX_LOG_CRIT, shm->log, 0,
+                               "\"%V\" shm store: index full; cannot "
+                               "insert more than %ui pairs",
+                               &shm->name, kv->nelts);
+            return NGX_ERROR;
+        }
+
+        kv->nelts++;
+
+        node_queue_insert(shm, n);
+
+    } else {
+        n->value.len = value->len;
+
+        node_queue_touch(shm, n);
+    }
+
+    /* no failure after this point */
+
+    node_set_ttl(kv, n, ttl);
+
+    n->cas += 1;
+
+    ngx_memcpy(n->value.data, value->data, value->len);
+
+    *written = 1;
+
+    return NGX_OK;
+}
+
+
+ngx_int_t
+ngx_wa_shm_kv_set_locked(ngx_wa_shm_t *shm, ngx_str_t *key,
+    ngx_str_t *value, uint32_t cas, ngx_msec_t ttl, unsigned *written)
+{
+    ngx_int_t         rc;
+    ngx_wa_shm_kv_t  *kv = ngx_wa_shm_get_kv(shm);
+
+    /* let optimistic readers know nodes may be modified or freed */
+
+    kv->seq++;
+    ngx_memory_barrier();
+
+    rc = ngx_wa_shm_kv_write_locked(shm, key, value, cas, ttl, written);
+
+    ngx_memory_barrier();
+    kv->seq++;
+
+    return rc;
+}
+
+
+ngx_int_t
+ngx_wa_shm_kv_incr_locked(ngx_wa_shm_t *shm, ngx_str_t *key, int64_t delta,
+    int64_t init, ngx_msec_t ttl, int64_t *value_out)
+{
+    int64_t                v;
+    unsigned               written;
+    ngx_int_t              rc;
+    ngx_str_t              value;
+    ngx_wa_shm_kv_t       *kv = ngx_wa_shm_get_kv(shm);
+    ngx_wa_shm_kv_node_t  *n;
+
+    kv->seq++;
+    ngx_memory_barrier();
+
+    n = index_lookup(shm, kv, ngx_crc32_long(key->data, key->len));
+
+    if (n && node_expired(n)) {
+        node_delete(shm, kv, n);
+        n = NULL;
+    }
+
+    if (n == NULL) {
+        /* the ttl only applies to new counters */
+        v = (int64_t) ((uint64_t) init + (uint64_t) delta);
+
+        value.data = (u_char *) &v;
+        value.len = sizeof(int64_t);
+
+        rc = ngx_wa_shm_kv_write_locked(shm, key, &value, 0, ttl, &written);
+
+    } else if (n->value.len != sizeof(int64_t)) {
+        /* not a counter */
+        rc = NGX_DECLINED;
+
+    } else {
+        /* in place; values are not aligned */
+        ngx_memcpy(&v, n->value.data, sizeof(int64_t));
+        v = (int64_t) ((uint64_t) v + (uint64_t) delta);
+        ngx_memcpy(n->value.data, &v, sizeof(int64_t));
+
+        n->cas += 1;
+
+        node_queue_touch(shm, n);
+
+        rc = NGX_OK;
+    }
+
+    ngx_memory_barrier();
+    kv->seq++;
+
+    if (rc == NGX_OK) {
+        *value_out = v;
+    }
+
+    return rc;
+}
+
+
+void
+ngx_wa_shm_kv_stats(ngx_wa_shm_t *shm, ngx_wa_shm_kv_stats_t *stats)
+{
+    ngx_uint_t        i, nshards;
+    ngx_wa_shm_kv_t  *kv;
+
+    ngx_memzero(stats, sizeof(ngx_wa_shm_kv_stats_t));
+
+    nshards = shm->shards ? shm->nshards : 1;
+
+    for (i = 0; i < nshards; i++) {
+        kv = ngx_wa_shm_get_kv(shm->shards ? &shm->shards[i] : shm);
+
+        stats->hits += kv->hits;
+        stats->misses += kv->misses;
+        stats->evictions += kv->evictions;
+        stats->nelts += kv->nelts;
+    }
+}
+
+
+ngx_uint_t
+ngx_wa_shm_kv_sweep_locked(ngx_wa_shm_t *shm, ngx_uint_t max)
+{
+    ngx_uint_t             n;
+    ngx_rbtree_node_t     *node, *root, *sentinel;
+    ngx_wa_shm_kv_t       *kv = ngx_wa_shm_get_kv(shm);
+
+    sentinel = kv->expiries.sentinel;
+    root = kv->expiries.root;
+
+    if (root == sentinel
+        || (ngx_msec_int_t) (ngx_rbtree_min(root, sentinel)->key
+                             - ngx_current_msec) > 0)
+    {
+        /* nothing expired */
+        return 0;
+    }
+
+    kv->seq++;
+    ngx_memory_barrier();
+
+    for (n = 0; n < max; n++) {
+        root = kv->expiries.root;
+
+        if (root == sentinel) {
+            break;
+        }
+
+        node = ngx_rbtree_min(root, sentinel);
+
+        if ((ngx_msec_int_t) (node->key - ngx_current_msec) > 0) {
+            break;
+        }
+
+        node_delete(shm, kv, (ngx_wa_shm_kv_node_t *)
+                             ((u_char *) node
+                              - offsetof(ngx_wa_shm_kv_node_t, expiry)));
+    }
+
+    ngx_memory_barrier();
+    kv->seq++;
+
+    return n;
+}
+
+
+static void
+ngx_wa_shm_kv_sweep_handler(ngx_event_t *ev)
+{
+    ngx_uint_t     i, n, nshards;
+    ngx_msec_t     next;
+    ngx_wa_shm_t  *shard, *shm = ev->data;
+
+    if (ngx_exiting || ngx_quit) {
+        return;
+    }
+
+    next = NGX_WA_SHM_KV_SWEEP_INTERVAL;
+    nshards = shm->shards ? shm->nshards : 1;
+
+    /* one shard locked at a time, a bounded number of nodes each */
+
+    for (i = 0; i < nshards; i++) {
+        shard = shm->shards ? &shm->shards[i] : shm;
+
+        ngx_wa_shm_lock(shard);
+
+        n = ngx_wa_shm_kv_sweep_locked(shard, NGX_WA_SHM_KV_SWEEP_BATCH);
+
+        ngx_wa_shm_unlock(shard);
+
+        if (n) {
+            ngx_log_debug2(NGX_LOG_DEBUG_WASM, ev->log, 0,
+                           "wasm \"%V\" shm store: swept %ui expired "
+                           "entries", &shm->name, n);
+        }
+
+        if (n == NGX_WA_SHM_KV_SWEEP_BATCH) {
+            /* more to sweep */
+            next = NGX_WA_SHM_KV_SWEEP_BUSY_INTERVAL;
+        }
+    }
+
+    ngx_add_timer(ev, next);
+}
+
+
+ngx_int_t
+ngx_wa_shm_kv_init_sweep(ngx_wa_shm_t *shm, ngx_cycle_t *cycle)
+{
+    ngx_event_t  *ev;
+
+    ev = ngx_pcalloc(cycle->pool, sizeof(ngx_event_t));
+    if (ev == NULL) {
+        return NGX_ERROR;
+    }
+
+    ev->handler = ngx_wa_shm_kv_sweep_handler;
+    ev->data = shm;
+    ev->log = cycle->log;
+    ev->cancelable = 1;
+
+    ngx_add_timer(ev, NGX_WA_SHM_KV_SWEEP_INTERVAL);
+
+    return NGX_OK;
+}
+
+
+static ngx_inline unsigned
+in_pool(ngx_wa_shm_t *shm, void *p, size_t size)
+{
+    u_char  *start = (u_char *) shm->shpool;
+    u_char  *end = shm->shpool->end;
+
+    return (u_char *) p >= start
+           && (u_char *) p <= end
+           && size <= (size_t) (end - (u_char *) p);
+}
+
+
+static ngx_wa_shm_kv_node_t *
+read_optimistic_slot(ngx_wa_shm_t *shm, ngx_wa_shm_kv_t *kv,
+    uint32_t key_hash)
+{
+    ngx_uint_t             i, d, nslots;
+    ngx_wa_shm_kv_slot_t  *slots, *slot;
+
+    /* the table may be swapped by a concurrent grow: read it once */
+    slots = kv->slots;
+    nslots = kv->nslots;
+
+    if (nslots == 0
+        || (nslots & (nslots - 1))
+        || !in_pool(shm, slots, nslots * sizeof(ngx_wa_shm_kv_slot_t)))
+    {
+        return (ngx_wa_shm_kv_node_t *) -1;
+    }
+
+    i = key_hash & (nslots - 1);
+
+    for (d = 0; d < nslots; d++) {
+        slot = &slots[i];
+
+        if (slot->node == NULL || slot->dist < d) {
+            return NULL;
+        }
+
+        if (slot->hash == key_hash) {
+            if (!in_pool(shm, slot->node, sizeof(ngx_wa_shm_kv_node_t))) {
+                return (ngx_wa_shm_kv_node_t *) -1;
+            }
+
+            return slot->node;
+        }
+
+        i = (i + 1) & (nslots - 1);
+    }
+
+    return NULL;
+}
+
+
+static ngx_int_t
+ngx_wa_shm_kv_read_optimistic(ngx_wa_shm_t *shm, uint32_t key_hash,
+    ngx_str_t *value, uint32_t *cas)
+{
+    size_t                 len;
+    u_char                *data;
+    unsigned               expired;
+    ngx_uint_t             depth;
+    ngx_atomic_uint_t      seq;
+    ngx_rbtree_node_t     *node, *sentinel;
+    ngx_wa_shm_kv_node_t  *n;
+    ngx_wa_shm_kv_t       *kv = ngx_wa_shm_get_kv(shm);
+
+    seq = kv->seq;
+    ngx_memory_barrier();
+
+    if (seq & 1) {
+        return NGX_AGAIN;
+    }
+
+    /**
+     * Nodes may be freed and their memory reused while we walk the tree:
+     * every pointer is checked against the slab pool bounds so that no read
+     * escapes the zone, and the result is discarded if seq changed.
+     */
+
+    if (shm->hash_index) {
+        n = read_optimistic_slot(shm, kv, key_hash);
+        if (n == (ngx_wa_shm_kv_node_t *) -1) {
+            return NGX_AGAIN;
+        }
+
+        goto found;
+    }
+
+    node = kv->rbtree.root;
+    sentinel = kv->rbtree.sentinel;
+    n = NULL;
+
+    for (depth = 0; node != sentinel; depth++) {
+        if (depth == NGX_WA_SHM_KV_MAX_DEPTH
+            || !in_pool(shm, node, sizeof(ngx_wa_shm_kv_node_t)))
+        {
+            return NGX_AGAIN;
+        }
+
+        if (key_hash != node->key) {
+            node = (key_hash < node->key) ? node->left : node->right;
+            continue;
+        }
+
+        n = (ngx_wa_shm_kv_node_t *) node;
+        break;
+    }
+
+found:
+
+    if (n == NULL) {
+        ngx_memory_barrier();
+        return kv->seq == seq ? NGX_DECLINED : NGX_AGAIN;
+    }
+
+    len = n->value.len;
+    data = n->value.data;
+
+    if (!in_pool(shm, data, len)) {
+        return NGX_AGAIN;
+    }
+
+    if (len > value->len) {
+        /* destination buffer too small */
+        ngx_memory_barrier();
+
+        if (kv->seq != seq) {
+            return NGX_AGAIN;
+        }
+
+        value->len = len;
+        return NGX_BUSY;
+    }
+
+    ngx_memcpy(value->data, data, len);
+
+    if (cas) {
+        *cas = n->cas;
+    }
+
+    expired = node_expired(n);
+
+    ngx_memory_barrier();
+
+    if (kv->seq != seq) {
+        return NGX_AGAIN;
+    }
+
+    if (expired) {
+        return NGX_DECLINED;
+    }
+
+    value->len = len;
+
+    return NGX_OK;
+}
+
+
+/**
+ * Copy the value of key into value->data, a buffer of value->len bytes
+ * owned by the caller. The value is never referenced after the zone's
+ * lock is released, so it stays valid for as long as the caller's buffer.
+ *
+ * NGX_OK: success, value->len is the value's length
+ * NGX_DECLINED: not found
+ * NGX_BUSY: buffer too small, value->len is the needed size
+ */
+ngx_int_t
+ngx_wa_shm_kv_read_locked(ngx_wa_shm_t *shm, ngx_str_t *key,
+    uint32_t *key_hash, ngx_str_t *value, uint32_t *cas)
+{
+    size_t      size = value->len;
+    ngx_int_t   rc;
+    ngx_str_t  *v;
+
+    rc = ngx_wa_shm_kv_get_locked(shm, key, key_hash, &v, cas);
+    if (rc != NGX_OK) {
+        return rc;
+    }
+
+    value->len = v->len;
+
+    if (v->len > size) {
+        return NGX_BUSY;
+    }
+
+    ngx_memcpy(value->data, v->data, v->len);
+
+    return NGX_OK;
+}
+
+
+/**
+ * Same as ngx_wa_shm_kv_read_locked(), without the lock held: with
+ * optimistic reads, the lock is only taken if writers keep retrying us.
+ */
+ngx_int_t
+ngx_wa_shm_kv_read(ngx_wa_shm_t *shm, ngx_str_t *key, uint32_t *key_hash,
+    ngx_str_t *value, uint32_t *cas)
+{
+    size_t            size = value->len;
+    uint32_t          hash;
+    ngx_int_t         rc = NGX_AGAIN;
+    ngx_uint_t        i;
+    ngx_wa_shm_t     *shard;
+    ngx_wa_shm_kv_t  *kv;
+
+    hash = key_hash ? *key_hash : ngx_crc32_long(key->data, key->len);
+    shard = ngx_wa_shm_kv_shard(shm, hash);
+
+    if (shard->optimistic_reads) {
+        for (i = 0; i < NGX_WA_SHM_KV_READ_TRIES; i++) {
+            value->len = size;
+
+            rc = ngx_wa_shm_kv_read_optimistic(shard, hash, value, cas);
+
+            switch (rc) {
+            case NGX_OK:
+            case NGX_DECLINED:
+                kv = ngx_wa_shm_get_kv(shard);
+
+                (void) ngx_atomic_fetch_add(rc == NGX_OK ? &kv->hits
+                                                         : &kv->misses, 1);
+
+                if (shard->eviction == NGX_WA_SHM_EVICTION_TINYLFU) {
+                    /* without the lock: counters only, no queue update */
+                    sketch_increment(&kv->eviction.tinylfu, hash, 0);
+                }
+
+                /* fallthrough */
+            case NGX_BUSY:
+                return rc;
+            default:
+                ngx_cpu_pause();
+                break;
+            }
+        }
+
+        ngx_log_debug1(NGX_LOG_DEBUG_WASM, shard->log, 0,
+                       "wasm \"%V\" shm store: optimistic read retries "
+                       "exhausted, locking", &shard->name);
+    }
+
+    value->len = size;
+
+    ngx_wa_shm_lock(shard);
+
+    rc = ngx_wa_shm_kv_read_locked(shard, key, &hash, value, cas);
+
+    ngx_wa_shm_unlock(shard);
+
+    return rc;
+}
+
+
+ngx_int_t
+ngx_wa_shm_kv_resolve_key(ngx_str_t *key, ngx_wa_shm_kv_key_t *out)
+{
+    size_t                   i;
+    ngx_int_t                zone_idx = NGX_WA_SHM_INDEX_NOTFOUND;
+    ngx_shm_zone_t          *zone;
+    ngx_array_t             *zone_array;
+    ngx_cycle_t             *cycle = (ngx_cycle_t *) ngx_cycle;
+    static const ngx_str_t   default_namespace = ngx_string("*");
+
+    ngx_memzero(out, sizeof(ngx_wa_shm_kv_key_t));
+
+    zone_array = ngx_wasmx_shms(cycle);
+    if (zone_array == NULL) {
+        return NGX_DECLINED;
+    }
+
+    for (i = 0; i < key->len; i++) {
+        if (key->data[i] == '/') {
+            out->namespace.data = key->data;
             out->namespace.len = i;
             out->key.data = key->data + i + 1;
             out->key.len = key->len - i - 1;
@@ -443,3 +1506,29 @@ ngx_wa_shm_kv_resolve_key(ngx_str_t *key, ngx_wa_shm_kv_key_t *out)
 
     return NGX_OK;
 }
+
+
+ngx_int_t
+ngx_wa_shm_kv_resolve(uint32_t id, ngx_wa_shm_t **out)
+{
+    ngx_wa_shm_t    *shm;
+    ngx_shm_zone_t  *zone;
+    ngx_array_t     *zone_array;
+    ngx_cycle_t     *cycle = (ngx_cycle_t *) ngx_cycle;
+
+    zone_array = ngx_wasmx_shms(cycle);
+    if (zone_array == NULL || id >= zone_array->nelts) {
+        return NGX_DECLINED;
+    }
+
+    zone = ((ngx_wa_shm_mapping_t *) zone_array->elts)[id].zone;
+
+    shm = zone->data;
+    if (shm->type != NGX_WA_SHM_TYPE_KV) {
+        return NGX_ABORT;
+    }
+
+    *out = shm;
+
+    return NGX_OK;
+}
@@ -5,17 +5,61 @@
 #include <ngx_wa_shm.h>
 
 
+/* callers' stack buffer for ngx_wa_shm_kv_read(), larger values BUSY */
+#define NGX_WA_SHM_KV_READ_BUF_SIZE  512
+
+
+typedef struct ngx_wa_shm_kv_node_s  ngx_wa_shm_kv_node_t;
+
+
 typedef struct {
-    ngx_rbtree_t        rbtree;
-    ngx_rbtree_node_t   sentinel;
-    ngx_uint_t          nelts;
+    ngx_wa_shm_kv_node_t  *node;  /* NULL if empty */
+    uint32_t               hash;
+    uint32_t               dist;  /* probe distance from the home slot */
+} ngx_wa_shm_kv_slot_t;
+
+
+typedef struct {
+    ngx_queue_t            window;  /* admission window (LRU) */
+    ngx_queue_t            probation;  /* main SLRU segments */
+    ngx_queue_t            protected;
+    ngx_uint_t             nwindow;
+    ngx_uint_t             nprotected;
+    u_char                *sketch;  /* count-min sketch, 4 rows */
+    ngx_uint_t             sketch_width;  /* power of 2 */
+    ngx_uint_t             sketch_additions;
+} ngx_wa_shm_kv_tinylfu_t;
+
+
+typedef struct {
+    ngx_atomic_t           seq;  /* odd while being written */
+    ngx_atomic_t           hits;
+    ngx_atomic_t           misses;
+    ngx_atomic_t           evictions;
+    ngx_rbtree_t           rbtree;
+    ngx_rbtree_node_t      sentinel;
+    ngx_rbtree_t           expiries;  /* nodes with a ttl */
+    ngx_rbtree_node_t      expiries_sentinel;
+    ngx_wa_shm_kv_slot_t  *slots;  /* hash_index: Robin Hood table */
+    ngx_uint_t             nslots;  /* power of 2 */
+    ngx_uint_t             nelts;
+    void                  *data;  /* owner zone's state, e.g. metrics */
     union {
-        ngx_queue_t     lru_queue;
-        ngx_queue_t     slru_queues[0];
+        ngx_queue_t              lru_queue;
+        ngx_wa_shm_kv_tinylfu_t  tinylfu;
+        ngx_queue_t              slru_queues[0];
     } eviction;
 } ngx_wa_shm_kv_t;
 
 
+typedef struct {
+    ngx_uint_t             hits;
+    ngx_uint_t             misses;
+    ngx_uint_t             evictions;
+    ngx_uint_t             nelts;
+} ngx_wa_shm_kv_stats_t;
+
+
 typedef struct {
     ngx_str_t           namespace;
     ngx_str_t           key;
@@ -24,12 +68,14 @@ typedef struct {
 } ngx_wa_shm_kv_key_t;
 
 
-typedef struct {
+struct ngx_wa_shm_kv_node_s {
     ngx_str_node_t      key;
     ngx_str_t           value;
     uint32_t            cas;
+    uint32_t            segment;  /* tinylfu queue */
     ngx_queue_t         queue;
-} ngx_wa_shm_kv_node_t;
+    ngx_rbtree_node_t   expiry;  /* key: expiry time, 0 if none */
+};
 
 
 ngx_wa_shm_kv_t *ngx_wa_shm_get_kv(ngx_wa_shm_t *shm);
@@ -38,8 +84,30 @@ ngx_int_t ngx_wa_shm_kv_init(ngx_wa_shm_t *shm);
 ngx_int_t ngx_wa_shm_kv_get_locked(ngx_wa_shm_t *shm,
     ngx_str_t *key, uint32_t *key_hash, ngx_str_t **value_out, uint32_t *cas);
 ngx_int_t ngx_wa_shm_kv_set_locked(ngx_wa_shm_t *shm,
-    ngx_str_t *key, ngx_str_t *value, uint32_t cas, unsigned *written);
+    ngx_str_t *key, ngx_str_t *value, uint32_t cas, ngx_msec_t ttl,
+    unsigned *written);
+ngx_int_t ngx_wa_shm_kv_incr_locked(ngx_wa_shm_t *shm, ngx_str_t *key,
+    int64_t delta, int64_t init, ngx_msec_t ttl, int64_t *value_out);
+void ngx_wa_shm_kv_stats(ngx_wa_shm_t *shm, ngx_wa_shm_kv_stats_t *stats);
+ngx_uint_t ngx_wa_shm_kv_sweep_locked(ngx_wa_shm_t *shm, ngx_uint_t max);
+ngx_int_t ngx_wa_shm_kv_init_sweep(ngx_wa_shm_t *shm, ngx_cycle_t *cycle);
+ngx_int_t ngx_wa_shm_kv_read_locked(ngx_wa_shm_t *shm, ngx_str_t *key,
+    uint32_t *key_hash, ngx_str_t *value, uint32_t *cas);
+ngx_int_t ngx_wa_shm_kv_read(ngx_wa_shm_t *shm, ngx_str_t *key,
+    uint32_t *key_hash, ngx_str_t *value, uint32_t *cas);
 ngx_int_t ngx_wa_shm_kv_resolve_key(ngx_str_t *key, ngx_wa_shm_kv_key_t *out);
+ngx_int_t ngx_wa_shm_kv_resolve(uint32_t id, ngx_wa_shm_t **out);
+
+
+static ngx_inline ngx_wa_shm_t *
+ngx_wa_shm_kv_shard(ngx_wa_shm_t *shm, uint32_t key_hash)
+{
+    if (shm->shards == NULL) {
+        return shm;
+    }
+
+    return &shm->shards[key_hash % shm->nshards];
+}
 
 
 #endif /* _NGX_WA_SHM_KV_H_INCLUDED_ */
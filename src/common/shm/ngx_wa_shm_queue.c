@@ -7,12 +7,42 @@
 #include <ngx_wa_shm_queue.h>
 
 
+/**
+ * mode=lockfree: a bounded MPMC ring of fixed size slots, each carrying
+ * a sequence number (D. Vyukov's algorithm). Producers and consumers
+ * claim positions with a CAS and never take the zone mutex.
+ */
+
+typedef struct {
+    ngx_atomic_t                seq;
+    uint32_t                    len;
+    u_char                      data[1];
+} ngx_wa_shm_queue_slot_t;
+
+
 typedef struct {
-    uint8_t         *buffer;
-    uint8_t         *buffer_end;
-    ngx_uint_t       push_ptr;
-    ngx_uint_t       pop_ptr;
-    ngx_uint_t       rising_occupancy;
+    /* producers and consumers positions on their own cache lines */
+    ngx_atomic_t                enqueue_pos;
+    u_char                      pad1[NGX_CPU_CACHE_LINE
+                                     - sizeof(ngx_atomic_t)];
+    ngx_atomic_t                dequeue_pos;
+    u_char                      pad2[NGX_CPU_CACHE_LINE
+                                     - sizeof(ngx_atomic_t)];
+    ngx_atomic_uint_t           mask;
+    size_t                      slot_size;
+    size_t                      stride;
+    u_char                     *slots;
+} ngx_wa_shm_queue_ring_t;
+
+
+typedef struct {
+    uint8_t                    *buffer;
+    uint8_t                    *buffer_end;
+    ngx_uint_t                  push_ptr;
+    ngx_uint_t                  pop_ptr;
+    ngx_uint_t                  rising_occupancy;
+    uint64_t                    subscribers;  /* workers with consumers */
+    ngx_wa_shm_queue_ring_t    *ring;  /* mode=lockfree */
 } ngx_wa_shm_queue_t;
 
 
@@ -125,14 +155,191 @@ check_queue_invariance(ngx_wa_shm_queue_t *queue)
 }
 
 
+static ngx_inline ngx_wa_shm_queue_slot_t *
+ring_slot(ngx_wa_shm_queue_ring_t *ring, ngx_atomic_uint_t pos)
+{
+    return (ngx_wa_shm_queue_slot_t *)
+           (ring->slots + (pos & ring->mask) * ring->stride);
+}
+
+
+static ngx_int_t
+ring_init(ngx_wa_shm_t *shm, ngx_wa_shm_queue_t *queue, size_t available)
+{
+    size_t                    stride;
+    ngx_uint_t                i, nslots;
+    ngx_wa_shm_queue_slot_t  *slot;
+    ngx_wa_shm_queue_ring_t  *ring;
+
+    stride = ngx_align(offsetof(ngx_wa_shm_queue_slot_t, data)
+                       + shm->slot_size, sizeof(ngx_atomic_t));
+
+    if (available < 2 * stride) {
+        ngx_log_error(NGX_LOG_EMERG, shm->log, 0,
+                      "wasm \"%V\" shm queue: zone too small for "
+                      "slot_size %uz", &shm->name, shm->slot_size);
+        return NGX_ERROR;
+    }
+
+    /* power of two for position masking */
+
+    nslots = 2;
+
+    while (nslots * 2 * stride <= available) {
+        nslots *= 2;
+    }
+
+    /* allocated along with the queue structure */
+    ring = (ngx_wa_shm_queue_ring_t *) (queue + 1);
+
+    ring->slots = ngx_slab_alloc(shm->shpool, nslots * stride);
+    if (ring->slots == NULL) {
+        dd("failed allocating queue slots");
+        return NGX_ERROR;
+    }
+
+    ring->mask = nslots - 1;
+    ring->slot_size = shm->slot_size;
+    ring->stride = stride;
+
+    for (i = 0; i < nslots; i++) {
+        slot = ring_slot(ring, i);
+        slot->seq = i;
+        slot->len = 0;
+    }
+
+    queue->ring = ring;
+
+    ngx_log_debug3(NGX_LOG_DEBUG_WASM, shm->log, 0,
+                   "wasm \"%V\" shm queue: initialized lockfree ring "
+                   "(%ui slots of %uz bytes)",
+                   &shm->name, nslots, shm->slot_size);
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ring_push(ngx_wa_shm_queue_t *queue, u_char *data, uint32_t len)
+{
+    ngx_atomic_int_t          dif;
+    ngx_atomic_uint_t         pos;
+    ngx_wa_shm_queue_slot_t  *slot;
+    ngx_wa_shm_queue_ring_t  *ring = queue->ring;
+
+    if (len > ring->slot_size) {
+        return NGX_DECLINED;
+    }
+
+    for ( ;; ) {
+        pos = ring->enqueue_pos;
+        slot = ring_slot(ring, pos);
+        dif = (ngx_atomic_int_t) (slot->seq - pos);
+
+        if (dif == 0) {
+            if (ngx_atomic_cmp_set(&ring->enqueue_pos, pos, pos + 1)) {
+                break;
+            }
+
+        } else if (dif < 0) {
+            /* slot not yet released by its consumer: full */
+            return NGX_ABORT;
+        }
+
+        /* claimed by another producer, retry */
+    }
+
+    slot->len = len;
+    ngx_memcpy(slot->data, data, len);
+
+    /* publish */
+
+    ngx_memory_barrier();
+    slot->seq = pos + 1;
+
+    if (ring->dequeue_pos == pos && queue->subscribers) {
+        /* consumers are only woken up when the queue stops being empty */
+        ngx_wa_shm_notify(queue->subscribers);
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ring_claim(ngx_wa_shm_queue_ring_t *ring, size_t max_len,
+    ngx_atomic_uint_t *pos_out, ngx_wa_shm_queue_slot_t **slot_out)
+{
+    ngx_atomic_int_t          dif;
+    ngx_atomic_uint_t         pos;
+    ngx_wa_shm_queue_slot_t  *slot;
+
+    for ( ;; ) {
+        pos = ring->dequeue_pos;
+        slot = ring_slot(ring, pos);
+        dif = (ngx_atomic_int_t) (slot->seq - (pos + 1));
+
+        if (dif == 0) {
+            ngx_memory_barrier();
+
+            /* len is stable until the slot is released */
+
+            if (slot->len > max_len) {
+                return NGX_DECLINED;
+            }
+
+            if (ngx_atomic_cmp_set(&ring->dequeue_pos, pos, pos + 1)) {
+                break;
+            }
+
+        } else if (dif < 0) {
+            /* empty */
+            return NGX_AGAIN;
+        }
+
+        /* claimed by another consumer, retry */
+    }
+
+    *pos_out = pos;
+    *slot_out = slot;
+
+    return NGX_OK;
+}
+
+
+static ngx_inline void
+ring_release(ngx_wa_shm_queue_ring_t *ring, ngx_wa_shm_queue_slot_t *slot,
+    ngx_atomic_uint_t pos)
+{
+    ngx_memory_barrier();
+    slot->seq = pos + ring->mask + 1;
+}
+
+
+static ngx_inline ngx_uint_t
+ring_empty(ngx_wa_shm_queue_ring_t *ring)
+{
+    ngx_atomic_uint_t  pos = ring->dequeue_pos;
+
+    return ring_slot(ring, pos)->seq != pos + 1;
+}
+
+
 ngx_int_t
 ngx_wa_shm_queue_init(ngx_wa_shm_t *shm)
 {
+    size_t               size;
     ngx_uint_t           buffer_size;
     ngx_uint_t           reserved_size = ngx_pagesize;
     ngx_wa_shm_queue_t  *queue;
 
-    queue = ngx_slab_calloc(shm->shpool, sizeof(ngx_wa_shm_queue_t));
+    size = sizeof(ngx_wa_shm_queue_t);
+
+    if (shm->lockfree) {
+        size += sizeof(ngx_wa_shm_queue_ring_t);
+    }
+
+    queue = ngx_slab_calloc(shm->shpool, size);
     if (queue == NULL) {
         dd("failed allocating queue structure");
         return NGX_ERROR;
@@ -142,6 +349,16 @@ ngx_wa_shm_queue_init(ngx_wa_shm_t *shm)
     ngx_wa_assert(buffer_size > reserved_size);
     buffer_size -= reserved_size;
 
+    if (shm->lockfree) {
+        if (ring_init(shm, queue, buffer_size) != NGX_OK) {
+            return NGX_ERROR;
+        }
+
+        shm->data = queue;
+
+        return NGX_OK;
+    }
+
     queue->buffer = ngx_slab_calloc(shm->shpool, buffer_size);
     if (queue->buffer == NULL) {
         dd("failed allocating queue buffer");
@@ -166,6 +383,7 @@ ngx_wa_shm_queue_push_locked(ngx_wa_shm_t *shm, ngx_str_t *data)
 {
     uint32_t             len = (uint32_t) data->len;
     ngx_uint_t           entry_size = sizeof(uint32_t) + data->len;
+    ngx_uint_t           empty;
     ngx_wa_shm_queue_t  *queue = ngx_wa_shm_get_queue(shm);
 
     /* queue full? */
@@ -174,6 +392,8 @@ ngx_wa_shm_queue_push_locked(ngx_wa_shm_t *shm, ngx_str_t *data)
         return NGX_ABORT;
     }
 
+    empty = queue_occupancy(queue) == 0;
+
     dd("pre-push ptr: %lu, len: %u", queue->push_ptr, len);
 
     circular_write(shm->log, queue, queue->push_ptr, &len, sizeof(uint32_t));
@@ -186,6 +406,11 @@ ngx_wa_shm_queue_push_locked(ngx_wa_shm_t *shm, ngx_str_t *data)
 
     check_queue_invariance(queue);
 
+    if (empty && queue->subscribers) {
+        /* consumers are only woken up when the queue stops being empty */
+        ngx_wa_shm_notify(queue->subscribers);
+    }
+
     return NGX_OK;
 }
 
@@ -233,6 +458,357 @@ ngx_wa_shm_queue_pop_locked(ngx_wa_shm_t *shm, ngx_str_t *data_out,
 }
 
 
+ngx_int_t
+ngx_wa_shm_queue_push_batch_locked(ngx_wa_shm_t *shm, ngx_str_t *items,
+    ngx_uint_t *n_out)
+{
+    size_t               off = 0;
+    uint32_t             len;
+    ngx_uint_t           n = 0, empty;
+    ngx_wa_shm_queue_t  *queue = ngx_wa_shm_get_queue(shm);
+
+    /**
+     * Items are framed as stored: each a uint32 length followed by its
+     * data, so the whole batch is validated and written at once.
+     */
+
+    while (off < items->len) {
+        if (items->len - off < sizeof(uint32_t)) {
+            return NGX_DECLINED;
+        }
+
+        ngx_memcpy(&len, items->data + off, sizeof(uint32_t));
+        off += sizeof(uint32_t);
+
+        if (len > items->len - off) {
+            return NGX_DECLINED;
+        }
+
+        off += len;
+        n++;
+    }
+
+    if (n == 0) {
+        *n_out = 0;
+        return NGX_OK;
+    }
+
+    /* queue full? all or nothing */
+
+    if (queue_occupancy(queue) + items->len > queue_capacity(queue)) {
+        return NGX_ABORT;
+    }
+
+    empty = queue_occupancy(queue) == 0;
+
+    circular_write(shm->log, queue, queue->push_ptr, items->data, items->len);
+    inc_ptr(queue, &queue->push_ptr, items->len);
+    queue->rising_occupancy = 1;
+
+    check_queue_invariance(queue);
+
+    if (empty && queue->subscribers) {
+        ngx_wa_shm_notify(queue->subscribers);
+    }
+
+    *n_out = n;
+
+    return NGX_OK;
+}
+
+
+ngx_int_t
+ngx_wa_shm_queue_pop_batch_locked(ngx_wa_shm_t *shm, ngx_uint_t max_items,
+    size_t max_size, ngx_str_t *data_out, ngx_uint_t *n_out,
+    ngx_wa_shm_queue_alloc_pt alloc, void *alloc_ctx)
+{
+    size_t               size = 0, occupancy;
+    uint32_t             len;
+    ngx_uint_t           n = 0, ptr;
+    void                *buf;
+    ngx_wa_shm_queue_t  *queue = ngx_wa_shm_get_queue(shm);
+
+    occupancy = queue_occupancy(queue);
+
+    /* queue empty? */
+
+    if (occupancy < sizeof(uint32_t)) {
+        return NGX_AGAIN;
+    }
+
+    /* count items fitting the limits, the first one always does */
+
+    ptr = queue->pop_ptr;
+
+    while (size < occupancy && (max_items == 0 || n < max_items)) {
+        circular_read(shm->log, queue, ptr, &len, sizeof(uint32_t));
+
+        if (n && max_size && size + sizeof(uint32_t) + len > max_size) {
+            break;
+        }
+
+        size += sizeof(uint32_t) + len;
+        inc_ptr(queue, &ptr, sizeof(uint32_t) + len);
+        n++;
+    }
+
+    ngx_wa_assert(size <= occupancy);
+
+    buf = alloc(size, alloc_ctx);
+    if (buf == NULL) {
+        return NGX_ERROR;
+    }
+
+    /* items are returned with their framing: a single copy */
+
+    circular_read(shm->log, queue, queue->pop_ptr, buf, size);
+    inc_ptr(queue, &queue->pop_ptr, size);
+
+    queue->rising_occupancy = 0;
+
+    data_out->data = buf;
+    data_out->len = size;
+    *n_out = n;
+
+    check_queue_invariance(queue);
+
+    return NGX_OK;
+}
+
+
+ngx_int_t
+ngx_wa_shm_queue_push(ngx_wa_shm_t *shm, ngx_str_t *data)
+{
+    ngx_int_t            rc;
+    ngx_wa_shm_queue_t  *queue = ngx_wa_shm_get_queue(shm);
+
+    if (queue->ring) {
+        return ring_push(queue, data->data, (uint32_t) data->len);
+    }
+
+    ngx_wa_shm_lock(shm);
+    rc = ngx_wa_shm_queue_push_locked(shm, data);
+    ngx_wa_shm_unlock(shm);
+
+    return rc;
+}
+
+
+ngx_int_t
+ngx_wa_shm_queue_pop(ngx_wa_shm_t *shm, ngx_str_t *data_out,
+    ngx_wa_shm_queue_alloc_pt alloc, void *alloc_ctx)
+{
+    uint32_t                  len;
+    ngx_int_t                 rc;
+    ngx_atomic_uint_t         pos;
+    void                     *buf = NULL;
+    ngx_wa_shm_queue_slot_t  *slot;
+    ngx_wa_shm_queue_t       *queue = ngx_wa_shm_get_queue(shm);
+
+    if (queue->ring == NULL) {
+        ngx_wa_shm_lock(shm);
+        rc = ngx_wa_shm_queue_pop_locked(shm, data_out, alloc, alloc_ctx);
+        ngx_wa_shm_unlock(shm);
+
+        return rc;
+    }
+
+    rc = ring_claim(queue->ring, NGX_MAX_SIZE_T_VALUE, &pos, &slot);
+    if (rc != NGX_OK) {
+        return rc;
+    }
+
+    len = slot->len;
+
+    if (len) {
+        /* a claimed slot cannot be given back: dropped on failure */
+        buf = alloc(len, alloc_ctx);
+        if (buf == NULL) {
+            ring_release(queue->ring, slot, pos);
+
+            ngx_log_error(NGX_LOG_ERR, shm->log, 0,
+                          "wasm \"%V\" shm queue: item dropped "
+                          "(allocation failed)", &shm->name);
+            return NGX_ERROR;
+        }
+
+        ngx_memcpy(buf, slot->data, len);
+    }
+
+    ring_release(queue->ring, slot, pos);
+
+    data_out->data = buf;
+    data_out->len = len;
+
+    return NGX_OK;
+}
+
+
+ngx_int_t
+ngx_wa_shm_queue_push_batch(ngx_wa_shm_t *shm, ngx_str_t *items,
+    ngx_uint_t *n_out)
+{
+    size_t               off = 0;
+    uint32_t             len;
+    ngx_int_t            rc;
+    ngx_uint_t           n = 0;
+    ngx_wa_shm_queue_t  *queue = ngx_wa_shm_get_queue(shm);
+
+    if (queue->ring == NULL) {
+        ngx_wa_shm_lock(shm);
+        rc = ngx_wa_shm_queue_push_batch_locked(shm, items, n_out);
+        ngx_wa_shm_unlock(shm);
+
+        return rc;
+    }
+
+    /* validate framing and slot sizes before pushing anything */
+
+    while (off < items->len) {
+        if (items->len - off < sizeof(uint32_t)) {
+            return NGX_DECLINED;
+        }
+
+        ngx_memcpy(&len, items->data + off, sizeof(uint32_t));
+        off += sizeof(uint32_t);
+
+        if (len > items->len - off || len > queue->ring->slot_size) {
+            return NGX_DECLINED;
+        }
+
+        off += len;
+    }
+
+    /* items are pushed one by one: not all or nothing */
+
+    off = 0;
+
+    while (off < items->len) {
+        ngx_memcpy(&len, items->data + off, sizeof(uint32_t));
+        off += sizeof(uint32_t);
+
+        rc = ring_push(queue, items->data + off, len);
+        if (rc != NGX_OK) {
+            *n_out = n;
+            return rc;
+        }
+
+        off += len;
+        n++;
+    }
+
+    *n_out = n;
+
+    return NGX_OK;
+}
+
+
+ngx_int_t
+ngx_wa_shm_queue_pop_batch(ngx_wa_shm_t *shm, ngx_uint_t max_items,
+    size_t max_size, ngx_str_t *data_out, ngx_uint_t *n_out,
+    ngx_wa_shm_queue_alloc_pt alloc, void *alloc_ctx)
+{
+    size_t                    size = 0, cap = 0, max_len;
+    uint32_t                  len;
+    ngx_int_t                 rc;
+    ngx_uint_t                n = 0;
+    ngx_atomic_uint_t         pos;
+    u_char                   *tmp = NULL, *p;
+    void                     *buf;
+    ngx_wa_shm_queue_slot_t  *slot;
+    ngx_wa_shm_queue_ring_t  *ring;
+    ngx_wa_shm_queue_t       *queue = ngx_wa_shm_get_queue(shm);
+
+    if (queue->ring == NULL) {
+        ngx_wa_shm_lock(shm);
+        rc = ngx_wa_shm_queue_pop_batch_locked(shm, max_items, max_size,
+                                               data_out, n_out, alloc,
+                                               alloc_ctx);
+        ngx_wa_shm_unlock(shm);
+
+        return rc;
+    }
+
+    ring = queue->ring;
+
+    /**
+     * Items are claimed one by one into a scratch buffer, then copied
+     * with their framing in a single guest allocation.
+     */
+
+    while (max_items == 0 || n < max_items) {
+        max_len = NGX_MAX_SIZE_T_VALUE;
+
+        if (n && max_size) {
+            if (size + sizeof(uint32_t) >= max_size) {
+                break;
+            }
+
+            max_len = max_size - size - sizeof(uint32_t);
+        }
+
+        rc = ring_claim(ring, max_len, &pos, &slot);
+        if (rc != NGX_OK) {
+            /* empty, or the next item does not fit */
+            break;
+        }
+
+        len = slot->len;
+
+        if (size + sizeof(uint32_t) + len > cap) {
+            cap = ngx_max(cap * 2, size + sizeof(uint32_t) + ring->stride);
+
+            p = ngx_alloc(cap, shm->log);
+            if (p == NULL) {
+                ring_release(ring, slot, pos);
+
+                if (tmp) {
+                    ngx_free(tmp);
+                }
+
+                return NGX_ERROR;
+            }
+
+            if (tmp) {
+                ngx_memcpy(p, tmp, size);
+                ngx_free(tmp);
+            }
+
+            tmp = p;
+        }
+
+        ngx_memcpy(tmp + size, &len, sizeof(uint32_t));
+        ngx_memcpy(tmp + size + sizeof(uint32_t), slot->data, len);
+        size += sizeof(uint32_t) + len;
+        n++;
+
+        ring_release(ring, slot, pos);
+    }
+
+    if (n == 0) {
+        return NGX_AGAIN;
+    }
+
+    buf = alloc(size, alloc_ctx);
+    if (buf == NULL) {
+        ngx_log_error(NGX_LOG_ERR, shm->log, 0,
+                      "wasm \"%V\" shm queue: %ui items dropped "
+                      "(allocation failed)", &shm->name, n);
+        ngx_free(tmp);
+        return NGX_ERROR;
+    }
+
+    ngx_memcpy(buf, tmp, size);
+    ngx_free(tmp);
+
+    data_out->data = buf;
+    data_out->len = size;
+    *n_out = n;
+
+    return NGX_OK;
+}
+
+
 ngx_int_t
 ngx_wa_shm_queue_resolve(ngx_log_t *log, uint32_t token, ngx_shm_zone_t **out)
 {
@@ -262,3 +838,211 @@ ngx_wa_shm_queue_resolve(ngx_log_t *log, uint32_t token, ngx_shm_zone_t **out)
 
     return NGX_OK;
 }
+
+
+ngx_int_t
+ngx_wa_shm_queue_subscribe(uint32_t token, ngx_wa_shm_queue_ready_pt handler,
+    void *data)
+{
+    size_t                          i;
+    ngx_wa_shm_t                   *shm;
+    ngx_wa_conf_t                  *wacf;
+    ngx_shm_zone_t                 *zone;
+    ngx_wa_shm_queue_t             *queue;
+    ngx_wa_shm_notify_t            *notify;
+    ngx_wa_shm_queue_subscriber_t  *sub;
+    ngx_cycle_t                    *cycle = (ngx_cycle_t *) ngx_cycle;
+
+    wacf = ngx_wa_cycle_get_conf(cycle);
+    notify = &wacf->notify;
+
+    if ((ngx_process != NGX_PROCESS_WORKER
+         && ngx_process != NGX_PROCESS_SINGLE)
+        || ngx_worker >= notify->nchannels)
+    {
+        /* no notification channel for this process */
+        return NGX_DECLINED;
+    }
+
+    if (ngx_wa_shm_queue_resolve(cycle->log, token, &zone) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    if (notify->subscribers.elts == NULL) {
+        if (ngx_array_init(&notify->subscribers, cycle->pool, 2,
+                           sizeof(ngx_wa_shm_queue_subscriber_t))
+            != NGX_OK)
+        {
+            return NGX_ERROR;
+        }
+    }
+
+    sub = notify->subscribers.elts;
+
+    for (i = 0; i < notify->subscribers.nelts; i++) {
+        if (sub[i].token == token && sub[i].data == data) {
+            return NGX_OK;
+        }
+    }
+
+    sub = ngx_array_push(&notify->subscribers);
+    if (sub == NULL) {
+        return NGX_ERROR;
+    }
+
+    sub->token = token;
+    sub->handler = handler;
+    sub->data = data;
+
+    shm = zone->data;
+    queue = ngx_wa_shm_get_queue(shm);
+
+    ngx_wa_shm_lock(shm);
+    queue->subscribers |= (uint64_t) 1 << ngx_worker;
+    ngx_wa_shm_unlock(shm);
+
+    ngx_log_debug2(NGX_LOG_DEBUG_WASM, cycle->log, 0,
+                   "wasm \"%V\" shm queue: subscribed in worker %ui",
+                   &shm->name, ngx_worker);
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_wa_shm_queue_clear_subscriber(ngx_cycle_t *cycle, uint32_t token)
+{
+    ngx_wa_shm_t        *shm;
+    ngx_shm_zone_t      *zone;
+    ngx_wa_shm_queue_t  *queue;
+
+    if (ngx_wa_shm_queue_resolve(cycle->log, token, &zone) != NGX_OK) {
+        return;
+    }
+
+    shm = zone->data;
+    queue = ngx_wa_shm_get_queue(shm);
+
+    ngx_wa_shm_lock(shm);
+    queue->subscribers &= ~((uint64_t) 1 << ngx_worker);
+    ngx_wa_shm_unlock(shm);
+
+    ngx_log_debug2(NGX_LOG_DEBUG_WASM, cycle->log, 0,
+                   "wasm \"%V\" shm queue: unsubscribed in worker %ui",
+                   &shm->name, ngx_worker);
+}
+
+
+void
+ngx_wa_shm_queue_unsubscribe(void *data)
+{
+    size_t                          i, j;
+    uint32_t                        token;
+    ngx_wa_conf_t                  *wacf;
+    ngx_wa_shm_notify_t            *notify;
+    ngx_wa_shm_queue_subscriber_t  *sub;
+    ngx_cycle_t                    *cycle = (ngx_cycle_t *) ngx_cycle;
+
+    wacf = ngx_wa_cycle_get_conf(cycle);
+    if (wacf == NULL) {
+        return;
+    }
+
+    notify = &wacf->notify;
+    sub = notify->subscribers.elts;
+
+    i = 0;
+
+    while (i < notify->subscribers.nelts) {
+        if (sub[i].data != data) {
+            i++;
+            continue;
+        }
+
+        token = sub[i].token;
+
+        sub[i] = sub[--notify->subscribers.nelts];
+
+        for (j = 0; j < notify->subscribers.nelts; j++) {
+            if (sub[j].token == token) {
+                break;
+            }
+        }
+
+        if (j == notify->subscribers.nelts) {
+            /* last consumer of this queue in the worker */
+            ngx_wa_shm_queue_clear_subscriber(cycle, token);
+        }
+    }
+}
+
+
+void
+ngx_wa_shm_queue_exit_process(ngx_cycle_t *cycle)
+{
+    size_t                          i;
+    ngx_wa_conf_t                  *wacf;
+    ngx_wa_shm_notify_t            *notify;
+    ngx_wa_shm_queue_subscriber_t  *sub;
+
+    wacf = ngx_wa_cycle_get_conf(cycle);
+    notify = &wacf->notify;
+    sub = notify->subscribers.elts;
+
+    /* the next process in this slot subscribes on its own */
+
+    for (i = 0; i < notify->subscribers.nelts; i++) {
+        ngx_wa_shm_queue_clear_subscriber(cycle, sub[i].token);
+    }
+
+    notify->subscribers.nelts = 0;
+}
+
+
+void
+ngx_wa_shm_queue_notify_ready(ngx_cycle_t *cycle)
+{
+    size_t                          i;
+    ngx_uint_t                      empty;
+    ngx_wa_shm_t                   *shm;
+    ngx_wa_conf_t                  *wacf;
+    ngx_shm_zone_t                 *zone;
+    ngx_wa_shm_queue_t             *queue;
+    ngx_wa_shm_notify_t            *notify;
+    ngx_wa_shm_queue_subscriber_t  *sub;
+
+    wacf = ngx_wa_cycle_get_conf(cycle);
+    notify = &wacf->notify;
+
+    /* handlers may subscribe: elts can be reallocated */
+
+    for (i = 0; i < notify->subscribers.nelts; i++) {
+        sub = &((ngx_wa_shm_queue_subscriber_t *)
+                notify->subscribers.elts)[i];
+
+        if (ngx_wa_shm_queue_resolve(cycle->log, sub->token, &zone)
+            != NGX_OK)
+        {
+            continue;
+        }
+
+        shm = zone->data;
+        queue = ngx_wa_shm_get_queue(shm);
+
+        if (queue->ring) {
+            empty = ring_empty(queue->ring);
+
+        } else {
+            ngx_wa_shm_lock(shm);
+            empty = queue_occupancy(queue) == 0;
+            ngx_wa_shm_unlock(shm);
+        }
+
+        if (empty) {
+            /* already drained by another consumer */
+            continue;
+        }
+
+        sub->handler(sub->token, sub->data);
+    }
+}
@@ -6,14 +6,40 @@
 
 
 typedef void *(*ngx_wa_shm_queue_alloc_pt)(size_t size, void *alloc_ctx);
+typedef void (*ngx_wa_shm_queue_ready_pt)(uint32_t token, void *data);
+
+
+typedef struct {
+    uint32_t                      token;
+    ngx_wa_shm_queue_ready_pt     handler;
+    void                         *data;
+} ngx_wa_shm_queue_subscriber_t;
 
 
 ngx_int_t ngx_wa_shm_queue_init(ngx_wa_shm_t *shm);
 ngx_int_t ngx_wa_shm_queue_push_locked(ngx_wa_shm_t *shm, ngx_str_t *data);
 ngx_int_t ngx_wa_shm_queue_pop_locked(ngx_wa_shm_t *shm,
     ngx_str_t *data_out, ngx_wa_shm_queue_alloc_pt alloc, void *alloc_ctx);
+ngx_int_t ngx_wa_shm_queue_push_batch_locked(ngx_wa_shm_t *shm,
+    ngx_str_t *items, ngx_uint_t *n_out);
+ngx_int_t ngx_wa_shm_queue_pop_batch_locked(ngx_wa_shm_t *shm,
+    ngx_uint_t max_items, size_t max_size, ngx_str_t *data_out,
+    ngx_uint_t *n_out, ngx_wa_shm_queue_alloc_pt alloc, void *alloc_ctx);
+ngx_int_t ngx_wa_shm_queue_push(ngx_wa_shm_t *shm, ngx_str_t *data);
+ngx_int_t ngx_wa_shm_queue_pop(ngx_wa_shm_t *shm, ngx_str_t *data_out,
+    ngx_wa_shm_queue_alloc_pt alloc, void *alloc_ctx);
+ngx_int_t ngx_wa_shm_queue_push_batch(ngx_wa_shm_t *shm, ngx_str_t *items,
+    ngx_uint_t *n_out);
+ngx_int_t ngx_wa_shm_queue_pop_batch(ngx_wa_shm_t *shm, ngx_uint_t max_items,
+    size_t max_size, ngx_str_t *data_out, ngx_uint_t *n_out,
+    ngx_wa_shm_queue_alloc_pt alloc, void *alloc_ctx);
 ngx_int_t ngx_wa_shm_queue_resolve(ngx_log_t *log, uint32_t token,
     ngx_shm_zone_t **out);
+ngx_int_t ngx_wa_shm_queue_subscribe(uint32_t token,
+    ngx_wa_shm_queue_ready_pt handler, void *data);
+void ngx_wa_shm_queue_unsubscribe(void *data);
+void ngx_wa_shm_queue_exit_process(ngx_cycle_t *cycle);
+void ngx_wa_shm_queue_notify_ready(ngx_cycle_t *cycle);
 
 
 #endif /* _NGX_WA_SHM_QUEUE_H_INCLUDED_ */
@@ -36,6 +36,11 @@ struct ngx_http_wasm_req_ctx_s {
     ngx_chain_t                       *busy_bufs;
 
     ngx_http_handler_pt                r_content_handler;
+    ngx_http_wasm_headers_index_t      req_headers_index;
+    ngx_http_wasm_headers_index_t      resp_headers_index;
+    /* bumped on headers changes */
+    ngx_uint_t                         req_headers_gen;
+    ngx_uint_t                         resp_headers_gen;
     ngx_array_t                        resp_shim_headers;
     ngx_uint_t                         resp_bufs_count;         /* response buffers count */
     ngx_chain_t                       *resp_bufs;               /* response buffers */
@@ -134,8 +139,12 @@ char *ngx_http_wasm_proxy_wasm_directive(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
 char *ngx_http_wasm_proxy_wasm_isolation_directive(ngx_conf_t *cf,
     ngx_command_t *cmd, void *conf);
+char *ngx_http_wasm_proxy_wasm_instance_pool_directive(ngx_conf_t *cf,
+    ngx_command_t *cmd, void *conf);
 char *ngx_http_wasm_resolver_add_directive(ngx_conf_t *cf,
     ngx_command_t *cmd, void *conf);
+char *ngx_http_wasm_metrics_exporter_directive(ngx_conf_t *cf,
+    ngx_command_t *cmd, void *conf);
 
 
 /* shim headers */
@@ -176,6 +185,7 @@ void ngx_http_wasm_resume(ngx_http_wasm_req_ctx_t *rctx);
 extern ngx_wasm_subsystem_t  ngx_http_wasm_subsystem;
 extern ngx_wavm_host_def_t   ngx_http_wasm_host_interface;
 extern ngx_module_t          ngx_http_wasm_module;
+extern ngx_module_t          ngx_http_wasm_filter_module;
 
 static const ngx_buf_tag_t   buf_tag = &ngx_http_wasm_module;
 
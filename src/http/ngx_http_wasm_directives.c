@@ -185,6 +185,58 @@ ngx_http_wasm_proxy_wasm_isolation_directive(ngx_conf_t *cf, ngx_command_t *cmd,
 }
 
 
+char *
+ngx_http_wasm_proxy_wasm_instance_pool_directive(ngx_conf_t *cf,
+    ngx_command_t *cmd, void *conf)
+{
+    ngx_int_t                   min, max;
+    ngx_str_t                  *values;
+    ngx_http_wasm_main_conf_t  *mcf = conf;
+
+    if (mcf->vm == NULL) {
+        return NGX_WASM_CONF_ERR_NO_WASM;
+    }
+
+    if (mcf->pwroot.ipool_max) {
+        return NGX_WA_CONF_ERR_DUPLICATE;
+    }
+
+    /* args */
+
+    values = cf->args->elts;
+
+    min = ngx_atoi(values[1].data, values[1].len);
+    if (min == NGX_ERROR) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid instance pool min \"%V\"", &values[1]);
+        return NGX_CONF_ERROR;
+    }
+
+    max = min;
+
+    if (cf->args->nelts > 2) {
+        max = ngx_atoi(values[2].data, values[2].len);
+        if (max == NGX_ERROR || max == 0 || max < min) {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "invalid instance pool max \"%V\"",
+                               &values[2]);
+            return NGX_CONF_ERROR;
+        }
+    }
+
+    if (max == 0) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid instance pool min \"%V\"", &values[1]);
+        return NGX_CONF_ERROR;
+    }
+
+    mcf->pwroot.ipool_min = (ngx_uint_t) min;
+    mcf->pwroot.ipool_max = (ngx_uint_t) max;
+
+    return NGX_CONF_OK;
+}
+
+
 char *
 ngx_http_wasm_resolver_add_directive(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf)
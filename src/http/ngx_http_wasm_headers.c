@@ -45,6 +45,223 @@ ngx_http_wasm_htype_list(ngx_http_request_t *r,
 }
 
 
+#define NGX_HTTP_WASM_HEADERS_INDEX_BUCKETS  32
+
+
+static ngx_int_t
+ngx_http_wasm_headers_index_reset(ngx_http_wasm_headers_index_t *index,
+    ngx_list_t *list, ngx_uint_t nbuckets)
+{
+    size_t                       i;
+    ngx_http_wasm_header_ref_t  *ref, *next;
+
+    /* recycle refs */
+
+    for (i = 0; i < index->nbuckets; i++) {
+        for (ref = index->buckets[i]; ref; ref = next) {
+            next = ref->next;
+            ref->next = index->free;
+            index->free = ref;
+        }
+    }
+
+    if (nbuckets != index->nbuckets) {
+        if (index->buckets) {
+            ngx_pfree(list->pool, index->buckets);
+        }
+
+        index->buckets = ngx_palloc(list->pool,
+                                    2 * nbuckets
+                                    * sizeof(ngx_http_wasm_header_ref_t *));
+        if (index->buckets == NULL) {
+            index->nbuckets = 0;
+            index->list = NULL;
+            return NGX_ERROR;
+        }
+
+        index->tails = index->buckets + nbuckets;
+        index->nbuckets = nbuckets;
+    }
+
+    ngx_memzero(index->buckets,
+                2 * nbuckets * sizeof(ngx_http_wasm_header_ref_t *));
+
+    index->list = list;
+    index->elts = list->part.elts;
+    index->part = &list->part;
+    index->nelts = 0;
+    index->first_nelts = 0;
+    index->n = 0;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_wasm_headers_index_add(ngx_http_wasm_headers_index_t *index,
+    ngx_table_elt_t *h)
+{
+    ngx_uint_t                   b;
+    ngx_http_wasm_header_ref_t  *ref;
+
+    ref = index->free;
+
+    if (ref) {
+        index->free = ref->next;
+
+    } else {
+        ref = ngx_palloc(index->list->pool,
+                         sizeof(ngx_http_wasm_header_ref_t));
+        if (ref == NULL) {
+            return NGX_ERROR;
+        }
+    }
+
+    ref->h = h;
+    ref->hash = ngx_hash_key_lc(h->key.data, h->key.len);
+    ref->next = NULL;
+
+    /* append to preserve the list order */
+
+    b = ref->hash % index->nbuckets;
+
+    if (index->tails[b]) {
+        index->tails[b]->next = ref;
+
+    } else {
+        index->buckets[b] = ref;
+    }
+
+    index->tails[b] = ref;
+    index->n++;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_wasm_headers_index_sync(ngx_http_wasm_headers_index_t *index,
+    ngx_list_t *list)
+{
+    size_t            i;
+    ngx_uint_t        nbuckets;
+    ngx_table_elt_t  *h;
+
+    /**
+     * Elements of a ngx_list_t are never moved: headers are updated in
+     * place, removed by zeroing their hash, or appended. Only appended
+     * elements need indexing; a list re-initialized or truncated (e.g.
+     * ngx_http_clean_header) is re-indexed entirely.
+     */
+
+    nbuckets = index->nbuckets ? index->nbuckets
+                               : NGX_HTTP_WASM_HEADERS_INDEX_BUCKETS;
+
+    if (index->list != list
+        || index->elts != list->part.elts
+        || list->part.nelts < index->first_nelts
+        || (index->part->next == NULL && index->part != list->last)
+        || index->part->nelts < index->nelts)
+    {
+        if (ngx_http_wasm_headers_index_reset(index, list, nbuckets)
+            != NGX_OK)
+        {
+            return NGX_ERROR;
+        }
+    }
+
+    for ( ;; ) {
+        h = index->part->elts;
+
+        for (i = index->nelts; i < index->part->nelts; i++) {
+            if (ngx_http_wasm_headers_index_add(index, &h[i]) != NGX_OK) {
+                index->list = NULL;
+                return NGX_ERROR;
+            }
+        }
+
+        index->nelts = index->part->nelts;
+
+        if (index->part == &list->part) {
+            index->first_nelts = index->nelts;
+        }
+
+        if (index->part->next == NULL) {
+            break;
+        }
+
+        index->part = index->part->next;
+        index->nelts = 0;
+    }
+
+    if (index->n > 2 * index->nbuckets) {
+        /* grow */
+
+        if (ngx_http_wasm_headers_index_reset(index, list,
+                                              2 * index->nbuckets)
+            != NGX_OK)
+        {
+            return NGX_ERROR;
+        }
+
+        return ngx_http_wasm_headers_index_sync(index, list);
+    }
+
+    return NGX_OK;
+}
+
+
+ngx_http_wasm_headers_index_t *
+ngx_http_wasm_headers_index(ngx_http_request_t *r, ngx_list_t *list)
+{
+    ngx_http_wasm_req_ctx_t        *rctx;
+    ngx_http_wasm_headers_index_t  *index;
+
+    rctx = ngx_http_get_module_ctx(r, ngx_http_wasm_module);
+    if (rctx == NULL) {
+        return NULL;
+    }
+
+    if (list == &r->headers_in.headers) {
+        index = &rctx->req_headers_index;
+
+    } else if (list == &r->headers_out.headers) {
+        index = &rctx->resp_headers_index;
+
+    } else {
+        return NULL;
+    }
+
+    if (ngx_http_wasm_headers_index_sync(index, list) != NGX_OK) {
+        return NULL;
+    }
+
+    return index;
+}
+
+
+ngx_http_wasm_header_ref_t *
+ngx_http_wasm_headers_index_find(ngx_http_wasm_headers_index_t *index,
+    ngx_str_t *key, ngx_uint_t hash, ngx_http_wasm_header_ref_t *prev)
+{
+    ngx_http_wasm_header_ref_t  *ref;
+
+    ref = prev ? prev->next : index->buckets[hash % index->nbuckets];
+
+    for (/* void */; ref; ref = ref->next) {
+        if (ref->hash == hash
+            && ref->h->hash != 0
+            && ref->h->key.len == key->len
+            && ngx_strncasecmp(ref->h->key.data, key->data, key->len) == 0)
+        {
+            return ref;
+        }
+    }
+
+    return NULL;
+}
+
+
 ngx_int_t
 ngx_http_wasm_set_header(ngx_http_request_t *r,
     ngx_http_wasm_headers_type_e htype,
@@ -52,6 +269,7 @@ ngx_http_wasm_set_header(ngx_http_request_t *r,
     ngx_str_t *key, ngx_str_t *value, ngx_http_wasm_headers_set_mode_e mode)
 {
     size_t                           i;
+    ngx_http_wasm_req_ctx_t         *rctx;
     ngx_http_wasm_header_set_ctx_t   hv;
     static ngx_str_t                 null_str = ngx_null_string;
 
@@ -117,6 +335,17 @@ ngx_http_wasm_set_header(ngx_http_request_t *r,
     ngx_wa_assert(hv.list);
     ngx_wa_assert(hv.handler);
 
+    rctx = ngx_http_get_module_ctx(r, ngx_http_wasm_module);
+    if (rctx) {
+        /* outdates copies of the headers, e.g. marshalled maps */
+        if (htype == NGX_HTTP_WASM_HEADERS_REQUEST) {
+            rctx->req_headers_gen++;
+
+        } else {
+            rctx->resp_headers_gen++;
+        }
+    }
+
     return hv.handler->handler_(&hv);
 }
 
@@ -125,23 +354,66 @@ ngx_int_t
 ngx_http_wasm_set_header_helper(ngx_http_wasm_header_set_ctx_t *hv,
     ngx_table_elt_t **out)
 {
-    size_t            i;
-    ngx_table_elt_t  *h;
-    ngx_list_part_t  *part;
-    ngx_list_t       *list = hv->list;
-    ngx_str_t        *key = hv->key;
-    ngx_str_t        *value = hv->value;
-    unsigned          found = 0;
+    size_t                          i;
+    ngx_table_elt_t                *h;
+    ngx_list_part_t                *part;
+    ngx_list_t                     *list = hv->list;
+    ngx_str_t                      *key = hv->key;
+    ngx_str_t                      *value = hv->value;
+    unsigned                        found = 0;
+    ngx_http_wasm_header_ref_t     *ref;
+    ngx_http_wasm_headers_index_t  *index;
 
     if (hv->mode == NGX_HTTP_WASM_HEADERS_APPEND) {
         goto new_header;
     }
 
+    index = ngx_http_wasm_headers_index(hv->r, list);
+
 again:
 
     dd("searching '%.*s' (found: %u)",
        (int) key->len, key->data, found);
 
+    if (index) {
+        for (ref = ngx_http_wasm_headers_index_find(index, key, hv->hash, NULL);
+             ref;
+             ref = ngx_http_wasm_headers_index_find(index, key, hv->hash, ref))
+        {
+            h = ref->h;
+
+            if (h->hash != hv->hash) {
+                continue;
+            }
+
+            if (hv->mode == NGX_HTTP_WASM_HEADERS_REMOVE || found) {
+                h->hash = 0;
+
+                if (out) {
+                    *out = NULL;
+                }
+
+                found = 1;
+
+                goto again;
+            }
+
+            ngx_wa_assert(hv->mode == NGX_HTTP_WASM_HEADERS_SET);
+
+            h->key = *key;
+            h->value = *value;
+            h->hash = hv->hash;
+
+            if (out) {
+                *out = h;
+            }
+
+            found = 1;
+        }
+
+        goto new_header;
+    }
+
     part = &list->part;
     h = part->elts;
 
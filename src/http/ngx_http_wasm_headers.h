@@ -43,6 +43,29 @@ struct ngx_http_wasm_header_set_ctx_s {
 };
 
 
+typedef struct ngx_http_wasm_header_ref_s  ngx_http_wasm_header_ref_t;
+
+struct ngx_http_wasm_header_ref_s {
+    ngx_table_elt_t                         *h;
+    ngx_uint_t                               hash;       /* lowercase key */
+    ngx_http_wasm_header_ref_t              *next;
+};
+
+
+typedef struct {
+    ngx_list_t                              *list;
+    void                                    *elts;       /* list->part.elts */
+    ngx_list_part_t                         *part;       /* last indexed part */
+    ngx_uint_t                               nelts;      /* indexed in part */
+    ngx_uint_t                               first_nelts;
+    ngx_uint_t                               n;
+    ngx_uint_t                               nbuckets;
+    ngx_http_wasm_header_ref_t             **buckets;
+    ngx_http_wasm_header_ref_t             **tails;
+    ngx_http_wasm_header_ref_t              *free;
+} ngx_http_wasm_headers_index_t;
+
+
 size_t ngx_http_wasm_req_headers_count(ngx_http_request_t *r);
 size_t ngx_http_wasm_resp_headers_count(ngx_http_request_t *r);
 
@@ -57,6 +80,12 @@ ngx_int_t ngx_http_wasm_set_resp_header(ngx_http_request_t *r, ngx_str_t *key,
 ngx_int_t ngx_http_wasm_set_resp_content_length(ngx_http_request_t *r,
     off_t cl);
 
+ngx_http_wasm_headers_index_t *ngx_http_wasm_headers_index(
+    ngx_http_request_t *r, ngx_list_t *list);
+ngx_http_wasm_header_ref_t *ngx_http_wasm_headers_index_find(
+    ngx_http_wasm_headers_index_t *index, ngx_str_t *key, ngx_uint_t hash,
+    ngx_http_wasm_header_ref_t *prev);
+
 /* helpers */
 ngx_int_t ngx_http_wasm_set_header(ngx_http_request_t *r,
     ngx_http_wasm_headers_type_e htype,
@@ -0,0 +1,572 @@
+#ifndef DDEBUG
+#define DDEBUG 0
+#endif
+#include "ddebug.h"
+
+#include <ngx_http_wasm.h>
+#include <ngx_wa_metrics.h>
+
+
+#define NGX_HTTP_WASM_METRICS_PAGE       64
+#define NGX_HTTP_WASM_METRICS_BUF_SIZE   4096
+/* longest sample line besides its name and labels */
+#define NGX_HTTP_WASM_METRICS_LINE_LEN   (sizeof("_bucket{,le=\"\"} \n")    \
+                                          + 2 * NGX_INT64_LEN)
+/* key="value",... with escaped values */
+#define NGX_HTTP_WASM_METRICS_LABELS_LEN                                     \
+    (NGX_WA_METRICS_LABELS_MAX * (3 * NGX_WA_METRICS_LABEL_MAX_LEN + 4))
+
+
+typedef struct {
+    ngx_http_request_t          *r;
+    ngx_wa_metrics_t            *metrics;
+    ngx_rbtree_node_t           *cursor;
+    ngx_chain_t                 *out;
+    ngx_chain_t                **ll;
+    ngx_chain_t                 *free;
+    ngx_chain_t                 *busy;
+    ngx_buf_t                   *b;
+
+    unsigned                     families:1;  /* metrics done */
+    unsigned                     eof:1;
+} ngx_http_wasm_metrics_ctx_t;
+
+
+static ngx_int_t ngx_http_wasm_metrics_handler(ngx_http_request_t *r);
+
+
+static ngx_str_t  ngx_http_wasm_metrics_content_type =
+    ngx_string("application/openmetrics-text; version=1.0.0; charset=utf-8");
+
+
+/**
+ * OpenMetrics names match [a-zA-Z_:][a-zA-Z0-9_:]*, e.g. "pw.filter.name"
+ * is exported as "pw_filter_name".
+ */
+static u_char *
+ngx_http_wasm_metrics_name(u_char *p, ngx_str_t *name)
+{
+    size_t  i;
+    u_char  c;
+
+    for (i = 0; i < name->len; i++) {
+        c = name->data[i];
+
+        if ((c >= 'a' && c <= 'z')
+            || (c >= 'A' && c <= 'Z')
+            || c == '_' || c == ':'
+            || (i && c >= '0' && c <= '9'))
+        {
+            *p++ = c;
+            continue;
+        }
+
+        *p++ = '_';
+    }
+
+    return p;
+}
+
+
+static u_char *
+ngx_http_wasm_metrics_labels(u_char *p, ngx_wa_metrics_family_t *f,
+    ngx_str_t *values)
+{
+    size_t      j;
+    u_char      c;
+    ngx_uint_t  i;
+
+    for (i = 0; i < f->nlabels; i++) {
+        if (i) {
+            *p++ = ',';
+        }
+
+        p = ngx_http_wasm_metrics_name(p, &f->keys[i]);
+        *p++ = '=';
+        *p++ = '"';
+
+        for (j = 0; j < values[i].len; j++) {
+            c = values[i].data[j];
+
+            switch (c) {
+            case '\\':
+            case '"':
+                *p++ = '\\';
+                *p++ = c;
+                break;
+
+            case '\n':
+                *p++ = '\\';
+                *p++ = 'n';
+                break;
+
+            default:
+                *p++ = c;
+                break;
+            }
+        }
+
+        *p++ = '"';
+    }
+
+    return p;
+}
+
+
+static u_char *
+ngx_http_wasm_metrics_reserve(ngx_http_wasm_metrics_ctx_t *ctx, size_t len)
+{
+    ngx_buf_t    *b = ctx->b;
+    ngx_chain_t  *cl;
+
+    if (b == NULL || (size_t) (b->end - b->last) < len) {
+        cl = ngx_chain_get_free_buf(ctx->r->pool, &ctx->free);
+        if (cl == NULL) {
+            return NULL;
+        }
+
+        b = cl->buf;
+
+        if (b->start == NULL || (size_t) (b->end - b->start) < len) {
+            /* buffers sent to the client are reused */
+            b->start = ngx_palloc(ctx->r->pool,
+                                  ngx_max(len, NGX_HTTP_WASM_METRICS_BUF_SIZE));
+            if (b->start == NULL) {
+                return NULL;
+            }
+
+            b->end = b->start + ngx_max(len, NGX_HTTP_WASM_METRICS_BUF_SIZE);
+        }
+
+        b->pos = b->start;
+        b->last = b->start;
+        b->temporary = 1;
+        b->tag = (ngx_buf_tag_t) &ngx_http_wasm_metrics_handler;
+
+        *ctx->ll = cl;
+        ctx->ll = &cl->next;
+        ctx->b = b;
+    }
+
+    return b->last;
+}
+
+
+static ngx_int_t
+ngx_http_wasm_metrics_flush(ngx_http_wasm_metrics_ctx_t *ctx)
+{
+    ngx_int_t  rc;
+
+    if (ctx->out == NULL && ctx->busy == NULL) {
+        return NGX_OK;
+    }
+
+    rc = ngx_http_output_filter(ctx->r, ctx->out);
+
+    ngx_chain_update_chains(ctx->r->pool, &ctx->free, &ctx->busy, &ctx->out,
+                            (ngx_buf_tag_t) &ngx_http_wasm_metrics_handler);
+
+    ctx->ll = &ctx->out;
+    ctx->b = NULL;
+
+    return rc;
+}
+
+
+static ngx_int_t
+ngx_http_wasm_metrics_type(ngx_http_wasm_metrics_ctx_t *ctx, ngx_str_t *name,
+    ngx_wa_metric_type_e type)
+{
+    u_char  *p;
+
+    p = ngx_http_wasm_metrics_reserve(ctx, name->len
+                                           + sizeof("# TYPE  histogram\n"));
+    if (p == NULL) {
+        return NGX_ERROR;
+    }
+
+    p = ngx_cpymem(p, "# TYPE ", sizeof("# TYPE ") - 1);
+    p = ngx_http_wasm_metrics_name(p, name);
+    ctx->b->last = ngx_sprintf(p, " %V\n", ngx_wa_metric_type_name(type));
+
+    return NGX_OK;
+}
+
+
+/**
+ * Render the samples of a metric; labels are "key=\"value\",..." for
+ * series of a family, empty otherwise.
+ */
+static ngx_int_t
+ngx_http_wasm_metrics_samples(ngx_http_wasm_metrics_ctx_t *ctx,
+    ngx_str_t *name, ngx_str_t *labels, ngx_wa_metric_t *sm)
+{
+    size_t                       i, len, lines = 1;
+    u_char                      *p;
+    uint64_t                     count = 0;
+    ngx_wa_metric_t             *m;
+    ngx_wa_metrics_bin_t        *b;
+    ngx_wa_metrics_histogram_t  *h;
+    u_char                       m_buf[NGX_WA_METRICS_ONE_SLOT_SIZE];
+    u_char                       h_buf[NGX_WA_METRICS_HISTOGRAM_MAX_SIZE];
+
+    ngx_memzero(m_buf, sizeof(m_buf));
+    ngx_memzero(h_buf, sizeof(h_buf));
+
+    m = (ngx_wa_metric_t *) m_buf;
+    h = ngx_wa_metrics_histogram_set_buffer(m, h_buf, sizeof(h_buf));
+
+    if (ngx_wa_metrics_collect(ctx->metrics, sm, m) != NGX_OK) {
+        return NGX_OK;
+    }
+
+    if (m->type == NGX_WA_METRIC_HISTOGRAM) {
+        /* buckets, sum and count */
+        for (i = 0; i < h->n_bins; i++) {
+            lines++;
+
+            if (h->bins[i].upper_bound == NGX_MAX_UINT32_VALUE) {
+                break;
+            }
+        }
+
+        lines += 1;
+    }
+
+    len = lines * (name->len + labels->len + NGX_HTTP_WASM_METRICS_LINE_LEN);
+
+    p = ngx_http_wasm_metrics_reserve(ctx, len);
+    if (p == NULL) {
+        return NGX_ERROR;
+    }
+
+    switch (m->type) {
+    case NGX_WA_METRIC_COUNTER:
+        p = ngx_http_wasm_metrics_name(p, name);
+        p = ngx_cpymem(p, "_total", sizeof("_total") - 1);
+        p = labels->len ? ngx_sprintf(p, "{%V}", labels) : p;
+        p = ngx_sprintf(p, " %ui\n", ngx_wa_metrics_counter(m));
+        break;
+
+    case NGX_WA_METRIC_GAUGE:
+        p = ngx_http_wasm_metrics_name(p, name);
+        p = labels->len ? ngx_sprintf(p, "{%V}", labels) : p;
+        p = ngx_sprintf(p, " %ui\n", ngx_wa_metrics_gauge(m));
+        break;
+
+    case NGX_WA_METRIC_HISTOGRAM:
+        /* bins are sorted, the last one has no upper bound */
+        for (i = 0; i < h->n_bins; i++) {
+            b = &h->bins[i];
+            count += b->count;
+
+            p = ngx_http_wasm_metrics_name(p, name);
+            p = ngx_sprintf(p, "_bucket{%V%s", labels,
+                            labels->len ? "," : "");
+
+            if (b->upper_bound == NGX_MAX_UINT32_VALUE) {
+                p = ngx_sprintf(p, "le=\"+Inf\"} %uL\n", count);
+                break;
+            }
+
+            p = ngx_sprintf(p, "le=\"%uD\"} %uL\n", b->upper_bound, count);
+        }
+
+        p = ngx_http_wasm_metrics_name(p, name);
+        p = ngx_cpymem(p, "_sum", sizeof("_sum") - 1);
+        p = labels->len ? ngx_sprintf(p, "{%V}", labels) : p;
+        p = ngx_sprintf(p, " %uL\n", h->sum);
+        p = ngx_http_wasm_metrics_name(p, name);
+        p = ngx_cpymem(p, "_count", sizeof("_count") - 1);
+        p = labels->len ? ngx_sprintf(p, "{%V}", labels) : p;
+        p = ngx_sprintf(p, " %uL\n", count);
+        break;
+
+    default:
+        ngx_wa_assert(0);
+        break;
+    }
+
+    ctx->b->last = p;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_wasm_metrics_family(ngx_http_wasm_metrics_ctx_t *ctx,
+    ngx_wa_metrics_family_t *f)
+{
+    ngx_str_t              labels;
+    ngx_uint_t             i, n;
+    ngx_wa_shm_kv_node_t  *node;
+    ngx_str_t              values[NGX_WA_METRICS_LABELS_MAX];
+    u_char                 buf[NGX_HTTP_WASM_METRICS_LABELS_LEN];
+
+    if (ngx_http_wasm_metrics_type(ctx, &f->sn.str, f->type) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    /* series are appended to the family without a lock */
+    n = f->nseries;
+    ngx_memory_barrier();
+
+    for (i = 0; i <= n; i++) {
+        if (i == n) {
+            if (n < f->max_series) {
+                /* not overflowing */
+                break;
+            }
+
+            node = f->overflow;
+
+        } else {
+            node = f->series[i];
+        }
+
+        ngx_wa_metrics_series_labels(ctx->metrics, &node->key.str, values);
+
+        labels.data = buf;
+        labels.len = ngx_http_wasm_metrics_labels(buf, f, values) - buf;
+
+        if (ngx_http_wasm_metrics_samples(ctx, &f->sn.str, &labels,
+                                          (ngx_wa_metric_t *)
+                                          node->value.data)
+            != NGX_OK)
+        {
+            return NGX_ERROR;
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+/**
+ * Render the next page of metrics, then of labelled families, and
+ * finally the EOF marker.
+ */
+static ngx_int_t
+ngx_http_wasm_metrics_page(ngx_http_wasm_metrics_ctx_t *ctx)
+{
+    u_char                   *p;
+    ngx_uint_t                i, n;
+    ngx_str_t                 none = ngx_null_string;
+    ngx_wa_metrics_entry_t    entries[NGX_HTTP_WASM_METRICS_PAGE];
+    ngx_wa_metrics_family_t  *families[NGX_HTTP_WASM_METRICS_PAGE];
+
+    if (!ctx->families) {
+        if (ctx->metrics
+            && ngx_wa_metrics_iterate(ctx->metrics, &ctx->cursor, entries,
+                                      NGX_HTTP_WASM_METRICS_PAGE, &n)
+               == NGX_OK)
+        {
+            for (i = 0; i < n; i++) {
+                if (ngx_http_wasm_metrics_type(ctx, entries[i].name,
+                                               entries[i].m->type)
+                    != NGX_OK
+                    || ngx_http_wasm_metrics_samples(ctx, entries[i].name,
+                                                     &none, entries[i].m)
+                       != NGX_OK)
+                {
+                    return NGX_ERROR;
+                }
+            }
+
+            return NGX_OK;
+        }
+
+        ctx->families = 1;
+        ctx->cursor = NULL;
+    }
+
+    if (ctx->metrics
+        && ngx_wa_metrics_families_iterate(ctx->metrics, &ctx->cursor,
+                                           families,
+                                           NGX_HTTP_WASM_METRICS_PAGE, &n)
+           == NGX_OK)
+    {
+        for (i = 0; i < n; i++) {
+            if (ngx_http_wasm_metrics_family(ctx, families[i]) != NGX_OK) {
+                return NGX_ERROR;
+            }
+        }
+
+        return NGX_OK;
+    }
+
+    p = ngx_http_wasm_metrics_reserve(ctx, sizeof("# EOF\n") - 1);
+    if (p == NULL) {
+        return NGX_ERROR;
+    }
+
+    ctx->b->last = ngx_cpymem(p, "# EOF\n", sizeof("# EOF\n") - 1);
+    ctx->b->last_buf = (ctx->r == ctx->r->main) ? 1 : 0;
+    ctx->b->last_in_chain = 1;
+    ctx->eof = 1;
+
+    return NGX_OK;
+}
+
+
+/**
+ * Send pages until the EOF marker, or until the client does not keep up:
+ * pages are only rendered once the previous one has been written, so
+ * that a slow client does not buffer the whole exposition.
+ *
+ * NGX_AGAIN: resume on the next write event
+ */
+static ngx_int_t
+ngx_http_wasm_metrics_send(ngx_http_wasm_metrics_ctx_t *ctx)
+{
+    ngx_int_t  rc;
+
+    for ( ;; ) {
+        rc = ngx_http_wasm_metrics_flush(ctx);
+
+        if (rc == NGX_ERROR || ctx->eof) {
+            return rc;
+        }
+
+        if (ctx->busy) {
+            return NGX_AGAIN;
+        }
+
+        if (ngx_http_wasm_metrics_page(ctx) != NGX_OK) {
+            return NGX_ERROR;
+        }
+    }
+}
+
+
+static ngx_int_t
+ngx_http_wasm_metrics_wait(ngx_http_request_t *r)
+{
+    ngx_event_t               *wev = r->connection->write;
+    ngx_http_core_loc_conf_t  *clcf;
+
+    clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
+
+    if (!wev->delayed) {
+        ngx_add_timer(wev, clcf->send_timeout);
+    }
+
+    return ngx_handle_write_event(wev, clcf->send_lowat);
+}
+
+
+static void
+ngx_http_wasm_metrics_write_handler(ngx_http_request_t *r)
+{
+    ngx_int_t                     rc;
+    ngx_event_t                  *wev = r->connection->write;
+    ngx_http_wasm_metrics_ctx_t  *ctx;
+
+    ctx = ngx_http_get_module_ctx(r, ngx_http_wasm_filter_module);
+
+    if (wev->timedout) {
+        ngx_log_error(NGX_LOG_INFO, r->connection->log, NGX_ETIMEDOUT,
+                      "client timed out");
+        r->connection->timedout = 1;
+        ngx_http_finalize_request(r, NGX_HTTP_REQUEST_TIME_OUT);
+        return;
+    }
+
+    if (wev->delayed) {
+        /* limit_rate */
+        if (ngx_http_wasm_metrics_wait(r) != NGX_OK) {
+            ngx_http_finalize_request(r, NGX_ERROR);
+        }
+
+        return;
+    }
+
+    if (wev->timer_set) {
+        ngx_del_timer(wev);
+    }
+
+    rc = ngx_http_wasm_metrics_send(ctx);
+
+    if (rc == NGX_AGAIN && !ctx->eof) {
+        if (ngx_http_wasm_metrics_wait(r) != NGX_OK) {
+            ngx_http_finalize_request(r, NGX_ERROR);
+        }
+
+        return;
+    }
+
+    ngx_http_finalize_request(r, rc);
+}
+
+
+static ngx_int_t
+ngx_http_wasm_metrics_handler(ngx_http_request_t *r)
+{
+    ngx_int_t                     rc;
+    ngx_http_wasm_metrics_ctx_t  *ctx;
+
+    if (!(r->method & (NGX_HTTP_GET|NGX_HTTP_HEAD))) {
+        return NGX_HTTP_NOT_ALLOWED;
+    }
+
+    rc = ngx_http_discard_request_body(r);
+    if (rc != NGX_OK) {
+        return rc;
+    }
+
+    r->headers_out.status = NGX_HTTP_OK;
+    r->headers_out.content_type = ngx_http_wasm_metrics_content_type;
+    r->headers_out.content_type_len = ngx_http_wasm_metrics_content_type.len;
+    r->headers_out.content_type_lowcase = NULL;
+    ngx_http_clear_content_length(r);
+
+    rc = ngx_http_send_header(r);
+    if (rc == NGX_ERROR || rc > NGX_OK || r->header_only) {
+        return rc;
+    }
+
+    ctx = ngx_pcalloc(r->pool, sizeof(ngx_http_wasm_metrics_ctx_t));
+    if (ctx == NULL) {
+        return NGX_ERROR;
+    }
+
+    ctx->r = r;
+    ctx->metrics = ngx_wasmx_metrics((ngx_cycle_t *) ngx_cycle);
+    ctx->ll = &ctx->out;
+
+    /* ngx_http_wasm_module's ctx is the rctx of proxy_wasm filters */
+    ngx_http_set_ctx(r, ctx, ngx_http_wasm_filter_module);
+
+    rc = ngx_http_wasm_metrics_send(ctx);
+
+    if (rc == NGX_AGAIN && !ctx->eof) {
+        if (ngx_http_wasm_metrics_wait(r) != NGX_OK) {
+            return NGX_ERROR;
+        }
+
+        r->main->count++;
+        r->write_event_handler = ngx_http_wasm_metrics_write_handler;
+
+        return NGX_DONE;
+    }
+
+    return rc;
+}
+
+
+char *
+ngx_http_wasm_metrics_exporter_directive(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf)
+{
+    ngx_http_core_loc_conf_t  *clcf;
+
+    clcf = ngx_http_conf_get_module_loc_conf(cf, ngx_http_core_module);
+
+    if (clcf->handler) {
+        return "is duplicate";
+    }
+
+    clcf->handler = ngx_http_wasm_metrics_handler;
+
+    return NGX_CONF_OK;
+}
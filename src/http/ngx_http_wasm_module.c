@@ -186,6 +186,21 @@ static ngx_command_t  ngx_http_wasm_module_cmds[] = {
       NGX_HTTP_MODULE,
       NULL },
 
+    { ngx_string("proxy_wasm_instance_pool"),
+      NGX_HTTP_MAIN_CONF|NGX_CONF_TAKE12,
+      ngx_http_wasm_proxy_wasm_instance_pool_directive,
+      NGX_HTTP_MAIN_CONF_OFFSET,
+      0,
+      NULL },
+
+    { ngx_string("proxy_wasm_instance_snapshot"),
+      NGX_HTTP_MAIN_CONF|NGX_CONF_FLAG,
+      ngx_conf_set_flag_slot,
+      NGX_HTTP_MAIN_CONF_OFFSET,
+      offsetof(ngx_http_wasm_main_conf_t, pwroot)
+      + offsetof(ngx_proxy_wasm_filters_root_t, snapshot),
+      NULL },
+
     { ngx_string("resolver_add"),
       NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE2,
       ngx_http_wasm_resolver_add_directive,
@@ -221,6 +236,13 @@ static ngx_command_t  ngx_http_wasm_module_cmds[] = {
       offsetof(ngx_http_wasm_loc_conf_t, postpone_access),
       NULL },
 
+    { ngx_string("wasm_metrics_exporter"),
+      NGX_HTTP_LOC_CONF|NGX_CONF_NOARGS,
+      ngx_http_wasm_metrics_exporter_directive,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      0,
+      NULL },
+
       ngx_null_command
 };
 
@@ -291,6 +313,8 @@ ngx_http_wasm_create_main_conf(ngx_conf_t *cf)
     ngx_proxy_wasm_properties_init(cf);
     ngx_proxy_wasm_root_init(&mcf->pwroot, cf->pool);
 
+    mcf->pwroot.snapshot = NGX_CONF_UNSET;
+
 #if (NGX_WASM_DYNAMIC_MODULE)
     /**
      * Ensure ngx_lua rewrite/access handlers are executed before
@@ -312,6 +336,8 @@ ngx_http_wasm_init_main_conf(ngx_conf_t *cf, void *conf)
 {
     ngx_http_wasm_main_conf_t  *mcf = conf;
 
+    ngx_conf_init_value(mcf->pwroot.snapshot, 0);
+
     mcf->ops = ngx_wasm_ops_new(cf->pool, &cf->cycle->new_log, mcf->vm,
                                 &ngx_http_wasm_subsystem);
     if (mcf->ops == NULL) {
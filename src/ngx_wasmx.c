@@ -15,6 +15,7 @@ static char *ngx_ipc_block(ngx_conf_t *cf, ngx_command_t *cmd, void *conf);
 #endif
 static ngx_int_t ngx_wasmx_init(ngx_cycle_t *cycle);
 static ngx_int_t ngx_wasmx_init_process(ngx_cycle_t *cycle);
+static void ngx_wasmx_exit_process(ngx_cycle_t *cycle);
 
 
 ngx_uint_t             ngx_wasm_max_module = 0;
@@ -60,7 +61,7 @@ ngx_module_t  ngx_wasmx_module = {
     ngx_wasmx_init_process,            /* init process */
     NULL,                              /* init thread */
     NULL,                              /* exit thread */
-    NULL,                              /* exit process */
+    ngx_wasmx_exit_process,            /* exit process */
     NULL,                              /* exit master */
     NGX_MODULE_V1_PADDING
 };
@@ -327,6 +328,20 @@ ngx_wasmx_init_process(ngx_cycle_t *cycle)
 }
 
 
+static void
+ngx_wasmx_exit_process(ngx_cycle_t *cycle)
+{
+    ngx_wa_conf_t  *wacf;
+
+    wacf = ngx_wa_cycle_get_conf(cycle);
+    if (wacf == NULL) {
+        return;
+    }
+
+    ngx_wa_shm_exit_process(cycle);
+}
+
+
 ngx_inline ngx_array_t *
 ngx_wasmx_shms(ngx_cycle_t *cycle)
 {
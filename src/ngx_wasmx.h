@@ -22,6 +22,7 @@
 #define NGX_WA_CONF_ERR_DUPLICATE   "is duplicate"
 
 #define NGX_WA_METRICS_DEFAULT_MAX_NAME_LEN  256
+#define NGX_WA_METRICS_DEFAULT_MAX_SERIES    256
 #define NGX_WA_METRICS_DEFAULT_SLAB_SIZE     1024 * 1024 * 5   /* 5 MiB */
 
 
@@ -44,6 +45,7 @@ typedef struct {
     void                   **ipc_confs;
 #endif
     ngx_array_t              shms;     /* ngx_wa_shm_mapping_t */
+    ngx_wa_shm_notify_t      notify;
     ngx_wa_metrics_t        *metrics;
 } ngx_wa_conf_t;
 
@@ -149,6 +149,12 @@ char *ngx_wasm_core_metrics_slab_size_directive(ngx_conf_t *cf,
     ngx_command_t *cmd, void *conf);
 char *ngx_wasm_core_metrics_max_metric_name_length_directive(ngx_conf_t *cf,
     ngx_command_t *cmd, void *conf);
+char *ngx_wasm_core_metrics_max_metric_series_directive(ngx_conf_t *cf,
+    ngx_command_t *cmd, void *conf);
+char *ngx_wasm_core_metrics_histogram_precision_directive(ngx_conf_t *cf,
+    ngx_command_t *cmd, void *conf);
+char *ngx_wasm_core_metrics_slot_layout_directive(ngx_conf_t *cf,
+    ngx_command_t *cmd, void *conf);
 char *ngx_wasm_core_resolver_directive(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
 char *ngx_wasm_core_pwm_lua_resolver_directive(ngx_conf_t *cf,
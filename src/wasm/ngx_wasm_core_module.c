@@ -67,6 +67,54 @@ static ngx_command_t  ngx_wasm_core_commands[] = {
       + offsetof(ngx_wavm_conf_t, cache_config),
       NULL },
 
+    { ngx_string("pooling_allocator"),
+      NGX_WASMTIME_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_num_slot,
+      NGX_WA_WASM_CONF_OFFSET,
+      offsetof(ngx_wasm_core_conf_t, vm_conf)
+      + offsetof(ngx_wavm_conf_t, pooling_instances),
+      NULL },
+
+    { ngx_string("pooling_max_memory_size"),
+      NGX_WASMTIME_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_size_slot,
+      NGX_WA_WASM_CONF_OFFSET,
+      offsetof(ngx_wasm_core_conf_t, vm_conf)
+      + offsetof(ngx_wavm_conf_t, pooling_max_memory_size),
+      NULL },
+
+    { ngx_string("memory_reservation"),
+      NGX_WASMTIME_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_size_slot,
+      NGX_WA_WASM_CONF_OFFSET,
+      offsetof(ngx_wasm_core_conf_t, vm_conf)
+      + offsetof(ngx_wavm_conf_t, memory_reservation),
+      NULL },
+
+    { ngx_string("memory_guard_size"),
+      NGX_WASMTIME_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_size_slot,
+      NGX_WA_WASM_CONF_OFFSET,
+      offsetof(ngx_wasm_core_conf_t, vm_conf)
+      + offsetof(ngx_wavm_conf_t, memory_guard_size),
+      NULL },
+
+    { ngx_string("memory_init_cow"),
+      NGX_WASMTIME_CONF|NGX_CONF_FLAG,
+      ngx_conf_set_flag_slot,
+      NGX_WA_WASM_CONF_OFFSET,
+      offsetof(ngx_wasm_core_conf_t, vm_conf)
+      + offsetof(ngx_wavm_conf_t, memory_init_cow),
+      NULL },
+
+    { ngx_string("compiler_threads"),
+      NGX_WASMTIME_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_num_slot,
+      NGX_WA_WASM_CONF_OFFSET,
+      offsetof(ngx_wasm_core_conf_t, vm_conf)
+      + offsetof(ngx_wavm_conf_t, compiler_threads),
+      NULL },
+
     { ngx_string("compiler"),
       NGX_WASM_CONF|NGX_CONF_TAKE1,
       ngx_conf_set_str_slot,
@@ -91,7 +139,7 @@ static ngx_command_t  ngx_wasm_core_commands[] = {
       NULL },
 
     { ngx_string("shm_kv"),
-      NGX_WASM_CONF|NGX_CONF_TAKE23|NGX_CONF_TAKE4,
+      NGX_WASM_CONF|NGX_CONF_2MORE,
       ngx_wasm_core_shm_kv_directive,
       NGX_WA_WASM_CONF_OFFSET,
       0,
@@ -111,6 +159,27 @@ static ngx_command_t  ngx_wasm_core_commands[] = {
       0,
       NULL },
 
+    { ngx_string("max_metric_series"),
+      NGX_METRICS_CONF|NGX_CONF_TAKE1,
+      ngx_wasm_core_metrics_max_metric_series_directive,
+      NGX_WA_WASM_CONF_OFFSET,
+      0,
+      NULL },
+
+    { ngx_string("histogram_precision"),
+      NGX_METRICS_CONF|NGX_CONF_TAKE1,
+      ngx_wasm_core_metrics_histogram_precision_directive,
+      NGX_WA_WASM_CONF_OFFSET,
+      0,
+      NULL },
+
+    { ngx_string("slot_layout"),
+      NGX_METRICS_CONF|NGX_CONF_TAKE1,
+      ngx_wasm_core_metrics_slot_layout_directive,
+      NGX_WA_WASM_CONF_OFFSET,
+      0,
+      NULL },
+
     { ngx_string("shm_queue"),
       NGX_WASM_CONF|NGX_CONF_TAKE23|NGX_CONF_TAKE4,
       ngx_wasm_core_shm_queue_directive,
@@ -344,6 +413,12 @@ ngx_wasm_core_create_conf(ngx_conf_t *cf)
     wcf->vm_conf.vm_name = wcf->vm->name;
     wcf->vm_conf.runtime_name = &runtime_name;
     wcf->vm_conf.backtraces = NGX_CONF_UNSET;
+    wcf->vm_conf.pooling_instances = NGX_CONF_UNSET_UINT;
+    wcf->vm_conf.pooling_max_memory_size = NGX_CONF_UNSET_SIZE;
+    wcf->vm_conf.memory_reservation = NGX_CONF_UNSET_SIZE;
+    wcf->vm_conf.memory_guard_size = NGX_CONF_UNSET_SIZE;
+    wcf->vm_conf.memory_init_cow = NGX_CONF_UNSET;
+    wcf->vm_conf.compiler_threads = NGX_CONF_UNSET_UINT;
 
     if (ngx_array_init(&wcf->vm_conf.flags, cycle->pool,
                        1, sizeof(ngx_wrt_flag_t))
@@ -166,8 +166,10 @@ ngx_wasm_core_shm_generic_directive(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf, ngx_wa_shm_type_e type)
 {
     size_t                  i;
-    ssize_t                 size;
-    ngx_str_t              *value, *name, *arg3;
+    ssize_t                 size, slot_size;
+    ngx_int_t               n;
+    ngx_uint_t              nshards, optimistic_reads, hash_index, lockfree;
+    ngx_str_t              *value, *name, *arg, v;
     ngx_array_t            *shms = ngx_wasmx_shms(cf->cycle);
     ngx_wa_shm_mapping_t   *mapping;
     ngx_wa_shm_t           *shm;
@@ -176,8 +178,12 @@ ngx_wasm_core_shm_generic_directive(ngx_conf_t *cf, ngx_command_t *cmd,
     value = cf->args->elts;
     name = &value[1];
     size = ngx_parse_size(&value[2]);
-    arg3 = (cf->args->nelts == 4) ? &value[3] : NULL;
     eviction = NGX_WA_SHM_EVICTION_SLRU;
+    nshards = 1;
+    optimistic_reads = 0;
+    hash_index = 0;
+    lockfree = 0;
+    slot_size = 0;
 
     if (!name->len) {
         ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
@@ -189,26 +195,121 @@ ngx_wasm_core_shm_generic_directive(ngx_conf_t *cf, ngx_command_t *cmd,
         return NGX_CONF_ERROR;
     }
 
-    if (arg3) {
-        if (ngx_str_eq(arg3->data, arg3->len, "eviction=lru", -1)) {
+    for (i = 3; i < cf->args->nelts; i++) {
+        arg = &value[i];
+
+        if (ngx_str_eq(arg->data, arg->len, "eviction=lru", -1)) {
             eviction = NGX_WA_SHM_EVICTION_LRU;
 
-        } else if (ngx_str_eq(arg3->data, arg3->len, "eviction=slru", -1)) {
+        } else if (ngx_str_eq(arg->data, arg->len, "eviction=slru", -1)) {
             eviction = NGX_WA_SHM_EVICTION_SLRU;
 
-        } else if (ngx_str_eq(arg3->data, arg3->len, "eviction=none", -1)) {
+        } else if (ngx_str_eq(arg->data, arg->len, "eviction=none", -1)) {
             eviction = NGX_WA_SHM_EVICTION_NONE;
 
-        } else if (ngx_strncmp(arg3->data, "eviction=", 9) == 0) {
+        } else if (ngx_str_eq(arg->data, arg->len, "eviction=tinylfu", -1)) {
+            eviction = NGX_WA_SHM_EVICTION_TINYLFU;
+
+        } else if (ngx_strncmp(arg->data, "eviction=", 9) == 0) {
             ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
                                "[wasm] invalid eviction policy \"%s\"",
-                               arg3->data + 9);
+                               arg->data + 9);
             return NGX_CONF_ERROR;
 
+        } else if (type == NGX_WA_SHM_TYPE_KV
+                   && ngx_str_eq(arg->data, arg->len, "reads=locked", -1))
+        {
+            optimistic_reads = 0;
+
+        } else if (type == NGX_WA_SHM_TYPE_KV
+                   && ngx_str_eq(arg->data, arg->len, "reads=optimistic", -1))
+        {
+            optimistic_reads = 1;
+
+        } else if (type == NGX_WA_SHM_TYPE_KV
+                   && ngx_str_eq(arg->data, arg->len, "index=rbtree", -1))
+        {
+            hash_index = 0;
+
+        } else if (type == NGX_WA_SHM_TYPE_KV
+                   && ngx_str_eq(arg->data, arg->len, "index=hash", -1))
+        {
+            hash_index = 1;
+
+        } else if (type == NGX_WA_SHM_TYPE_KV
+                   && ngx_strncmp(arg->data, "shards=", 7) == 0)
+        {
+            n = ngx_atoi(arg->data + 7, arg->len - 7);
+            if (n == NGX_ERROR || n < 1 || n > NGX_WA_SHM_MAX_SHARDS) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "[wasm] invalid number of shards \"%s\", "
+                                   "must be between 1 and %d",
+                                   arg->data + 7, NGX_WA_SHM_MAX_SHARDS);
+                return NGX_CONF_ERROR;
+            }
+
+            nshards = n;
+
+        } else if (type == NGX_WA_SHM_TYPE_QUEUE
+                   && ngx_str_eq(arg->data, arg->len, "mode=locked", -1))
+        {
+            lockfree = 0;
+
+        } else if (type == NGX_WA_SHM_TYPE_QUEUE
+                   && ngx_str_eq(arg->data, arg->len, "mode=lockfree", -1))
+        {
+            lockfree = 1;
+
+        } else if (type == NGX_WA_SHM_TYPE_QUEUE
+                   && ngx_strncmp(arg->data, "slot_size=", 10) == 0)
+        {
+            v.data = arg->data + 10;
+            v.len = arg->len - 10;
+
+            slot_size = ngx_parse_size(&v);
+            if (slot_size == NGX_ERROR || slot_size == 0) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "[wasm] invalid slot size \"%V\"", &v);
+                return NGX_CONF_ERROR;
+            }
+
         } else {
             ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
                                "[wasm] invalid option \"%V\"",
-                               arg3);
+                               arg);
+            return NGX_CONF_ERROR;
+        }
+    }
+
+    if (slot_size && !lockfree) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "[wasm] shm_queue \"%V\": slot_size requires "
+                           "mode=lockfree", name);
+        return NGX_CONF_ERROR;
+    }
+
+#if !(NGX_HAVE_ATOMIC_OPS)
+    if (lockfree) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "[wasm] shm_queue \"%V\": lockfree mode not "
+                           "supported on this platform", name);
+        return NGX_CONF_ERROR;
+    }
+#endif
+
+    if (nshards > 1) {
+#if !(NGX_HAVE_ATOMIC_OPS)
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "[wasm] shm_kv \"%V\": shards not supported on "
+                           "this platform", name);
+        return NGX_CONF_ERROR;
+#endif
+
+        if ((size_t) size / nshards < NGX_WA_SHM_MIN_SIZE + ngx_pagesize) {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "[wasm] shm_kv \"%V\": size of %z bytes is "
+                               "too small for %ui shards", name, size,
+                               nshards);
             return NGX_CONF_ERROR;
         }
     }
@@ -222,6 +323,19 @@ ngx_wasm_core_shm_generic_directive(ngx_conf_t *cf, ngx_command_t *cmd,
     shm->eviction = eviction;
     shm->name = *name;
     shm->log = cf->cycle->log;
+    shm->nshards = nshards;
+    shm->optimistic_reads = optimistic_reads;
+    shm->hash_index = hash_index;
+    shm->lockfree = lockfree;
+    shm->slot_size = slot_size ? (size_t) slot_size
+                               : NGX_WA_SHM_QUEUE_SLOT_SIZE;
+
+    if (nshards > 1) {
+        shm->shards = ngx_pcalloc(cf->pool, nshards * sizeof(ngx_wa_shm_t));
+        if (shm->shards == NULL) {
+            return NGX_CONF_ERROR;
+        }
+    }
 
     mapping = shms->elts;
 
@@ -310,13 +424,13 @@ char *
 ngx_wasm_core_shm_queue_directive(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf)
 {
-    ngx_str_t  *args, *arg3;
+    size_t      i;
+    ngx_str_t  *args;
 
-    if (cf->args->nelts == 4) {
-        args = cf->args->elts;
-        arg3 = &args[3];
+    args = cf->args->elts;
 
-        if (ngx_strncmp(arg3->data, "eviction=", 9) == 0) {
+    for (i = 3; i < cf->args->nelts; i++) {
+        if (ngx_strncmp(args[i].data, "eviction=", 9) == 0) {
             ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
                                "[wasm] shm_queue \"%V\": queues do not "
                                "support eviction policies",
@@ -385,6 +499,90 @@ ngx_wasm_core_metrics_max_metric_name_length_directive(ngx_conf_t *cf,
 }
 
 
+char *
+ngx_wasm_core_metrics_max_metric_series_directive(ngx_conf_t *cf,
+    ngx_command_t *cmd, void *conf)
+{
+    ngx_int_t          n;
+    ngx_str_t         *value;
+    ngx_wa_metrics_t  *metrics = ngx_wasmx_metrics(cf->cycle);
+
+    if (metrics->config.max_metric_series != NGX_CONF_UNSET_UINT) {
+        return NGX_WA_CONF_ERR_DUPLICATE;
+    }
+
+    value = cf->args->elts;
+    n = ngx_atoi(value[1].data, value[1].len);
+    if (n == NGX_ERROR || n == 0) {
+        return "invalid value";
+    }
+
+    metrics->config.max_metric_series = n;
+
+    return NGX_CONF_OK;
+}
+
+
+char *
+ngx_wasm_core_metrics_histogram_precision_directive(ngx_conf_t *cf,
+    ngx_command_t *cmd, void *conf)
+{
+    ngx_int_t          n;
+    ngx_str_t         *value;
+    ngx_wa_metrics_t  *metrics = ngx_wasmx_metrics(cf->cycle);
+
+    if (metrics->config.histogram_precision != NGX_CONF_UNSET_UINT) {
+        return NGX_WA_CONF_ERR_DUPLICATE;
+    }
+
+    value = cf->args->elts;
+    n = ngx_atoi(value[1].data, value[1].len);
+    if (n == NGX_ERROR
+        || n == 0
+        || n > NGX_WA_METRICS_HISTOGRAM_PRECISION_MAX)
+    {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "[wasm] invalid histogram precision \"%V\" "
+                           "(expected 1 to %d)", &value[1],
+                           NGX_WA_METRICS_HISTOGRAM_PRECISION_MAX);
+        return NGX_CONF_ERROR;
+    }
+
+    metrics->config.histogram_precision = n;
+
+    return NGX_CONF_OK;
+}
+
+
+char *
+ngx_wasm_core_metrics_slot_layout_directive(ngx_conf_t *cf,
+    ngx_command_t *cmd, void *conf)
+{
+    ngx_str_t         *value;
+    ngx_wa_metrics_t  *metrics = ngx_wasmx_metrics(cf->cycle);
+
+    if (metrics->config.slot_layout != NGX_CONF_UNSET_UINT) {
+        return NGX_WA_CONF_ERR_DUPLICATE;
+    }
+
+    value = cf->args->elts;
+
+    if (ngx_str_eq(value[1].data, value[1].len, "packed", -1)) {
+        metrics->config.slot_layout = NGX_WA_METRICS_SLOTS_PACKED;
+
+    } else if (ngx_str_eq(value[1].data, value[1].len, "padded", -1)) {
+        metrics->config.slot_layout = NGX_WA_METRICS_SLOTS_PADDED;
+
+    } else {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "[wasm] invalid slot layout \"%V\"", &value[1]);
+        return NGX_CONF_ERROR;
+    }
+
+    return NGX_CONF_OK;
+}
+
+
 char *
 ngx_wasm_core_resolver_directive(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 {
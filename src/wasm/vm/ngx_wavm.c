@@ -4,6 +4,9 @@
 #include "ddebug.h"
 
 #include <ngx_wavm.h>
+#ifdef NGX_WASM_HAVE_WASMTIME
+#include <pthread.h>
+#endif
 #ifdef NGX_WASM_BACKTRACE
 #include <ngx_wasm_backtrace.h>
 #endif
@@ -24,6 +27,8 @@ typedef enum {
     NGX_WAVM_MODULE_LOADED = (1 << 2),
     NGX_WAVM_MODULE_LINKED = (1 << 3),
     NGX_WAVM_MODULE_INVALID = (1 << 4),
+    NGX_WAVM_MODULE_PRECOMPILED = (1 << 5),
+    NGX_WAVM_MODULE_COMPILED = (1 << 6),
 } ngx_wavm_module_state;
 
 
@@ -38,7 +43,12 @@ typedef enum {
 static ngx_int_t ngx_wavm_engine_init(ngx_wavm_t *vm);
 static void ngx_wavm_engine_destroy(ngx_wavm_t *vm);
 static void ngx_wavm_destroy_instances(ngx_wavm_t *vm);
+static ngx_int_t ngx_wavm_module_check_precompiled(ngx_wavm_module_t *module);
 static ngx_int_t ngx_wavm_module_load_bytes(ngx_wavm_module_t *module);
+static ngx_int_t ngx_wavm_module_compile(ngx_wavm_module_t *module);
+#ifdef NGX_WASM_HAVE_WASMTIME
+static void ngx_wavm_compile_modules(ngx_wavm_t *vm);
+#endif
 static ngx_int_t ngx_wavm_module_load(ngx_wavm_module_t *module);
 static void ngx_wavm_module_destroy(ngx_wavm_module_t *module);
 static ngx_int_t ngx_wavm_func_call(ngx_wavm_func_t *f, wasm_val_vec_t *args,
@@ -49,6 +59,11 @@ static ngx_int_t ngx_wavm_instance_call_func_va(ngx_wavm_instance_t *instance,
     ngx_wavm_func_t *f, wasm_val_vec_t **rets, va_list args);
 static u_char *ngx_wavm_log_error_handler(ngx_log_t *log, u_char *buf,
     size_t len);
+static ngx_wavm_instance_t *ngx_wavm_instance_init(ngx_wavm_module_t *module,
+    ngx_pool_t *pool, ngx_log_t *log, void *data,
+    ngx_wavm_snapshot_t *snapshot);
+static ngx_int_t ngx_wavm_snapshot_restore(ngx_wavm_snapshot_t *snapshot,
+    ngx_wavm_instance_t *instance);
 
 
 static const char  NGX_WAVM_NOMEM_CHAR[] = "no memory";
@@ -239,6 +254,14 @@ ngx_wavm_load(ngx_wavm_t *vm)
         goto done;
     }
 
+#ifdef NGX_WASM_HAVE_WASMTIME
+    if (vm->config->compiler_threads != NGX_CONF_UNSET_UINT
+        && vm->config->compiler_threads > 1)
+    {
+        ngx_wavm_compile_modules(vm);
+    }
+#endif
+
     for (node = ngx_rbtree_min(root, sentinel);
          node;
          node = ngx_rbtree_next(&vm->modules_tree, node))
@@ -397,6 +420,12 @@ ngx_wavm_module_add(ngx_wavm_t *vm, ngx_str_t *name, ngx_str_t *path,
                     ".wat", 4) == 0)
     {
         module->state |= NGX_WAVM_MODULE_ISWAT;
+
+    } else if (module->path.len > 6
+               && ngx_strncmp(&module->path.data[module->path.len - 6],
+                              ".cwasm", 6) == 0)
+    {
+        module->state |= NGX_WAVM_MODULE_PRECOMPILED;
     }
 
     if (config) {
@@ -426,6 +455,42 @@ error:
 }
 
 
+static ngx_int_t
+ngx_wavm_module_check_precompiled(ngx_wavm_module_t *module)
+{
+    ngx_wavm_t       *vm = module->vm;
+    ngx_file_info_t   fi;
+
+    /**
+     * Precompiled artifacts are not read in the master process: they are
+     * only checked for existence and mapped by each worker.
+     */
+
+    if (ngx_wrt.module_deserialize == NULL) {
+        ngx_wavm_log_error(NGX_LOG_EMERG, vm->log, NULL,
+                           "failed loading \"%V\" module: precompiled "
+                           "modules not supported by \"%V\" runtime",
+                           &module->name, vm->config->runtime_name);
+        return NGX_ERROR;
+    }
+
+    if (ngx_file_info(module->path.data, &fi) == NGX_FILE_ERROR) {
+        ngx_wasm_log_error(NGX_LOG_EMERG, vm->log, ngx_errno,
+                           ngx_file_info_n " \"%V\" failed",
+                           &module->path);
+        return NGX_ERROR;
+    }
+
+    ngx_log_debug2(NGX_LOG_DEBUG_WASM, vm->log, 0,
+                   "wasm \"%V\" module precompiled at \"%V\"",
+                   &module->name, &module->path);
+
+    module->state |= NGX_WAVM_MODULE_LOADED_BYTES;
+
+    return NGX_OK;
+}
+
+
 static ngx_int_t
 ngx_wavm_module_load_bytes(ngx_wavm_module_t *module)
 {
@@ -439,6 +504,10 @@ ngx_wavm_module_load_bytes(ngx_wavm_module_t *module)
 
     ngx_wrt_err_init(&e);
 
+    if (ngx_wavm_state(module, NGX_WAVM_MODULE_PRECOMPILED)) {
+        return ngx_wavm_module_check_precompiled(module);
+    }
+
     ngx_log_debug4(NGX_LOG_DEBUG_WASM, vm->log, 0,
                    "wasm loading \"%V\" module bytes from \"%V\""
                    " (module: %p, engine: %p)",
@@ -498,6 +567,158 @@ done:
 }
 
 
+static ngx_int_t
+ngx_wavm_module_compile(ngx_wavm_module_t *module)
+{
+    ngx_int_t    rc;
+    ngx_msec_t   start_time;
+    ngx_wavm_t  *vm = module->vm;
+
+    /* no logging or pool allocation: may run in a compiler thread */
+
+    ngx_wrt_err_init(&module->compile_err);
+
+    start_time = ngx_wasm_monotonic_time();
+
+    if (ngx_wavm_state(module, NGX_WAVM_MODULE_PRECOMPILED)) {
+        rc = ngx_wrt.module_deserialize(&module->wrt_module, &vm->wrt_engine,
+                                        &module->path, &module->imports,
+                                        &module->exports,
+                                        &module->compile_err);
+
+    } else {
+        rc = ngx_wrt.module_init(&module->wrt_module, &vm->wrt_engine,
+                                 &module->bytes,
+                                 &module->imports, &module->exports,
+                                 &module->compile_err);
+    }
+
+    module->compile_time = ngx_wasm_monotonic_time() - start_time;
+    module->compile_rc = rc;
+    module->state |= NGX_WAVM_MODULE_COMPILED;
+
+    return rc;
+}
+
+
+#ifdef NGX_WASM_HAVE_WASMTIME
+typedef struct {
+    ngx_wavm_module_t    **modules;
+    ngx_uint_t             nmodules;
+    ngx_atomic_t           next;
+} ngx_wavm_compile_ctx_t;
+
+
+static void *
+ngx_wavm_compile_thread(void *data)
+{
+    ngx_wavm_compile_ctx_t  *cctx = data;
+    ngx_atomic_uint_t        i;
+
+    for ( ;; ) {
+        i = ngx_atomic_fetch_add(&cctx->next, 1);
+        if (i >= cctx->nmodules) {
+            break;
+        }
+
+        (void) ngx_wavm_module_compile(cctx->modules[i]);
+    }
+
+    return NULL;
+}
+
+
+static void
+ngx_wavm_compile_modules(ngx_wavm_t *vm)
+{
+    int                      err;
+    ngx_uint_t               i, n, nthreads;
+    ngx_str_node_t          *sn;
+    ngx_rbtree_node_t       *node;
+    ngx_wavm_module_t       *module;
+    ngx_wavm_compile_ctx_t   cctx;
+    pthread_t               *tids;
+
+    /**
+     * Compile all modules concurrently on up to "compiler_threads" threads
+     * sharing the engine; results are consumed (and errors logged) by
+     * ngx_wavm_module_load in modules_tree order. Modules left uncompiled
+     * (e.g. on thread creation failure) are compiled sequentially there.
+     */
+
+    n = 0;
+
+    for (node = ngx_rbtree_min(vm->modules_tree.root,
+                               vm->modules_tree.sentinel);
+         node;
+         node = ngx_rbtree_next(&vm->modules_tree, node))
+    {
+        n++;
+    }
+
+    if (n < 2) {
+        return;
+    }
+
+    cctx.modules = ngx_palloc(vm->pool, n * sizeof(ngx_wavm_module_t *));
+    if (cctx.modules == NULL) {
+        return;
+    }
+
+    cctx.nmodules = 0;
+    cctx.next = 0;
+
+    for (node = ngx_rbtree_min(vm->modules_tree.root,
+                               vm->modules_tree.sentinel);
+         node;
+         node = ngx_rbtree_next(&vm->modules_tree, node))
+    {
+        sn = ngx_wa_sn_n2sn(node);
+        module = ngx_rbtree_data(&sn->node, ngx_wavm_module_t, sn);
+
+        if (ngx_wavm_state(module, NGX_WAVM_MODULE_LOADED_BYTES)
+            && !ngx_wavm_state(module, NGX_WAVM_MODULE_LOADED
+                                       |NGX_WAVM_MODULE_COMPILED))
+        {
+            cctx.modules[cctx.nmodules++] = module;
+        }
+    }
+
+    nthreads = ngx_min(vm->config->compiler_threads, cctx.nmodules);
+    if (nthreads < 2) {
+        return;
+    }
+
+    tids = ngx_palloc(vm->pool, nthreads * sizeof(pthread_t));
+    if (tids == NULL) {
+        return;
+    }
+
+    ngx_log_debug2(NGX_LOG_DEBUG_WASM, vm->log, 0,
+                   "wasm compiling %ui modules on %ui threads",
+                   cctx.nmodules, nthreads);
+
+    for (i = 0; i < nthreads; i++) {
+        err = pthread_create(&tids[i], NULL, ngx_wavm_compile_thread, &cctx);
+        if (err) {
+            ngx_wasm_log_error(NGX_LOG_WARN, vm->log, err,
+                               "pthread_create() failed");
+            break;
+        }
+    }
+
+    nthreads = i;
+
+    for (i = 0; i < nthreads; i++) {
+        (void) pthread_join(tids[i], NULL);
+    }
+
+    /* compilation could have stayed on-CPU for several seconds */
+    ngx_time_update();
+}
+#endif
+
+
 static ngx_int_t
 ngx_wavm_module_load(ngx_wavm_module_t *module)
 {
@@ -505,11 +726,10 @@ ngx_wavm_module_load(ngx_wavm_module_t *module)
     u_char                   *p;
     const char               *err = NGX_WAVM_NOMEM_CHAR;
     ngx_uint_t                rc;
-    ngx_wrt_err_t             e;
+    ngx_wrt_err_t            *e;
     ngx_wavm_t               *vm;
     ngx_wavm_funcref_t       *funcref;
     wasm_exporttype_t        *exporttype;
-    ngx_msec_t                start_time, end_time;
     const wasm_externtype_t  *externtype;
     const wasm_importtype_t  *importtype;
     const wasm_name_t        *exportname;
@@ -531,16 +751,18 @@ ngx_wavm_module_load(ngx_wavm_module_t *module)
     ngx_wavm_log_error(NGX_LOG_INFO, vm->log, NULL,
                        "loading \"%V\" module", &module->name);
 
-    ngx_wrt_err_init(&e);
+    e = &module->compile_err;
 
-    start_time = ngx_wasm_monotonic_time();
+    if (ngx_wavm_state(module, NGX_WAVM_MODULE_COMPILED)) {
+        /* compiled by ngx_wavm_compile_modules */
+        rc = module->compile_rc;
 
-    rc = ngx_wrt.module_init(&module->wrt_module, &vm->wrt_engine,
-                             &module->bytes,
-                             &module->imports, &module->exports, &e);
+    } else {
+        rc = ngx_wavm_module_compile(module);
 
-    /* ngx_wrt.module_init could have stayed on-CPU for several seconds */
-    ngx_time_update();
+        /* ngx_wrt.module_init could have stayed on-CPU for several seconds */
+        ngx_time_update();
+    }
 
     if (rc != NGX_OK) {
         err = NGX_WAVM_EMPTY_CHAR;
@@ -624,7 +846,10 @@ ngx_wavm_module_load(ngx_wavm_module_t *module)
 
     if (vm->config->backtraces) {
 #ifdef NGX_WASM_BACKTRACE
-        module->name_table = ngx_wasm_backtrace_get_name_table(&module->bytes);
+        if (module->bytes.size) {
+            module->name_table = ngx_wasm_backtrace_get_name_table(
+                                     &module->bytes);
+        }
 
 #elif (NGX_WASM_HAVE_V8 || NGX_WASM_HAVE_WASMER)
         ngx_wavm_log_error(NGX_LOG_WARN, vm->log, NULL,
@@ -636,18 +861,16 @@ ngx_wavm_module_load(ngx_wavm_module_t *module)
     module->idx = vm->modules_max++;
     module->state |= NGX_WAVM_MODULE_LOADED;
 
-    end_time = ngx_wasm_monotonic_time();
-
     ngx_wavm_log_error(NGX_LOG_INFO, vm->log, NULL,
                        "successfully loaded \"%V\" module in %dms",
-                       &module->name, end_time - start_time);
+                       &module->name, module->compile_time);
 
     rc = NGX_OK;
     goto done;
 
 error:
 
-    ngx_wavm_log_error(NGX_LOG_EMERG, vm->log, &e,
+    ngx_wavm_log_error(NGX_LOG_EMERG, vm->log, e,
                        "failed loading \"%V\" module: %s",
                        &module->name, err);
 
@@ -801,7 +1024,10 @@ ngx_wavm_module_destroy(ngx_wavm_module_t *module)
                    " (vm: %p, module: %p)",
                    &module->name, vm->name, vm, module);
 
-    if (ngx_wavm_state(module, NGX_WAVM_MODULE_LOADED)) {
+    if (ngx_wavm_state(module, NGX_WAVM_MODULE_LOADED)
+        || (ngx_wavm_state(module, NGX_WAVM_MODULE_COMPILED)
+            && module->compile_rc == NGX_OK))
+    {
         wasm_importtype_vec_delete(&module->imports);
         wasm_exporttype_vec_delete(&module->exports);
         ngx_wrt.module_destroy(&module->wrt_module);
@@ -890,6 +1116,22 @@ ngx_wavm_instance_cleanup(void *data)
 ngx_wavm_instance_t *
 ngx_wavm_instance_create(ngx_wavm_module_t *module, ngx_pool_t *pool,
     ngx_log_t *log, void *data)
+{
+    return ngx_wavm_instance_init(module, pool, log, data, NULL);
+}
+
+
+ngx_wavm_instance_t *
+ngx_wavm_instance_restore(ngx_wavm_snapshot_t *snapshot, ngx_pool_t *pool,
+    ngx_log_t *log, void *data)
+{
+    return ngx_wavm_instance_init(snapshot->module, pool, log, data, snapshot);
+}
+
+
+static ngx_wavm_instance_t *
+ngx_wavm_instance_init(ngx_wavm_module_t *module, ngx_pool_t *pool,
+    ngx_log_t *log, void *data, ngx_wavm_snapshot_t *snapshot)
 {
     size_t                     i;
     ngx_int_t                  rc;
@@ -1060,6 +1302,17 @@ ngx_wavm_instance_create(ngx_wavm_module_t *module, ngx_pool_t *pool,
 
     ngx_wa_assert(instance->funcs.nelts == module->exports.size);
 
+    if (snapshot) {
+        /* restored memory already reflects _start */
+
+        if (ngx_wavm_snapshot_restore(snapshot, instance) != NGX_OK) {
+            err = "failed restoring memory snapshot";
+            goto error;
+        }
+
+        return instance;
+    }
+
     /* _start */
 
     if (module->f_start) {
@@ -1405,6 +1658,158 @@ ngx_wavm_instance_destroy(ngx_wavm_instance_t *instance)
 }
 
 
+/* snapshots */
+
+
+static ngx_inline unsigned
+ngx_wavm_snapshot_page_empty(u_char *p)
+{
+    uint64_t  *w, *last;
+
+    w = (uint64_t *) p;
+    last = w + NGX_WAVM_SNAPSHOT_PAGE_SIZE / sizeof(uint64_t);
+
+    for ( /* void */ ; w < last; w++) {
+        if (*w) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+
+ngx_wavm_snapshot_t *
+ngx_wavm_snapshot_create(ngx_wavm_instance_t *instance, ngx_log_t *log)
+{
+    size_t                size;
+    u_char               *base, *p;
+    ngx_uint_t            i, n, npages;
+    ngx_wavm_snapshot_t  *snapshot;
+
+    if (instance->memory == NULL || instance->trapped) {
+        ngx_wavm_log_error(NGX_LOG_ERR, log, NULL,
+                           "cannot snapshot \"%V\" instance: %s",
+                           &instance->module->name,
+                           instance->trapped ? "instance trapped"
+                                             : "no memory export");
+        return NULL;
+    }
+
+    size = ngx_wavm_memory_data_size(instance->memory);
+    base = (u_char *) ngx_wavm_memory_base(instance->memory);
+    n = size / NGX_WAVM_SNAPSHOT_PAGE_SIZE;
+
+    /* only keep pages with content; the rest is zero-filled on restore */
+
+    for (i = 0, npages = 0; i < n; i++) {
+        if (!ngx_wavm_snapshot_page_empty(base
+                                          + i * NGX_WAVM_SNAPSHOT_PAGE_SIZE))
+        {
+            npages++;
+        }
+    }
+
+    snapshot = ngx_alloc(sizeof(ngx_wavm_snapshot_t)
+                         + npages * NGX_WAVM_SNAPSHOT_PAGE_SIZE
+                         + npages * sizeof(uint32_t), log);
+    if (snapshot == NULL) {
+        return NULL;
+    }
+
+    snapshot->module = instance->module;
+    snapshot->size = size;
+    snapshot->npages = npages;
+    snapshot->data = (u_char *) snapshot + sizeof(ngx_wavm_snapshot_t);
+    snapshot->pages = (uint32_t *) (snapshot->data
+                                    + npages * NGX_WAVM_SNAPSHOT_PAGE_SIZE);
+
+    for (i = 0, p = snapshot->data, npages = 0; i < n; i++) {
+        if (ngx_wavm_snapshot_page_empty(base
+                                         + i * NGX_WAVM_SNAPSHOT_PAGE_SIZE))
+        {
+            continue;
+        }
+
+        p = ngx_cpymem(p, base + i * NGX_WAVM_SNAPSHOT_PAGE_SIZE,
+                       NGX_WAVM_SNAPSHOT_PAGE_SIZE);
+
+        snapshot->pages[npages++] = (uint32_t) i;
+    }
+
+    ngx_log_debug4(NGX_LOG_DEBUG_WASM, log, 0,
+                   "wasm \"%V\" memory snapshot created "
+                   "(size: %uz, pages: %ui/%ui)",
+                   &instance->module->name, size, npages, n);
+
+    return snapshot;
+}
+
+
+static ngx_int_t
+ngx_wavm_snapshot_restore(ngx_wavm_snapshot_t *snapshot,
+    ngx_wavm_instance_t *instance)
+{
+    size_t       size;
+    u_char      *base, *p;
+    ngx_uint_t   i, j, n;
+
+    ngx_log_debug2(NGX_LOG_DEBUG_WASM, instance->log, 0,
+                   "wasm restoring \"%V\" instance memory snapshot "
+                   "(size: %uz)", &instance->module->name, snapshot->size);
+
+    if (instance->memory == NULL) {
+        return NGX_ERROR;
+    }
+
+    size = ngx_wavm_memory_data_size(instance->memory);
+
+    if (size > snapshot->size) {
+        /* linear memory cannot shrink */
+        return NGX_ERROR;
+    }
+
+    if (size < snapshot->size
+        && ngx_wavm_memory_grow(instance->memory,
+                                (snapshot->size - size) / NGX_WAVM_PAGE_SIZE)
+           != NGX_OK)
+    {
+        return NGX_ERROR;
+    }
+
+    base = (u_char *) ngx_wavm_memory_base(instance->memory);
+    n = snapshot->size / NGX_WAVM_SNAPSHOT_PAGE_SIZE;
+
+    for (i = 0, j = 0; i < n; i++) {
+        p = base + i * NGX_WAVM_SNAPSHOT_PAGE_SIZE;
+
+        if (j < snapshot->npages && snapshot->pages[j] == i) {
+            ngx_memcpy(p, snapshot->data + j * NGX_WAVM_SNAPSHOT_PAGE_SIZE,
+                       NGX_WAVM_SNAPSHOT_PAGE_SIZE);
+            j++;
+            continue;
+        }
+
+        /**
+         * Pages outside of data segments are untouched by instantiation;
+         * reading them does not commit memory, writing would.
+         */
+        if (!ngx_wavm_snapshot_page_empty(p)) {
+            ngx_memzero(p, NGX_WAVM_SNAPSHOT_PAGE_SIZE);
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+void
+ngx_wavm_snapshot_destroy(ngx_wavm_snapshot_t *snapshot)
+{
+    ngx_free(snapshot);
+}
+
+
 #if NGX_WASM_BACKTRACE
 static int
 name_idx_compare(const void *a, const void *b)
@@ -20,6 +20,9 @@
 #define NGX_WAVM_BAD_USAGE           -12
 #define NGX_WAVM_NYI                 -13
 
+#define NGX_WAVM_PAGE_SIZE           65536
+#define NGX_WAVM_SNAPSHOT_PAGE_SIZE  4096
+
 
 typedef struct {
     ngx_log_t                         *orig_log;
@@ -83,6 +86,9 @@ struct ngx_wavm_module_s {
     wasm_importtype_vec_t              imports;
     wasm_exporttype_vec_t              exports;
     ngx_wrt_module_t                   wrt_module;
+    ngx_int_t                          compile_rc;
+    ngx_msec_t                         compile_time;
+    ngx_wrt_err_t                      compile_err;
     ngx_rbtree_t                       funcs_tree;
     ngx_rbtree_node_t                  funcs_sentinel;
     ngx_wavm_funcref_t                *f_start;
@@ -94,6 +100,15 @@ struct ngx_wavm_module_s {
 };
 
 
+typedef struct {
+    ngx_wavm_module_t                 *module;
+    size_t                             size;       /* linear memory size */
+    ngx_uint_t                         npages;     /* non-empty pages */
+    uint32_t                          *pages;      /* non-empty page indexes */
+    u_char                            *data;       /* non-empty page contents */
+} ngx_wavm_snapshot_t;
+
+
 struct ngx_wavm_s {
     const ngx_str_t                   *name;
     ngx_wavm_conf_t                   *config;
@@ -137,12 +152,19 @@ ngx_int_t ngx_wavm_instance_call_funcref(ngx_wavm_instance_t *instance,
 ngx_int_t ngx_wavm_instance_call_funcref_vec(ngx_wavm_instance_t *instance,
     ngx_wavm_funcref_t *funcref, wasm_val_vec_t **rets, wasm_val_vec_t *args);
 void ngx_wavm_instance_destroy(ngx_wavm_instance_t *instance);
+ngx_wavm_instance_t *ngx_wavm_instance_restore(ngx_wavm_snapshot_t *snapshot,
+    ngx_pool_t *pool, ngx_log_t *log, void *data);
 void ngx_wavm_instance_trap_printf(ngx_wavm_instance_t *instance,
     const char *fmt, ...);
 void ngx_wavm_instance_trap_vprintf(ngx_wavm_instance_t *instance,
     const char *fmt, va_list args);
 
 
+ngx_wavm_snapshot_t *ngx_wavm_snapshot_create(ngx_wavm_instance_t *instance,
+    ngx_log_t *log);
+void ngx_wavm_snapshot_destroy(ngx_wavm_snapshot_t *snapshot);
+
+
 static ngx_inline void
 ngx_wavm_instance_set_data(ngx_wavm_instance_t *instance, void *data,
     ngx_log_t *log)
@@ -181,6 +203,33 @@ ngx_wavm_memory_base(ngx_wrt_extern_t *mem)
 }
 
 
+static ngx_inline ngx_int_t
+ngx_wavm_memory_grow(ngx_wrt_extern_t *mem, uint32_t pages)
+{
+#ifdef NGX_WASM_HAVE_WASMTIME
+    uint64_t           prev;
+    wasmtime_error_t  *err;
+#endif
+
+    ngx_wa_assert(mem->kind == NGX_WRT_EXTERN_MEMORY);
+
+#ifdef NGX_WASM_HAVE_WASMTIME
+    err = wasmtime_memory_grow(mem->context, &mem->ext.of.memory, pages,
+                               &prev);
+    if (err) {
+        wasmtime_error_delete(err);
+        return NGX_ERROR;
+    }
+
+    return NGX_OK;
+
+#else
+    return wasm_memory_grow(wasm_extern_as_memory(mem->ext), pages)
+           ? NGX_OK : NGX_ERROR;
+#endif
+}
+
+
 static ngx_inline void *
 ngx_wavm_memory_lift(ngx_wrt_extern_t *mem, ngx_wavm_ptr_t p,
     uint32_t size, uint32_t align, unsigned *err_count)
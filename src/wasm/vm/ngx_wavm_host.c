@@ -103,6 +103,13 @@ const wasm_valkind_t *ngx_wavm_arity_i32_i64_i32x2[] = {
 };
 
 
+const wasm_valkind_t *ngx_wavm_arity_i32x2_i64x2_i32x2[] = {
+    &ngx_wavm_i32, &ngx_wavm_i32, &ngx_wavm_i64, &ngx_wavm_i64,
+    &ngx_wavm_i32, &ngx_wavm_i32,
+    NULL
+};
+
+
 const wasm_valkind_t *ngx_wavm_arity_i32x5_i64x2_i32x2[] = {
     &ngx_wavm_i32, &ngx_wavm_i32, &ngx_wavm_i32, &ngx_wavm_i32,
     &ngx_wavm_i32, &ngx_wavm_i64, &ngx_wavm_i64, &ngx_wavm_i32,
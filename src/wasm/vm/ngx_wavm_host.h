@@ -44,6 +44,7 @@ extern const wasm_valkind_t *ngx_wavm_arity_i32x12[];
 extern const wasm_valkind_t *ngx_wavm_arity_i32_i64[];
 extern const wasm_valkind_t *ngx_wavm_arity_i32_i64_i32[];
 extern const wasm_valkind_t *ngx_wavm_arity_i32_i64_i32x2[];
+extern const wasm_valkind_t *ngx_wavm_arity_i32x2_i64x2_i32x2[];
 extern const wasm_valkind_t *ngx_wavm_arity_i32x5_i64x2_i32x2[];
 
 
@@ -20,6 +20,12 @@ typedef struct {
     ngx_str_t                      compiler;
     ngx_flag_t                     backtraces;
     ngx_array_t                    flags;
+    ngx_uint_t                     pooling_instances;
+    size_t                         pooling_max_memory_size;
+    size_t                         memory_reservation;
+    size_t                         memory_guard_size;
+    ngx_flag_t                     memory_init_cow;
+    ngx_uint_t                     compiler_threads;
 } ngx_wavm_conf_t;
 
 
@@ -303,6 +309,13 @@ typedef struct {
                                                 wasm_importtype_vec_t *imports,
                                                 wasm_exporttype_vec_t *exports,
                                                 ngx_wrt_err_t *err);
+    ngx_int_t                    (*module_deserialize)(
+                                         ngx_wrt_module_t *module,
+                                         ngx_wrt_engine_t *engine,
+                                         ngx_str_t *path,
+                                         wasm_importtype_vec_t *imports,
+                                         wasm_exporttype_vec_t *exports,
+                                         ngx_wrt_err_t *err);
     ngx_int_t                    (*module_link)(ngx_wrt_module_t *module,
                                                 ngx_array_t *hfuncs,
                                                 ngx_wrt_err_t *err);
@@ -879,6 +879,7 @@ ngx_wrt_t  ngx_wrt = {
     ngx_v8_validate,
     ngx_v8_wat2wasm,
     ngx_v8_init_module,
+    NULL,                            /* module_deserialize */
     ngx_v8_link_module,
     ngx_v8_destroy_module,
     ngx_v8_init_store,
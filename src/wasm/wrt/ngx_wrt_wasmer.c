@@ -900,6 +900,7 @@ ngx_wrt_t  ngx_wrt = {
     ngx_wasmer_validate,
     ngx_wasmer_wat2wasm,
     ngx_wasmer_init_module,
+    NULL,                            /* module_deserialize */
     ngx_wasmer_link_module,
     ngx_wasmer_destroy_module,
     ngx_wasmer_init_store,
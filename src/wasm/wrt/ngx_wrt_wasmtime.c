@@ -130,6 +130,83 @@ profiler_flag_handler(wasm_config_t *config, ngx_str_t *name, ngx_str_t *value,
 }
 
 
+static ngx_int_t
+ngx_wasmtime_init_memory_conf(wasm_config_t *config, ngx_wavm_conf_t *conf,
+    ngx_log_t *log)
+{
+#ifdef WASMTIME_FEATURE_POOLING_ALLOCATOR
+#ifndef NGX_WASM_HAVE_NOPOOL
+    uint32_t                               n;
+    wasmtime_pooling_allocation_config_t  *pooling;
+#endif
+#endif
+
+    if (conf->memory_reservation != NGX_CONF_UNSET_SIZE) {
+        wasmtime_config_static_memory_maximum_size_set(
+            config, conf->memory_reservation);
+    }
+
+    if (conf->memory_guard_size != NGX_CONF_UNSET_SIZE) {
+        wasmtime_config_static_memory_guard_size_set(config,
+                                                     conf->memory_guard_size);
+        wasmtime_config_dynamic_memory_guard_size_set(config,
+                                                      conf->memory_guard_size);
+    }
+
+    if (conf->memory_init_cow != NGX_CONF_UNSET) {
+        wasmtime_config_memory_init_cow_set(config, conf->memory_init_cow);
+    }
+
+    if (conf->pooling_instances == NGX_CONF_UNSET_UINT
+        || conf->pooling_instances == 0)
+    {
+        return NGX_OK;
+    }
+
+#ifdef NGX_WASM_HAVE_NOPOOL
+    ngx_wavm_log_error(NGX_LOG_INFO, log, NULL,
+                       "wasmtime pooling allocator disabled in this build");
+
+    return NGX_OK;
+
+#elif (defined WASMTIME_FEATURE_POOLING_ALLOCATOR)
+    pooling = wasmtime_pooling_allocation_config_new();
+    if (pooling == NULL) {
+        return NGX_ERROR;
+    }
+
+    n = (uint32_t) conf->pooling_instances;
+
+    /* one store, core instance, memory and table per ngx_wavm instance */
+
+    wasmtime_pooling_allocation_config_total_core_instances_set(pooling, n);
+    wasmtime_pooling_allocation_config_total_memories_set(pooling, n);
+    wasmtime_pooling_allocation_config_total_tables_set(pooling, n);
+
+    if (conf->pooling_max_memory_size != NGX_CONF_UNSET_SIZE) {
+        wasmtime_pooling_allocation_config_max_memory_size_set(
+            pooling, conf->pooling_max_memory_size);
+    }
+
+    wasmtime_pooling_allocation_strategy_set(config, pooling);
+    wasmtime_pooling_allocation_config_delete(pooling);
+
+    ngx_wavm_log_error(NGX_LOG_INFO, log, NULL,
+                       "using wasmtime pooling allocator (instances: %ui)",
+                       conf->pooling_instances);
+
+    return NGX_OK;
+
+#else
+    ngx_wavm_log_error(NGX_LOG_ERR, log, NULL,
+                       "wasmtime pooling allocator not supported by "
+                       "this wasmtime build");
+
+    return NGX_ERROR;
+#endif
+}
+
+
 static wasm_config_t *
 ngx_wasmtime_init_conf(ngx_wavm_conf_t *conf, ngx_log_t *log)
 {
@@ -236,6 +313,10 @@ ngx_wasmtime_init_conf(ngx_wavm_conf_t *conf, ngx_log_t *log)
 #endif
     }
 
+    if (ngx_wasmtime_init_memory_conf(config, conf, log) != NGX_OK) {
+        goto error;
+    }
+
     if (ngx_wrt_apply_flags(config, conf, log) != NGX_OK) {
         goto error;
     }
@@ -373,6 +454,31 @@ ngx_wasmtime_init_module(ngx_wrt_module_t *module, ngx_wrt_engine_t *engine,
 }
 
 
+static ngx_int_t
+ngx_wasmtime_deserialize_module(ngx_wrt_module_t *module,
+    ngx_wrt_engine_t *engine, ngx_str_t *path, wasm_importtype_vec_t *imports,
+    wasm_exporttype_vec_t *exports, ngx_wrt_err_t *err)
+{
+    /* the artifact is mmap'ed, not read */
+
+    err->res = wasmtime_module_deserialize_file(engine->engine,
+                                                (const char *) path->data,
+                                                &module->module);
+    if (err->res) {
+        return NGX_ERROR;
+    }
+
+    wasmtime_module_imports(module->module, imports);
+    wasmtime_module_exports(module->module, exports);
+
+    module->import_types = imports;
+    module->export_types = exports;
+    module->engine = engine;
+
+    return NGX_OK;
+}
+
+
 static ngx_int_t
 ngx_wasmtime_link_module(ngx_wrt_module_t *module, ngx_array_t *hfuncs,
     ngx_wrt_err_t *err)
@@ -845,6 +951,10 @@ static ngx_wrt_flag_handler_t  flag_handlers[] = {
       size_flag_handler,
       wasmtime_config_dynamic_memory_guard_size_set },
 
+    { ngx_string("memory_init_cow"),
+      bool_flag_handler,
+      wasmtime_config_memory_init_cow_set },
+
     { ngx_null_string, NULL, NULL },
 };
 
@@ -858,6 +968,7 @@ ngx_wrt_t  ngx_wrt = {
     ngx_wasmtime_validate,
     ngx_wasmtime_wat2wasm,
     ngx_wasmtime_init_module,
+    ngx_wasmtime_deserialize_module,
     ngx_wasmtime_link_module,
     ngx_wasmtime_destroy_module,
     ngx_wasmtime_init_store,
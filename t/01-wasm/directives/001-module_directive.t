@@ -315,3 +315,58 @@ qq{
     qr/\[emerg\] .*? \[wasm\] failed linking "x" module with "ngx_proxy_wasm" host interface/
 ]
 --- must_die: 2
+
+
+
+=== TEST 17: module directive - precompiled module, no such path
+--- skip_eval: 4: $::nginxV !~ m/wasmtime/
+--- main_config
+    wasm {
+        module a $TEST_NGINX_HTML_DIR/none.cwasm;
+    }
+--- error_log eval
+qr/\[emerg\] .*? \[wasm\] stat\(\) ".*?none\.cwasm" failed \(2: No such file or directory\)/
+--- no_error_log
+[error]
+[crit]
+--- must_die
+
+
+
+=== TEST 18: module directive - precompiled module, unsupported runtime
+--- skip_eval: 4: $::nginxV =~ m/wasmtime/
+--- main_config
+    wasm {
+        module a $TEST_NGINX_HTML_DIR/a.cwasm;
+    }
+--- user_files
+>>> a.cwasm
+--- error_log eval
+qr/\[emerg\] .*? \[wasm\] failed loading "a" module: precompiled modules not supported by ".*?" runtime/
+--- no_error_log
+[error]
+[crit]
+--- must_die
+
+
+
+=== TEST 19: module directive - precompiled module, runs a filter
+--- skip_eval: 4: $::nginxV !~ m/wasmtime/ || !-e "$t::TestWasmX::crates/hostcalls.cwasm"
+--- load_nginx_modules: ngx_http_echo_module
+--- main_config eval
+qq{
+    wasm {
+        module hostcalls $t::TestWasmX::crates/hostcalls.cwasm;
+    }
+}
+--- config
+    location /t {
+        proxy_wasm hostcalls 'test=/t/log/levels';
+        echo ok;
+    }
+--- response_body
+ok
+--- error_log eval
+qr/\[info\] .*? \*\d+ \[proxy-wasm\]\["hostcalls" #\d+\] proxy_log info, client:/
+--- no_error_log
+[emerg]
@@ -164,6 +164,7 @@ qr/\[emerg\] .*? "my_shm" shm already defined/
         shm_kv my_kv_1 1m eviction=lru;
         shm_kv my_kv_2 64k eviction=none;
         shm_kv my_kv_3 64k;
+        shm_kv my_kv_4 64k eviction=tinylfu;
     }
 --- no_error_log
 [error]
@@ -255,3 +256,218 @@ qr/\[emerg\] .*? invalid eviction policy \"\"/
 [crit]
 [stub]
 --- must_die
+
+
+
+=== TEST 16: shm directive - kv shards
+--- valgrind
+--- main_config
+    wasm {
+        shm_kv my_kv_1 1m shards=8;
+        shm_kv my_kv_2 1m eviction=lru shards=2;
+    }
+--- no_error_log
+[error]
+[crit]
+[emerg]
+[stub]
+
+
+
+=== TEST 17: shm directive - kv invalid shards
+--- main_config eval
+qq{
+    wasm {
+        shm_kv my_shm 1m shards=0;
+    }
+}
+--- error_log eval
+qr/\[emerg\] .*? invalid number of shards \"0\", must be between 1 and 64/
+--- no_error_log
+[error]
+[crit]
+[stub]
+--- must_die
+
+
+
+=== TEST 18: shm directive - kv too small for shards
+--- main_config eval
+qq{
+    wasm {
+        shm_kv my_shm $::min_shm_size shards=4;
+    }
+}
+--- error_log eval
+qr/\[emerg\] .*? shm_kv "my_shm": size of \d+ bytes is too small for 4 shards/
+--- no_error_log
+[error]
+[crit]
+[stub]
+--- must_die
+
+
+
+=== TEST 19: shm directive - queue invalid shards option
+--- main_config eval
+qq{
+    wasm {
+        shm_queue my_shm $::min_shm_size shards=2;
+    }
+}
+--- error_log eval
+qr/\[emerg\] .*? invalid option \"shards=2\"/
+--- no_error_log
+[error]
+[crit]
+[stub]
+--- must_die
+
+
+
+=== TEST 20: shm directive - kv reads mode
+--- valgrind
+--- main_config
+    wasm {
+        shm_kv my_kv_1 1m reads=optimistic;
+        shm_kv my_kv_2 1m eviction=lru shards=2 reads=locked;
+    }
+--- no_error_log
+[error]
+[crit]
+[emerg]
+[stub]
+
+
+
+=== TEST 21: shm directive - kv invalid reads mode
+--- main_config eval
+qq{
+    wasm {
+        shm_kv my_shm $::min_shm_size reads=foo;
+    }
+}
+--- error_log eval
+qr/\[emerg\] .*? invalid option \"reads=foo\"/
+--- no_error_log
+[error]
+[crit]
+[stub]
+--- must_die
+
+
+
+=== TEST 22: shm directive - kv index
+--- valgrind
+--- main_config
+    wasm {
+        shm_kv my_kv_1 1m index=hash;
+        shm_kv my_kv_2 1m shards=2 reads=optimistic index=hash;
+        shm_kv my_kv_3 1m index=rbtree;
+    }
+--- no_error_log
+[error]
+[crit]
+[emerg]
+[stub]
+
+
+
+=== TEST 23: shm directive - kv invalid index
+--- main_config eval
+qq{
+    wasm {
+        shm_kv my_shm $::min_shm_size index=foo;
+    }
+}
+--- error_log eval
+qr/\[emerg\] .*? invalid option \"index=foo\"/
+--- no_error_log
+[error]
+[crit]
+[stub]
+--- must_die
+
+
+
+=== TEST 24: shm directive - queue mode
+--- valgrind
+--- main_config
+    wasm {
+        shm_queue my_queue_1 1m mode=lockfree;
+        shm_queue my_queue_2 1m mode=lockfree slot_size=4k;
+        shm_queue my_queue_3 1m mode=locked;
+    }
+--- no_error_log
+[error]
+[crit]
+[emerg]
+[stub]
+
+
+
+=== TEST 25: shm directive - queue invalid mode
+--- main_config eval
+qq{
+    wasm {
+        shm_queue my_shm $::min_shm_size mode=foo;
+    }
+}
+--- error_log eval
+qr/\[emerg\] .*? invalid option \"mode=foo\"/
+--- no_error_log
+[error]
+[crit]
+[stub]
+--- must_die
+
+
+
+=== TEST 26: shm directive - queue slot_size requires lockfree mode
+--- main_config eval
+qq{
+    wasm {
+        shm_queue my_shm $::min_shm_size slot_size=512;
+    }
+}
+--- error_log eval
+qr/\[emerg\] .*? shm_queue \"my_shm\": slot_size requires mode=lockfree/
+--- no_error_log
+[error]
+[crit]
+[stub]
+--- must_die
+
+
+
+=== TEST 27: shm directive - queue invalid slot_size
+--- main_config eval
+qq{
+    wasm {
+        shm_queue my_shm $::min_shm_size mode=lockfree slot_size=foo;
+    }
+}
+--- error_log eval
+qr/\[emerg\] .*? invalid slot size \"foo\"/
+--- no_error_log
+[error]
+[crit]
+[stub]
+--- must_die
+
+
+
+=== TEST 28: shm directive - kv does not support queue mode
+--- main_config eval
+qq{
+    wasm {
+        shm_kv my_shm $::min_shm_size mode=lockfree;
+    }
+}
+--- error_log eval
+qr/\[emerg\] .*? invalid option \"mode=lockfree\"/
+--- no_error_log
+[error]
+[crit]
+[stub]
+--- must_die
@@ -128,3 +128,140 @@ qr/\[emerg\] .*? \[wasm\] invalid shm size "1x"/
 [error]
 [crit]
 --- must_die
+
+
+
+=== TEST 9: slot_layout directive - sanity
+--- main_config
+    wasm {
+        metrics {
+            slot_layout padded;
+        }
+    }
+--- no_error_log
+[error]
+[crit]
+[emerg]
+
+
+
+=== TEST 10: slot_layout directive - invalid value
+--- main_config
+    wasm {
+        metrics {
+            slot_layout foo;
+        }
+    }
+--- error_log eval
+qr/\[emerg\] .*? \[wasm\] invalid slot layout "foo"/
+--- no_error_log
+[error]
+[crit]
+--- must_die
+
+
+
+=== TEST 11: slot_layout directive - duplicate
+--- main_config
+    wasm {
+        metrics {
+            slot_layout packed;
+            slot_layout padded;
+        }
+    }
+--- error_log: is duplicate
+--- no_error_log
+[error]
+[crit]
+--- must_die
+
+
+
+=== TEST 12: max_metric_series directive - sanity
+--- main_config
+    wasm {
+        metrics {
+            max_metric_series 10;
+        }
+    }
+--- no_error_log
+[error]
+[crit]
+[emerg]
+
+
+
+=== TEST 13: max_metric_series directive - invalid value
+--- main_config
+    wasm {
+        metrics {
+            max_metric_series 0;
+        }
+    }
+--- error_log: invalid value
+--- no_error_log
+[error]
+[crit]
+--- must_die
+
+
+
+=== TEST 14: max_metric_series directive - duplicate
+--- main_config
+    wasm {
+        metrics {
+            max_metric_series 10;
+            max_metric_series 20;
+        }
+    }
+--- error_log: is duplicate
+--- no_error_log
+[error]
+[crit]
+--- must_die
+
+
+
+=== TEST 15: histogram_precision directive - sanity
+--- main_config
+    wasm {
+        metrics {
+            histogram_precision 3;
+        }
+    }
+--- no_error_log
+[error]
+[crit]
+[emerg]
+
+
+
+=== TEST 16: histogram_precision directive - invalid value
+--- main_config
+    wasm {
+        metrics {
+            histogram_precision 6;
+        }
+    }
+--- error_log eval
+qr/\[emerg\] .*? \[wasm\] invalid histogram precision "6" \(expected 1 to 5\)/
+--- no_error_log
+[error]
+[crit]
+--- must_die
+
+
+
+=== TEST 17: histogram_precision directive - duplicate
+--- main_config
+    wasm {
+        metrics {
+            histogram_precision 2;
+            histogram_precision 3;
+        }
+    }
+--- error_log: is duplicate
+--- no_error_log
+[error]
+[crit]
+--- must_die
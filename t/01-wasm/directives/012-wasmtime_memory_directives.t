@@ -0,0 +1,80 @@
+# vim:set ft= ts=4 sts=4 sw=4 et fdm=marker:
+
+use strict;
+use lib '.';
+use t::TestWasmX;
+
+if ($t::TestWasmX::nginxV !~ m/wasmtime/) {
+    plan(skip_all => "not built with Wasmtime, skipping");
+
+} else {
+    plan_tests(4);
+}
+
+run_tests();
+
+__DATA__
+
+=== TEST 1: wasmtime pooling_allocator - invalid value
+--- main_config
+    wasm {
+        wasmtime {
+            pooling_allocator foo;
+        }
+    }
+--- error_log eval
+qr/\[emerg\] .*? "pooling_allocator" directive invalid number/
+--- no_error_log
+[error]
+[crit]
+--- must_die
+
+
+
+=== TEST 2: wasmtime memory_reservation - invalid value
+--- main_config
+    wasm {
+        wasmtime {
+            memory_reservation foo;
+        }
+    }
+--- error_log eval
+qr/\[emerg\] .*? "memory_reservation" directive invalid value/
+--- no_error_log
+[error]
+[crit]
+--- must_die
+
+
+
+=== TEST 3: wasmtime pooling_allocator - instances from slots
+--- skip_eval: 4: $ENV{TEST_NGINX_USE_VALGRIND}
+--- main_config eval
+qq{
+    wasm {
+        module hostcalls $t::TestWasmX::crates/hostcalls.wasm;
+
+        wasmtime {
+            pooling_allocator 16;
+            pooling_max_memory_size 64m;
+            memory_reservation 64m;
+            memory_guard_size 64k;
+            memory_init_cow on;
+        }
+    }
+}
+--- config
+    location /t {
+        proxy_wasm_isolation filter;
+        proxy_wasm hostcalls 'test=/t/set_request_header \
+                              value=Hello:wasm';
+        proxy_wasm hostcalls 'test=/t/echo/headers';
+    }
+--- response_body
+Host: localhost
+Connection: close
+Hello: wasm
+--- error_log eval
+qr/\[info\] .*? using wasmtime pooling allocator \(instances: 16\)/
+--- no_error_log
+[error]
@@ -0,0 +1,74 @@
+# vim:set ft= ts=4 sts=4 sw=4 et fdm=marker:
+
+use strict;
+use lib '.';
+use t::TestWasmX;
+
+if ($t::TestWasmX::nginxV !~ m/wasmtime/) {
+    plan(skip_all => "not built with Wasmtime, skipping");
+
+} else {
+    plan_tests(4);
+}
+
+run_tests();
+
+__DATA__
+
+=== TEST 1: wasmtime compiler_threads - invalid value
+--- main_config
+    wasm {
+        wasmtime {
+            compiler_threads foo;
+        }
+    }
+--- error_log eval
+qr/\[emerg\] .*? "compiler_threads" directive invalid number/
+--- no_error_log
+[error]
+[crit]
+--- must_die
+
+
+
+=== TEST 2: wasmtime compiler_threads - compiles modules concurrently
+--- skip_no_debug
+--- main_config
+    wasm {
+        module a $TEST_NGINX_HTML_DIR/a.wat;
+        module b $TEST_NGINX_HTML_DIR/a.wat;
+        module c $TEST_NGINX_HTML_DIR/a.wat;
+
+        wasmtime {
+            compiler_threads 2;
+        }
+    }
+--- user_files
+>>> a.wat
+(module)
+--- error_log
+wasm compiling 3 modules on 2 threads
+--- no_error_log
+[error]
+[crit]
+
+
+
+=== TEST 3: wasmtime compiler_threads - all modules loaded
+--- main_config
+    wasm {
+        module a $TEST_NGINX_HTML_DIR/a.wat;
+        module b $TEST_NGINX_HTML_DIR/a.wat;
+
+        wasmtime {
+            compiler_threads 2;
+        }
+    }
+--- user_files
+>>> a.wat
+(module)
+--- error_log eval
+qr/\[info\] .*? \[wasm\] successfully loaded "b" module in \d+ms/
+--- no_error_log
+[error]
+[crit]
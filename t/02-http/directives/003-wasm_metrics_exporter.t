@@ -0,0 +1,237 @@
+# vim:set ft= ts=4 sts=4 sw=4 et fdm=marker:
+
+use strict;
+use lib '.';
+use t::TestWasmX;
+
+skip_hup();
+
+plan_tests(4);
+run_tests();
+
+__DATA__
+
+=== TEST 1: wasm_metrics_exporter - counter
+--- valgrind
+--- load_nginx_modules: ngx_http_echo_module
+--- wasm_modules: hostcalls
+--- config
+    location /t {
+        proxy_wasm hostcalls 'on_configure=define_and_increment_counters \
+                              metrics=c1';
+        echo ok;
+    }
+
+    location /metrics {
+        wasm_metrics_exporter;
+    }
+--- request
+GET /metrics
+--- response_headers
+Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8
+--- response_body
+# TYPE pw_hostcalls_c1 counter
+pw_hostcalls_c1_total 1
+# EOF
+--- no_error_log
+[error]
+
+
+
+=== TEST 2: wasm_metrics_exporter - gauge
+--- load_nginx_modules: ngx_http_echo_module
+--- wasm_modules: hostcalls
+--- config
+    location /t {
+        proxy_wasm hostcalls 'on_configure=define_and_record_histograms \
+                              metrics=g1 \
+                              value=10';
+        echo ok;
+    }
+
+    location /metrics {
+        wasm_metrics_exporter;
+    }
+--- request
+GET /metrics
+--- response_headers
+Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8
+--- response_body
+# TYPE pw_hostcalls_g1 gauge
+pw_hostcalls_g1 10
+# EOF
+--- no_error_log
+[error]
+
+
+
+=== TEST 3: wasm_metrics_exporter - histogram
+Buckets are cumulative and the last one is always +Inf.
+
+--- load_nginx_modules: ngx_http_echo_module
+--- wasm_modules: hostcalls
+--- config
+    location /t {
+        proxy_wasm hostcalls 'on_configure=define_and_record_histograms \
+                              metrics=h1 \
+                              value=10';
+        echo ok;
+    }
+
+    location /metrics {
+        wasm_metrics_exporter;
+    }
+--- request
+GET /metrics
+--- response_headers
+Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8
+--- response_body
+# TYPE pw_hostcalls_h1 histogram
+pw_hostcalls_h1_bucket{le="16"} 1
+pw_hostcalls_h1_bucket{le="+Inf"} 1
+pw_hostcalls_h1_sum 10
+pw_hostcalls_h1_count 1
+# EOF
+--- no_error_log
+[error]
+
+
+
+=== TEST 4: wasm_metrics_exporter - no metrics
+--- config
+    location /metrics {
+        wasm_metrics_exporter;
+    }
+--- request
+GET /metrics
+--- response_headers
+Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8
+--- response_body
+# EOF
+--- no_error_log
+[error]
+
+
+
+=== TEST 5: wasm_metrics_exporter - HEAD
+--- config
+    location /metrics {
+        wasm_metrics_exporter;
+    }
+--- request
+HEAD /metrics
+--- response_headers
+Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8
+--- response_body
+--- no_error_log
+[error]
+
+
+
+=== TEST 6: wasm_metrics_exporter - method not allowed
+--- config
+    location /metrics {
+        wasm_metrics_exporter;
+    }
+--- request
+POST /metrics
+--- error_code: 405
+--- response_headers
+Content-Type: text/html
+--- response_body_like: 405 Not Allowed
+--- no_error_log
+[error]
+
+
+
+=== TEST 7: wasm_metrics_exporter - duplicate content handler
+--- load_nginx_modules: ngx_http_echo_module
+--- config
+    location /metrics {
+        echo ok;
+        wasm_metrics_exporter;
+    }
+--- error_log eval
+qr/\[emerg\] .*? "wasm_metrics_exporter" directive is duplicate/
+--- no_error_log
+[error]
+[crit]
+--- must_die
+
+
+
+=== TEST 8: wasm_metrics_exporter - log-linear histogram
+Only non-empty buckets and +Inf are exported.
+
+--- load_nginx_modules: ngx_http_echo_module
+--- main_config eval
+qq{
+    wasm {
+        module hostcalls $ENV{TEST_NGINX_CRATES_DIR}/hostcalls.wasm;
+
+        metrics {
+            histogram_precision 2;
+        }
+    }
+}
+--- config
+    location /t {
+        proxy_wasm hostcalls 'on_configure=define_and_record_histograms \
+                              metrics=h1 \
+                              value=10';
+        echo ok;
+    }
+
+    location /metrics {
+        wasm_metrics_exporter;
+    }
+--- request
+GET /metrics
+--- response_headers
+Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8
+--- response_body
+# TYPE pw_hostcalls_h1 histogram
+pw_hostcalls_h1_bucket{le="11"} 1
+pw_hostcalls_h1_bucket{le="+Inf"} 1
+pw_hostcalls_h1_sum 10
+pw_hostcalls_h1_count 1
+# EOF
+--- no_error_log
+[error]
+
+
+
+=== TEST 9: wasm_metrics_exporter - many metrics to a rate-limited client
+Pages are rendered as the client reads them rather than buffered at once.
+
+--- timeout: 10
+--- load_nginx_modules: ngx_http_echo_module
+--- main_config eval
+qq{
+    wasm {
+        module hostcalls $ENV{TEST_NGINX_CRATES_DIR}/hostcalls.wasm;
+
+        metrics {
+            slab_size 5m;
+        }
+    }
+}
+--- config
+    location /t {
+        proxy_wasm hostcalls 'on_configure=define_and_increment_counters \
+                              metrics=c2000';
+        echo ok;
+    }
+
+    location /metrics {
+        limit_rate 64k;
+        wasm_metrics_exporter;
+    }
+--- request
+GET /metrics
+--- response_headers
+Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8
+--- response_body_like eval
+qr/\A(# TYPE pw_hostcalls_c\d+ counter\npw_hostcalls_c\d+_total 1\n){2000}# EOF\n\z/
+--- no_error_log
+[error]
@@ -0,0 +1,94 @@
+# vim:set ft= ts=4 sts=4 sw=4 et fdm=marker:
+
+use strict;
+use lib '.';
+use t::TestWasmX;
+
+plan_tests(6);
+run_tests();
+
+__DATA__
+
+=== TEST 1: proxy_wasm_instance_pool directive - no wasm{} configuration block
+--- main_config
+--- http_config
+    proxy_wasm_instance_pool 1;
+--- config
+--- error_log eval
+qr/\[emerg\] .*? "proxy_wasm_instance_pool" directive is specified but config has no "wasm" section/
+--- no_error_log
+[warn]
+[error]
+[alert]
+[crit]
+--- must_die
+
+
+
+=== TEST 2: proxy_wasm_instance_pool directive - invalid min
+--- http_config
+    proxy_wasm_instance_pool foo;
+--- config
+--- error_log eval
+qr/\[emerg\] .*? invalid instance pool min "foo"/
+--- no_error_log
+[warn]
+[error]
+[alert]
+[crit]
+--- must_die
+
+
+
+=== TEST 3: proxy_wasm_instance_pool directive - max lower than min
+--- http_config
+    proxy_wasm_instance_pool 4 2;
+--- config
+--- error_log eval
+qr/\[emerg\] .*? invalid instance pool max "2"/
+--- no_error_log
+[warn]
+[error]
+[alert]
+[crit]
+--- must_die
+
+
+
+=== TEST 4: proxy_wasm_instance_pool directive - duplicate
+--- http_config
+    proxy_wasm_instance_pool 1;
+    proxy_wasm_instance_pool 2;
+--- config
+--- error_log eval
+qr/\[emerg\] .*? "proxy_wasm_instance_pool" directive is duplicate/
+--- no_error_log
+[warn]
+[error]
+[alert]
+[crit]
+--- must_die
+
+
+
+=== TEST 5: proxy_wasm_instance_pool directive - stream isolation takes pooled instances
+--- skip_no_debug
+--- wasm_modules: hostcalls
+--- http_config
+    proxy_wasm_instance_pool 1 2;
+--- config
+    location /t {
+        proxy_wasm_isolation stream;
+        proxy_wasm hostcalls 'test=/t/log/current_time';
+        return 200;
+    }
+--- ignore_response_body
+--- error_log eval
+[
+    qr/\[debug\] .*? proxy_wasm "hostcalls" instance pool filled/,
+    qr/\[debug\] .*? filter pooled instance/,
+]
+--- no_error_log
+[error]
+[crit]
+[emerg]
@@ -0,0 +1,72 @@
+# vim:set ft= ts=4 sts=4 sw=4 et fdm=marker:
+
+use strict;
+use lib '.';
+use t::TestWasmX;
+
+plan_tests(6);
+run_tests();
+
+__DATA__
+
+=== TEST 1: proxy_wasm_instance_snapshot directive - invalid value
+--- http_config
+    proxy_wasm_instance_snapshot foo;
+--- config
+--- error_log eval
+qr/\[emerg\] .*? invalid value "foo" in "proxy_wasm_instance_snapshot" directive, it must be "on" or "off"/
+--- no_error_log
+[warn]
+[error]
+[alert]
+[crit]
+--- must_die
+
+
+
+=== TEST 2: proxy_wasm_instance_snapshot directive - stream isolation restores instances
+--- skip_no_debug
+--- wasm_modules: hostcalls
+--- http_config
+    proxy_wasm_instance_snapshot on;
+--- config
+    location /t {
+        proxy_wasm_isolation stream;
+        proxy_wasm hostcalls 'test=/t/log/current_time';
+        return 200;
+    }
+--- ignore_response_body
+--- error_log eval
+[
+    qr/\[debug\] .*? wasm "hostcalls" memory snapshot created/,
+    qr/\[debug\] .*? wasm restoring "hostcalls" instance memory snapshot/,
+]
+--- no_error_log
+[error]
+[crit]
+[emerg]
+
+
+
+=== TEST 3: proxy_wasm_instance_snapshot directive - restored instances are not configured again
+--- skip_no_debug
+--- wasm_modules: hostcalls
+--- http_config
+    proxy_wasm_instance_snapshot on;
+--- config
+    location /t {
+        proxy_wasm_isolation stream;
+        proxy_wasm hostcalls 'test=/t/log/current_time';
+        return 200;
+    }
+--- ignore_response_body
+--- grep_error_log eval: qr/(\*\d+.*?new instance|#\d+ on_(configure|vm_start)).*/
+--- grep_error_log_out eval
+qr/#0 on_vm_start[^#*]*
+#0 on_configure[^#*]*
+\*\d+ .*? filter new instance[^#*]*\Z/
+--- no_error_log
+[error]
+[crit]
+[emerg]
+[alert]
@@ -181,3 +181,29 @@ Connection: close
 [error]
 [crit]
 [alert]
+
+
+
+=== TEST 8: proxy_wasm - get_http_request_headers() x chained filters with mutation
+should not reuse the previous filters marshalled map once headers are modified
+--- wasm_modules: hostcalls
+--- config
+    location /t {
+        proxy_wasm hostcalls 'test=/t/log/request_headers';
+        proxy_wasm hostcalls 'test=/t/log/request_headers';
+        proxy_wasm hostcalls 'test=/t/add_request_header \
+                              value=Hello:world';
+        proxy_wasm hostcalls 'test=/t/echo/headers';
+    }
+--- response_body
+Host: localhost
+Connection: close
+Hello: world
+--- error_log eval
+[
+    qr/testing in "RequestHeaders"/,
+    qr/\[info\] .*? Host: localhost/,
+    qr/\[info\] .*? Connection: close/,
+]
+--- no_error_log
+[error]
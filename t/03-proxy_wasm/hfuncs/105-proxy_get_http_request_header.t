@@ -353,3 +353,31 @@ path: \/t/
 [alert]
 [stub1]
 [stub2]
+
+
+
+=== TEST 14: proxy_wasm - get_http_request_header() sees headers updated and removed by previous filters
+--- wasm_modules: hostcalls
+--- config
+    location /t {
+        proxy_wasm hostcalls 'test=/t/set_request_header \
+                              value=Hello:wasm';
+        proxy_wasm hostcalls 'test=/t/log/request_header \
+                              name=hello';
+        proxy_wasm hostcalls 'test=/t/set_request_header \
+                              value=Hello:';
+        proxy_wasm hostcalls 'test=/t/log/request_header \
+                              name=HELLO';
+        return 200;
+    }
+--- more_headers
+Hello: world
+--- error_log
+testing in "RequestHeaders"
+request header "hello: wasm"
+--- no_error_log
+request header "HELLO
+request header "hello: world"
+[error]
+[crit]
+[alert]
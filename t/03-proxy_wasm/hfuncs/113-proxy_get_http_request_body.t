@@ -173,3 +173,43 @@ ok
 qr/request body: Hello from main request body/
 --- no_error_log
 [error]
+
+
+
+=== TEST 9: proxy_wasm - proxy_get_buffer_windows() + proxy_get_buffer_into() read request body windows
+--- load_nginx_modules: ngx_http_echo_module
+--- wasm_modules: hostcalls
+--- config
+    location /t {
+        proxy_wasm hostcalls 'on=request_body';
+        echo ok;
+    }
+--- request
+POST /t/log/request_body_windows
+Hello from main request body
+--- response_body
+ok
+--- error_log eval
+qr/request body window at 0 \(28 bytes\): "Hello from main request body"/
+--- no_error_log
+[error]
+
+
+
+=== TEST 10: proxy_wasm - proxy_get_buffer_windows() + proxy_get_buffer_into() with offset
+--- load_nginx_modules: ngx_http_echo_module
+--- wasm_modules: hostcalls
+--- config
+    location /t {
+        proxy_wasm hostcalls 'on=request_body offset=11';
+        echo ok;
+    }
+--- request
+POST /t/log/request_body_windows
+Hello from main request body
+--- response_body
+ok
+--- error_log eval
+qr/request body window at 11 \(17 bytes\): "main request body"/
+--- no_error_log
+[error]
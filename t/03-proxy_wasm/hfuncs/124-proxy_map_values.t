@@ -0,0 +1,97 @@
+# vim:set ft= ts=4 sts=4 sw=4 et fdm=marker:
+
+use strict;
+use lib '.';
+use t::TestWasmX;
+
+plan_tests(4);
+run_tests();
+
+__DATA__
+
+=== TEST 1: proxy_wasm - proxy_get_map_values() retrieves all values of given keys
+--- wasm_modules: hostcalls
+--- config
+    location /t {
+        proxy_wasm hostcalls 'test=/t/log/request_map_values keys=x-a,Host';
+        return 200;
+    }
+--- more_headers
+X-A: 1
+X-B: 2
+X-A: 3
+--- error_log
+request map value "X-A: 1"
+request map value "X-A: 3"
+--- no_error_log
+request map value "X-B
+
+
+
+=== TEST 2: proxy_wasm - proxy_get_map_values() with no keys retrieves all pairs
+--- wasm_modules: hostcalls
+--- config
+    location /t {
+        proxy_wasm hostcalls 'test=/t/log/request_map_values';
+        return 200;
+    }
+--- more_headers
+X-B: 2
+--- error_log
+request map value "Host: localhost"
+request map value "X-B: 2"
+--- no_error_log
+[error]
+
+
+
+=== TEST 3: proxy_wasm - proxy_get_map_values() with no matching key
+--- wasm_modules: hostcalls
+--- config
+    location /t {
+        proxy_wasm hostcalls 'test=/t/log/request_map_values keys=X-None';
+        return 200;
+    }
+--- error_log
+request map values status: 1
+--- no_error_log
+[error]
+[crit]
+
+
+
+=== TEST 4: proxy_wasm - proxy_set_map_values() adds response headers
+--- wasm_modules: hostcalls
+--- config
+    location /t {
+        proxy_wasm hostcalls 'on=response_headers \
+                              test=/t/set_response_map_values \
+                              add=X-A:1,X-B:2';
+        return 200;
+    }
+--- response_headers
+X-A: 1
+X-B: 2
+--- no_error_log
+[error]
+
+
+
+=== TEST 5: proxy_wasm - proxy_set_map_values() removes keys before adding pairs
+--- wasm_modules: hostcalls
+--- config
+    location /t {
+        proxy_wasm hostcalls 'on=response_headers \
+                              test=/t/set_response_map_values \
+                              add=X-A:1,X-B:2';
+        proxy_wasm hostcalls 'on=response_headers \
+                              test=/t/set_response_map_values \
+                              remove=X-A,X-B \
+                              add=X-B:3';
+        return 200;
+    }
+--- response_headers
+X-A:
+X-B: 3
+--- no_error_log
+[error]
@@ -0,0 +1,62 @@
+# vim:set ft= ts=4 sts=4 sw=4 et fdm=marker:
+
+use strict;
+use lib '.';
+use t::TestWasmX;
+
+plan_tests(5);
+run_tests();
+
+__DATA__
+
+=== TEST 1: proxy_wasm - get_property_by_handle() resolved on_configure
+--- wasm_modules: hostcalls
+--- load_nginx_modules: ngx_http_echo_module
+--- config
+    location /t {
+        proxy_wasm hostcalls 'on_configure=resolve_properties \
+                              test=/t/log/property_handles \
+                              name=request.path,request.method,ngx.uri,request.headers.x-foo,request.id,wasmx.unset';
+        echo ok;
+    }
+--- more_headers
+x-foo: bar
+x-request-id: id123
+--- request
+GET /t?a=1
+--- response_body
+ok
+--- grep_error_log eval: qr/(request|ngx)\.[\-\.a-z]+: [^\s,]+|property not found: [\.a-z]+/
+--- grep_error_log_out
+request.path: /t?a=1
+request.method: GET
+ngx.uri: /t
+request.headers.x-foo: bar
+request.id: id123
+property not found: wasmx.unset
+--- error_log eval
+qr/resolved request\.path to handle 0/
+--- no_error_log
+[error]
+
+
+
+=== TEST 2: proxy_wasm - get_property_by_handle() same path resolves to the same handle
+--- wasm_modules: hostcalls
+--- load_nginx_modules: ngx_http_echo_module
+--- config
+    location /t {
+        proxy_wasm hostcalls 'on_configure=resolve_properties \
+                              test=/t/log/property_handles \
+                              name=request.method,request.method';
+        echo ok;
+    }
+--- response_body
+ok
+--- grep_error_log eval: qr/resolved [\.a-z]+ to handle \d+/
+--- grep_error_log_out
+resolved request.method to handle 0
+resolved request.method to handle 0
+--- no_error_log
+[error]
+[crit]
@@ -0,0 +1,112 @@
+# vim:set ft= ts=4 sts=4 sw=4 et fdm=marker:
+
+use strict;
+use lib '.';
+use t::TestWasmX;
+
+skip_hup();
+
+plan_tests(4);
+run_tests();
+
+__DATA__
+
+=== TEST 1: proxy_wasm metrics - define_metric() labelled series
+--- load_nginx_modules: ngx_http_echo_module
+--- wasm_modules: hostcalls
+--- config
+    location /t {
+        proxy_wasm hostcalls 'on_configure=define_and_increment_counters \
+                              metrics=c1 \
+                              metrics_labels={s=1}|{s=2}';
+        echo ok;
+    }
+
+    location /metrics {
+        wasm_metrics_exporter;
+    }
+--- request
+GET /metrics
+--- response_body
+# TYPE pw_hostcalls_c1 counter
+pw_hostcalls_c1_total{s="1"} 1
+pw_hostcalls_c1_total{s="2"} 1
+# EOF
+--- no_error_log
+[error]
+[crit]
+
+
+
+=== TEST 2: proxy_wasm metrics - define_metric() series past max_metric_series
+Series defined once the family is full share the "__overflow__" series.
+
+--- load_nginx_modules: ngx_http_echo_module
+--- main_config eval
+qq{
+    wasm {
+        module hostcalls $ENV{TEST_NGINX_CRATES_DIR}/hostcalls.wasm;
+
+        metrics {
+            max_metric_series 2;
+        }
+    }
+}
+--- config
+    location /t {
+        proxy_wasm hostcalls 'on_configure=define_and_increment_counters \
+                              metrics=c1 \
+                              metrics_labels={s=1}|{s=2}|{s=3}|{s=4}';
+        echo ok;
+    }
+
+    location /metrics {
+        wasm_metrics_exporter;
+    }
+--- request
+GET /metrics
+--- response_body
+# TYPE pw_hostcalls_c1 counter
+pw_hostcalls_c1_total{s="1"} 1
+pw_hostcalls_c1_total{s="2"} 1
+pw_hostcalls_c1_total{s="__overflow__"} 2
+# EOF
+--- no_error_log
+[error]
+[crit]
+
+
+
+=== TEST 3: proxy_wasm metrics - define_metric() label keys mismatch
+--- wasm_modules: hostcalls
+--- config
+    location /t {
+        proxy_wasm hostcalls 'on=request_headers \
+                              test=/t/metrics/define \
+                              metrics=c1 \
+                              metrics_labels={a=1}|{b=1}';
+    }
+--- error_code: 500
+--- error_log eval
+qr/host trap \(internal error\): could not define metric "c1\{b=1\}": invalid labels/
+--- no_error_log
+[emerg]
+[alert]
+
+
+
+=== TEST 4: proxy_wasm metrics - define_metric() malformed labels
+--- wasm_modules: hostcalls
+--- config
+    location /t {
+        proxy_wasm hostcalls 'on=request_headers \
+                              test=/t/metrics/define \
+                              metrics=c1 \
+                              metrics_labels={a}';
+    }
+--- error_code: 500
+--- error_log eval
+qr/host trap \(internal error\): could not define metric "c1\{a\}": invalid labels/
+--- no_error_log
+[emerg]
+[alert]
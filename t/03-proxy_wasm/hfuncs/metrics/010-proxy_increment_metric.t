@@ -33,3 +33,54 @@ qr/c1: $::workers at Configure/
 --- no_error_log
 [error]
 [crit]
+
+
+
+=== TEST 2: proxy_wasm - increment_metric() resolves a metric once per worker
+--- skip_no_debug
+--- load_nginx_modules: ngx_http_echo_module
+--- wasm_modules: hostcalls
+--- config
+    location /t {
+        proxy_wasm hostcalls 'on_configure=define_metrics \
+                              on=request_headers \
+                              test=/t/metrics/increment_counters \
+                              metrics=c1 \
+                              n_increments=3';
+        echo ok;
+    }
+--- grep_error_log eval: qr/wasm caching metric "\d+" handle/
+--- grep_error_log_out eval
+qr/\A[^\n]*wasm caching metric "\d+" handle\n\z/
+--- no_error_log
+[error]
+[crit]
+
+
+
+=== TEST 3: proxy_wasm - increment_metric() with padded slots
+A counter's value should reflect increments made by all workers.
+
+--- valgrind
+--- load_nginx_modules: ngx_http_echo_module
+--- main_config eval
+qq{
+    wasm {
+        module hostcalls $ENV{TEST_NGINX_CRATES_DIR}/hostcalls.wasm;
+
+        metrics {
+            slot_layout padded;
+        }
+    }
+}
+--- config
+    location /t {
+        proxy_wasm hostcalls 'on_configure=define_and_increment_counters \
+                              metrics=c1';
+        echo ok;
+    }
+--- error_log eval
+qr/c1: $::workers at Configure/
+--- no_error_log
+[error]
+[crit]
@@ -346,3 +346,138 @@ ok
 [alert]
 [stub1]
 [stub2]
+
+
+
+=== TEST 9: proxy_wasm key/value shm - get and set in a sharded zone
+--- valgrind
+--- load_nginx_modules: ngx_http_echo_module
+--- wasm_modules: hostcalls
+--- shm_kv: kv1 1m shards=4
+--- config
+    location /t {
+        # set kv1/test=hello
+        proxy_wasm hostcalls 'test=/t/shm/set_shared_data \
+                              key=kv1/test \
+                              value=hello';
+        # set kv1/other=world
+        proxy_wasm hostcalls 'test=/t/shm/set_shared_data \
+                              key=kv1/other \
+                              value=world';
+        # get kv1/test
+        proxy_wasm hostcalls 'test=/t/shm/get_shared_data \
+                              key=kv1/test';
+        # get kv1/other
+        proxy_wasm hostcalls 'test=/t/shm/get_shared_data \
+                              key=kv1/other \
+                              header_cas=cas-2 \
+                              header_data=data-2 \
+                              header_exists=exists-2';
+        echo ok;
+    }
+--- response_headers
+cas: 1
+exists: 1
+data: hello
+cas-2: 1
+exists-2: 1
+data-2: world
+--- response_body
+ok
+--- no_error_log
+[error]
+[crit]
+[emerg]
+[alert]
+
+
+
+=== TEST 10: proxy_wasm key/value shm - get and set with optimistic reads
+--- valgrind
+--- load_nginx_modules: ngx_http_echo_module
+--- wasm_modules: hostcalls
+--- shm_kv: kv1 1m shards=2 reads=optimistic
+--- config
+    location /t {
+        # set kv1/test=hello
+        proxy_wasm hostcalls 'test=/t/shm/set_shared_data \
+                              key=kv1/test \
+                              value=hello';
+        # set kv1/test=hello world (cas: 1)
+        proxy_wasm hostcalls 'test=/t/shm/set_shared_data \
+                              key=kv1/test \
+                              value=hello_world \
+                              cas=1';
+        # get kv1/test
+        proxy_wasm hostcalls 'test=/t/shm/get_shared_data \
+                              key=kv1/test';
+        # get kv1/nop
+        proxy_wasm hostcalls 'test=/t/shm/get_shared_data \
+                              key=kv1/nop \
+                              header_cas=cas-2 \
+                              header_data=data-2 \
+                              header_exists=exists-2';
+        echo ok;
+    }
+--- response_headers
+cas: 2
+exists: 1
+data: hello_world
+cas-2: 0
+exists-2: 0
+data-2:
+--- response_body
+ok
+--- no_error_log
+[error]
+[crit]
+[emerg]
+[alert]
+
+
+
+=== TEST 11: proxy_wasm key/value shm - get, set and delete with hash index
+--- valgrind
+--- load_nginx_modules: ngx_http_echo_module
+--- wasm_modules: hostcalls
+--- shm_kv: kv1 1m shards=2 reads=optimistic index=hash
+--- config
+    location /t {
+        # set kv1/test=hello
+        proxy_wasm hostcalls 'test=/t/shm/set_shared_data \
+                              key=kv1/test \
+                              value=hello';
+        # set kv1/test=hello world (cas: 1)
+        proxy_wasm hostcalls 'test=/t/shm/set_shared_data \
+                              key=kv1/test \
+                              value=hello_world \
+                              cas=1';
+        # get kv1/test
+        proxy_wasm hostcalls 'test=/t/shm/get_shared_data \
+                              key=kv1/test';
+        # delete kv1/test
+        proxy_wasm hostcalls 'test=/t/shm/set_shared_data \
+                              key=kv1/test \
+                              cas=2';
+        # get kv1/test
+        proxy_wasm hostcalls 'test=/t/shm/get_shared_data \
+                              key=kv1/test \
+                              header_cas=cas-2 \
+                              header_data=data-2 \
+                              header_exists=exists-2';
+        echo ok;
+    }
+--- response_headers
+cas: 2
+exists: 1
+data: hello_world
+cas-2: 0
+exists-2: 0
+data-2:
+--- response_body
+ok
+--- no_error_log
+[error]
+[crit]
+[emerg]
+[alert]
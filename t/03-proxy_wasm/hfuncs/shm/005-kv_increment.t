@@ -0,0 +1,63 @@
+# vim:set ft= ts=4 sts=4 sw=4 et fdm=marker:
+
+use strict;
+use lib '.';
+use t::TestWasmX;
+
+plan_tests(5);
+run_tests();
+
+__DATA__
+
+=== TEST 1: proxy_wasm key/value shm - increment_shared_data() sanity
+--- valgrind
+--- load_nginx_modules: ngx_http_echo_module
+--- wasm_modules: hostcalls
+--- shm_kv: kv1 1m shards=2
+--- config
+    location /t {
+        proxy_wasm hostcalls 'test=/t/shm/increment_shared_data \
+                              key=kv1/c1 \
+                              init=10';
+        proxy_wasm hostcalls 'test=/t/shm/increment_shared_data \
+                              key=kv1/c1 \
+                              delta=5 \
+                              init=10';
+        proxy_wasm hostcalls 'test=/t/shm/increment_shared_data \
+                              key=kv1/c1 \
+                              delta=-20';
+        echo ok;
+    }
+--- response_body
+ok
+--- grep_error_log eval: qr/kv1\/c1: -?\d+/
+--- grep_error_log_out
+kv1/c1: 11
+kv1/c1: 16
+kv1/c1: -4
+--- no_error_log
+[error]
+[crit]
+
+
+
+=== TEST 2: proxy_wasm key/value shm - increment_shared_data() on a non-counter value
+--- load_nginx_modules: ngx_http_echo_module
+--- wasm_modules: hostcalls
+--- shm_kv: kv1 1m
+--- config
+    location /t {
+        proxy_wasm hostcalls 'test=/t/shm/set_shared_data \
+                              key=kv1/k1 \
+                              value=hello';
+        proxy_wasm hostcalls 'test=/t/shm/increment_shared_data \
+                              key=kv1/k1';
+        echo ok;
+    }
+--- response_body
+ok
+--- error_log
+kv1/k1: not a counter
+--- no_error_log
+[error]
+[crit]
@@ -0,0 +1,73 @@
+# vim:set ft= ts=4 sts=4 sw=4 et fdm=marker:
+
+use strict;
+use lib '.';
+use t::TestWasmX::Lua;
+
+skip_no_openresty();
+
+plan_tests(5);
+run_tests();
+
+__DATA__
+
+=== TEST 1: proxy_wasm key/value shm - set_shared_data_with_ttl() expires the value
+--- wasm_modules: hostcalls
+--- shm_kv: kv1 1m
+--- config
+    location /t {
+        proxy_wasm hostcalls 'test=/t/shm/set_shared_data \
+                              key=kv1/k1 \
+                              value=hello \
+                              ttl=100';
+        proxy_wasm hostcalls 'test=/t/shm/set_shared_data \
+                              key=kv1/k2 \
+                              value=hello \
+                              ttl=60000';
+        proxy_wasm hostcalls 'on=log \
+                              test=/t/shm/log_shared_data \
+                              key=kv1/k1';
+        proxy_wasm hostcalls 'on=log \
+                              test=/t/shm/log_shared_data \
+                              key=kv1/k2';
+
+        content_by_lua_block {
+            ngx.sleep(0.2)
+            ngx.say("ok")
+        }
+    }
+--- response_body
+ok
+--- error_log
+kv1/k1: "" 0
+kv1/k2: "hello" 1
+--- no_error_log
+[error]
+
+
+
+=== TEST 2: proxy_wasm key/value shm - increment_shared_data() ttl applies to new counters
+--- wasm_modules: hostcalls
+--- shm_kv: kv1 1m
+--- config
+    location /t {
+        proxy_wasm hostcalls 'test=/t/shm/increment_shared_data \
+                              key=kv1/c1 \
+                              ttl=100';
+        proxy_wasm hostcalls 'on=log \
+                              test=/t/shm/increment_shared_data \
+                              key=kv1/c1';
+
+        content_by_lua_block {
+            ngx.sleep(0.2)
+            ngx.say("ok")
+        }
+    }
+--- response_body
+ok
+--- grep_error_log eval: qr/kv1\/c1: \d+/
+--- grep_error_log_out
+kv1/c1: 1
+kv1/c1: 1
+--- no_error_log
+[error]
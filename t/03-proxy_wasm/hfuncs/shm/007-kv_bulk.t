@@ -0,0 +1,95 @@
+# vim:set ft= ts=4 sts=4 sw=4 et fdm=marker:
+
+use strict;
+use lib '.';
+use t::TestWasmX;
+
+plan_tests(5);
+run_tests();
+
+__DATA__
+
+=== TEST 1: proxy_wasm key/value shm - bulk set/get_shared_kvstore_key_values() sanity
+--- valgrind
+--- load_nginx_modules: ngx_http_echo_module
+--- wasm_modules: hostcalls
+--- shm_kv: kv1 1m shards=2
+--- config
+    location /t {
+        proxy_wasm hostcalls 'test=/t/shm/set_kvstore_values \
+                              kvstore=kv1 \
+                              pairs=k1:v1,k2:v2,k3:v3';
+        proxy_wasm hostcalls 'test=/t/shm/get_kvstore_values \
+                              kvstore=kv1 \
+                              keys=k1,k3,k4';
+        proxy_wasm hostcalls 'test=/t/shm/log_shared_data \
+                              key=kv1/k2';
+        echo ok;
+    }
+--- response_body
+ok
+--- grep_error_log eval: qr/kvstore (written|value|cas) .*|kv1\/k2: .*/
+--- grep_error_log_out eval
+qr/kvstore written: 3 \(status: 0\)
+kvstore value "k1: v1"
+kvstore value "k3: v3"
+kvstore cas "k1: [1-9]\d*"
+kvstore cas "k3: [1-9]\d*"
+kvstore cas "k4: 0"
+kv1\/k2: "v2" [1-9]\d*/
+--- no_error_log
+[error]
+[crit]
+
+
+
+=== TEST 2: proxy_wasm key/value shm - bulk set_shared_kvstore_key_values() with cas
+--- load_nginx_modules: ngx_http_echo_module
+--- wasm_modules: hostcalls
+--- shm_kv: kv1 1m
+--- config
+    location /t {
+        proxy_wasm hostcalls 'test=/t/shm/set_kvstore_values \
+                              kvstore=kv1 \
+                              pairs=k1:v1,k2:v2';
+        proxy_wasm hostcalls 'test=/t/shm/set_kvstore_values \
+                              kvstore=kv1 \
+                              pairs=k1:v1b,k2:v2b \
+                              cas=1,99';
+        proxy_wasm hostcalls 'test=/t/shm/get_kvstore_values \
+                              kvstore=kv1 \
+                              keys=k1,k2';
+        echo ok;
+    }
+--- response_body
+ok
+--- grep_error_log eval: qr/kvstore (written|value) .*/
+--- grep_error_log_out
+kvstore written: 2 (status: 0)
+kvstore written: 1 (status: 8)
+kvstore value "k1: v1b"
+kvstore value "k2: v2"
+--- no_error_log
+[error]
+[crit]
+
+
+
+=== TEST 3: proxy_wasm key/value shm - bulk get_shared_kvstore_key_values() on a queue
+--- load_nginx_modules: ngx_http_echo_module
+--- wasm_modules: hostcalls
+--- shm_queue: q1 1m
+--- config
+    location /t {
+        proxy_wasm hostcalls 'test=/t/shm/get_kvstore_values \
+                              kvstore=q1 \
+                              keys=k1';
+        echo ok;
+    }
+--- error_code: 500
+--- response_body_like: 500 Internal Server Error
+--- error_log
+attempt to use a queue as a key/value shm store
+--- no_error_log
+[crit]
+[emerg]
@@ -0,0 +1,88 @@
+# vim:set ft= ts=4 sts=4 sw=4 et fdm=marker:
+
+use strict;
+use lib '.';
+use t::TestWasmX;
+
+plan_tests(6);
+run_tests();
+
+__DATA__
+
+=== TEST 1: proxy_wasm queue shm - on_queue_ready wakes up the registering root context
+--- valgrind
+--- load_nginx_modules: ngx_http_echo_module
+--- wasm_modules: hostcalls
+--- shm_queue: test 1m
+--- config
+    location /t {
+        proxy_wasm hostcalls 'on_configure=register_queue \
+                              test=/t/shm/enqueue \
+                              queue=test \
+                              value=hello';
+        echo ok;
+    }
+--- response_headers
+status-enqueue: 0
+--- response_body
+ok
+--- wait: 0.2
+--- error_log eval
+[
+    qr/registered queue "test" as 0/,
+    qr/on_queue_ready 0: hello/,
+]
+--- no_error_log
+[error]
+
+
+
+=== TEST 2: proxy_wasm queue shm - queues registered in request contexts are not woken up
+--- load_nginx_modules: ngx_http_echo_module
+--- wasm_modules: hostcalls
+--- shm_queue: test 1m
+--- config
+    location /t {
+        proxy_wasm hostcalls 'test=/t/shm/enqueue \
+                              queue=test \
+                              value=hello';
+        echo ok;
+    }
+--- response_headers
+status-enqueue: 0
+--- response_body
+ok
+--- wait: 0.2
+--- no_error_log
+on_queue_ready
+[error]
+[crit]
+
+
+
+=== TEST 3: proxy_wasm queue shm - root contexts of destroyed instances are unsubscribed
+--- valgrind
+--- load_nginx_modules: ngx_http_echo_module
+--- wasm_modules: hostcalls
+--- shm_queue: test 1m
+--- config
+    location /t {
+        proxy_wasm_isolation stream;
+        proxy_wasm hostcalls 'on_configure=register_queue \
+                              test=/t/shm/enqueue \
+                              queue=test \
+                              value=hello';
+        echo ok;
+    }
+--- response_headers
+status-enqueue: 0
+--- response_body
+ok
+--- wait: 0.2
+--- error_log eval
+[
+    qr/registered queue "test" as 0/,
+    qr/on_queue_ready 0: hello/,
+]
+--- no_error_log
+[error]
@@ -0,0 +1,106 @@
+# vim:set ft= ts=4 sts=4 sw=4 et fdm=marker:
+
+use strict;
+use lib '.';
+use t::TestWasmX;
+
+plan_tests(6);
+run_tests();
+
+__DATA__
+
+=== TEST 1: proxy_wasm queue shm - enqueue and dequeue items in batches
+--- valgrind
+--- load_nginx_modules: ngx_http_echo_module
+--- wasm_modules: hostcalls
+--- shm_queue: test 1m
+--- config
+    location /t {
+        proxy_wasm hostcalls 'test=/t/shm/enqueue_items \
+                              queue=test \
+                              values=a,bb,ccc';
+        proxy_wasm hostcalls 'test=/t/shm/dequeue_items \
+                              queue=test \
+                              max_items=2';
+        proxy_wasm hostcalls 'test=/t/shm/dequeue_items \
+                              queue=test';
+        echo ok;
+    }
+--- response_headers
+status-enqueue: 0
+--- response_body
+ok
+--- grep_error_log eval: qr/dequeued .*/
+--- grep_error_log_out
+dequeued 2 items (status: 0)
+dequeued item: a
+dequeued item: bb
+dequeued 1 items (status: 0)
+dequeued item: ccc
+--- no_error_log
+[error]
+[crit]
+
+
+
+=== TEST 2: proxy_wasm queue shm - dequeue items up to a size
+The first item is always returned, even if larger.
+--- load_nginx_modules: ngx_http_echo_module
+--- wasm_modules: hostcalls
+--- shm_queue: test 1m
+--- config
+    location /t {
+        proxy_wasm hostcalls 'test=/t/shm/enqueue_items \
+                              queue=test \
+                              values=a,bb,ccc';
+        proxy_wasm hostcalls 'test=/t/shm/dequeue_items \
+                              queue=test \
+                              max_size=12';
+        proxy_wasm hostcalls 'test=/t/shm/dequeue_items \
+                              queue=test \
+                              max_size=1';
+        echo ok;
+    }
+--- response_headers
+status-enqueue: 0
+--- response_body
+ok
+--- grep_error_log eval: qr/dequeued .*/
+--- grep_error_log_out
+dequeued 2 items (status: 0)
+dequeued item: a
+dequeued item: bb
+dequeued 1 items (status: 0)
+dequeued item: ccc
+--- no_error_log
+[error]
+[crit]
+
+
+
+=== TEST 3: proxy_wasm queue shm - dequeue items from an empty queue
+--- load_nginx_modules: ngx_http_echo_module
+--- wasm_modules: hostcalls
+--- shm_queue: test 1m
+--- config
+    location /t {
+        proxy_wasm hostcalls 'test=/t/shm/enqueue_items \
+                              queue=test \
+                              values=a';
+        proxy_wasm hostcalls 'test=/t/shm/dequeue_items \
+                              queue=test';
+        proxy_wasm hostcalls 'test=/t/shm/dequeue_items \
+                              queue=test';
+        echo ok;
+    }
+--- response_headers
+status-enqueue: 0
+--- response_body
+ok
+--- grep_error_log eval: qr/dequeued \d+ items .*/
+--- grep_error_log_out
+dequeued 1 items (status: 0)
+dequeued 0 items (status: 7)
+--- no_error_log
+[error]
+[crit]
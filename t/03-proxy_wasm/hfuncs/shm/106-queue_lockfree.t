@@ -0,0 +1,92 @@
+# vim:set ft= ts=4 sts=4 sw=4 et fdm=marker:
+
+use strict;
+use lib '.';
+use t::TestWasmX;
+
+plan_tests(6);
+run_tests();
+
+__DATA__
+
+=== TEST 1: proxy_wasm queue shm - lockfree: push and pop a value
+--- valgrind
+--- load_nginx_modules: ngx_http_echo_module
+--- wasm_modules: hostcalls
+--- shm_queue: test 1m mode=lockfree
+--- config
+    location /t {
+        proxy_wasm hostcalls 'test=/t/shm/enqueue \
+                              queue=test \
+                              value=hello';
+        proxy_wasm hostcalls 'test=/t/shm/dequeue \
+                              queue=test';
+        echo ok;
+    }
+--- response_headers
+status-dequeue: 0
+data: hello
+--- response_body
+ok
+--- no_error_log
+[error]
+[crit]
+
+
+
+=== TEST 2: proxy_wasm queue shm - lockfree: enqueue and dequeue items in batches
+--- load_nginx_modules: ngx_http_echo_module
+--- wasm_modules: hostcalls
+--- shm_queue: test 1m mode=lockfree slot_size=64
+--- config
+    location /t {
+        proxy_wasm hostcalls 'test=/t/shm/enqueue_items \
+                              queue=test \
+                              values=a,bb,ccc';
+        proxy_wasm hostcalls 'test=/t/shm/dequeue_items \
+                              queue=test \
+                              max_size=12';
+        proxy_wasm hostcalls 'test=/t/shm/dequeue_items \
+                              queue=test';
+        proxy_wasm hostcalls 'test=/t/shm/dequeue_items \
+                              queue=test';
+        echo ok;
+    }
+--- response_headers
+status-enqueue: 0
+--- response_body
+ok
+--- grep_error_log eval: qr/dequeued .*/
+--- grep_error_log_out
+dequeued 2 items (status: 0)
+dequeued item: a
+dequeued item: bb
+dequeued 1 items (status: 0)
+dequeued item: ccc
+dequeued 0 items (status: 7)
+--- no_error_log
+[error]
+[crit]
+
+
+
+=== TEST 3: proxy_wasm queue shm - lockfree: push item larger than slot_size
+--- load_nginx_modules: ngx_http_echo_module
+--- wasm_modules: hostcalls
+--- shm_queue: test 1m mode=lockfree slot_size=8
+--- config
+    location /t {
+        proxy_wasm hostcalls 'test=/t/shm/enqueue \
+                              queue=test \
+                              value=hello_world';
+        echo ok;
+    }
+--- error_code: 500
+--- response_body_like: 500 Internal Server Error
+--- grep_error_log eval: qr/.*?could not enqueue.*/
+--- grep_error_log_out eval
+qr~(\[error\]|Uncaught RuntimeError|\s+).*?host trap \(internal error\): could not enqueue \(item exceeds queue slot_size\).*~
+--- no_error_log
+[crit]
+[emerg]
+[alert]
@@ -112,3 +112,29 @@ v1
 --- no_error_log
 [error]
 [crit]
+
+
+
+=== TEST 5: shm_kv - get() values larger than the copy buffer
+--- shm_kv: kv 1m reads=optimistic
+--- config
+    location /t {
+        access_by_lua_block {
+            local shm = require "resty.wasmx.shm"
+
+            assert(shm.kv:set("kv/k1", "v1"))
+            assert(shm.kv:set("kv/k2", string.rep("a", 10000)))
+
+            local v = shm.kv:get("kv/k2")
+            ngx.say(#v, " ", v == string.rep("a", 10000))
+
+            v = shm.kv:get("kv/k1")
+            ngx.say(v)
+        }
+    }
+--- response_body
+10000 true
+v1
+--- no_error_log
+[error]
+[crit]
@@ -0,0 +1,90 @@
+# vim:set ft= ts=4 sts=4 sw=4 et fdm=marker:
+
+use strict;
+use lib '.';
+use t::TestWasmX::Lua;
+
+skip_no_openresty();
+
+plan_tests(3);
+run_tests();
+
+__DATA__
+
+=== TEST 1: shm_kv - incr() sanity
+--- valgrind
+--- shm_kv: kv 16k
+--- config
+    location /t {
+        access_by_lua_block {
+            local shm = require "resty.wasmx.shm"
+
+            ngx.say(shm.kv:incr("c1", 1))
+            ngx.say(shm.kv:incr("c1", 2))
+            ngx.say(shm.kv:incr("c1", -5))
+            ngx.say(shm.kv:incr("c2", 1, 10))
+            ngx.say(shm.kv:incr("c2", 1, 10))
+
+            local v, cas = shm.kv:get("c1")
+            ngx.say(#v, " ", cas)
+        }
+    }
+--- response_body
+1
+3
+-2
+11
+12
+8 3
+--- no_error_log
+[error]
+
+
+
+=== TEST 2: shm_kv - incr() on a non-counter value
+--- shm_kv: kv 16k
+--- config
+    location /t {
+        access_by_lua_block {
+            local shm = require "resty.wasmx.shm"
+
+            shm.kv:set("k1", "v1")
+
+            ngx.say(shm.kv:incr("k1", 1))
+        }
+    }
+--- response_body
+nilnot a number
+--- no_error_log
+[error]
+
+
+
+=== TEST 3: shm_kv - incr() bad args
+--- shm_kv: kv 16k
+--- config
+    location /t {
+        access_by_lua_block {
+            local shm = require "resty.wasmx.shm"
+
+            local _, perr = pcall(shm.kv.incr, {}, false)
+            ngx.say(perr)
+
+            _, perr = pcall(shm.kv.incr, {}, "k1", "1")
+            ngx.say(perr)
+
+            _, perr = pcall(shm.kv.incr, {}, "k1", 1.5)
+            ngx.say(perr)
+
+            _, perr = pcall(shm.kv.incr, {}, "k1", 1, false)
+            ngx.say(perr)
+        }
+    }
+--- response_body
+key must be a string
+value must be an integer
+value must be an integer
+init must be an integer
+--- no_error_log
+[crit]
+[emerg]
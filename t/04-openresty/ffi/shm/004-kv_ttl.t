@@ -0,0 +1,122 @@
+# vim:set ft= ts=4 sts=4 sw=4 et fdm=marker:
+
+use strict;
+use lib '.';
+use t::TestWasmX::Lua;
+
+skip_no_openresty();
+
+plan_tests(3);
+run_tests();
+
+__DATA__
+
+=== TEST 1: shm_kv - set() with ttl
+--- valgrind
+--- shm_kv: kv 16k
+--- config
+    location /t {
+        access_by_lua_block {
+            local shm = require "resty.wasmx.shm"
+
+            assert(shm.kv:set("k1", "v1", 0, 0.1) == 1)
+            assert(shm.kv:set("k2", "v2", 0, 0.1) == 1)
+            assert(shm.kv:set("k2", "v2", 1) == 1)
+
+            ngx.say(shm.kv:get("k1"))
+
+            ngx.sleep(0.2)
+
+            ngx.say(shm.kv:get("k1"))
+            ngx.say(shm.kv:get("k2"))
+
+            -- expired entries are treated as missing by cas
+            ngx.say(shm.kv:set("k1", "v1", 1))
+            ngx.say(shm.kv:set("k1", "v1", 0))
+        }
+    }
+--- response_body
+v11
+nil
+v22
+0
+1
+--- no_error_log
+[error]
+
+
+
+=== TEST 2: shm_kv - incr() with init_ttl
+--- shm_kv: kv 16k reads=optimistic
+--- config
+    location /t {
+        access_by_lua_block {
+            local shm = require "resty.wasmx.shm"
+
+            ngx.say(shm.kv:incr("c1", 1, 0, 0.1))
+            ngx.say(shm.kv:incr("c1", 1, 0, 10))
+
+            ngx.sleep(0.2)
+
+            ngx.say(shm.kv:get("c1"))
+            ngx.say(shm.kv:incr("c1", 1, 0))
+        }
+    }
+--- response_body
+1
+2
+nil
+1
+--- no_error_log
+[error]
+
+
+
+=== TEST 3: shm_kv - expired entries are swept
+--- skip_no_debug
+--- shm_kv: kv 1m shards=2
+--- config
+    location /t {
+        access_by_lua_block {
+            local shm = require "resty.wasmx.shm"
+
+            for i = 1, 10 do
+                shm.kv:set("k" .. i, "v", 0, 0.1)
+            end
+
+            shm.kv:set("k11", "v")
+
+            ngx.sleep(1.5)
+
+            ngx.say(table.concat(shm.kv:get_keys(), " "))
+        }
+    }
+--- response_body
+k11
+--- error_log eval
+qr/\[debug\] .*? wasm "kv" shm store: swept \d+ expired entries/
+--- no_error_log
+[error]
+
+
+
+=== TEST 4: shm_kv - set() and incr() bad ttl
+--- shm_kv: kv 16k
+--- config
+    location /t {
+        access_by_lua_block {
+            local shm = require "resty.wasmx.shm"
+
+            local _, perr = pcall(shm.kv.set, shm.kv, "k1", "v1", 0, false)
+            ngx.say(perr)
+
+            _, perr = pcall(shm.kv.incr, shm.kv, "k1", 1, 0, -1)
+            ngx.say(perr)
+        }
+    }
+--- response_body
+ttl must be a number >= 0
+ttl must be a number >= 0
+--- no_error_log
+[crit]
+[emerg]
@@ -0,0 +1,104 @@
+# vim:set ft= ts=4 sts=4 sw=4 et fdm=marker:
+
+use strict;
+use lib '.';
+use t::TestWasmX::Lua;
+
+skip_no_openresty();
+
+plan_tests(3);
+run_tests();
+
+__DATA__
+
+=== TEST 1: shm_kv - stats() sanity
+--- valgrind
+--- shm_kv: kv 1m shards=2
+--- config
+    location /t {
+        access_by_lua_block {
+            local shm = require "resty.wasmx.shm"
+
+            shm.kv:set("k1", "v1")
+            shm.kv:set("k2", "v2")
+
+            shm.kv:get("k1")
+            shm.kv:get("k2")
+            shm.kv:get("k2")
+            shm.kv:get("nop")
+
+            local stats = shm.kv:stats()
+
+            ngx.say("hits: ", stats.hits)
+            ngx.say("misses: ", stats.misses)
+            ngx.say("evictions: ", stats.evictions)
+            ngx.say("entries: ", stats.entries)
+        }
+    }
+--- response_body
+hits: 3
+misses: 1
+evictions: 0
+entries: 2
+--- no_error_log
+[error]
+
+
+
+=== TEST 2: shm_kv - eviction=tinylfu keeps frequently used entries through a scan
+--- shm_kv: kv 32k eviction=tinylfu
+--- config
+    location /t {
+        access_by_lua_block {
+            local shm = require "resty.wasmx.shm"
+
+            shm.kv:set("hot", "v")
+
+            for i = 1, 10 do
+                shm.kv:get("hot")
+            end
+
+            for i = 1, 500 do
+                assert(shm.kv:set("scan" .. i, string.rep(".", 100)) == 1)
+            end
+
+            ngx.say(shm.kv:get("hot"))
+            ngx.say(shm.kv:stats().evictions > 0)
+        }
+    }
+--- response_body
+v1
+true
+--- no_error_log
+[error]
+[crit]
+
+
+
+=== TEST 3: shm_kv - eviction=lru evicts frequently used entries during a scan
+--- shm_kv: kv 32k eviction=lru
+--- config
+    location /t {
+        access_by_lua_block {
+            local shm = require "resty.wasmx.shm"
+
+            shm.kv:set("hot", "v")
+
+            for i = 1, 10 do
+                shm.kv:get("hot")
+            end
+
+            for i = 1, 500 do
+                assert(shm.kv:set("scan" .. i, string.rep(".", 100)) == 1)
+            end
+
+            ngx.say(shm.kv:get("hot"))
+            ngx.say(shm.kv:stats().evictions > 0)
+        }
+    }
+--- response_body
+nil
+true
+--- no_error_log
+[error]
+[crit]
@@ -221,3 +221,39 @@ v1
 --- no_error_log
 [error]
 [crit]
+
+
+
+=== TEST 8: shm - iterate_keys() with hash index
+--- main_config
+    wasm {
+        shm_kv kv 1m index=hash shards=2;
+    }
+--- config
+    location /t {
+        access_by_lua_block {
+            local shm = require "resty.wasmx.shm"
+
+            shm.kv:set("k1", "v1")
+            shm.kv:set("k2", "v2")
+            shm.kv:set("k3", "v3")
+
+            shm.kv:lock()
+
+            local keys = {}
+
+            for k in shm.kv:iterate_keys({ page_size = 2 }) do
+                table.insert(keys, k)
+            end
+
+            shm.kv:unlock()
+
+            table.sort(keys)
+            ngx.say(table.concat(keys, " "))
+        }
+    }
+--- response_body
+k1 k2 k3
+--- no_error_log
+[error]
+[crit]
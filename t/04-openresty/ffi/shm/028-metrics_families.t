@@ -0,0 +1,151 @@
+# vim:set ft= ts=4 sts=4 sw=4 et fdm=marker:
+
+use strict;
+use lib '.';
+use t::TestWasmX::Lua;
+
+skip_no_openresty();
+
+plan_tests(4);
+run_tests();
+
+__DATA__
+
+=== TEST 1: shm_metrics - define() labelled series
+--- valgrind
+--- metrics: 16k
+--- config
+    location /t {
+        access_by_lua_block {
+            local shm = require "resty.wasmx.shm"
+
+            local ok = { method = "GET", status = "200" }
+            local nf = { method = "GET", status = "404" }
+
+            local a = assert(shm.metrics:define("reqs", shm.metrics.COUNTER,
+                                                { labels = ok }))
+            local b = assert(shm.metrics:define("reqs", shm.metrics.COUNTER,
+                                                { labels = nf }))
+
+            assert(a ~= b)
+            assert(a == shm.metrics:define("reqs", shm.metrics.COUNTER,
+                                           { labels = { status = "200",
+                                                        method = "GET" } }))
+
+            shm.metrics:increment(a, 3)
+            shm.metrics:increment(b)
+
+            local m = shm.metrics:get_by_name("reqs", { labels = ok })
+            ngx.say(m.type, " ", m.value)
+
+            m = shm.metrics:get_by_name("reqs", { labels = nf })
+            ngx.say(m.type, " ", m.value)
+
+            ngx.say(shm.metrics:get_by_name("reqs", {
+                labels = { method = "PUT", status = "200" }
+            }))
+        }
+    }
+--- response_body
+counter 3
+counter 1
+nil
+--- no_error_log
+[error]
+[crit]
+
+
+
+=== TEST 2: shm_metrics - define() series past max_metric_series
+--- main_config
+    wasm {
+        metrics {
+            max_metric_series 1;
+        }
+    }
+--- config
+    location /t {
+        access_by_lua_block {
+            local shm = require "resty.wasmx.shm"
+
+            local a = assert(shm.metrics:define("reqs", shm.metrics.COUNTER,
+                                                { labels = { s = "1" } }))
+            local b = assert(shm.metrics:define("reqs", shm.metrics.COUNTER,
+                                                { labels = { s = "2" } }))
+            local c = assert(shm.metrics:define("reqs", shm.metrics.COUNTER,
+                                                { labels = { s = "3" } }))
+
+            assert(a ~= b)
+            assert(b == c)
+
+            shm.metrics:increment(b)
+            shm.metrics:increment(c)
+
+            local keys = assert(shm.metrics:get_keys())
+            table.sort(keys)
+
+            for _, key in ipairs(keys) do
+                local m = shm.metrics:get_by_name(key, { prefix = false })
+                ngx.say(key, ": ", m.value)
+            end
+        }
+    }
+--- response_body
+lua.reqs{s=1}: 0
+lua.reqs{s=__overflow__}: 2
+--- no_error_log
+[error]
+[crit]
+
+
+
+=== TEST 3: shm_metrics - define() invalid labels
+--- metrics: 16k
+--- config
+    location /t {
+        access_by_lua_block {
+            local shm = require "resty.wasmx.shm"
+
+            assert(shm.metrics:define("reqs", shm.metrics.COUNTER,
+                                      { labels = { s = "1" } }))
+
+            ngx.say(select(2, shm.metrics:define("reqs", shm.metrics.COUNTER,
+                                                 { labels = { s = "a,b" } })))
+            ngx.say(select(2, shm.metrics:define("reqs", shm.metrics.COUNTER,
+                                                 { labels = { t = "1" } })))
+            ngx.say(select(2, shm.metrics:define("reqs", shm.metrics.GAUGE,
+                                                 { labels = { s = "2" } })))
+        }
+    }
+--- response_body
+invalid labels
+invalid labels
+invalid labels
+--- no_error_log
+[error]
+[crit]
+
+
+
+=== TEST 4: shm_metrics - define() bad labels option
+--- metrics: 16k
+--- config
+    location /t {
+        access_by_lua_block {
+            local shm = require "resty.wasmx.shm"
+
+            local ok, perr = pcall(shm.metrics.define, shm.metrics, "reqs",
+                                   shm.metrics.COUNTER, { labels = "s=1" })
+            ngx.say(perr)
+
+            ok, perr = pcall(shm.metrics.define, shm.metrics, "reqs",
+                             shm.metrics.COUNTER, { labels = { s = "" } })
+            ngx.say(perr)
+        }
+    }
+--- response_body
+opts.labels must be a table
+opts.labels must be a table of non-empty strings
+--- no_error_log
+[error]
+[crit]
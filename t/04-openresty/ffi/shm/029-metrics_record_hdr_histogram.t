@@ -0,0 +1,83 @@
+# vim:set ft= ts=4 sts=4 sw=4 et fdm=marker:
+
+use strict;
+use lib '.';
+use t::TestWasmX::Lua;
+
+skip_no_openresty();
+
+master_on();
+workers(2);
+
+plan_tests(4);
+run_tests();
+
+__DATA__
+
+=== TEST 1: shm_metrics - record() log-linear histogram, multiple workers
+Only non-empty bins and the last bin are returned.
+
+--- valgrind
+--- main_config
+    wasm {
+        metrics {
+            histogram_precision 2;
+        }
+    }
+--- http_config
+    init_worker_by_lua_block {
+        local shm = require "resty.wasmx.shm"
+
+        h1 = shm.metrics:define("h1", shm.metrics.HISTOGRAM)
+
+        for _, v in ipairs({ 0, 1, 5, 2100, 3900 }) do
+            assert(shm.metrics:record(h1, v))
+        end
+    }
+--- config
+    location /t {
+        access_by_lua_block {
+            local shm = require "resty.wasmx.shm"
+            local pretty = require "pl.pretty"
+
+            ngx.say("h1: ", pretty.write(shm.metrics:get(h1), ""))
+        }
+    }
+--- response_body
+h1: {sum=12012,type="histogram",value={{count=2,ub=0},{count=2,ub=1},{count=2,ub=5},{count=2,ub=2559},{count=2,ub=4095},{count=0,ub=4294967295}}}
+--- no_error_log
+[error]
+[crit]
+
+
+
+=== TEST 2: shm_metrics - record() log-linear histogram, custom bins
+Histograms defined with custom bins are not affected by histogram_precision.
+
+--- main_config
+    wasm {
+        metrics {
+            histogram_precision 2;
+        }
+    }
+--- config
+    location /t {
+        access_by_lua_block {
+            local shm = require "resty.wasmx.shm"
+            local pretty = require "pl.pretty"
+
+            local ch1 = shm.metrics:define("ch1", shm.metrics.HISTOGRAM,
+                                           { bins = { 1, 3, 5 } })
+
+            for _, v in ipairs({ 1, 2, 3, 4, 5, 6 }) do
+                assert(shm.metrics:record(ch1, v))
+            end
+
+            ngx.say("ch1: ", pretty.write(shm.metrics:get(ch1), ""))
+        }
+    }
+--- response_body
+ch1: {sum=21,type="histogram",value={{count=1,ub=1},{count=2,ub=3},{count=2,ub=5},{count=1,ub=4294967295}}}
+--- no_error_log
+[error]
+[crit]
@@ -185,3 +185,38 @@ c2: 14
 --- no_error_log
 [error]
 [crit]
+
+
+
+=== TEST 7: SIGHUP metrics - changed slot_layout - shm preserved, realloc
+--- workers: 2
+--- valgrind
+--- load_nginx_modules: ngx_http_echo_module
+--- main_config eval
+qq{
+    wasm {
+        module hostcalls $ENV{TEST_NGINX_CRATES_DIR}/hostcalls.wasm;
+
+        metrics {
+            slab_size 5m;
+            slot_layout padded;
+        }
+    }
+}
+--- config eval
+qq{
+    location /t {
+        proxy_wasm hostcalls 'on_configure=define_and_increment_counters \
+                              on=response_headers \
+                              test=/t/metrics/get \
+                              metrics=$::metrics';
+        echo ok;
+    }
+}
+--- response_headers
+c1: 16
+c2: 16
+--- error_log: reallocating metric
+--- no_error_log
+[error]
+[crit]
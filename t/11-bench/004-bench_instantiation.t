@@ -0,0 +1,53 @@
+# vim:set ft= ts=4 sts=4 sw=4 et fdm=marker:
+
+use strict;
+use lib '.';
+use t::TestWasmX;
+
+plan_tests(4);
+run_tests();
+
+__DATA__
+
+=== TEST 1: bench - instantiation with default allocator
+Each request creates (and frees) one instance: requests/sec is
+instances/sec.
+--- wasm_modules: on_phases
+--- config
+    location /t {
+        proxy_wasm_isolation filter;
+        proxy_wasm on_phases;
+        return 200;
+    }
+--- response_body
+--- no_error_log
+[error]
+[crit]
+
+
+
+=== TEST 2: bench - instantiation with wasmtime pooling allocator
+Each request creates (and frees) one instance: requests/sec is
+instances/sec.
+--- skip_eval: 4: $::nginxV !~ m/wasmtime/ || $ENV{TEST_NGINX_USE_VALGRIND}
+--- main_config eval
+qq{
+    wasm {
+        module on_phases $t::TestWasmX::crates/on_phases.wasm;
+
+        wasmtime {
+            pooling_allocator 1024;
+            memory_init_cow on;
+        }
+    }
+}
+--- config
+    location /t {
+        proxy_wasm_isolation filter;
+        proxy_wasm on_phases;
+        return 200;
+    }
+--- response_body
+--- no_error_log
+[error]
+[crit]
@@ -0,0 +1,75 @@
+# vim:set ft= ts=4 sts=4 sw=4 et fdm=marker:
+
+use strict;
+use lib '.';
+use t::TestWasmX;
+
+# Compare metrics slot layouts under concurrent increments from all workers:
+#   export TEST_NGINX_BENCHMARK='10000 64'
+#   ./util/test.sh t/11-bench/005-bench_metrics.t
+
+our $workers = 4;
+
+workers($workers);
+master_on();
+
+plan_tests(4);
+run_tests();
+
+__DATA__
+
+=== TEST 1: bench - metrics increments, packed slots
+--- load_nginx_modules: ngx_http_echo_module
+--- main_config eval
+qq{
+    wasm {
+        module hostcalls $ENV{TEST_NGINX_CRATES_DIR}/hostcalls.wasm;
+
+        metrics {
+            slot_layout packed;
+        }
+    }
+}
+--- config
+    location /t {
+        proxy_wasm hostcalls 'on_configure=define_metrics \
+                              on=request_headers \
+                              test=/t/metrics/increment_counters \
+                              metrics=c1,c2,c3,c4 \
+                              n_increments=1000';
+        echo ok;
+    }
+--- response_body
+ok
+--- no_error_log
+[error]
+[crit]
+
+
+
+=== TEST 2: bench - metrics increments, padded slots
+--- load_nginx_modules: ngx_http_echo_module
+--- main_config eval
+qq{
+    wasm {
+        module hostcalls $ENV{TEST_NGINX_CRATES_DIR}/hostcalls.wasm;
+
+        metrics {
+            slot_layout padded;
+        }
+    }
+}
+--- config
+    location /t {
+        proxy_wasm hostcalls 'on_configure=define_metrics \
+                              on=request_headers \
+                              test=/t/metrics/increment_counters \
+                              metrics=c1,c2,c3,c4 \
+                              n_increments=1000';
+        echo ok;
+    }
+--- response_body
+ok
+--- no_error_log
+[error]
+[crit]
@@ -70,6 +70,12 @@ impl RootContext for TestRoot {
             "do_trap" => panic!("trap on_configure"),
             "do_return_false" => return false,
             "define_metrics" => test_define_metrics(self),
+            "resolve_properties" => test_resolve_properties(self),
+            "register_queue" => {
+                let queue = self.get_config("queue").expect("missing queue parameter");
+                let queue_id = self.register_shared_queue(queue);
+                info!("registered queue \"{}\" as {}", queue, queue_id);
+            }
             "define_and_increment_counters" => {
                 test_define_metrics(self);
                 test_increment_counters(self, TestPhase::Configure, None);
@@ -169,6 +175,16 @@ impl RootContext for TestRoot {
         }
     }
 
+    fn on_queue_ready(&mut self, queue_id: u32) {
+        while let Ok(Some(bytes)) = self.dequeue_shared_queue(queue_id) {
+            info!(
+                "on_queue_ready {}: {}",
+                queue_id,
+                String::from_utf8_lossy(&bytes)
+            );
+        }
+    }
+
     fn create_http_context(&self, context_id: u32) -> Option<Box<dyn HttpContext>> {
         info!("create context id #{}", context_id);
         let mut phases: Vec<TestPhase>;
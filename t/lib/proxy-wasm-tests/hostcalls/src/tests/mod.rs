@@ -15,6 +15,108 @@ extern "C" {
         return_value_data: *mut *mut u8,
         return_value_size: *mut usize,
     ) -> i32;
+
+    fn proxy_get_buffer_into(
+        buffer_type: i32,
+        offset: usize,
+        max_size: usize,
+        dst_data: *mut u8,
+        return_size: *mut u32,
+    ) -> i32;
+
+    fn proxy_get_map_values(
+        map_type: i32,
+        keys_data: *const u8,
+        keys_size: usize,
+        return_map_data: *mut *mut u8,
+        return_map_size: *mut usize,
+    ) -> i32;
+
+    fn proxy_set_map_values(
+        map_type: i32,
+        remove_keys_data: *const u8,
+        remove_keys_size: usize,
+        map_data: *const u8,
+        map_size: usize,
+    ) -> i32;
+
+    fn proxy_resolve_property(
+        path_data: *const u8,
+        path_size: usize,
+        return_handle: *mut u32,
+    ) -> i32;
+
+    fn proxy_get_property_by_handle(
+        handle: u32,
+        return_value_data: *mut *mut u8,
+        return_value_size: *mut usize,
+    ) -> i32;
+
+    fn proxy_increment_shared_data(
+        key_data: *const u8,
+        key_size: usize,
+        delta: i64,
+        initial_value: i64,
+        ttl_ms: u32,
+        return_value: *mut i64,
+    ) -> i32;
+
+    fn proxy_set_shared_data_with_ttl(
+        key_data: *const u8,
+        key_size: usize,
+        value_data: *const u8,
+        value_size: usize,
+        cas: u32,
+        ttl_ms: u32,
+    ) -> i32;
+
+    fn proxy_open_shared_kvstore(
+        name_data: *const u8,
+        name_size: usize,
+        can_create: u32,
+        return_kvstore_id: *mut u32,
+    ) -> i32;
+
+    fn proxy_get_shared_kvstore_key_values(
+        kvstore_id: u32,
+        keys_data: *const u8,
+        keys_size: usize,
+        return_map_data: *mut *mut u8,
+        return_map_size: *mut usize,
+        return_cas_data: *mut u32,
+    ) -> i32;
+
+    fn proxy_set_shared_kvstore_key_values(
+        kvstore_id: u32,
+        map_data: *const u8,
+        map_size: usize,
+        cas_data: *const u32,
+        cas_size: usize,
+        return_written: *mut u32,
+    ) -> i32;
+
+    fn proxy_enqueue_shared_queue_items(
+        queue_id: u32,
+        items_data: *const u8,
+        items_size: usize,
+    ) -> i32;
+
+    fn proxy_dequeue_shared_queue_items(
+        queue_id: u32,
+        max_items: u32,
+        max_size: u32,
+        return_items_data: *mut *mut u8,
+        return_items_size: *mut usize,
+        return_count: *mut u32,
+    ) -> i32;
+
+    fn proxy_get_buffer_windows(
+        buffer_type: i32,
+        offset: usize,
+        windows_data: *mut u32,
+        max_windows: usize,
+        return_count: *mut u32,
+    ) -> i32;
 }
 
 pub(crate) fn test_log_levels(_: &TestHttp) {
@@ -55,6 +157,163 @@ pub(crate) fn test_log_request_body(ctx: &TestHttp) {
     }
 }
 
+pub(crate) fn test_log_request_body_windows(ctx: &TestHttp) {
+    let offset = ctx
+        .config
+        .get("offset")
+        .map(|v| v.parse::<usize>().unwrap())
+        .unwrap_or(0);
+
+    let mut windows = [0u32; 16];
+    let mut count: u32 = 0;
+
+    let status = unsafe {
+        proxy_get_buffer_windows(
+            BufferType::HttpRequestBody as i32,
+            offset,
+            windows.as_mut_ptr(),
+            windows.len() / 2,
+            &mut count,
+        )
+    };
+
+    if status != Status::Ok as i32 {
+        info!("request body windows status: {}", status);
+        return;
+    }
+
+    for w in windows[..count as usize * 2].chunks(2) {
+        let mut scratch = vec![0u8; w[1] as usize];
+        let mut len: u32 = 0;
+
+        unsafe {
+            proxy_get_buffer_into(
+                BufferType::HttpRequestBody as i32,
+                w[0] as usize,
+                scratch.len(),
+                scratch.as_mut_ptr(),
+                &mut len,
+            );
+        }
+
+        scratch.truncate(len as usize);
+
+        info!(
+            "request body window at {} ({} bytes): {:?}",
+            w[0],
+            len,
+            String::from_utf8(scratch).unwrap()
+        );
+    }
+}
+
+fn serialize_list(items: &[(&str, Option<&str>)]) -> Vec<u8> {
+    let mut bytes: Vec<u8> = Vec::new();
+    bytes.extend_from_slice(&(items.len() as u32).to_le_bytes());
+
+    for (k, v) in items {
+        bytes.extend_from_slice(&(k.len() as u32).to_le_bytes());
+        if let Some(v) = v {
+            bytes.extend_from_slice(&(v.len() as u32).to_le_bytes());
+        }
+    }
+
+    for (k, v) in items {
+        bytes.extend_from_slice(k.as_bytes());
+        bytes.push(0);
+        if let Some(v) = v {
+            bytes.extend_from_slice(v.as_bytes());
+            bytes.push(0);
+        }
+    }
+
+    bytes
+}
+
+fn deserialize_pairs(bytes: &[u8]) -> Vec<(String, String)> {
+    let mut pairs = Vec::new();
+    let n = u32::from_le_bytes(bytes[0..4].try_into().unwrap()) as usize;
+    let mut p = 4 + n * 8;
+
+    for i in 0..n {
+        let s = 4 + i * 8;
+        let klen = u32::from_le_bytes(bytes[s..s + 4].try_into().unwrap()) as usize;
+        let vlen = u32::from_le_bytes(bytes[s + 4..s + 8].try_into().unwrap()) as usize;
+        let k = String::from_utf8(bytes[p..p + klen].to_vec()).unwrap();
+        p += klen + 1;
+        let v = String::from_utf8(bytes[p..p + vlen].to_vec()).unwrap();
+        p += vlen + 1;
+        pairs.push((k, v));
+    }
+
+    pairs
+}
+
+pub(crate) fn test_log_request_map_values(ctx: &TestHttp) {
+    let keys: Vec<(&str, Option<&str>)> = ctx
+        .config
+        .get("keys")
+        .map(|v| v.split(',').map(|k| (k, None)).collect())
+        .unwrap_or_default();
+
+    let keys = serialize_list(&keys);
+    let mut return_data: *mut u8 = std::ptr::null_mut();
+    let mut return_size: usize = 0;
+
+    let status = unsafe {
+        proxy_get_map_values(
+            MapType::HttpRequestHeaders as i32,
+            keys.as_ptr(),
+            keys.len(),
+            &mut return_data,
+            &mut return_size,
+        )
+    };
+
+    if status != Status::Ok as i32 {
+        info!("request map values status: {}", status);
+        return;
+    }
+
+    let bytes = unsafe { Vec::from_raw_parts(return_data, return_size, return_size) };
+
+    for (k, v) in deserialize_pairs(&bytes) {
+        info!("request map value \"{}: {}\"", k, v);
+    }
+}
+
+pub(crate) fn test_set_response_map_values(ctx: &TestHttp) {
+    let remove: Vec<(&str, Option<&str>)> = ctx
+        .config
+        .get("remove")
+        .map(|v| v.split(',').map(|k| (k, None)).collect())
+        .unwrap_or_default();
+
+    let pairs: Vec<(&str, Option<&str>)> = ctx
+        .config
+        .get("add")
+        .map(|v| {
+            v.split(',')
+                .filter_map(|h| h.split_once(':'))
+                .map(|(k, v)| (k, Some(v)))
+                .collect()
+        })
+        .unwrap_or_default();
+
+    let remove = serialize_list(&remove);
+    let pairs = serialize_list(&pairs);
+
+    unsafe {
+        proxy_set_map_values(
+            MapType::HttpResponseHeaders as i32,
+            remove.as_ptr(),
+            remove.len(),
+            pairs.as_ptr(),
+            pairs.len(),
+        );
+    }
+}
+
 pub(crate) fn test_log_response_body(ctx: &TestHttp) {
     let max_len = ctx
         .config
@@ -105,6 +364,67 @@ pub(crate) fn test_log_property(ctx: &(dyn TestContext + 'static)) {
     }
 }
 
+pub(crate) fn test_resolve_properties(ctx: &mut TestRoot) {
+    let name = ctx
+        .get_config("name")
+        .expect("expected a name argument")
+        .to_string();
+
+    let mut handles = Vec::new();
+
+    for property in name.split(',') {
+        let path = property.replace('.', "\0");
+        let mut handle: u32 = 0;
+
+        unsafe {
+            if proxy_resolve_property(path.as_ptr(), path.len(), &mut handle) != 0 {
+                panic!("failed resolving property: {}", property);
+            }
+        }
+
+        info!("resolved {} to handle {}", property, handle);
+        handles.push(handle.to_string());
+    }
+
+    ctx.config.insert("handles".to_string(), handles.join(","));
+}
+
+pub(crate) fn test_log_property_handles(ctx: &TestHttp) {
+    let name = ctx.get_config("name").expect("expected a name argument");
+    let handles = ctx
+        .get_config("handles")
+        .expect("expected resolved handles");
+
+    for (property, handle) in name.split(',').zip(handles.split(',')) {
+        let mut data: *mut u8 = std::ptr::null_mut();
+        let mut size: usize = 0;
+
+        let status = unsafe {
+            proxy_get_property_by_handle(handle.parse().expect("bad handle"), &mut data, &mut size)
+        };
+
+        if status == Status::NotFound as i32 {
+            info!("property not found: {}", property);
+            continue;
+        }
+
+        if status != Status::Ok as i32 {
+            panic!("unexpected status getting {}: {}", property, status);
+        }
+
+        let bytes = if data.is_null() {
+            Vec::new()
+        } else {
+            unsafe { Vec::from_raw_parts(data, size, size) }
+        };
+
+        match String::from_utf8(bytes) {
+            Ok(value) => info!("{}: {}", property, value),
+            Err(_) => panic!("failed converting {} to UTF-8", property),
+        }
+    }
+}
+
 pub(crate) fn test_log_properties(ctx: &(dyn TestContext + 'static), phase: TestPhase) {
     let name = ctx.get_config("name").expect("expected a name argument");
 
@@ -418,17 +738,146 @@ pub(crate) fn test_set_shared_data(ctx: &TestHttp) {
         .map(|x| x.as_str())
         .unwrap_or("set-ok");
 
-    let ok = ctx
-        .set_shared_data(
-            ctx.config.get("key").unwrap(),
-            ctx.config.get("value").map(|x| x.as_bytes()),
-            cas,
-        )
-        .is_ok();
+    let ok = match ctx.config.get("ttl") {
+        Some(ttl) => {
+            let key = ctx.config.get("key").unwrap();
+            let value = ctx.config.get("value").unwrap();
+            let status = unsafe {
+                proxy_set_shared_data_with_ttl(
+                    key.as_ptr(),
+                    key.len(),
+                    value.as_ptr(),
+                    value.len(),
+                    cas.unwrap_or(0),
+                    ttl.parse::<u32>().unwrap(),
+                )
+            };
+
+            status == 0
+        }
+        None => ctx
+            .set_shared_data(
+                ctx.config.get("key").unwrap(),
+                ctx.config.get("value").map(|x| x.as_bytes()),
+                cas,
+            )
+            .is_ok(),
+    };
 
     ctx.add_http_response_header(hok, if ok { "1" } else { "0" });
 }
 
+pub(crate) fn test_increment_shared_data(ctx: &TestHttp) {
+    let key = ctx.config.get("key").unwrap();
+    let delta = ctx
+        .config
+        .get("delta")
+        .map_or(1, |v| v.parse::<i64>().unwrap());
+    let init = ctx
+        .config
+        .get("init")
+        .map_or(0, |v| v.parse::<i64>().unwrap());
+    let ttl = ctx
+        .config
+        .get("ttl")
+        .map_or(0, |v| v.parse::<u32>().unwrap());
+
+    let mut value: i64 = 0;
+    let status = unsafe {
+        proxy_increment_shared_data(key.as_ptr(), key.len(), delta, init, ttl, &mut value)
+    };
+
+    match status {
+        0 => info!("{}: {}", key, value),
+        2 => info!("{}: not a counter", key),
+        _ => panic!("unexpected status: {}", status),
+    }
+}
+
+fn open_shared_kvstore(ctx: &TestHttp) -> u32 {
+    let name = ctx.config.get("kvstore").unwrap();
+    let mut id: u32 = 0;
+    let status = unsafe { proxy_open_shared_kvstore(name.as_ptr(), name.len(), 0, &mut id) };
+
+    if status != Status::Ok as i32 {
+        panic!("could not open kvstore \"{}\": {}", name, status);
+    }
+
+    id
+}
+
+pub(crate) fn test_get_shared_kvstore_values(ctx: &TestHttp) {
+    let id = open_shared_kvstore(ctx);
+    let names: Vec<&str> = ctx.config.get("keys").unwrap().split(',').collect();
+    let keys: Vec<(&str, Option<&str>)> = names.iter().map(|k| (*k, None)).collect();
+    let keys = serialize_list(&keys);
+    let mut cas: Vec<u32> = vec![0; names.len()];
+    let mut return_data: *mut u8 = std::ptr::null_mut();
+    let mut return_size: usize = 0;
+
+    let status = unsafe {
+        proxy_get_shared_kvstore_key_values(
+            id,
+            keys.as_ptr(),
+            keys.len(),
+            &mut return_data,
+            &mut return_size,
+            cas.as_mut_ptr(),
+        )
+    };
+
+    if status != Status::Ok as i32 {
+        info!("kvstore values status: {}", status);
+        return;
+    }
+
+    let bytes = unsafe { Vec::from_raw_parts(return_data, return_size, return_size) };
+
+    for (k, v) in deserialize_pairs(&bytes) {
+        info!("kvstore value \"{}: {}\"", k, v);
+    }
+
+    for (k, c) in names.iter().zip(cas.iter()) {
+        info!("kvstore cas \"{}: {}\"", k, c);
+    }
+}
+
+pub(crate) fn test_set_shared_kvstore_values(ctx: &TestHttp) {
+    let id = open_shared_kvstore(ctx);
+    let pairs: Vec<(&str, Option<&str>)> = ctx
+        .config
+        .get("pairs")
+        .unwrap()
+        .split(',')
+        .filter_map(|p| p.split_once(':'))
+        .map(|(k, v)| (k, Some(v)))
+        .collect();
+    let pairs = serialize_list(&pairs);
+    let cas: Vec<u32> = ctx
+        .config
+        .get("cas")
+        .map(|v| v.split(',').map(|c| c.parse::<u32>().unwrap()).collect())
+        .unwrap_or_default();
+    let mut written: u32 = 0;
+
+    let status = unsafe {
+        proxy_set_shared_kvstore_key_values(
+            id,
+            pairs.as_ptr(),
+            pairs.len(),
+            if cas.is_empty() {
+                std::ptr::null()
+            } else {
+                cas.as_ptr()
+            },
+            cas.len() * 4,
+            &mut written,
+        )
+    };
+
+    info!("kvstore written: {} (status: {})", written, status);
+}
+
 pub(crate) fn test_set_shared_data_by_len(ctx: &mut TestHttp) {
     let len = ctx
         .config
@@ -468,6 +917,11 @@ pub(crate) fn test_define_metrics(ctx: &mut (dyn TestContext + 'static)) {
         .map(|x| x.to_string())
         .expect("missing metrics parameter");
 
+    // e.g. "{status=200}|{status=404}": one series per label set
+    let labels_config = ctx
+        .get_config("metrics_labels")
+        .map_or(String::new(), |x| x.to_string());
+
     for metric in metrics_config.split(",") {
         let metric_char = metric.chars().nth(0).unwrap();
         let metric_type = match metric_char {
@@ -485,11 +939,14 @@ pub(crate) fn test_define_metrics(ctx: &mut (dyn TestContext + 'static)) {
                 name = format!("{}{}", name, "x".repeat(name_len - name.chars().count()));
             }
 
-            let m_id = define_metric(metric_type, &name).expect("cannot define new metric");
+            for labels in labels_config.split('|') {
+                let name = format!("{}{}", name, labels);
+                let m_id = define_metric(metric_type, &name).expect("cannot define new metric");
 
-            info!("defined metric {} as {:?}", &name, m_id);
+                info!("defined metric {} as {:?}", &name, m_id);
 
-            ctx.save_metric_mapping(name.as_str(), m_id);
+                ctx.save_metric_mapping(name.as_str(), m_id);
+            }
         }
     }
 }
@@ -606,6 +1063,65 @@ pub(crate) fn test_shared_queue_enqueue(ctx: &TestHttp) {
     ctx.add_http_response_header(hstatus, format!("{status}").as_str());
 }
 
+pub(crate) fn test_shared_queue_enqueue_items(ctx: &TestHttp) {
+    let queue_id = ctx.register_shared_queue(ctx.config.get("queue").unwrap());
+    let mut items: Vec<u8> = Vec::new();
+
+    for v in ctx.config.get("values").unwrap().split(',') {
+        items.extend_from_slice(&(v.len() as u32).to_le_bytes());
+        items.extend_from_slice(v.as_bytes());
+    }
+
+    let status = unsafe { proxy_enqueue_shared_queue_items(queue_id, items.as_ptr(), items.len()) };
+
+    ctx.add_http_response_header("status-enqueue", format!("{status}").as_str());
+}
+
+pub(crate) fn test_shared_queue_dequeue_items(ctx: &TestHttp) {
+    let queue_id = ctx.register_shared_queue(ctx.config.get("queue").unwrap());
+    let max_items = ctx
+        .config
+        .get("max_items")
+        .map_or(0, |v| v.parse::<u32>().unwrap());
+    let max_size = ctx
+        .config
+        .get("max_size")
+        .map_or(0, |v| v.parse::<u32>().unwrap());
+    let mut return_data: *mut u8 = std::ptr::null_mut();
+    let mut return_size: usize = 0;
+    let mut count: u32 = 0;
+
+    let status = unsafe {
+        proxy_dequeue_shared_queue_items(
+            queue_id,
+            max_items,
+            max_size,
+            &mut return_data,
+            &mut return_size,
+            &mut count,
+        )
+    };
+
+    info!("dequeued {} items (status: {})", count, status);
+
+    if status != Status::Ok as i32 {
+        return;
+    }
+
+    let bytes = unsafe { Vec::from_raw_parts(return_data, return_size, return_size) };
+    let mut p = 0;
+
+    while p < bytes.len() {
+        let len = u32::from_le_bytes(bytes[p..p + 4].try_into().unwrap()) as usize;
+        p += 4;
+        info!(
+            "dequeued item: {}",
+            String::from_utf8_lossy(&bytes[p..p + len])
+        );
+        p += len;
+    }
+}
+
 pub(crate) fn test_shared_queue_dequeue(ctx: &TestHttp) {
     let queue_id: u32 = ctx
         .config
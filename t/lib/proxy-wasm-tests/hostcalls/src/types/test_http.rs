@@ -60,11 +60,14 @@ impl TestHttp {
             "/t/log/request_header" => test_log_request_header(self),
             "/t/log/request_headers" => test_log_request_headers(self),
             "/t/log/request_body" => test_log_request_body(self),
+            "/t/log/request_body_windows" => test_log_request_body_windows(self),
+            "/t/log/request_map_values" => test_log_request_map_values(self),
             "/t/log/response_header" => test_log_response_header(self),
             "/t/log/response_headers" => test_log_response_headers(self),
             "/t/log/response_body" => test_log_response_body(self),
             "/t/log/property" => test_log_property(self),
             "/t/log/properties" => test_log_properties(self, cur_phase),
+            "/t/log/property_handles" => test_log_property_handles(self),
             "/t/log/metrics" => test_log_metrics(self, cur_phase),
 
             /* send_local_response */
@@ -83,6 +86,7 @@ impl TestHttp {
             "/t/set_request_headers/special" => test_set_request_headers_special(self),
             "/t/set_request_headers/invalid" => test_set_request_headers_invalid(self),
             "/t/set_response_headers" => test_set_response_headers(self),
+            "/t/set_response_map_values" => test_set_response_map_values(self),
             "/t/set_request_header" => test_set_request_header(self),
             "/t/set_response_header" => test_set_response_header(self),
             "/t/add_request_header" => test_add_request_header(self),
@@ -118,11 +122,16 @@ impl TestHttp {
 
             /* shared memory */
             "/t/shm/get_shared_data" => test_get_shared_data(self),
+            "/t/shm/increment_shared_data" => test_increment_shared_data(self),
+            "/t/shm/get_kvstore_values" => test_get_shared_kvstore_values(self),
+            "/t/shm/set_kvstore_values" => test_set_shared_kvstore_values(self),
             "/t/shm/log_shared_data" => test_log_shared_data(self),
             "/t/shm/set_shared_data" => test_set_shared_data(self),
             "/t/shm/set_shared_data_by_len" => test_set_shared_data_by_len(self),
             "/t/shm/enqueue" => test_shared_queue_enqueue(self),
             "/t/shm/dequeue" => test_shared_queue_dequeue(self),
+            "/t/shm/enqueue_items" => test_shared_queue_enqueue_items(self),
+            "/t/shm/dequeue_items" => test_shared_queue_dequeue_items(self),
 
             /* metrics */
             "/t/metrics/define" => test_define_metrics(self),
@@ -113,6 +113,16 @@ eval cargo build \
 eval cp t/lib/target/$TEST_NGINX_CARGO_RUSTTARGET/$TEST_NGINX_CARGO_PROFILE/*.wasm \
     $DIR_TESTS_LIB_WASM
 
+if [[ "$($TEST_NGINX_BINARY -V 2>&1)" =~ wasmtime ]]; then
+    RUSTFLAGS= cargo build \
+        --manifest-path lib/ngx-wasm-rs/lib/compile/Cargo.toml \
+        --release
+
+    lib/ngx-wasm-rs/lib/compile/target/release/ngx-wasm-compile \
+        $DIR_TESTS_LIB_WASM/hostcalls.wasm \
+        $DIR_TESTS_LIB_WASM/hostcalls.cwasm
+fi
+
 $NGX_WASM_DIR/util/sdk.sh -S go --install
 $NGX_WASM_DIR/util/sdk.sh -S assemblyscript --install
 